@@ -104,7 +104,42 @@
 #define GL_RG                             0x8227
 #endif
 
+#include <stdlib.h>
 #include "SOIL2.h"
+
+/*	allocations go through the hooks SOIL_set_allocator was given, or the C library	*/
+static void *(*SOIL_alloc_hook)( size_t size, void *user ) = NULL;
+static void *(*SOIL_realloc_hook)( void *ptr, size_t size, void *user ) = NULL;
+static void (*SOIL_free_hook)( void *ptr, void *user ) = NULL;
+static void *SOIL_hook_user = NULL;
+
+static void *SOIL_malloc( size_t size )
+{
+	return SOIL_alloc_hook ? SOIL_alloc_hook( size, SOIL_hook_user ) : malloc( size );
+}
+
+static void *SOIL_realloc( void *ptr, size_t size )
+{
+	return SOIL_realloc_hook ? SOIL_realloc_hook( ptr, size, SOIL_hook_user ) : realloc( ptr, size );
+}
+
+static void SOIL_free( void *ptr )
+{
+	if( SOIL_free_hook )
+	{
+		SOIL_free_hook( ptr, SOIL_hook_user );
+	} else
+	{
+		free( ptr );
+	}
+}
+
+#define STBI_MALLOC(sz)           SOIL_malloc(sz)
+#define STBI_REALLOC(p,newsz)     SOIL_realloc(p,newsz)
+#define STBI_FREE(p)              SOIL_free(p)
+#define STBIW_MALLOC(sz)          SOIL_malloc(sz)
+#define STBIW_REALLOC(p,newsz)    SOIL_realloc(p,newsz)
+#define STBIW_FREE(p)             SOIL_free(p)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -118,8 +153,21 @@
 #include <stdlib.h>
 #include <string.h>
 
-/*	error reporting	*/
-const char *result_string_pointer = "SOIL initialized";
+/*	DDS files are mapped rather than read, where the platform can	*/
+#if !defined( _WIN32 ) && ( defined( __unix__ ) || defined( __APPLE__ ) )
+	#define SOIL_HAS_MMAP
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#elif defined( _WIN32 ) && !defined( SOIL_PLATFORM_WIN32 )
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif
+
+/*	error reporting, a thread's own so the asset cooker's workers each see their
+	own last result	*/
+static STBI_THREAD_LOCAL const char *result_string_pointer = "SOIL initialized";
 
 /*	for loading cube maps	*/
 enum{
@@ -180,6 +228,48 @@ static int has_BGRA8888_capability = SOIL_CAPABILITY_UNKNOWN;
 int query_BGRA8888_capability( void );
 static int has_ETC1_capability = SOIL_CAPABILITY_UNKNOWN;
 int query_ETC1_capability( void );
+/*	for BC4 / BC5 (a.k.a. ATI1 / ATI2) compression	*/
+static int has_RGTC_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_RGTC_capability( void );
+#define SOIL_GL_COMPRESSED_RED_RGTC1	0x8DBB
+#define SOIL_GL_COMPRESSED_SIGNED_RED_RGTC1	0x8DBC
+#define SOIL_GL_COMPRESSED_RG_RGTC2		0x8DBD
+#define SOIL_GL_COMPRESSED_SIGNED_RG_RGTC2	0x8DBE
+/*	for BC6H / BC7, which only come in DX10 DDS files	*/
+static int has_BPTC_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_BPTC_capability( void );
+#define SOIL_GL_COMPRESSED_RGBA_BPTC_UNORM			0x8E8C
+#define SOIL_GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM	0x8E8D
+#define SOIL_GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT	0x8E8E
+#define SOIL_GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT	0x8E8F
+#define SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT	0x8C4D
+#define SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT	0x8C4E
+#define SOIL_GL_RGBA8			0x8058
+#define SOIL_GL_SRGB8_ALPHA8	0x8C43
+#define SOIL_TEXTURE_MAX_LEVEL	0x813D
+/*	for DDS texture arrays and cubemap arrays	*/
+static int has_texture_array_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_texture_array_capability( void );
+static int has_cubemap_array_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_cubemap_array_capability( void );
+#define SOIL_TEXTURE_2D_ARRAY			0x8C1A
+#define SOIL_TEXTURE_CUBE_MAP_ARRAY		0x9009
+typedef void (APIENTRY * P_SOIL_GLTEXIMAGE3DPROC) (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const GLvoid *pixels);
+typedef void (APIENTRY * P_SOIL_GLTEXSUBIMAGE3DPROC) (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const GLvoid *pixels);
+typedef void (APIENTRY * P_SOIL_GLCOMPRESSEDTEXIMAGE3DPROC) (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei imageSize, const GLvoid *data);
+typedef void (APIENTRY * P_SOIL_GLCOMPRESSEDTEXSUBIMAGE3DPROC) (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize, const GLvoid *data);
+static P_SOIL_GLTEXIMAGE3DPROC soilGlTexImage3D = NULL;
+static P_SOIL_GLTEXSUBIMAGE3DPROC soilGlTexSubImage3D = NULL;
+static P_SOIL_GLCOMPRESSEDTEXIMAGE3DPROC soilGlCompressedTexImage3D = NULL;
+static P_SOIL_GLCOMPRESSEDTEXSUBIMAGE3DPROC soilGlCompressedTexSubImage3D = NULL;
+
+/*	for HDR textures in shared exponent or half float	*/
+static int has_HDR_capability = SOIL_CAPABILITY_UNKNOWN;
+int query_HDR_capability( void );
+#define SOIL_GL_RGB9_E5					0x8C3D
+#define SOIL_GL_UNSIGNED_INT_5_9_9_9_REV	0x8C3E
+#define SOIL_GL_RGBA16F					0x881A
+#define SOIL_GL_HALF_FLOAT				0x140B
 
 /* GL_IMG_texture_compression_pvrtc */
 #define SOIL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG                      0x8C00
@@ -369,6 +459,7 @@ unsigned int
 		unsigned int opengl_texture_target,
 		unsigned int texture_check_size_enum
 	);
+void check_for_GL_errors( const char *calling_location );
 
 /*	and the code magic begins here [8^)	*/
 unsigned int
@@ -444,6 +535,88 @@ unsigned int
 	return tex_id;
 }
 
+/*	converts RGBE texels (in place when it can) and uploads them as
+	an RGB9_E5 or RGBA16F texture	*/
+static unsigned int SOIL_create_OGL_HDR_texture(
+		unsigned char *rgbe,
+		int width, int height,
+		int HDR_format,
+		unsigned int reuse_texture_ID,
+		unsigned int flags )
+{
+	unsigned short *half = NULL;
+	unsigned int tex_id = reuse_texture_ID;
+	int unpack_aligment;
+	if( query_HDR_capability() != SOIL_CAPABILITY_PRESENT )
+	{
+		result_string_pointer = "Shared exponent or half float textures not supported by the OpenGL driver";
+		return 0;
+	}
+	if( HDR_format == SOIL_HDR_RGB9_E5 )
+	{
+		/*	same 4 bytes a texel, the result can go over the source	*/
+		RGBE_to_RGB9_E5( rgbe, (unsigned int*)rgbe, width * height );
+	} else
+	{
+		half = (unsigned short*)SOIL_malloc( width * height * 4 * sizeof( unsigned short ) );
+		if( NULL == half )
+		{
+			result_string_pointer = "Out of memory";
+			return 0;
+		}
+		RGBE_to_RGBA16F( rgbe, half, width * height );
+	}
+	if( tex_id == 0 )
+	{
+		glGenTextures( 1, &tex_id );
+	}
+	check_for_GL_errors( "glGenTextures" );
+	if( tex_id )
+	{
+		glGetIntegerv( GL_UNPACK_ALIGNMENT, &unpack_aligment );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+		glBindTexture( GL_TEXTURE_2D, tex_id );
+		if( HDR_format == SOIL_HDR_RGB9_E5 )
+		{
+			glTexImage2D( GL_TEXTURE_2D, 0, SOIL_GL_RGB9_E5, width, height, 0,
+					GL_RGB, SOIL_GL_UNSIGNED_INT_5_9_9_9_REV, rgbe );
+		} else
+		{
+			glTexImage2D( GL_TEXTURE_2D, 0, SOIL_GL_RGBA16F, width, height, 0,
+					GL_RGBA, SOIL_GL_HALF_FLOAT, half );
+		}
+		check_for_GL_errors( "glTexImage2D" );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_aligment );
+		/*	mipmaps can only come from the driver, the CPU filters are 8 bit	*/
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		if( (flags & (SOIL_FLAG_MIPMAPS | SOIL_FLAG_GL_MIPMAPS)) &&
+			(query_gen_mipmap_capability() == SOIL_CAPABILITY_PRESENT) )
+		{
+			soilGlGenerateMipmap( GL_TEXTURE_2D );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+		} else
+		{
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		}
+		if( flags & SOIL_FLAG_TEXTURE_REPEATS )
+		{
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+		} else
+		{
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, SOIL_CLAMP_TO_EDGE );
+			glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, SOIL_CLAMP_TO_EDGE );
+		}
+		check_for_GL_errors( "GL_TEXTURE_WRAP_*" );
+		result_string_pointer = "Image loaded as an OpenGL texture";
+	} else
+	{
+		result_string_pointer = "Failed to generate an OpenGL texture name; missing OpenGL context?";
+	}
+	SOIL_free( half );
+	return tex_id;
+}
+
 unsigned int
 	SOIL_load_OGL_HDR_texture
 	(
@@ -456,13 +629,15 @@ unsigned int
 {
 	/*	variables	*/
 	unsigned char* img = NULL;
-	int width, height, channels;
+	int width, height, channels = 4;
 	unsigned int tex_id;
 	/*	no direct uploading of the image as a DDS file	*/
 	/* error check */
 	if( (fake_HDR_format != SOIL_HDR_RGBE) &&
 		(fake_HDR_format != SOIL_HDR_RGBdivA) &&
-		(fake_HDR_format != SOIL_HDR_RGBdivA2) )
+		(fake_HDR_format != SOIL_HDR_RGBdivA2) &&
+		(fake_HDR_format != SOIL_HDR_RGB9_E5) &&
+		(fake_HDR_format != SOIL_HDR_HALF) )
 	{
 		result_string_pointer = "Invalid fake HDR format specified";
 		return 0;
@@ -471,8 +646,9 @@ unsigned int
 	/* check if the image is HDR */
 	if ( stbi_is_hdr( filename ) )
 	{
-		/*	try to load the image (only the HDR type) */
-		img = stbi_load( filename, &width, &height, &channels, 4 );
+		/*	try to load the image (only the HDR type) as the raw RGBE
+			bytes, stbi_load would tone map it down to LDR	*/
+		img = stbi_load_rgbe( filename, &width, &height );
 	}
 
 	/*	channels holds the original number of channels, which may have been forced	*/
@@ -482,6 +658,14 @@ unsigned int
 		result_string_pointer = stbi_failure_reason();
 		return 0;
 	}
+	/*	the real HDR formats skip the LDR texture path	*/
+	if( (fake_HDR_format == SOIL_HDR_RGB9_E5) || (fake_HDR_format == SOIL_HDR_HALF) )
+	{
+		tex_id = SOIL_create_OGL_HDR_texture( img, width, height,
+				fake_HDR_format, reuse_texture_ID, flags );
+		SOIL_free_image_data( img );
+		return tex_id;
+	}
 	/* the load worked, do I need to convert it? */
 	if( fake_HDR_format == SOIL_HDR_RGBdivA )
 	{
@@ -1241,7 +1425,7 @@ unsigned int
 		dh = width;
 	}
 	sz = dw+dh;
-	sub_img = (unsigned char *)malloc( sz*sz*channels );
+	sub_img = (unsigned char *)SOIL_malloc( sz*sz*channels );
 	/*	do the splitting and uploading	*/
 	tex_id = reuse_texture_ID;
 	for( i = 0; i < 6; ++i )
@@ -1346,7 +1530,7 @@ static void createMipmaps(const unsigned char *const img,
 		int MIPlevel = 1;
 		int MIPwidth = (width+1) / 2;
 		int MIPheight = (height+1) / 2;
-		unsigned char *resampled = (unsigned char*)malloc( channels*MIPwidth*MIPheight );
+		unsigned char *resampled = (unsigned char*)SOIL_malloc( channels*MIPwidth*MIPheight );
 
 		while( ((1<<MIPlevel) <= width) || ((1<<MIPlevel) <= height) )
 		{
@@ -1484,7 +1668,7 @@ unsigned int
 
 	/*	create a copy the image data only if needed */
 	if ( needCopy ) {
-		img = (unsigned char*)malloc( iwidth*iheight*channels );
+		img = (unsigned char*)SOIL_malloc( iwidth*iheight*channels );
 		memcpy( img, data, iwidth*iheight*channels );
 	}
 
@@ -1562,7 +1746,7 @@ unsigned int
 		if( (new_width != iwidth) || (new_height != iheight) )
 		{
 			/*	yep, resize	*/
-			unsigned char *resampled = (unsigned char*)malloc( channels*new_width*new_height );
+			unsigned char *resampled = (unsigned char*)SOIL_malloc( channels*new_width*new_height );
 			up_scale_image(
 					NULL != img ? img : data, iwidth, iheight, channels,
 					resampled, new_width, new_height );
@@ -1594,7 +1778,7 @@ unsigned int
 		}
 		new_width = iwidth / reduce_block_x;
 		new_height = iheight / reduce_block_y;
-		resampled = (unsigned char*)malloc( channels*new_width*new_height );
+		resampled = (unsigned char*)SOIL_malloc( channels*new_width*new_height );
 		/*	perform the actual reduction	*/
 		mipmap_image( NULL != img ? img : data, iwidth, iheight, channels,
 						resampled, reduce_block_x, reduce_block_y );
@@ -1826,7 +2010,7 @@ int
 	}
 
 	/*  Get the data from OpenGL	*/
-	pixel_data = (unsigned char*)malloc( 3*width*height );
+	pixel_data = (unsigned char*)SOIL_malloc( 3*width*height );
 	glReadPixels (x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixel_data);
 
 	if ( 1 != pack_aligment )
@@ -1865,8 +2049,40 @@ unsigned char*
 		int force_channels
 	)
 {
-	unsigned char *result = stbi_load( filename,
-			width, height, channels, force_channels );
+	FILE *f;
+	unsigned char *buffer;
+	unsigned char *result;
+	size_t buffer_length, bytes_read;
+	/*	decode from memory where possible, stb_image can only split
+		big JPEGs across threads when it has the whole file	*/
+	f = (NULL != filename) ? fopen( filename, "rb" ) : NULL;
+	buffer = NULL;
+	if( NULL != f )
+	{
+		fseek( f, 0, SEEK_END );
+		buffer_length = ftell( f );
+		fseek( f, 0, SEEK_SET );
+		buffer = (unsigned char *) SOIL_malloc( buffer_length );
+		if( NULL != buffer )
+		{
+			bytes_read = fread( (void*)buffer, 1, buffer_length, f );
+			if( bytes_read < buffer_length )
+			{
+				buffer_length = bytes_read;
+			}
+		}
+		fclose( f );
+	}
+	if( NULL != buffer )
+	{
+		result = stbi_load_from_memory( buffer, (int)buffer_length,
+				width, height, channels, force_channels );
+		SOIL_free_image_data( buffer );
+	} else
+	{
+		result = stbi_load( filename,
+				width, height, channels, force_channels );
+	}
 	if( result == NULL )
 	{
 		result_string_pointer = stbi_failure_reason();
@@ -1900,6 +2116,179 @@ unsigned char*
 	return result;
 }
 
+int
+	SOIL_get_image_size
+	(
+		const char *filename,
+		int *width, int *height, int *channels
+	)
+{
+	int w = 0, h = 0, c = 0;
+	/*	error checks	*/
+	if( NULL == filename )
+	{
+		result_string_pointer = "NULL filename";
+		return 0;
+	}
+	/*	stb_image reads just enough of the header	*/
+	if( !stbi_info( filename, &w, &h, &c ) )
+	{
+		result_string_pointer = stbi_failure_reason();
+		return 0;
+	}
+	if( width )
+	{
+		*width = w;
+	}
+	if( height )
+	{
+		*height = h;
+	}
+	if( channels )
+	{
+		*channels = c;
+	}
+	result_string_pointer = "Image size read";
+	return 1;
+}
+
+int
+	SOIL_get_image_size_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels
+	)
+{
+	int w = 0, h = 0, c = 0;
+	/*	error checks	*/
+	if( NULL == buffer )
+	{
+		result_string_pointer = "NULL buffer";
+		return 0;
+	}
+	if( !stbi_info_from_memory( buffer, buffer_length, &w, &h, &c ) )
+	{
+		result_string_pointer = stbi_failure_reason();
+		return 0;
+	}
+	if( width )
+	{
+		*width = w;
+	}
+	if( height )
+	{
+		*height = h;
+	}
+	if( channels )
+	{
+		*channels = c;
+	}
+	result_string_pointer = "Image size read";
+	return 1;
+}
+
+unsigned char*
+	SOIL_load_image_scaled
+	(
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels,
+		int scale_denom
+	)
+{
+	FILE *f;
+	unsigned char *buffer;
+	unsigned char *result;
+	size_t buffer_length, bytes_read;
+	/*	error checks	*/
+	if( NULL == filename )
+	{
+		result_string_pointer = "NULL filename";
+		return NULL;
+	}
+	f = fopen( filename, "rb" );
+	if( NULL == f )
+	{
+		result_string_pointer = "Unable to open file";
+		return NULL;
+	}
+	fseek( f, 0, SEEK_END );
+	buffer_length = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	buffer = (unsigned char *) SOIL_malloc( buffer_length );
+	if( NULL == buffer )
+	{
+		result_string_pointer = "malloc failed";
+		fclose( f );
+		return NULL;
+	}
+	bytes_read = fread( (void*)buffer, 1, buffer_length, f );
+	fclose( f );
+	if( bytes_read < buffer_length )
+	{
+		buffer_length = bytes_read;
+	}
+	result = SOIL_load_image_scaled_from_memory(
+				buffer, (int)buffer_length,
+				width, height, channels,
+				force_channels, scale_denom );
+	SOIL_free_image_data( buffer );
+	return result;
+}
+
+unsigned char*
+	SOIL_load_image_scaled_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels,
+		int scale_denom
+	)
+{
+	int full_width = 0, full_height = 0, full_channels = 0;
+	int block, block_x, block_y, out_channels;
+	unsigned char *result, *resampled;
+	/*	same rounding of scale_denom as stb_image: 2, 4 or 8	*/
+	block = (scale_denom >= 8) ? 8 : (scale_denom >= 4) ? 4 : (scale_denom >= 2) ? 2 : 1;
+	stbi_info_from_memory( buffer, buffer_length, &full_width, &full_height, &full_channels );
+	result = stbi_load_scaled_from_memory(
+				buffer, buffer_length,
+				width, height, channels,
+				force_channels, block );
+	if( result == NULL )
+	{
+		result_string_pointer = stbi_failure_reason();
+		return NULL;
+	}
+	result_string_pointer = "Image loaded from memory";
+	if( (block == 1) || (*width != full_width) || (*height != full_height) )
+	{
+		/*	already at the reduced size (JPEG)	*/
+		return result;
+	}
+	/*	only JPEGs decode scaled, box filter everything else down	*/
+	block_x = (block < *width) ? block : *width;
+	block_y = (block < *height) ? block : *height;
+	if( (block_x == 1) && (block_y == 1) )
+	{
+		return result;
+	}
+	out_channels = force_channels ? force_channels : *channels;
+	resampled = (unsigned char*)SOIL_malloc( out_channels * (*width / block_x) * (*height / block_y) );
+	if( NULL == resampled )
+	{
+		result_string_pointer = "malloc failed";
+		SOIL_free_image_data( result );
+		return NULL;
+	}
+	mipmap_image( result, *width, *height, out_channels, resampled, block_x, block_y );
+	SOIL_free_image_data( result );
+	*width /= block_x;
+	*height /= block_y;
+	return resampled;
+}
 
 int
 	SOIL_save_image
@@ -1948,6 +2337,45 @@ int
 		save_result = save_image_as_DDS( filename,
 				width, height, channels, (const unsigned char *const)data );
 	} else
+	if( image_type == SOIL_SAVE_TYPE_DDS_BC4 )
+	{
+		save_result = save_image_as_DDS_BC4( filename,
+				width, height, channels, (const unsigned char *const)data );
+	} else
+	if( image_type == SOIL_SAVE_TYPE_DDS_BC5 )
+	{
+		save_result = save_image_as_DDS_BC5( filename,
+				width, height, channels, (const unsigned char *const)data );
+	} else
+	if( image_type == SOIL_SAVE_TYPE_DDS_YCOCG )
+	{
+		save_result = save_image_as_DDS_YCoCg( filename,
+				width, height, channels, (const unsigned char *const)data );
+	} else
+	if( image_type == SOIL_SAVE_TYPE_DDS_MIPMAPS )
+	{
+		/*	DXT1 without alpha, DXT5 with it	*/
+		save_result = save_image_as_DDS_mipmapped( filename,
+				width, height, channels,
+				((channels & 1) == 1) ?
+					(('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24)) :
+					(('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24)),
+				(const unsigned char *const)data );
+	} else
+	if( image_type == SOIL_SAVE_TYPE_DDS_BC4_MIPMAPS )
+	{
+		save_result = save_image_as_DDS_mipmapped( filename,
+				width, height, channels,
+				('A' << 0) | ('T' << 8) | ('I' << 16) | ('1' << 24),
+				(const unsigned char *const)data );
+	} else
+	if( image_type == SOIL_SAVE_TYPE_DDS_BC5_MIPMAPS )
+	{
+		save_result = save_image_as_DDS_mipmapped( filename,
+				width, height, channels,
+				('A' << 0) | ('T' << 8) | ('I' << 16) | ('2' << 24),
+				(const unsigned char *const)data );
+	} else
 	if( image_type == SOIL_SAVE_TYPE_PNG )
 	{
 		save_result = stbi_write_png( filename,
@@ -1972,135 +2400,1021 @@ int
 	return save_result;
 }
 
-void
-	SOIL_free_image_data
-	(
-		unsigned char *img_data
-	)
+/*	resamples RGBE texels (converted in place) to 6 faces of RGB9_E5 or
+	RGBA16F, one after the other, freed with SOIL_free_image_data	*/
+static unsigned char *SOIL_HDR_cube_faces(
+		unsigned char *rgbe,
+		int width, int height,
+		int HDR_format,
+		int face_size )
 {
-	if ( img_data )
-		free( (void*)img_data );
+	unsigned char *faces;
+	float *face_rgb;
+	int face, i, texel_size, face_texels;
+	texel_size = (HDR_format == SOIL_HDR_RGB9_E5) ? 4 : 8;
+	face_texels = face_size * face_size;
+	faces = (unsigned char*)SOIL_malloc( face_texels * texel_size * 6 );
+	face_rgb = (float*)SOIL_malloc( face_texels * 3 * sizeof( float ) );
+	if( (NULL == faces) || (NULL == face_rgb) )
+	{
+		SOIL_free( faces );
+		SOIL_free( face_rgb );
+		result_string_pointer = "Out of memory";
+		return NULL;
+	}
+	/*	the source is resampled from RGB9_E5, which holds every RGBE texel
+		of a sane exposure exactly in the same space	*/
+	RGBE_to_RGB9_E5( rgbe, (unsigned int*)rgbe, width * height );
+	for( face = 0; face < 6; ++face )
+	{
+		equirectangular_to_cube_face( (const unsigned int*)rgbe, width, height,
+				face, face_size, face_rgb );
+		if( HDR_format == SOIL_HDR_RGB9_E5 )
+		{
+			unsigned int *out = (unsigned int*)faces + face * face_texels;
+			for( i = 0; i < face_texels; ++i )
+			{
+				out[i] = float_to_RGB9_E5( face_rgb[i*3+0], face_rgb[i*3+1], face_rgb[i*3+2] );
+			}
+		} else
+		{
+			unsigned short *out = (unsigned short*)faces + face * face_texels * 4;
+			for( i = 0; i < face_texels; ++i )
+			{
+				out[i*4+0] = float_to_half( face_rgb[i*3+0] );
+				out[i*4+1] = float_to_half( face_rgb[i*3+1] );
+				out[i*4+2] = float_to_half( face_rgb[i*3+2] );
+				out[i*4+3] = 0x3C00;
+			}
+		}
+	}
+	SOIL_free( face_rgb );
+	return faces;
 }
 
-const char*
-	SOIL_last_result
+/*	shared by the HDR cubemap loaders once the RGBE texels are decoded	*/
+static unsigned char *SOIL_load_HDR_cubemap_rgbe(
+		unsigned char *rgbe,
+		int width, int height,
+		int HDR_format,
+		int *face_size )
+{
+	unsigned char *faces;
+	if( NULL == rgbe )
+	{
+		result_string_pointer = stbi_failure_reason();
+		return NULL;
+	}
+	/*	an equirectangular map is 2:1, so a face is a quarter of it across	*/
+	if( *face_size == 0 )
+	{
+		*face_size = (width >= 4) ? (width / 4) : 1;
+	}
+	faces = SOIL_HDR_cube_faces( rgbe, width, height, HDR_format, *face_size );
+	SOIL_free_image_data( rgbe );
+	if( faces )
+	{
+		result_string_pointer = "HDR cubemap converted";
+	}
+	return faces;
+}
+
+unsigned char*
+	SOIL_load_HDR_cubemap
 	(
-		void
+		const char *HDR_filename,
+		int HDR_format,
+		int *face_size
 	)
 {
-	return result_string_pointer;
+	unsigned char *rgbe;
+	int width, height;
+	/*	error check	*/
+	if( (NULL == HDR_filename) || (NULL == face_size) ||
+		((HDR_format != SOIL_HDR_RGB9_E5) && (HDR_format != SOIL_HDR_HALF)) ||
+		(*face_size < 0) )
+	{
+		result_string_pointer = "Invalid parameters to load the HDR cubemap";
+		return NULL;
+	}
+	rgbe = stbi_load_rgbe( HDR_filename, &width, &height );
+	return SOIL_load_HDR_cubemap_rgbe( rgbe, width, height, HDR_format, face_size );
 }
 
-unsigned int SOIL_direct_load_DDS_from_memory(
+unsigned char*
+	SOIL_load_HDR_cubemap_from_memory
+	(
 		const unsigned char *const buffer,
 		int buffer_length,
-		unsigned int reuse_texture_ID,
-		int flags,
-		int loading_as_cubemap )
+		int HDR_format,
+		int *face_size
+	)
 {
-	/*	variables	*/
-	DDS_header header;
-	unsigned int buffer_index = 0;
-	unsigned int tex_ID = 0;
-	/*	file reading variables	*/
-	unsigned int S3TC_type = 0;
-	unsigned char *DDS_data;
-	unsigned int DDS_main_size;
-	unsigned int DDS_full_size;
-	unsigned int width, height;
-	int mipmaps, cubemap, uncompressed, block_size = 16;
-	unsigned int flag;
-	unsigned int cf_target, ogl_target_start, ogl_target_end;
-	unsigned int opengl_texture_type;
-	int i;
-	/*	1st off, does the filename even exist?	*/
-	if( NULL == buffer )
+	unsigned char *rgbe;
+	int width, height;
+	/*	error check	*/
+	if( (NULL == buffer) || (NULL == face_size) ||
+		((HDR_format != SOIL_HDR_RGB9_E5) && (HDR_format != SOIL_HDR_HALF)) ||
+		(*face_size < 0) )
 	{
-		/*	we can't do it!	*/
-		result_string_pointer = "NULL buffer";
-		return 0;
+		result_string_pointer = "Invalid parameters to load the HDR cubemap";
+		return NULL;
 	}
-	if( buffer_length < sizeof( DDS_header ) )
-	{
-		/*	we can't do it!	*/
-		result_string_pointer = "DDS file was too small to contain the DDS header";
+	rgbe = stbi_load_rgbe_from_memory( buffer, buffer_length, &width, &height );
+	return SOIL_load_HDR_cubemap_rgbe( rgbe, width, height, HDR_format, face_size );
+}
+
+int
+	SOIL_save_HDR_cubemap
+	(
+		const char *filename,
+		const char *HDR_filename,
+		int HDR_format,
+		int face_size
+	)
+{
+	unsigned char *faces;
+	int save_result;
+	/*	error check	*/
+	if( NULL == filename )
+	{
+		result_string_pointer = "Invalid parameters to save the HDR cubemap";
+		return 0;
+	}
+	faces = SOIL_load_HDR_cubemap( HDR_filename, HDR_format, &face_size );
+	if( NULL == faces )
+	{
+		return 0;
+	}
+	save_result = save_image_as_DDS_DX10( filename, face_size, face_size, 6,
+			(HDR_format == SOIL_HDR_RGB9_E5) ? DXGI_FORMAT_R9G9B9E5_SHAREDEXP : DXGI_FORMAT_R16G16B16A16_FLOAT,
+			faces );
+	SOIL_free( faces );
+	result_string_pointer = save_result ? "Image saved" : "Saving the image failed";
+	return save_result;
+}
+
+int
+	SOIL_save_cubemap
+	(
+		const char *filename,
+		const char *x_pos_file,
+		const char *x_neg_file,
+		const char *y_pos_file,
+		const char *y_neg_file,
+		const char *z_pos_file,
+		const char *z_neg_file
+	)
+{
+	const char *face_files[6];
+	unsigned char *faces = NULL, *img;
+	int width, height, channels, face_size = 0, face;
+	int save_result;
+	/*	error check	*/
+	if( NULL == filename )
+	{
+		result_string_pointer = "Invalid parameters to save the cubemap";
+		return 0;
+	}
+	face_files[0] = x_pos_file;
+	face_files[1] = x_neg_file;
+	face_files[2] = y_pos_file;
+	face_files[3] = y_neg_file;
+	face_files[4] = z_pos_file;
+	face_files[5] = z_neg_file;
+	for( face = 0; face < 6; ++face )
+	{
+		img = SOIL_load_image( face_files[face], &width, &height, &channels, SOIL_LOAD_RGBA );
+		if( NULL == img )
+		{
+			SOIL_free( faces );
+			return 0;
+		}
+		if( face == 0 )
+		{
+			face_size = width;
+			faces = (unsigned char*)SOIL_malloc( face_size * face_size * 4 * 6 );
+		}
+		if( (NULL == faces) || (width != face_size) || (height != face_size) )
+		{
+			result_string_pointer = faces ? "Cubemap faces have to be square and the same size" : "Out of memory";
+			SOIL_free_image_data( img );
+			SOIL_free( faces );
+			return 0;
+		}
+		memcpy( faces + face * face_size * face_size * 4, img, face_size * face_size * 4 );
+		SOIL_free_image_data( img );
+	}
+	save_result = save_image_as_DDS_DX10( filename, face_size, face_size, 6,
+			DXGI_FORMAT_R8G8B8A8_UNORM, faces );
+	SOIL_free( faces );
+	result_string_pointer = save_result ? "Image saved" : "Saving the image failed";
+	return save_result;
+}
+
+void
+	SOIL_free_image_data
+	(
+		unsigned char *img_data
+	)
+{
+	if ( img_data )
+		SOIL_free( (void*)img_data );
+}
+
+void
+	SOIL_set_allocator
+	(
+		void *(*alloc_fn)( size_t size, void *user ),
+		void *(*realloc_fn)( void *ptr, size_t size, void *user ),
+		void (*free_fn)( void *ptr, void *user ),
+		void *user
+	)
+{
+	SOIL_alloc_hook = alloc_fn;
+	SOIL_realloc_hook = realloc_fn;
+	SOIL_free_hook = free_fn;
+	SOIL_hook_user = user;
+}
+
+const char*
+	SOIL_last_result
+	(
+		void
+	)
+{
+	return result_string_pointer;
+}
+
+/*	DXT files are the one cooked format for every driver: without S3TC
+	they are transcoded at load, to ETC1 where that is supported (opaque
+	2D textures and cubemaps), otherwise to RGBA8	*/
+#define SOIL_DDS_TRANSCODE_NONE	0
+#define SOIL_DDS_TRANSCODE_ETC1	1
+#define SOIL_DDS_TRANSCODE_RGBA	2
+/*	levels with fewer blocks than this are transcoded on one thread	*/
+#define SOIL_DDS_TRANSCODE_BLOCKS_PER_THREAD	4096
+
+/*	what the DDS loaders need to know about a file, filled in by SOIL_parse_DDS	*/
+typedef struct
+{
+	unsigned int width, height;
+	int mipmaps;				/*	levels stored for each face, at least 1	*/
+	int faces;					/*	6 for cubemaps, otherwise 1	*/
+	int layers;					/*	array elements, each one holds all the faces	*/
+	int compressed;
+	int block_size;				/*	bytes per 4x4 block, or per pixel when uncompressed	*/
+	int swap_red_blue;			/*	uncompressed BGR(A) data	*/
+	unsigned int internal_format, format;
+	unsigned int type;			/*	the pixel type of uncompressed data	*/
+	int transcode;				/*	SOIL_DDS_TRANSCODE_*, when the driver can't take the blocks	*/
+	int DXT_family;				/*	1, 3 or 5 for the DXT blocks being transcoded	*/
+	unsigned int data_offset;	/*	where the 1st face starts	*/
+	unsigned int face_size;		/*	one face with all of its mipmaps	*/
+}
+SOIL_DDS_info;
+
+static unsigned int SOIL_DDS_level_size( const SOIL_DDS_info *info, int level )
+{
+	unsigned int w = info->width >> level;
+	unsigned int h = info->height >> level;
+	if( w < 1 )
+	{
+		w = 1;
+	}
+	if( h < 1 )
+	{
+		h = 1;
+	}
+	if( info->compressed )
+	{
+		/*	compressed DDS, MIPmap size calculation is block based	*/
+		return ((w+3)>>2)*((h+3)>>2)*info->block_size;
+	}
+	/*	uncompressed DDS, simple MIPmap size calculation	*/
+	return w*h*info->block_size;
+}
+
+/*	drops the largest levels of every face, as if the file's chain
+	started further down.  The smallest level is always kept	*/
+static void SOIL_DDS_skip_mipmaps( SOIL_DDS_info *info, int skip )
+{
+	int i;
+	if( skip > info->mipmaps - 1 )
+	{
+		skip = info->mipmaps - 1;
+	}
+	if( skip < 1 )
+	{
+		return;
+	}
+	for( i = 0; i < skip; ++i )
+	{
+		info->data_offset += SOIL_DDS_level_size( info, i );
+	}
+	info->width >>= skip;
+	info->height >>= skip;
+	if( info->width < 1 )
+	{
+		info->width = 1;
+	}
+	if( info->height < 1 )
+	{
+		info->height = 1;
+	}
+	info->mipmaps -= skip;
+}
+
+/*	sets up a DXT texture the driver can't take to be decoded to RGBA8	*/
+static void SOIL_DDS_transcode_to_RGBA( SOIL_DDS_info *info, int srgb )
+{
+	info->transcode = SOIL_DDS_TRANSCODE_RGBA;
+	info->format = GL_RGBA;
+	#if defined( SOIL_GLES1 ) || defined( SOIL_GLES2 )
+	info->internal_format = GL_RGBA;
+	#else
+	info->internal_format = (srgb && (query_sRGB_capability() == SOIL_CAPABILITY_PRESENT)) ?
+		SOIL_GL_SRGB8_ALPHA8 : SOIL_GL_RGBA8;
+	#endif
+}
+
+/*	picks what DXT blocks become when there is no S3TC, ETC1 has no
+	alpha and no arrays so only DXT1 single textures go there (and
+	only if none of their blocks turn out to use the transparent texel,
+	see SOIL_DDS_check_transcode).  Returns the capability to check	*/
+static int SOIL_DDS_pick_transcode( SOIL_DDS_info *info, int DXT_family, int srgb )
+{
+	info->DXT_family = DXT_family;
+	if( (DXT_family == 1) && (info->layers == 1) &&
+		(query_ETC1_capability() == SOIL_CAPABILITY_PRESENT) )
+	{
+		info->transcode = SOIL_DDS_TRANSCODE_ETC1;
+		info->internal_format = SOIL_GL_ETC1_RGB8_OES;
+	} else
+	{
+		SOIL_DDS_transcode_to_RGBA( info, srgb );
+	}
+	return SOIL_CAPABILITY_PRESENT;
+}
+
+/*	DXT1 punch-through alpha would turn black in ETC1, so any block
+	with c0 <= c1 that picks the 4th color sends the file to RGBA8	*/
+static void SOIL_DDS_check_transcode(
+		const unsigned char *data,
+		unsigned int size,
+		SOIL_DDS_info *info,
+		int srgb )
+{
+	unsigned int i;
+	if( info->transcode != SOIL_DDS_TRANSCODE_ETC1 )
+	{
+		return;
+	}
+	for( i = 0; i + 8 <= size; i += 8 )
+	{
+		unsigned int c0 = data[i+0] | (data[i+1] << 8);
+		unsigned int c1 = data[i+2] | (data[i+3] << 8);
+		unsigned int indices = data[i+4] | (data[i+5] << 8) | (data[i+6] << 16) | ((unsigned int)data[i+7] << 24);
+		/*	a 2 bit index of 3 has both bits set	*/
+		if( (c0 <= c1) && (indices & (indices >> 1) & 0x55555555) )
+		{
+			SOIL_DDS_transcode_to_RGBA( info, srgb );
+			return;
+		}
+	}
+}
+
+/*	picks the OpenGL format for a DX10 header, 0 if it can't be uploaded	*/
+static int SOIL_DDS_DXGI_format( unsigned int dxgi_format, int *srgb, SOIL_DDS_info *info )
+{
+	int capability = query_DXT_capability();
+	int DXT_family = 0;
+	info->compressed = 1;
+	info->block_size = 16;
+	*srgb = 0;
+	switch( dxgi_format )
+	{
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		*srgb = 1;
+		/*	fall through	*/
+	case DXGI_FORMAT_BC1_UNORM:
+		info->internal_format = *srgb ? SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : SOIL_RGBA_S3TC_DXT1;
+		info->block_size = 8;
+		DXT_family = 1;
+		break;
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+		*srgb = 1;
+		/*	fall through	*/
+	case DXGI_FORMAT_BC2_UNORM:
+		info->internal_format = *srgb ? SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT : SOIL_RGBA_S3TC_DXT3;
+		DXT_family = 3;
+		break;
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		*srgb = 1;
+		/*	fall through	*/
+	case DXGI_FORMAT_BC3_UNORM:
+		info->internal_format = *srgb ? SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : SOIL_RGBA_S3TC_DXT5;
+		DXT_family = 5;
+		break;
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		info->internal_format = (dxgi_format == DXGI_FORMAT_BC4_UNORM) ? SOIL_GL_COMPRESSED_RED_RGTC1 : SOIL_GL_COMPRESSED_SIGNED_RED_RGTC1;
+		info->block_size = 8;
+		capability = query_RGTC_capability();
+		break;
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+		info->internal_format = (dxgi_format == DXGI_FORMAT_BC5_UNORM) ? SOIL_GL_COMPRESSED_RG_RGTC2 : SOIL_GL_COMPRESSED_SIGNED_RG_RGTC2;
+		capability = query_RGTC_capability();
+		break;
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+		info->internal_format = (dxgi_format == DXGI_FORMAT_BC6H_UF16) ? SOIL_GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT : SOIL_GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
+		capability = query_BPTC_capability();
+		break;
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		*srgb = 1;
+		/*	fall through	*/
+	case DXGI_FORMAT_BC7_UNORM:
+		info->internal_format = *srgb ? SOIL_GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : SOIL_GL_COMPRESSED_RGBA_BPTC_UNORM;
+		capability = query_BPTC_capability();
+		break;
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		*srgb = 1;
+		/*	fall through	*/
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+		info->internal_format = *srgb ? SOIL_GL_SRGB8_ALPHA8 : SOIL_GL_RGBA8;
+		info->format = GL_RGBA;
+		info->compressed = 0;
+		info->block_size = 4;
+		info->swap_red_blue = (dxgi_format == DXGI_FORMAT_B8G8R8A8_UNORM) || (dxgi_format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB);
+		capability = SOIL_CAPABILITY_PRESENT;
+		break;
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+		info->internal_format = SOIL_GL_RGB9_E5;
+		info->format = GL_RGB;
+		info->type = SOIL_GL_UNSIGNED_INT_5_9_9_9_REV;
+		info->compressed = 0;
+		info->block_size = 4;
+		capability = query_HDR_capability();
+		break;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		info->internal_format = SOIL_GL_RGBA16F;
+		info->format = GL_RGBA;
+		info->type = SOIL_GL_HALF_FLOAT;
+		info->compressed = 0;
+		info->block_size = 8;
+		capability = query_HDR_capability();
+		break;
+	default:
+		result_string_pointer = "DDS file has a DXGI format that can not be uploaded";
+		return 0;
+	}
+	if( (capability != SOIL_CAPABILITY_PRESENT) && DXT_family )
+	{
+		capability = SOIL_DDS_pick_transcode( info, DXT_family, *srgb );
+	}
+	if( capability != SOIL_CAPABILITY_PRESENT )
+	{
+		result_string_pointer = "Direct upload of this DDS format not supported by the OpenGL driver";
+		return 0;
+	}
+	return 1;
+}
+
+/*	validates a DDS header (and the DX10 one if present), and works out
+	where everything is.  Returns 0 and sets the result string on failure	*/
+static int SOIL_parse_DDS(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int flags,
+		SOIL_DDS_info *info )
+{
+	DDS_header header;
+	DDS_header_DXT10 header10;
+	unsigned int flag, FourCC;
+	double face_bytes = 0.0;
+	int i, srgb = 0;
+	memset( info, 0, sizeof( SOIL_DDS_info ) );
+	info->type = GL_UNSIGNED_BYTE;
+	if( NULL == buffer )
+	{
+		/*	we can't do it!	*/
+		result_string_pointer = "NULL buffer";
+		return 0;
+	}
+	if( buffer_length < (int)sizeof( DDS_header ) )
+	{
+		/*	we can't do it!	*/
+		result_string_pointer = "DDS file was too small to contain the DDS header";
 		return 0;
 	}
 	/*	try reading in the header	*/
 	memcpy ( (void*)(&header), (const void *)buffer, sizeof( DDS_header ) );
-	buffer_index = sizeof( DDS_header );
+	info->data_offset = sizeof( DDS_header );
 	/*	guilty until proven innocent	*/
 	result_string_pointer = "Failed to read a known DDS header";
-	/*	validate the header (warning, "goto"'s ahead, shield your eyes!!)	*/
+	/*	validate the header	*/
 	flag = ('D'<<0)|('D'<<8)|('S'<<16)|(' '<<24);
-	if( header.dwMagic != flag ) {goto quick_exit;}
-	if( header.dwSize != 124 ) {goto quick_exit;}
+	if( header.dwMagic != flag ) {return 0;}
+	if( header.dwSize != 124 ) {return 0;}
 	/*	I need all of these	*/
 	flag = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
-	if( (header.dwFlags & flag) != flag ) {goto quick_exit;}
+	if( (header.dwFlags & flag) != flag ) {return 0;}
 	/*	According to the MSDN spec, the dwFlags should contain
 		DDSD_LINEARSIZE if it's compressed, or DDSD_PITCH if
 		uncompressed.  Some DDS writers do not conform to the
 		spec, so I need to make my reader more tolerant	*/
 	/*	I need one of these	*/
 	flag = DDPF_FOURCC | DDPF_RGB;
-	if( (header.sPixelFormat.dwFlags & flag) == 0 ) {goto quick_exit;}
-	if( header.sPixelFormat.dwSize != 32 ) {goto quick_exit;}
-	if( (header.sCaps.dwCaps1 & DDSCAPS_TEXTURE) == 0 ) {goto quick_exit;}
-	/*	make sure it is a type we can upload	*/
-	if( (header.sPixelFormat.dwFlags & DDPF_FOURCC) &&
-		!(
-		(header.sPixelFormat.dwFourCC == (('D'<<0)|('X'<<8)|('T'<<16)|('1'<<24))) ||
-		(header.sPixelFormat.dwFourCC == (('D'<<0)|('X'<<8)|('T'<<16)|('3'<<24))) ||
-		(header.sPixelFormat.dwFourCC == (('D'<<0)|('X'<<8)|('T'<<16)|('5'<<24)))
-		) )
-	{
-		goto quick_exit;
-	}
-	/*	OK, validated the header, let's load the image data	*/
-	result_string_pointer = "DDS header loaded and validated";
-	width = header.dwWidth;
-	height = header.dwHeight;
-	uncompressed = 1 - (header.sPixelFormat.dwFlags & DDPF_FOURCC) / DDPF_FOURCC;
-	cubemap = (header.sCaps.dwCaps2 & DDSCAPS2_CUBEMAP) / DDSCAPS2_CUBEMAP;
-	if( uncompressed )
-	{
-		S3TC_type = GL_RGB;
-		block_size = 3;
+	if( (header.sPixelFormat.dwFlags & flag) == 0 ) {return 0;}
+	if( header.sPixelFormat.dwSize != 32 ) {return 0;}
+	if( (header.sCaps.dwCaps1 & DDSCAPS_TEXTURE) == 0 ) {return 0;}
+	if( (header.dwWidth < 1) || (header.dwHeight < 1) ||
+		(header.dwWidth > 65536) || (header.dwHeight > 65536) ) {return 0;}
+	info->width = header.dwWidth;
+	info->height = header.dwHeight;
+	info->layers = 1;
+	info->faces = (header.sCaps.dwCaps2 & DDSCAPS2_CUBEMAP) ? 6 : 1;
+	info->mipmaps = 1;
+	if( (header.sCaps.dwCaps1 & DDSCAPS_MIPMAP) && (header.dwMipMapCount > 1) )
+	{
+		info->mipmaps = header.dwMipMapCount;
+		/*	nothing past 1x1	*/
+		for( i = 1; ((info->width | info->height) >> i) && (i < 32); ++i )
+		{
+		}
+		if( info->mipmaps > i )
+		{
+			info->mipmaps = i;
+		}
+	}
+	FourCC = header.sPixelFormat.dwFourCC;
+	if( (header.sPixelFormat.dwFlags & DDPF_FOURCC) == 0 )
+	{
+		/*	uncompressed, and remember, DDS uncompressed uses BGR(A)	*/
+		info->internal_format = info->format = GL_RGB;
+		info->block_size = 3;
 		if( header.sPixelFormat.dwFlags & DDPF_ALPHAPIXELS )
 		{
-			S3TC_type = GL_RGBA;
-			block_size = 4;
+			info->internal_format = info->format = GL_RGBA;
+			info->block_size = 4;
 		}
-		DDS_main_size = width * height * block_size;
+		info->swap_red_blue = 1;
 	} else
+	if( FourCC == (('D'<<0)|('X'<<8)|('1'<<16)|('0'<<24)) )
 	{
-		/*	can we even handle direct uploading to OpenGL DXT compressed images?	*/
-		if( query_DXT_capability() != SOIL_CAPABILITY_PRESENT )
+		/*	the DX10 header follows, and it decides everything	*/
+		if( buffer_length < (int)(sizeof( DDS_header ) + sizeof( DDS_header_DXT10 )) ) {return 0;}
+		memcpy ( (void*)(&header10), (const void *)&buffer[info->data_offset], sizeof( DDS_header_DXT10 ) );
+		info->data_offset += sizeof( DDS_header_DXT10 );
+		if( header10.resourceDimension != DDS_DIMENSION_TEXTURE2D )
+		{
+			result_string_pointer = "DDS file is not a 2D texture";
+			return 0;
+		}
+		if( header10.arraySize > 65536 ) {return 0;}
+		info->faces = (header10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) ? 6 : 1;
+		info->layers = (header10.arraySize > 1) ? header10.arraySize : 1;
+		if( !SOIL_DDS_DXGI_format( header10.dxgiFormat, &srgb, info ) )
+		{
+			return 0;
+		}
+	} else
+	{
+		/*	legacy FourCC codes	*/
+		int capability = query_DXT_capability();
+		int DXT_family = 0;
+		srgb = (flags & SOIL_FLAG_SRGB_COLOR_SPACE) ? 1 : 0;
+		info->compressed = 1;
+		info->block_size = 16;
+		if( FourCC == (('D'<<0)|('X'<<8)|('T'<<16)|('1'<<24)) )
+		{
+			info->internal_format = srgb ? SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : SOIL_RGBA_S3TC_DXT1;
+			info->block_size = 8;
+			DXT_family = 1;
+		} else
+		if( FourCC == (('D'<<0)|('X'<<8)|('T'<<16)|('3'<<24)) )
+		{
+			info->internal_format = srgb ? SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT : SOIL_RGBA_S3TC_DXT3;
+			DXT_family = 3;
+		} else
+		if( FourCC == (('D'<<0)|('X'<<8)|('T'<<16)|('5'<<24)) )
+		{
+			info->internal_format = srgb ? SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : SOIL_RGBA_S3TC_DXT5;
+			DXT_family = 5;
+		} else
+		if( (FourCC == (('A'<<0)|('T'<<8)|('I'<<16)|('1'<<24))) ||
+			(FourCC == (('B'<<0)|('C'<<8)|('4'<<16)|('U'<<24))) )
+		{
+			/*	BC4 and BC5 go by a couple of names, and have no sRGB version	*/
+			info->internal_format = SOIL_GL_COMPRESSED_RED_RGTC1;
+			info->block_size = 8;
+			capability = query_RGTC_capability();
+			srgb = 0;
+		} else
+		if( (FourCC == (('A'<<0)|('T'<<8)|('I'<<16)|('2'<<24))) ||
+			(FourCC == (('B'<<0)|('C'<<8)|('5'<<16)|('U'<<24))) )
+		{
+			info->internal_format = SOIL_GL_COMPRESSED_RG_RGTC2;
+			capability = query_RGTC_capability();
+			srgb = 0;
+		} else
+		{
+			return 0;
+		}
+		if( (capability != SOIL_CAPABILITY_PRESENT) && DXT_family )
+		{
+			capability = SOIL_DDS_pick_transcode( info, DXT_family, srgb );
+		}
+		/*	can we even handle direct uploading to OpenGL of these compressed images?	*/
+		if( capability != SOIL_CAPABILITY_PRESENT )
 		{
 			/*	we can't do it!	*/
-			result_string_pointer = "Direct upload of S3TC images not supported by the OpenGL driver";
+			result_string_pointer = "Direct upload of this DDS format not supported by the OpenGL driver";
 			return 0;
 		}
-		/*	well, we know it is DXT1/3/5, because we checked above	*/
-		switch( (header.sPixelFormat.dwFourCC >> 24) - '0' )
+	}
+	/*	sRGB falls back to the plain format when the driver lacks it	*/
+	if( srgb && (query_sRGB_capability() != SOIL_CAPABILITY_PRESENT) )
+	{
+		switch( info->internal_format )
 		{
-		case 1:
-			S3TC_type = SOIL_RGBA_S3TC_DXT1;
-			block_size = 8;
-			break;
-		case 3:
-			S3TC_type = SOIL_RGBA_S3TC_DXT3;
-			block_size = 16;
-			break;
-		case 5:
-			S3TC_type = SOIL_RGBA_S3TC_DXT5;
-			block_size = 16;
-			break;
+		case SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:	info->internal_format = SOIL_RGBA_S3TC_DXT1; break;
+		case SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:	info->internal_format = SOIL_RGBA_S3TC_DXT3; break;
+		case SOIL_GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:	info->internal_format = SOIL_RGBA_S3TC_DXT5; break;
+		case SOIL_GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:		info->internal_format = SOIL_GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+		case SOIL_GL_SRGB8_ALPHA8:							info->internal_format = SOIL_GL_RGBA8; break;
+		}
+	}
+	/*	everything has to be in the buffer (added up in floating point,
+		so a bogus header can't wrap the sizes around)	*/
+	for( i = 0; i < info->mipmaps; ++i )
+	{
+		face_bytes += SOIL_DDS_level_size( info, i );
+	}
+	if( info->data_offset + face_bytes * info->faces * info->layers > (double)buffer_length )
+	{
+		result_string_pointer = "DDS file was too small for expected image data";
+		return 0;
+	}
+	info->face_size = (unsigned int)face_bytes;
+	SOIL_DDS_check_transcode( &buffer[info->data_offset],
+		info->face_size * info->faces, info, srgb );
+	result_string_pointer = "DDS header loaded and validated";
+	return 1;
+}
+
+/*	one thread's share of a level being transcoded, in rows of blocks	*/
+typedef struct
+{
+	const SOIL_DDS_info *info;
+	const unsigned char *data;
+	unsigned char *out;
+	int width, height;
+	int first_row, end_row;
+}
+SOIL_DDS_transcode_task;
+
+static void SOIL_DDS_transcode_rows( void *arg )
+{
+	SOIL_DDS_transcode_task *task = (SOIL_DDS_transcode_task*)arg;
+	const SOIL_DDS_info *info = task->info;
+	int block_pitch = (task->width + 3) >> 2;
+	unsigned char block[16*4];
+	unsigned char rgb[16*3];
+	int bx, by, x, y;
+	for( by = task->first_row; by < task->end_row; ++by )
+	{
+		for( bx = 0; bx < block_pitch; ++bx )
+		{
+			int block_index = by*block_pitch + bx;
+			unsigned char *src = (unsigned char*)&task->data[block_index * info->block_size];
+			int w = task->width - bx*4;
+			int h = task->height - by*4;
+			if( w > 4 )
+			{
+				w = 4;
+			}
+			if( h > 4 )
+			{
+				h = 4;
+			}
+			/*	decode the block to RGBA	*/
+			if( info->DXT_family == 1 )
+			{
+				stbi_decode_DXT1_block( block, src );
+			} else
+			{
+				if( info->DXT_family == 3 )
+				{
+					stbi_decode_DXT23_alpha_block( block, src );
+				} else
+				{
+					stbi_decode_DXT45_alpha_block( block, src );
+				}
+				stbi_decode_DXT_color_block( block, src + 8 );
+			}
+			if( info->transcode == SOIL_DDS_TRANSCODE_ETC1 )
+			{
+				/*	re-encode it, leaving out texels past the edges	*/
+				unsigned int valid = 0;
+				for( y = 0; y < 16; ++y )
+				{
+					rgb[y*3+0] = block[y*4+0];
+					rgb[y*3+1] = block[y*4+1];
+					rgb[y*3+2] = block[y*4+2];
+				}
+				for( y = 0; y < h; ++y )
+				{
+					for( x = 0; x < w; ++x )
+					{
+						valid |= 1 << (x + y*4);
+					}
+				}
+				etc1_encode_block( rgb, valid, &task->out[block_index * 8] );
+			} else
+			{
+				for( y = 0; y < h; ++y )
+				{
+					memcpy( &task->out[((by*4 + y) * task->width + bx*4) * 4], &block[y*16], w*4 );
+				}
+			}
+		}
+	}
+}
+
+/*	transcodes one level of DXT blocks into out, splitting the rows of
+	blocks over threads when there are enough of them.  Returns the
+	size of the transcoded level	*/
+static unsigned int SOIL_DDS_transcode_level(
+		const SOIL_DDS_info *info,
+		const unsigned char *data,
+		int width, int height,
+		unsigned char *out )
+{
+	SOIL_DDS_transcode_task tasks[STBI__MAX_THREADS];
+	int rows = (height + 3) >> 2;
+	int blocks = rows * ((width + 3) >> 2);
+	int blocks_per_thread = SOIL_DDS_TRANSCODE_BLOCKS_PER_THREAD;
+	int count, i;
+	/*	encoding ETC1 costs far more per block than decoding	*/
+	if( info->transcode == SOIL_DDS_TRANSCODE_ETC1 )
+	{
+		blocks_per_thread /= 16;
+	}
+	count = blocks / blocks_per_thread;
+	if( count > stbi__cpu_count() )
+	{
+		count = stbi__cpu_count();
+	}
+	if( count > STBI__MAX_THREADS )
+	{
+		count = STBI__MAX_THREADS;
+	}
+	if( count > rows )
+	{
+		count = rows;
+	}
+	if( count < 1 )
+	{
+		count = 1;
+	}
+	for( i = 0; i < count; ++i )
+	{
+		tasks[i].info = info;
+		tasks[i].data = data;
+		tasks[i].out = out;
+		tasks[i].width = width;
+		tasks[i].height = height;
+		tasks[i].first_row = rows * i / count;
+		tasks[i].end_row = rows * (i + 1) / count;
+	}
+	stbi__run_tasks( SOIL_DDS_transcode_rows, tasks, sizeof( tasks[0] ), count );
+	if( info->transcode == SOIL_DDS_TRANSCODE_ETC1 )
+	{
+		return blocks * 8;
+	}
+	return width * height * 4;
+}
+
+/*	uploads one level of one face straight out of the DDS data.  Arrays
+	(target is the array target) go into the slice layer of storage
+	allocated beforehand	*/
+static void SOIL_upload_DDS_level(
+		const SOIL_DDS_info *info,
+		unsigned int target, int level, int layer,
+		const unsigned char *data, unsigned int size,
+		unsigned char *scratch )
+{
+	int w = info->width >> level;
+	int h = info->height >> level;
+	int compressed = info->compressed && (info->transcode != SOIL_DDS_TRANSCODE_RGBA);
+	if( w < 1 )
+	{
+		w = 1;
+	}
+	if( h < 1 )
+	{
+		h = 1;
+	}
+	if( info->transcode != SOIL_DDS_TRANSCODE_NONE )
+	{
+		size = SOIL_DDS_transcode_level( info, data, w, h, scratch );
+		data = scratch;
+	} else
+	if( info->swap_red_blue )
+	{
+		/*	swap to RGB(A), the only time the data gets copied	*/
+		unsigned int i;
+		memcpy( scratch, data, size );
+		for( i = 0; i < size; i += info->block_size )
+		{
+			unsigned char temp = scratch[i];
+			scratch[i] = scratch[i+2];
+			scratch[i+2] = temp;
+		}
+		data = scratch;
+	}
+	if( (target == SOIL_TEXTURE_2D_ARRAY) || (target == SOIL_TEXTURE_CUBE_MAP_ARRAY) )
+	{
+		if( compressed )
+		{
+			soilGlCompressedTexSubImage3D( target, level, 0, 0, layer, w, h, 1,
+				info->internal_format, size, data );
+		} else
+		{
+			soilGlTexSubImage3D( target, level, 0, 0, layer, w, h, 1,
+				info->format, info->type, data );
+		}
+	} else
+	{
+		if( compressed )
+		{
+			soilGlCompressedTexImage2D( target, level,
+				info->internal_format, w, h, 0, size, data );
+		} else
+		{
+			glTexImage2D( target, level,
+				info->internal_format, w, h, 0,
+				info->format, info->type, data );
 		}
-		DDS_main_size = ((width+3)>>2)*((height+3)>>2)*block_size;
 	}
-	if( cubemap )
+}
+
+/*	uploads every face and level of a parsed DDS into the texture, binding
+	it to opengl_texture_type.  2D arrays and cubemap arrays load all of
+	their layers in here too	*/
+static unsigned int SOIL_upload_DDS(
+		const unsigned char *const buffer,
+		const SOIL_DDS_info *info,
+		unsigned int reuse_texture_ID,
+		int flags,
+		unsigned int opengl_texture_type )
+{
+	unsigned int tex_ID = reuse_texture_ID;
+	unsigned char *scratch = NULL;
+	const unsigned char *data;
+	int is_array = (opengl_texture_type == SOIL_TEXTURE_2D_ARRAY) || (opengl_texture_type == SOIL_TEXTURE_CUBE_MAP_ARRAY);
+	int slices = info->faces * info->layers;
+	int slice, level;
+	GLint unpack_aligment;
+	if( info->transcode == SOIL_DDS_TRANSCODE_RGBA )
+	{
+		scratch = (unsigned char*)SOIL_malloc( info->width * info->height * 4 );
+		if( NULL == scratch )
+		{
+			result_string_pointer = "malloc failed";
+			return 0;
+		}
+	} else
+	if( info->swap_red_blue || info->transcode )
+	{
+		scratch = (unsigned char*)SOIL_malloc( SOIL_DDS_level_size( info, 0 ) );
+		if( NULL == scratch )
+		{
+			result_string_pointer = "malloc failed";
+			return 0;
+		}
+	}
+	/*	got the image data RAM, create or use an existing OpenGL texture handle	*/
+	if( tex_ID == 0 )
+	{
+		glGenTextures( 1, &tex_ID );
+	}
+	/*  bind an OpenGL texture ID	*/
+	glBindTexture( opengl_texture_type, tex_ID );
+	/*	uncompressed rows are tightly packed	*/
+	glGetIntegerv( GL_UNPACK_ALIGNMENT, &unpack_aligment );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	if( is_array )
+	{
+		/*	the layers of each level are not next to each other in
+			the file, so allocate the levels and fill them a slice at a time	*/
+		for( level = 0; level < info->mipmaps; ++level )
+		{
+			int w = info->width >> level;
+			int h = info->height >> level;
+			if( w < 1 )
+			{
+				w = 1;
+			}
+			if( h < 1 )
+			{
+				h = 1;
+			}
+			if( info->compressed && (info->transcode != SOIL_DDS_TRANSCODE_RGBA) )
+			{
+				soilGlCompressedTexImage3D( opengl_texture_type, level, info->internal_format,
+					w, h, slices, 0, SOIL_DDS_level_size( info, level ) * slices, NULL );
+			} else
+			{
+				soilGlTexImage3D( opengl_texture_type, level, info->internal_format,
+					w, h, slices, 0, info->format, info->type, NULL );
+			}
+		}
+	}
+	/*	the file holds each face (of each array element) with all
+		of its mipmaps, one after the other	*/
+	for( slice = 0; slice < slices; ++slice )
+	{
+		unsigned int target = opengl_texture_type;
+		data = &buffer[info->data_offset + slice * info->face_size];
+		if( opengl_texture_type == SOIL_TEXTURE_CUBE_MAP )
+		{
+			target = SOIL_TEXTURE_CUBE_MAP_POSITIVE_X + slice;
+		}
+		for( level = 0; level < info->mipmaps; ++level )
+		{
+			unsigned int size = SOIL_DDS_level_size( info, level );
+			SOIL_upload_DDS_level( info, target, level, slice, data, size, scratch );
+			data += size;
+		}
+	}
+	glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_aligment );
+	if( scratch )
+	{
+		SOIL_free( scratch );
+	}
+	/*	did I have MIPmaps?	*/
+	if( info->mipmaps > 1 )
+	{
+		/*	instruct OpenGL to use the MIPmaps	*/
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+	} else
+	{
+		/*	instruct OpenGL _NOT_ to use the MIPmaps	*/
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	}
+	#if !defined( SOIL_GLES1 ) && !defined( SOIL_GLES2 )
+	/*	files often stop the chain before 1x1, only use the levels we have	*/
+	glTexParameteri( opengl_texture_type, SOIL_TEXTURE_MAX_LEVEL, info->mipmaps - 1 );
+	#endif
+	/*	does the user want clamping, or wrapping?	*/
+	if( flags & SOIL_FLAG_TEXTURE_REPEATS )
+	{
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_S, GL_REPEAT );
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_T, GL_REPEAT );
+		glTexParameteri( opengl_texture_type, SOIL_TEXTURE_WRAP_R, GL_REPEAT );
+	} else
+	{
+		unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;
+		/* unsigned int clamp_mode = GL_CLAMP; */
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_S, clamp_mode );
+		glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_T, clamp_mode );
+		glTexParameteri( opengl_texture_type, SOIL_TEXTURE_WRAP_R, clamp_mode );
+	}
+	/*	it worked!	*/
+	result_string_pointer = "DDS file loaded";
+	return tex_ID;
+}
+
+unsigned int SOIL_direct_load_DDS_from_memory_skip_mipmaps(
+		const unsigned char *const buffer,
+		int buffer_length,
+		unsigned int reuse_texture_ID,
+		int flags,
+		int loading_as_cubemap,
+		int skip_mipmaps )
+{
+	SOIL_DDS_info info;
+	unsigned int opengl_texture_type = GL_TEXTURE_2D;
+	if( !SOIL_parse_DDS( buffer, buffer_length, flags, &info ) )
+	{
+		return 0;
+	}
+	SOIL_DDS_skip_mipmaps( &info, skip_mipmaps );
+	if( info.layers > 1 )
+	{
+		/*	we can't do it!	*/
+		result_string_pointer = "DDS image was a texture array, use SOIL_direct_load_DDS_array";
+		return 0;
+	}
+	if( info.faces == 6 )
 	{
 		/* does the user want a cubemap?	*/
 		if( !loading_as_cubemap )
@@ -2116,8 +3430,6 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 			result_string_pointer = "Direct upload of cubemap images not supported by the OpenGL driver";
 			return 0;
 		}
-		ogl_target_start = SOIL_TEXTURE_CUBE_MAP_POSITIVE_X;
-		ogl_target_end =   SOIL_TEXTURE_CUBE_MAP_NEGATIVE_Z;
 		opengl_texture_type = SOIL_TEXTURE_CUBE_MAP;
 	} else
 	{
@@ -2128,158 +3440,160 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 			result_string_pointer = "DDS image was not a cubemap";
 			return 0;
 		}
-		ogl_target_start = GL_TEXTURE_2D;
-		ogl_target_end =   GL_TEXTURE_2D;
-		opengl_texture_type = GL_TEXTURE_2D;
 	}
-	if( (header.sCaps.dwCaps1 & DDSCAPS_MIPMAP) && (header.dwMipMapCount > 1) )
+	return SOIL_upload_DDS( buffer, &info, reuse_texture_ID, flags, opengl_texture_type );
+}
+
+unsigned int SOIL_direct_load_DDS_from_memory(
+		const unsigned char *const buffer,
+		int buffer_length,
+		unsigned int reuse_texture_ID,
+		int flags,
+		int loading_as_cubemap )
+{
+	return SOIL_direct_load_DDS_from_memory_skip_mipmaps(
+		buffer, buffer_length,
+		reuse_texture_ID, flags, loading_as_cubemap, 0 );
+}
+
+unsigned int SOIL_direct_load_DDS_array_from_memory(
+		const unsigned char *const buffer,
+		int buffer_length,
+		unsigned int reuse_texture_ID,
+		int flags,
+		unsigned int *texture_target,
+		int *layers )
+{
+	SOIL_DDS_info info;
+	unsigned int opengl_texture_type = SOIL_TEXTURE_2D_ARRAY;
+	if( !SOIL_parse_DDS( buffer, buffer_length, flags, &info ) )
+	{
+		return 0;
+	}
+	if( query_texture_array_capability() != SOIL_CAPABILITY_PRESENT )
+	{
+		/*	we can't do it!	*/
+		result_string_pointer = "Direct upload of texture arrays not supported by the OpenGL driver";
+		return 0;
+	}
+	if( info.faces == 6 )
 	{
-		mipmaps = header.dwMipMapCount - 1;
-		DDS_full_size = DDS_main_size;
-		for( i = 1; i <= mipmaps; ++ i )
+		if( query_cubemap_array_capability() != SOIL_CAPABILITY_PRESENT )
 		{
-			int w, h;
-			w = width >> i;
-			h = height >> i;
-			if( w < 1 )
-			{
-				w = 1;
-			}
-			if( h < 1 )
-			{
-				h = 1;
-			}
-			if ( uncompressed )
-			{
-				/*	uncompressed DDS, simple MIPmap size calculation	*/
-				DDS_full_size += w*h*block_size;
-			} else
-			{
-				/*	compressed DDS, MIPmap size calculation is block based	*/
-				DDS_full_size += ((w+3)/4)*((h+3)/4)*block_size;
-			}
+			/*	we can't do it!	*/
+			result_string_pointer = "Direct upload of cubemap arrays not supported by the OpenGL driver";
+			return 0;
 		}
-	} else
+		opengl_texture_type = SOIL_TEXTURE_CUBE_MAP_ARRAY;
+	}
+	if( texture_target )
 	{
-		mipmaps = 0;
-		DDS_full_size = DDS_main_size;
+		*texture_target = opengl_texture_type;
 	}
-	DDS_data = (unsigned char*)malloc( DDS_full_size );
-	/*	got the image data RAM, create or use an existing OpenGL texture handle	*/
-	tex_ID = reuse_texture_ID;
-	if( tex_ID == 0 )
+	if( layers )
 	{
-		glGenTextures( 1, &tex_ID );
+		*layers = info.layers;
 	}
-	/*  bind an OpenGL texture ID	*/
-	glBindTexture( opengl_texture_type, tex_ID );
-	/*	do this for each face of the cubemap!	*/
-	for( cf_target = ogl_target_start; cf_target <= ogl_target_end; ++cf_target )
+	return SOIL_upload_DDS( buffer, &info, reuse_texture_ID, flags, opengl_texture_type );
+}
+
+/*	maps a whole file read only, so the DDS blocks can be handed to OpenGL
+	straight from the page cache.  Where mapping isn't available (or fails)
+	the file is read into memory instead, *mapping is then NULL	*/
+static const unsigned char *SOIL_map_file( const char *filename, size_t *length, void **mapping )
+{
+	FILE *f;
+	unsigned char *buffer;
+	size_t bytes_read;
+	*length = 0;
+	*mapping = NULL;
+#if defined( _WIN32 )
 	{
-		if( buffer_index + DDS_full_size <= (unsigned int)buffer_length )
+		HANDLE file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+		if( file != INVALID_HANDLE_VALUE )
 		{
-			unsigned int byte_offset = DDS_main_size;
-			memcpy( (void*)DDS_data, (const void*)(&buffer[buffer_index]), DDS_full_size );
-			buffer_index += DDS_full_size;
-			/*	upload the main chunk	*/
-			if( uncompressed )
+			LARGE_INTEGER size;
+			HANDLE view_handle = NULL;
+			const unsigned char *view = NULL;
+			if( GetFileSizeEx( file, &size ) && (size.QuadPart > 0) && (size.QuadPart < 0x7FFFFFFF) )
 			{
-				/*	and remember, DXT uncompressed uses BGR(A),
-					so swap to RGB(A) for ALL MIPmap levels	*/
-				for( i = 0; i < (int)DDS_full_size; i += block_size )
+				view_handle = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+				if( view_handle )
 				{
-					unsigned char temp = DDS_data[i];
-					DDS_data[i] = DDS_data[i+2];
-					DDS_data[i+2] = temp;
+					view = (const unsigned char *)MapViewOfFile( view_handle, FILE_MAP_READ, 0, 0, 0 );
+					if( NULL == view )
+					{
+						CloseHandle( view_handle );
+					}
 				}
-				glTexImage2D(
-					cf_target, 0,
-					S3TC_type, width, height, 0,
-					S3TC_type, GL_UNSIGNED_BYTE, DDS_data );
-			} else
-			{
-				soilGlCompressedTexImage2D(
-					cf_target, 0,
-					S3TC_type, width, height, 0,
-					DDS_main_size, DDS_data );
 			}
-			/*	upload the mipmaps, if we have them	*/
-			for( i = 1; i <= mipmaps; ++i )
+			CloseHandle( file );
+			if( view )
 			{
-				int w, h, mip_size;
-				w = width >> i;
-				h = height >> i;
-				if( w < 1 )
-				{
-					w = 1;
-				}
-				if( h < 1 )
-				{
-					h = 1;
-				}
-				/*	upload this mipmap	*/
-				if( uncompressed )
-				{
-					mip_size = w*h*block_size;
-					glTexImage2D(
-						cf_target, i,
-						S3TC_type, w, h, 0,
-						S3TC_type, GL_UNSIGNED_BYTE, &DDS_data[byte_offset] );
-				} else
-				{
-					mip_size = ((w+3)/4)*((h+3)/4)*block_size;
-					soilGlCompressedTexImage2D(
-						cf_target, i,
-						S3TC_type, w, h, 0,
-						mip_size, &DDS_data[byte_offset] );
-				}
-				/*	and move to the next mipmap	*/
-				byte_offset += mip_size;
+				*length = (size_t)size.QuadPart;
+				*mapping = view_handle;
+				return view;
 			}
-			/*	it worked!	*/
-			result_string_pointer = "DDS file loaded";
-		} else
-		{
-			glDeleteTextures( 1, & tex_ID );
-			tex_ID = 0;
-			cf_target = ogl_target_end + 1;
-			result_string_pointer = "DDS file was too small for expected image data";
 		}
-	}/* end reading each face */
-	SOIL_free_image_data( DDS_data );
-	if( tex_ID )
+	}
+#elif defined( SOIL_HAS_MMAP )
 	{
-		/*	did I have MIPmaps?	*/
-		if( mipmaps > 0 )
-		{
-			/*	instruct OpenGL to use the MIPmaps	*/
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
-		} else
-		{
-			/*	instruct OpenGL _NOT_ to use the MIPmaps	*/
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-		}
-		/*	does the user want clamping, or wrapping?	*/
-		if( flags & SOIL_FLAG_TEXTURE_REPEATS )
-		{
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_S, GL_REPEAT );
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_T, GL_REPEAT );
-			glTexParameteri( opengl_texture_type, SOIL_TEXTURE_WRAP_R, GL_REPEAT );
-		} else
+		int fd = open( filename, O_RDONLY );
+		if( fd >= 0 )
 		{
-			unsigned int clamp_mode = SOIL_CLAMP_TO_EDGE;
-			/* unsigned int clamp_mode = GL_CLAMP; */
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_S, clamp_mode );
-			glTexParameteri( opengl_texture_type, GL_TEXTURE_WRAP_T, clamp_mode );
-			glTexParameteri( opengl_texture_type, SOIL_TEXTURE_WRAP_R, clamp_mode );
+			struct stat st;
+			void *view = MAP_FAILED;
+			if( (fstat( fd, &st ) == 0) && (st.st_size > 0) && (st.st_size < 0x7FFFFFFF) )
+			{
+				view = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+			}
+			close( fd );
+			if( view != MAP_FAILED )
+			{
+				*length = (size_t)st.st_size;
+				*mapping = view;
+				return (const unsigned char *)view;
+			}
 		}
 	}
+#endif
+	f = fopen( filename, "rb" );
+	if( NULL == f )
+	{
+		return NULL;
+	}
+	fseek( f, 0, SEEK_END );
+	*length = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	buffer = (unsigned char *) SOIL_malloc( *length + 1 );
+	if( NULL == buffer )
+	{
+		fclose( f );
+		return NULL;
+	}
+	bytes_read = fread( (void*)buffer, 1, *length, f );
+	fclose( f );
+	if( bytes_read < *length )
+	{
+		/*	huh?	*/
+		*length = bytes_read;
+	}
+	return buffer;
+}
 
-quick_exit:
-	/*	report success or failure	*/
-	return tex_ID;
+static void SOIL_unmap_file( const unsigned char *data, size_t length, void *mapping )
+{
+	if( NULL == mapping )
+	{
+		SOIL_free( (void*)data );
+		return;
+	}
+#if defined( _WIN32 )
+	UnmapViewOfFile( data );
+	CloseHandle( (HANDLE)mapping );
+#elif defined( SOIL_HAS_MMAP )
+	munmap( mapping, length );
+#endif
 }
 
 unsigned int SOIL_direct_load_DDS(
@@ -2288,9 +3602,20 @@ unsigned int SOIL_direct_load_DDS(
 		int flags,
 		int loading_as_cubemap )
 {
-	FILE *f;
-	unsigned char *buffer;
-	size_t buffer_length, bytes_read;
+	return SOIL_direct_load_DDS_skip_mipmaps(
+		filename, reuse_texture_ID, flags, loading_as_cubemap, 0 );
+}
+
+unsigned int SOIL_direct_load_DDS_skip_mipmaps(
+		const char *filename,
+		unsigned int reuse_texture_ID,
+		int flags,
+		int loading_as_cubemap,
+		int skip_mipmaps )
+{
+	const unsigned char *buffer;
+	size_t buffer_length;
+	void *mapping;
 	unsigned int tex_ID = 0;
 	/*	error checks	*/
 	if( NULL == filename )
@@ -2298,38 +3623,89 @@ unsigned int SOIL_direct_load_DDS(
 		result_string_pointer = "NULL filename";
 		return 0;
 	}
-	f = fopen( filename, "rb" );
-	if( NULL == f )
+	buffer = SOIL_map_file( filename, &buffer_length, &mapping );
+	if( NULL == buffer )
 	{
 		/*	the file doesn't seem to exist (or be open-able)	*/
 		result_string_pointer = "Can not find DDS file";
 		return 0;
 	}
-	fseek( f, 0, SEEK_END );
-	buffer_length = ftell( f );
-	fseek( f, 0, SEEK_SET );
-	buffer = (unsigned char *) malloc( buffer_length );
-	if( NULL == buffer )
+	/*	now try to do the loading	*/
+	tex_ID = SOIL_direct_load_DDS_from_memory_skip_mipmaps(
+		buffer, (int)buffer_length,
+		reuse_texture_ID, flags, loading_as_cubemap, skip_mipmaps );
+	SOIL_unmap_file( buffer, buffer_length, mapping );
+	return tex_ID;
+}
+
+unsigned int SOIL_direct_load_DDS_array(
+		const char *filename,
+		unsigned int reuse_texture_ID,
+		int flags,
+		unsigned int *texture_target,
+		int *layers )
+{
+	const unsigned char *buffer;
+	size_t buffer_length;
+	void *mapping;
+	unsigned int tex_ID = 0;
+	/*	error checks	*/
+	if( NULL == filename )
 	{
-		result_string_pointer = "malloc failed";
-		fclose( f );
+		result_string_pointer = "NULL filename";
 		return 0;
 	}
-	bytes_read = fread( (void*)buffer, 1, buffer_length, f );
-	fclose( f );
-	if( bytes_read < buffer_length )
+	buffer = SOIL_map_file( filename, &buffer_length, &mapping );
+	if( NULL == buffer )
 	{
-		/*	huh?	*/
-		buffer_length = bytes_read;
+		/*	the file doesn't seem to exist (or be open-able)	*/
+		result_string_pointer = "Can not find DDS file";
+		return 0;
 	}
 	/*	now try to do the loading	*/
-	tex_ID = SOIL_direct_load_DDS_from_memory(
-		(const unsigned char *const)buffer, (int)buffer_length,
-		reuse_texture_ID, flags, loading_as_cubemap );
-	SOIL_free_image_data( buffer );
+	tex_ID = SOIL_direct_load_DDS_array_from_memory(
+		buffer, (int)buffer_length,
+		reuse_texture_ID, flags, texture_target, layers );
+	SOIL_unmap_file( buffer, buffer_length, mapping );
 	return tex_ID;
 }
 
+int SOIL_DDS_is_YCoCg( const char *filename )
+{
+	FILE *f;
+	DDS_header header;
+	size_t read_size;
+	if( NULL == filename )
+	{
+		result_string_pointer = "NULL filename";
+		return 0;
+	}
+	f = fopen( filename, "rb" );
+	if( NULL == f )
+	{
+		result_string_pointer = "Can not find DDS file";
+		return 0;
+	}
+	read_size = fread( &header, 1, sizeof( DDS_header ), f );
+	fclose( f );
+	return SOIL_DDS_is_YCoCg_from_memory( (const unsigned char *)&header, (int)read_size );
+}
+
+int SOIL_DDS_is_YCoCg_from_memory( const unsigned char *const buffer, int buffer_length )
+{
+	DDS_header header;
+	if( (NULL == buffer) || (buffer_length < (int)sizeof( DDS_header )) )
+	{
+		return 0;
+	}
+	memcpy( &header, buffer, sizeof( DDS_header ) );
+	/*	only the header is needed, DXT5 with the YCoCg swizzle code	*/
+	return ( header.dwMagic == (('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24)) ) &&
+		( header.sPixelFormat.dwFlags & DDPF_FOURCC ) &&
+		( header.sPixelFormat.dwFourCC == (('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24)) ) &&
+		( header.sPixelFormat.dwRGBBitCount == DDS_SWIZZLE_YCOCG_SCALED );
+}
+
 unsigned int SOIL_direct_load_PVR_from_memory(
 		const unsigned char *const buffer,
 		int buffer_length,
@@ -2625,7 +4001,7 @@ unsigned int SOIL_direct_load_PVR(
 	fseek( f, 0, SEEK_END );
 	buffer_length = ftell( f );
 	fseek( f, 0, SEEK_SET );
-	buffer = (unsigned char *) malloc( buffer_length );
+	buffer = (unsigned char *) SOIL_malloc( buffer_length );
 	if( NULL == buffer )
 	{
 		result_string_pointer = "malloc failed";
@@ -2762,7 +4138,7 @@ unsigned int SOIL_direct_load_ETC1(const char *filename,
 	fseek( f, 0, SEEK_END );
 	buffer_length = ftell( f );
 	fseek( f, 0, SEEK_SET );
-	buffer = (unsigned char *) malloc( buffer_length );
+	buffer = (unsigned char *) SOIL_malloc( buffer_length );
 	if( NULL == buffer )
 	{
 		result_string_pointer = "malloc failed";
@@ -2848,13 +4224,18 @@ int query_cubemap_capability( void )
 	/*	check for the capability	*/
 	if( has_cubemap_capability == SOIL_CAPABILITY_UNKNOWN )
 	{
-		/*	we haven't yet checked for the capability, do so	*/
+		/*	we haven't yet checked for the capability, do so
+			(core profiles don't list it, it is core since OpenGL 1.3)	*/
 		if(
 			(0 == SOIL_GL_ExtensionSupported(
 				"GL_ARB_texture_cube_map" ) )
 		&&
 			(0 == SOIL_GL_ExtensionSupported(
 				"GL_EXT_texture_cube_map" ) )
+		#if defined( SOIL_X11_PLATFORM ) || defined( SOIL_PLATFORM_WIN32 ) || defined( SOIL_PLATFORM_OSX )
+		&&
+			!isAtLeastGL3()
+		#endif
 			)
 		{
 			/*	not there, flag the failure	*/
@@ -3022,6 +4403,131 @@ int query_ETC1_capability( void )
 	return has_ETC1_capability;
 }
 
+int query_RGTC_capability( void )
+{
+	/*	check for the capability	*/
+	if( has_RGTC_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		/*	we haven't yet checked for the capability, do so	*/
+		if (0 == SOIL_GL_ExtensionSupported(
+				"GL_ARB_texture_compression_rgtc" ) &&
+			0 == SOIL_GL_ExtensionSupported(
+				"GL_EXT_texture_compression_rgtc" ) )
+		{
+			/*	not there, flag the failure	*/
+			has_RGTC_capability = SOIL_CAPABILITY_NONE;
+		} else
+		{
+			if ( NULL == soilGlCompressedTexImage2D ) {
+				soilGlCompressedTexImage2D = get_glCompressedTexImage2D_addr();
+			}
+
+			/*	it's there, as long as I can upload it	*/
+			has_RGTC_capability = ( NULL == soilGlCompressedTexImage2D ) ? SOIL_CAPABILITY_NONE : SOIL_CAPABILITY_PRESENT;
+		}
+	}
+	/*	let the user know if we can do BC4 / BC5 or not	*/
+	return has_RGTC_capability;
+}
+
+int query_BPTC_capability( void )
+{
+	/*	check for the capability	*/
+	if( has_BPTC_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		/*	we haven't yet checked for the capability, do so	*/
+		if (0 == SOIL_GL_ExtensionSupported(
+				"GL_ARB_texture_compression_bptc" ) &&
+			0 == SOIL_GL_ExtensionSupported(
+				"GL_EXT_texture_compression_bptc" ) )
+		{
+			/*	not there, flag the failure	*/
+			has_BPTC_capability = SOIL_CAPABILITY_NONE;
+		} else
+		{
+			if ( NULL == soilGlCompressedTexImage2D ) {
+				soilGlCompressedTexImage2D = get_glCompressedTexImage2D_addr();
+			}
+
+			/*	it's there, as long as I can upload it	*/
+			has_BPTC_capability = ( NULL == soilGlCompressedTexImage2D ) ? SOIL_CAPABILITY_NONE : SOIL_CAPABILITY_PRESENT;
+		}
+	}
+	/*	let the user know if we can do BC6H / BC7 or not	*/
+	return has_BPTC_capability;
+}
+
+int query_texture_array_capability( void )
+{
+	/*	check for the capability	*/
+	if( has_texture_array_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		int supported = SOIL_GL_ExtensionSupported( "GL_EXT_texture_array" );
+		#if defined( SOIL_X11_PLATFORM ) || defined( SOIL_PLATFORM_WIN32 ) || defined( SOIL_PLATFORM_OSX )
+		/*	core since OpenGL 3.0	*/
+		supported = supported || isAtLeastGL3();
+		#endif
+		has_texture_array_capability = SOIL_CAPABILITY_NONE;
+		if( supported )
+		{
+			soilGlTexImage3D = (P_SOIL_GLTEXIMAGE3DPROC)SOIL_GL_GetProcAddress( "glTexImage3D" );
+			soilGlTexSubImage3D = (P_SOIL_GLTEXSUBIMAGE3DPROC)SOIL_GL_GetProcAddress( "glTexSubImage3D" );
+			soilGlCompressedTexImage3D = (P_SOIL_GLCOMPRESSEDTEXIMAGE3DPROC)SOIL_GL_GetProcAddress( "glCompressedTexImage3D" );
+			soilGlCompressedTexSubImage3D = (P_SOIL_GLCOMPRESSEDTEXSUBIMAGE3DPROC)SOIL_GL_GetProcAddress( "glCompressedTexSubImage3D" );
+			if( soilGlTexImage3D && soilGlTexSubImage3D &&
+				soilGlCompressedTexImage3D && soilGlCompressedTexSubImage3D )
+			{
+				/*	it's there!	*/
+				has_texture_array_capability = SOIL_CAPABILITY_PRESENT;
+			}
+		}
+	}
+	/*	let the user know if we can do texture arrays or not	*/
+	return has_texture_array_capability;
+}
+
+int query_cubemap_array_capability( void )
+{
+	/*	check for the capability	*/
+	if( has_cubemap_array_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		/*	we haven't yet checked for the capability, do so	*/
+		if( (query_texture_array_capability() != SOIL_CAPABILITY_PRESENT) ||
+			(0 == SOIL_GL_ExtensionSupported( "GL_ARB_texture_cube_map_array" ) &&
+			 0 == SOIL_GL_ExtensionSupported( "GL_EXT_texture_cube_map_array" ) &&
+			 0 == SOIL_GL_ExtensionSupported( "GL_OES_texture_cube_map_array" )) )
+		{
+			/*	not there, flag the failure	*/
+			has_cubemap_array_capability = SOIL_CAPABILITY_NONE;
+		} else
+		{
+			/*	it's there!	*/
+			has_cubemap_array_capability = SOIL_CAPABILITY_PRESENT;
+		}
+	}
+	/*	let the user know if we can do cubemap arrays or not	*/
+	return has_cubemap_array_capability;
+}
+
+int query_HDR_capability( void )
+{
+	/*	check for the capability	*/
+	if( has_HDR_capability == SOIL_CAPABILITY_UNKNOWN )
+	{
+		int supported =
+			SOIL_GL_ExtensionSupported( "GL_EXT_texture_shared_exponent" ) &&
+			SOIL_GL_ExtensionSupported( "GL_ARB_texture_float" ) &&
+			SOIL_GL_ExtensionSupported( "GL_ARB_half_float_pixel" );
+		#if defined( SOIL_X11_PLATFORM ) || defined( SOIL_PLATFORM_WIN32 ) || defined( SOIL_PLATFORM_OSX )
+		/*	all core since OpenGL 3.0	*/
+		supported = supported || isAtLeastGL3();
+		#endif
+		has_HDR_capability = supported ? SOIL_CAPABILITY_PRESENT : SOIL_CAPABILITY_NONE;
+	}
+	/*	let the user know if we can do RGB9_E5 & RGBA16F or not	*/
+	return has_HDR_capability;
+}
+
 int query_gen_mipmap_capability( void )
 {
 	/* check for the capability   */
@@ -45,6 +45,8 @@
 #ifndef HEADER_SIMPLE_OPENGL_IMAGE_LIBRARY
 #define HEADER_SIMPLE_OPENGL_IMAGE_LIBRARY
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -121,6 +123,11 @@ enum
 	(TGA supports uncompressed RGB / RGBA)
 	(BMP supports uncompressed RGB)
 	(DDS supports DXT1 and DXT5)
+	(DDS_BC4 keeps the 1st channel, DDS_BC5 the 1st two)
+	(DDS_YCOCG is opaque scaled YCoCg in DXT5 with MIPmaps, for diffuse
+	maps; it needs a shader decode, see save_image_as_DDS_YCoCg)
+	(DDS_MIPMAPS, DDS_BC4_MIPMAPS and DDS_BC5_MIPMAPS are DDS, DDS_BC4
+	and DDS_BC5 with a full chain of MIPmaps, ready to upload as they are)
 	(PNG supports RGB / RGBA)
 **/
 enum
@@ -129,7 +136,13 @@ enum
 	SOIL_SAVE_TYPE_BMP = 1,
 	SOIL_SAVE_TYPE_PNG = 2,
 	SOIL_SAVE_TYPE_DDS = 3,
-	SOIL_SAVE_TYPE_JPG = 4
+	SOIL_SAVE_TYPE_JPG = 4,
+	SOIL_SAVE_TYPE_DDS_BC4 = 5,
+	SOIL_SAVE_TYPE_DDS_BC5 = 6,
+	SOIL_SAVE_TYPE_DDS_YCOCG = 7,
+	SOIL_SAVE_TYPE_DDS_MIPMAPS = 8,
+	SOIL_SAVE_TYPE_DDS_BC4_MIPMAPS = 9,
+	SOIL_SAVE_TYPE_DDS_BC5_MIPMAPS = 10
 };
 
 /**
@@ -146,12 +159,20 @@ enum
 	SOIL_HDR_RGBE:		RGB * pow( 2.0, A - 128.0 )
 	SOIL_HDR_RGBdivA:	RGB / A
 	SOIL_HDR_RGBdivA2:	RGB / (A*A)
+
+	and the real ones, sampled directly (they need OpenGL 3 or
+	GL_EXT_texture_shared_exponent & GL_ARB_texture_float)
+
+	SOIL_HDR_RGB9_E5:	RGB * pow( 2.0, E - 24.0 ), 9 bits each and a shared 5 bit exponent
+	SOIL_HDR_HALF:		RGBA in half floats, twice the memory
 **/
 enum
 {
 	SOIL_HDR_RGBE = 0,
 	SOIL_HDR_RGBdivA = 1,
-	SOIL_HDR_RGBdivA2 = 2
+	SOIL_HDR_RGBdivA2 = 2,
+	SOIL_HDR_RGB9_E5 = 3,
+	SOIL_HDR_HALF = 4
 };
 
 /**
@@ -220,7 +241,7 @@ unsigned int
 /**
 	Loads an HDR image from disk into an OpenGL texture.
 	\param filename the name of the file to upload as a texture
-	\param fake_HDR_format SOIL_HDR_RGBE, SOIL_HDR_RGBdivA, SOIL_HDR_RGBdivA2
+	\param fake_HDR_format SOIL_HDR_RGBE, SOIL_HDR_RGBdivA, SOIL_HDR_RGBdivA2, SOIL_HDR_RGB9_E5, SOIL_HDR_HALF
 	\param reuse_texture_ID 0-generate a new texture ID, otherwise reuse the texture ID (overwriting the old texture)
 	\param flags can be any of SOIL_FLAG_POWER_OF_TWO | SOIL_FLAG_MIPMAPS | SOIL_FLAG_TEXTURE_REPEATS | SOIL_FLAG_MULTIPLY_ALPHA | SOIL_FLAG_INVERT_Y | SOIL_FLAG_COMPRESS_TO_DXT
 	\return 0-failed, otherwise returns the OpenGL texture handle
@@ -403,6 +424,63 @@ unsigned char*
 		int force_channels
 	);
 
+/**
+	Reads the size of an image from its header, without decoding it
+	(DDS files included).
+	\param width, height, channels receive the values (any may be NULL)
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_get_image_size
+	(
+		const char *filename,
+		int *width, int *height, int *channels
+	);
+
+/**
+	Reads the size of an image in memory from its header, see SOIL_get_image_size.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_get_image_size_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels
+	);
+
+/**
+	Loads an image from disk at a reduced size, 1/scale_denom of the
+	original in each axis (scale_denom 2, 4 or 8).  JPEG files are
+	decoded straight to that size with a reduced IDCT, so no full size
+	image is ever built; their dimensions round up.  Other formats are
+	loaded at full size and box filtered down, with dimensions rounding
+	down (minimum 1).  *width and *height return the reduced size.
+	\return NULL if failed, otherwise the pixels, freed with SOIL_free_image_data
+**/
+unsigned char*
+	SOIL_load_image_scaled
+	(
+		const char *filename,
+		int *width, int *height, int *channels,
+		int force_channels,
+		int scale_denom
+	);
+
+/**
+	Loads an image from memory at a reduced size, see SOIL_load_image_scaled.
+	\return NULL if failed, otherwise the pixels, freed with SOIL_free_image_data
+**/
+unsigned char*
+	SOIL_load_image_scaled_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int *width, int *height, int *channels,
+		int force_channels,
+		int scale_denom
+	);
+
 /**
 	Saves an image from an array of unsigned chars (RGBA) to disk
 	\param quality parameter only used for SOIL_SAVE_TYPE_JPG files, values accepted between 0 and 100.
@@ -427,6 +505,77 @@ int
 		const unsigned char *const data
 	);
 
+/**
+	Converts an equirectangular Radiance .hdr environment to a cubemap in RAM,
+	without writing anything. The 6 faces (+X, -X, +Y, -Y, +Z, -Z) follow one
+	another, 4 bytes a texel for RGB9_E5 and 8 for RGBA16F.
+	\param HDR_filename the latitude / longitude .hdr to convert
+	\param HDR_format SOIL_HDR_RGB9_E5 or SOIL_HDR_HALF
+	\param face_size the width of each face, 0 uses a quarter of the .hdr width and is set to it
+	\return NULL if failed, otherwise the faces, freed with SOIL_free_image_data
+**/
+unsigned char*
+	SOIL_load_HDR_cubemap
+	(
+		const char *HDR_filename,
+		int HDR_format,
+		int *face_size
+	);
+
+/**
+	Converts an equirectangular Radiance .hdr held in RAM to a cubemap in RAM,
+	as SOIL_load_HDR_cubemap does.
+	\param buffer the .hdr in RAM just as if it were still in a file
+	\param buffer_length the size of the buffer in bytes
+	\param HDR_format SOIL_HDR_RGB9_E5 or SOIL_HDR_HALF
+	\param face_size the width of each face, 0 uses a quarter of the .hdr width and is set to it
+	\return NULL if failed, otherwise the faces, freed with SOIL_free_image_data
+**/
+unsigned char*
+	SOIL_load_HDR_cubemap_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length,
+		int HDR_format,
+		int *face_size
+	);
+
+/**
+	Converts an equirectangular Radiance .hdr environment to a cubemap and
+	saves it as a DX10 DDS, ready for SOIL_direct_load_DDS with cubemap set.
+	\param HDR_filename the latitude / longitude .hdr to convert
+	\param HDR_format SOIL_HDR_RGB9_E5 or SOIL_HDR_HALF
+	\param face_size the width of each face, 0 uses a quarter of the .hdr width
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_save_HDR_cubemap
+	(
+		const char *filename,
+		const char *HDR_filename,
+		int HDR_format,
+		int face_size
+	);
+
+/**
+	Loads 6 images and saves them as one uncompressed RGBA8 cubemap
+	DDS (DX10), ready for SOIL_direct_load_DDS with cubemap set.
+	The faces have to be square and all the same size.
+	\param x_pos_file the image for the +X face, and so on
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	SOIL_save_cubemap
+	(
+		const char *filename,
+		const char *x_pos_file,
+		const char *x_neg_file,
+		const char *y_pos_file,
+		const char *y_neg_file,
+		const char *z_pos_file,
+		const char *z_neg_file
+	);
+
 /**
 	Frees the image data (note, this is just C's "free()"...this function is
 	present mostly so C++ programmers don't forget to use "free()" and call
@@ -438,6 +587,23 @@ void
 		unsigned char *img_data
 	);
 
+/**
+	Routes the allocations SOIL and stb_image make through the given functions,
+	or back to malloc, realloc and free when they're NULL. Images SOIL returns
+	(SOIL_free_image_data) come from alloc_fn too. free_fn and realloc_fn may
+	also be given pointers that came from malloc (the DXT compressor's buffers,
+	or anything allocated before the hooks were set), and have to hand those on
+	to free and realloc. The hooks are called from whichever thread is loading.
+**/
+void
+	SOIL_set_allocator
+	(
+		void *(*alloc_fn)( size_t size, void *user ),
+		void *(*realloc_fn)( void *ptr, size_t size, void *user ),
+		void (*free_fn)( void *ptr, void *user ),
+		void *user
+	);
+
 /**
 	This function resturn a pointer to a string describing the last thing
 	that happened inside SOIL.  It can be used to determine why an image
@@ -463,13 +629,57 @@ int
 		const char *extension
 	);
 
-/** Loads the DDS texture directly to the GPU memory ( if supported ) */
+/**
+	Loads the DDS texture directly to the GPU memory ( if supported ).
+	Handles DXT1/3/5, BC4/BC5 (ATI1/ATI2) and uncompressed files, plus
+	DX10 headers with BC1-BC7 and RGBA8 formats.  The file is mapped,
+	not read, and every level is uploaded straight from the mapping.
+	SOIL_FLAG_SRGB_COLOR_SPACE picks the sRGB version of DXT1/3/5.
+	Without S3TC support, DXT1/3/5 files are transcoded on load (over
+	several threads for big levels): opaque DXT1 to ETC1 when the driver
+	has it, anything else to RGBA8, so one set of DDS files works on
+	every driver.
+**/
 unsigned int SOIL_direct_load_DDS(
 		const char *filename,
 		unsigned int reuse_texture_ID,
 		int flags,
 		int loading_as_cubemap );
 
+/**
+	Same as SOIL_direct_load_DDS, but leaves out the largest skip_mipmaps
+	levels of the file, so a texture can be loaded at half (1) or quarter
+	(2) resolution without being re-cooked.  The skipped levels are never
+	read.  A file always keeps its smallest level, so one without MIPmaps
+	loads at full size.
+**/
+unsigned int SOIL_direct_load_DDS_skip_mipmaps(
+		const char *filename,
+		unsigned int reuse_texture_ID,
+		int flags,
+		int loading_as_cubemap,
+		int skip_mipmaps );
+
+/**
+	Checks whether a DDS file holds scaled YCoCg rather than RGBA, as
+	saved with SOIL_SAVE_TYPE_DDS_YCOCG.  It still loads as DXT5, but
+	the shader has to convert the texels back to RGB.
+	\return 1 if the file is scaled YCoCg, 0 otherwise (or on error)
+**/
+int
+	SOIL_DDS_is_YCoCg
+	(
+		const char *filename
+	);
+
+/** Checks whether a DDS file in memory holds scaled YCoCg, see SOIL_DDS_is_YCoCg */
+int
+	SOIL_DDS_is_YCoCg_from_memory
+	(
+		const unsigned char *const buffer,
+		int buffer_length
+	);
+
 /** Loads the DDS texture directly to the GPU memory ( if supported ) */
 unsigned int SOIL_direct_load_DDS_from_memory(
 		const unsigned char *const buffer,
@@ -478,6 +688,40 @@ unsigned int SOIL_direct_load_DDS_from_memory(
 		int flags,
 		int loading_as_cubemap );
 
+/** Loads a DDS texture in memory without its largest levels, see SOIL_direct_load_DDS_skip_mipmaps */
+unsigned int SOIL_direct_load_DDS_from_memory_skip_mipmaps(
+		const unsigned char *const buffer,
+		int buffer_length,
+		unsigned int reuse_texture_ID,
+		int flags,
+		int loading_as_cubemap,
+		int skip_mipmaps );
+
+/**
+	Loads every slice of a DDS texture array (DX10 header with an array
+	size) directly to the GPU memory in one call.  Cubemap arrays become
+	GL_TEXTURE_CUBE_MAP_ARRAY, anything else GL_TEXTURE_2D_ARRAY, and a
+	file that is not an array loads as a single layer.
+	\param texture_target receives the texture target used (may be NULL)
+	\param layers receives the number of array elements (may be NULL)
+	\return 0 if failed, otherwise returns the OpenGL texture handle
+**/
+unsigned int SOIL_direct_load_DDS_array(
+		const char *filename,
+		unsigned int reuse_texture_ID,
+		int flags,
+		unsigned int *texture_target,
+		int *layers );
+
+/** Loads the DDS texture array directly to the GPU memory ( if supported ) */
+unsigned int SOIL_direct_load_DDS_array_from_memory(
+		const unsigned char *const buffer,
+		int buffer_length,
+		unsigned int reuse_texture_ID,
+		int flags,
+		unsigned int *texture_target,
+		int *layers );
+
 /** Loads the PVR texture directly to the GPU memory ( if supported ) */
 unsigned int SOIL_direct_load_PVR(
 		const char *filename,
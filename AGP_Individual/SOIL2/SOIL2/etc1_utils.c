@@ -298,9 +298,21 @@ inline int square(int x) {
     return x * x;
 }
 
+// Remembers the modifier picked for the last few distinct colors of a
+// subblock.  Blocks decoded from DXT1 have at most 4 colors, so most
+// pixels are answered from here when transcoding.
+
+typedef struct {
+    etc1_uint32 color[4];
+    etc1_uint32 score[4];
+    int index[4];
+    int count;
+} etc_modifier_cache;
+
 static etc1_uint32 chooseModifier(const etc1_byte* pBaseColors,
         const etc1_byte* pIn, etc1_uint32 *pLow, int bitIndex,
-        const int* pModifierTable) {
+        const int* pModifierTable, etc_modifier_cache* pCache) {
+    etc1_uint32 color = pIn[0] | (pIn[1] << 8) | (pIn[2] << 16);
     etc1_uint32 bestScore = ~0;
     int bestIndex = 0;
     int pixelR = pIn[0];
@@ -310,6 +322,13 @@ static etc1_uint32 chooseModifier(const etc1_byte* pBaseColors,
     int g = pBaseColors[1];
     int b = pBaseColors[2];
 	int i;
+	for ( i = 0; i < pCache->count; i++) {
+        if (pCache->color[i] == color) {
+            bestIndex = pCache->index[i];
+            *pLow |= (((bestIndex >> 1) << 16) | (bestIndex & 1)) << bitIndex;
+            return pCache->score[i];
+        }
+    }
 	for ( i = 0; i < 4; i++) {
         int modifier = pModifierTable[i];
         int decodedG = clamp(g + modifier);
@@ -329,18 +348,30 @@ static etc1_uint32 chooseModifier(const etc1_byte* pBaseColors,
             bestIndex = i;
         }
     }
+    if (pCache->count < 4) {
+        pCache->color[pCache->count] = color;
+        pCache->score[pCache->count] = bestScore;
+        pCache->index[pCache->count] = bestIndex;
+        pCache->count++;
+    }
     etc1_uint32 lowMask = (((bestIndex >> 1) << 16) | (bestIndex & 1))
             << bitIndex;
     *pLow |= lowMask;
     return bestScore;
 }
 
+// Stops as soon as the score reaches limit, the caller already has a
+// candidate at least that good so the rest of the subblock can't win.
+
 static
 void etc_encode_subblock_helper(const etc1_byte* pIn, etc1_uint32 inMask,
 		etc_compressed* pCompressed, etc1_bool flipped, etc1_bool second,
-        const etc1_byte* pBaseColors, const int* pModifierTable) {
-    int score = pCompressed->score;
+        const etc1_byte* pBaseColors, const int* pModifierTable,
+        etc1_uint32 limit) {
+    etc1_uint32 score = pCompressed->score;
+    etc_modifier_cache cache;
 	int y, x;
+    cache.count = 0;
     if (flipped) {
         int by = 0;
         if (second) {
@@ -352,7 +383,12 @@ void etc_encode_subblock_helper(const etc1_byte* pIn, etc1_uint32 inMask,
                 int i = x + 4 * yy;
                 if (inMask & (1 << i)) {
                     score += chooseModifier(pBaseColors, pIn + i * 3,
-                            &pCompressed->low, yy + x * 4, pModifierTable);
+                            &pCompressed->low, yy + x * 4, pModifierTable,
+                            &cache);
+                    if (score >= limit) {
+                        pCompressed->score = score;
+                        return;
+                    }
                 }
             }
         }
@@ -367,7 +403,12 @@ void etc_encode_subblock_helper(const etc1_byte* pIn, etc1_uint32 inMask,
                 int i = xx + 4 * y;
                 if (inMask & (1 << i)) {
                     score += chooseModifier(pBaseColors, pIn + i * 3,
-                            &pCompressed->low, y + xx * 4, pModifierTable);
+                            &pCompressed->low, y + xx * 4, pModifierTable,
+                            &cache);
+                    if (score >= limit) {
+                        pCompressed->score = score;
+                        return;
+                    }
                 }
             }
         }
@@ -434,9 +475,13 @@ static void etc_encodeBaseColors(etc1_byte* pBaseColors,
     pBaseColors[5] = b2;
 }
 
+// limit is the score of the best block found so far, candidates that
+// can't beat it are abandoned early (the result is left scoring >= limit).
+
 static
 void etc_encode_block_helper(const etc1_byte* pIn, etc1_uint32 inMask,
-		const etc1_byte* pColors, etc_compressed* pCompressed, etc1_bool flipped) {
+		const etc1_byte* pColors, etc_compressed* pCompressed, etc1_bool flipped,
+        etc1_uint32 limit) {
 	int i;
 
     pCompressed->score = ~0;
@@ -456,9 +501,13 @@ void etc_encode_block_helper(const etc1_byte* pIn, etc1_uint32 inMask,
         temp.high = originalHigh | (i << 5);
         temp.low = 0;
 		etc_encode_subblock_helper(pIn, inMask, &temp, flipped, 0,
-                pBaseColors, pModifierTable);
+                pBaseColors, pModifierTable,
+                pCompressed->score < limit ? pCompressed->score : limit);
         take_best(pCompressed, &temp);
     }
+    if (pCompressed->score >= limit) {
+        return;
+    }
     pModifierTable = kModifierTable;
     etc_compressed firstHalf = *pCompressed;
 	for ( i = 0; i < 8; i++, pModifierTable += 4) {
@@ -467,7 +516,8 @@ void etc_encode_block_helper(const etc1_byte* pIn, etc1_uint32 inMask,
         temp.high = firstHalf.high | (i << 2);
         temp.low = firstHalf.low;
 		etc_encode_subblock_helper(pIn, inMask, &temp, flipped, 1,
-                pBaseColors + 3, pModifierTable);
+                pBaseColors + 3, pModifierTable,
+                (i == 0 || pCompressed->score > limit) ? limit : pCompressed->score);
         if (i == 0) {
             *pCompressed = temp;
         } else {
@@ -498,8 +548,8 @@ void etc1_encode_block(const etc1_byte* pIn, etc1_uint32 inMask,
 	etc_average_colors_subblock(pIn, inMask, flippedColors + 3, 1, 1);
 
     etc_compressed a, b;
-	etc_encode_block_helper(pIn, inMask, colors, &a, 0);
-	etc_encode_block_helper(pIn, inMask, flippedColors, &b, 1);
+	etc_encode_block_helper(pIn, inMask, colors, &a, 0, ~0);
+	etc_encode_block_helper(pIn, inMask, flippedColors, &b, 1, a.score);
     take_best(&a, &b);
     writeBigEndian(pOut, a.high);
     writeBigEndian(pOut + 4, a.low);
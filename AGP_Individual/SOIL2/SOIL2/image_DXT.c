@@ -8,6 +8,7 @@
 */
 
 #include "image_DXT.h"
+#include "image_helper.h"
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -37,6 +38,48 @@ void compress_DDS_color_block(
 void compress_DDS_alpha_block(
 				const unsigned char *const uncompressed,
 				unsigned char compressed[8] );
+/*
+	Takes a 4x4 block of a single channel (every stride'th byte)
+	and compresses it into 8 bytes in BC4 format, the same layout
+	as the DXT5 alpha block.  Both endpoint modes are tried and
+	the one with the least squared error is kept.
+*/
+void compress_DDS_channel_block(
+				int stride,
+				const unsigned char *const uncompressed,
+				unsigned char compressed[8] );
+/*
+	Gathers the 4x4 blocks of the 1st (and 2nd if two_channels)
+	channel of an image and compresses each with the block above.
+*/
+static unsigned char* convert_image_to_BC4_BC5(
+				const unsigned char *const uncompressed,
+				int width, int height, int channels,
+				int two_channels, int *out_size );
+/*
+	Builds the full chain of MIPmaps of an image, each level box
+	filtered from the original in RGB(A) and then compressed by
+	convert, and saves it as a 2D FourCC DDS file.
+*/
+typedef unsigned char* (*DXT_converter)(
+				const unsigned char *const uncompressed,
+				int width, int height, int channels,
+				int *out_size );
+static int save_DDS_mip_chain(
+				const char *filename,
+				int width, int height, int channels,
+				const unsigned char *const data,
+				DXT_converter convert,
+				unsigned int FourCC, unsigned int swizzle );
+/*
+	Writes a DDS header for a 2D FourCC image with the given number
+	of mipmaps and swizzle code (0 for none), then the data.
+*/
+static int write_DDS_FourCC(
+				const char *filename,
+				int width, int height, unsigned int FourCC,
+				int mipmaps, unsigned int swizzle,
+				const unsigned char *const DDS_data, int DDS_size );
 
 /********* Actual Exposed Functions *********/
 int
@@ -48,10 +91,8 @@ int
 	)
 {
 	/*	variables	*/
-	FILE *fout;
 	unsigned char *DDS_data;
-	DDS_header header;
-	int DDS_size;
+	int DDS_size, save_result;
 	/*	error check	*/
 	if( (NULL == filename) ||
 		(width < 1) || (height < 1) ||
@@ -71,30 +112,182 @@ int
 		DDS_data = convert_image_to_DXT5( data, width, height, channels, &DDS_size );
 	}
 	/*	save it	*/
+	if( (channels & 1) == 1 )
+	{
+		save_result = write_DDS_FourCC( filename, width, height,
+				('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24), 1, 0, DDS_data, DDS_size );
+	} else
+	{
+		save_result = write_DDS_FourCC( filename, width, height,
+				('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24), 1, 0, DDS_data, DDS_size );
+	}
+	/*	done	*/
+	free( DDS_data );
+	return save_result;
+}
+
+int
+	save_image_as_DDS_BC4
+	(
+		const char *filename,
+		int width, int height, int channels,
+		const unsigned char *const data
+	)
+{
+	unsigned char *DDS_data;
+	int DDS_size, save_result;
+	if( NULL == filename )
+	{
+		return 0;
+	}
+	DDS_data = convert_image_to_BC4( data, width, height, channels, &DDS_size );
+	if( NULL == DDS_data )
+	{
+		return 0;
+	}
+	save_result = write_DDS_FourCC( filename, width, height,
+			('A' << 0) | ('T' << 8) | ('I' << 16) | ('1' << 24), 1, 0, DDS_data, DDS_size );
+	free( DDS_data );
+	return save_result;
+}
+
+int
+	save_image_as_DDS_BC5
+	(
+		const char *filename,
+		int width, int height, int channels,
+		const unsigned char *const data
+	)
+{
+	unsigned char *DDS_data;
+	int DDS_size, save_result;
+	if( NULL == filename )
+	{
+		return 0;
+	}
+	DDS_data = convert_image_to_BC5( data, width, height, channels, &DDS_size );
+	if( NULL == DDS_data )
+	{
+		return 0;
+	}
+	save_result = write_DDS_FourCC( filename, width, height,
+			('A' << 0) | ('T' << 8) | ('I' << 16) | ('2' << 24), 1, 0, DDS_data, DDS_size );
+	free( DDS_data );
+	return save_result;
+}
+
+int
+	save_image_as_DDS_YCoCg
+	(
+		const char *filename,
+		int width, int height, int channels,
+		const unsigned char *const data
+	)
+{
+	return save_DDS_mip_chain( filename, width, height, channels, data,
+			convert_image_to_DXT5_YCoCg,
+			('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24),
+			DDS_SWIZZLE_YCOCG_SCALED );
+}
+
+int
+	save_image_as_DDS_mipmapped
+	(
+		const char *filename,
+		int width, int height, int channels,
+		unsigned int FourCC,
+		const unsigned char *const data
+	)
+{
+	DXT_converter convert;
+	/*	pick the block compressor for the FourCC	*/
+	if( FourCC == (('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24)) )
+	{
+		convert = convert_image_to_DXT1;
+	} else
+	if( FourCC == (('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24)) )
+	{
+		convert = convert_image_to_DXT5;
+	} else
+	if( FourCC == (('A' << 0) | ('T' << 8) | ('I' << 16) | ('1' << 24)) )
+	{
+		convert = convert_image_to_BC4;
+	} else
+	if( FourCC == (('A' << 0) | ('T' << 8) | ('I' << 16) | ('2' << 24)) )
+	{
+		convert = convert_image_to_BC5;
+	} else
+	{
+		return 0;
+	}
+	return save_DDS_mip_chain( filename, width, height, channels, data,
+			convert, FourCC, 0 );
+}
+
+int
+	save_image_as_DDS_DX10
+	(
+		const char *filename,
+		int width, int height, int faces,
+		unsigned int dxgi_format,
+		const unsigned char *const data
+	)
+{
+	FILE *fout;
+	DDS_header header;
+	DDS_header_DXT10 header10;
+	int texel_size = 4;
+	/*	error check	*/
+	if( (NULL == filename) ||
+		(width < 1) || (height < 1) ||
+		((faces != 1) && (faces != 6)) ||
+		(data == NULL ) )
+	{
+		return 0;
+	}
+	if( dxgi_format == DXGI_FORMAT_R16G16B16A16_FLOAT )
+	{
+		texel_size = 8;
+	} else
+	if( (dxgi_format != DXGI_FORMAT_R8G8B8A8_UNORM) &&
+		(dxgi_format != DXGI_FORMAT_R9G9B9E5_SHAREDEXP) )
+	{
+		return 0;
+	}
 	memset( &header, 0, sizeof( DDS_header ) );
 	header.dwMagic = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
 	header.dwSize = 124;
-	header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+	header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_PITCH;
 	header.dwWidth = width;
 	header.dwHeight = height;
-	header.dwPitchOrLinearSize = DDS_size;
+	header.dwPitchOrLinearSize = width * texel_size;
 	header.sPixelFormat.dwSize = 32;
 	header.sPixelFormat.dwFlags = DDPF_FOURCC;
-	if( (channels & 1) == 1 )
-	{
-		header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24);
-	} else
+	header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('1' << 16) | ('0' << 24);
+	header.sCaps.dwCaps1 = DDSCAPS_TEXTURE;
+	memset( &header10, 0, sizeof( DDS_header_DXT10 ) );
+	header10.dxgiFormat = dxgi_format;
+	header10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+	header10.arraySize = 1;
+	if( faces == 6 )
 	{
-		header.sPixelFormat.dwFourCC = ('D' << 0) | ('X' << 8) | ('T' << 16) | ('5' << 24);
+		header.sCaps.dwCaps1 |= DDSCAPS_COMPLEX;
+		header.sCaps.dwCaps2 = DDSCAPS2_CUBEMAP |
+				DDSCAPS2_CUBEMAP_POSITIVEX | DDSCAPS2_CUBEMAP_NEGATIVEX |
+				DDSCAPS2_CUBEMAP_POSITIVEY | DDSCAPS2_CUBEMAP_NEGATIVEY |
+				DDSCAPS2_CUBEMAP_POSITIVEZ | DDSCAPS2_CUBEMAP_NEGATIVEZ;
+		header10.miscFlag = DDS_RESOURCE_MISC_TEXTURECUBE;
 	}
-	header.sCaps.dwCaps1 = DDSCAPS_TEXTURE;
 	/*	write it out	*/
 	fout = fopen( filename, "wb");
+	if( NULL == fout )
+	{
+		return 0;
+	}
 	fwrite( &header, sizeof( DDS_header ), 1, fout );
-	fwrite( DDS_data, 1, DDS_size, fout );
+	fwrite( &header10, sizeof( DDS_header_DXT10 ), 1, fout );
+	fwrite( data, 1, width * height * texel_size * faces, fout );
 	fclose( fout );
-	/*	done	*/
-	free( DDS_data );
 	return 1;
 }
 
@@ -274,7 +467,309 @@ unsigned char* convert_image_to_DXT5(
 	return compressed;
 }
 
+unsigned char* convert_image_to_BC4(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size )
+{
+	return convert_image_to_BC4_BC5( uncompressed, width, height, channels, 0, out_size );
+}
+
+unsigned char* convert_image_to_BC5(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size )
+{
+	return convert_image_to_BC4_BC5( uncompressed, width, height, channels, 1, out_size );
+}
+
+unsigned char* convert_image_to_DXT5_YCoCg(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int *out_size )
+{
+	unsigned char *YCoCg, *compressed;
+	int i, j, x, y;
+	unsigned char ublock[16*4];
+	int index = 0, chan_step = 1;
+	/*	error check	*/
+	*out_size = 0;
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) ||
+		(channels < 1) || (channels > 4) )
+	{
+		return NULL;
+	}
+	/*	for channels == 1 or 2, I do not step forward for R,G,B vales	*/
+	if( channels < 3 )
+	{
+		chan_step = 0;
+	}
+	YCoCg = (unsigned char*)malloc( width*height*4 );
+	compressed = (unsigned char*)malloc( ((width+3) >> 2) * ((height+3) >> 2) * 16 );
+	if( (NULL == YCoCg) || (NULL == compressed) )
+	{
+		free( YCoCg );
+		free( compressed );
+		return NULL;
+	}
+	/*	convert an opaque RGBA copy, which comes back as CoCgAY	*/
+	for( i = 0; i < width*height; ++i )
+	{
+		const unsigned char *texel = &uncompressed[i*channels];
+		YCoCg[i*4+0] = texel[0];
+		YCoCg[i*4+1] = texel[chan_step];
+		YCoCg[i*4+2] = texel[chan_step+chan_step];
+		YCoCg[i*4+3] = 255;
+	}
+	convert_RGB_to_YCoCg( YCoCg, width, height, 4 );
+	/*	go through each block	*/
+	for( j = 0; j < height; j += 4 )
+	{
+		for( i = 0; i < width; i += 4 )
+		{
+			int idx = 0, max_CoCg = 0, scale = 1;
+			for( y = 0; y < 4; ++y )
+			{
+				int sy = (j+y < height) ? j+y : height-1;
+				for( x = 0; x < 4; ++x )
+				{
+					int sx = (i+x < width) ? i+x : width-1;
+					const unsigned char *texel = &YCoCg[(sy*width+sx)*4];
+					int Co = texel[0] - 128;
+					int Cg = texel[1] - 128;
+					Co = (Co < 0) ? -Co : Co;
+					Cg = (Cg < 0) ? -Cg : Cg;
+					if( Co > max_CoCg )
+					{
+						max_CoCg = Co;
+					}
+					if( Cg > max_CoCg )
+					{
+						max_CoCg = Cg;
+					}
+					ublock[idx++] = texel[0];
+					ublock[idx++] = texel[1];
+					ublock[idx++] = texel[2];
+					ublock[idx++] = texel[3];
+				}
+			}
+			/*	blow up small chroma so it uses more of the 5:6 bits,
+				keeping the scale in blue where it costs nothing	*/
+			if( max_CoCg < 64 )
+			{
+				scale = 2;
+			}
+			if( max_CoCg < 32 )
+			{
+				scale = 4;
+			}
+			/*	the 128 offset is moved to where 0 lands exactly in
+				5 and 6 bits, so grey blocks come back grey	*/
+			for( x = 0; x < 16; ++x )
+			{
+				int Co = (ublock[x*4+0] - 128) * scale + 132;
+				int Cg = (ublock[x*4+1] - 128) * scale + 130;
+				ublock[x*4+0] = (unsigned char)((Co > 255) ? 255 : Co);
+				ublock[x*4+1] = (unsigned char)((Cg > 255) ? 255 : Cg);
+				ublock[x*4+2] = (unsigned char)((scale - 1) << 3);
+			}
+			/*	Y goes in the alpha block	*/
+			compress_DDS_channel_block( 4, ublock+3, &compressed[index] );
+			index += 8;
+			compress_DDS_color_block( 4, ublock, &compressed[index] );
+			index += 8;
+		}
+	}
+	free( YCoCg );
+	*out_size = index;
+	return compressed;
+}
+
 /********* Helper Functions *********/
+static int save_DDS_mip_chain(
+		const char *filename,
+		int width, int height, int channels,
+		const unsigned char *const data,
+		DXT_converter convert,
+		unsigned int FourCC, unsigned int swizzle )
+{
+	unsigned char *DDS_data, *level_data, *resampled;
+	int DDS_size = 0, level_size, save_result;
+	int level = 0, mip_width, mip_height;
+	int block_size = 16;
+	/*	error check	*/
+	if( (NULL == filename) ||
+		(width < 1) || (height < 1) ||
+		(channels < 1) || (channels > 4) ||
+		(data == NULL ) )
+	{
+		return 0;
+	}
+	if( (FourCC == (('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24))) ||
+		(FourCC == (('A' << 0) | ('T' << 8) | ('I' << 16) | ('1' << 24))) )
+	{
+		block_size = 8;
+	}
+	/*	find the size of all the MIPmap levels together	*/
+	do
+	{
+		mip_width = (width >> level) ? (width >> level) : 1;
+		mip_height = (height >> level) ? (height >> level) : 1;
+		DDS_size += ((mip_width+3) >> 2) * ((mip_height+3) >> 2) * block_size;
+		++level;
+	} while( ((1 << level) <= width) || ((1 << level) <= height) );
+	DDS_data = (unsigned char*)malloc( DDS_size );
+	resampled = (unsigned char*)malloc( ((width+1) / 2) * ((height+1) / 2) * channels );
+	if( (NULL == DDS_data) || (NULL == resampled) )
+	{
+		free( DDS_data );
+		free( resampled );
+		return 0;
+	}
+	/*	the MIPmaps are averaged before the conversion	*/
+	DDS_size = 0;
+	level = 0;
+	do
+	{
+		mip_width = (width >> level) ? (width >> level) : 1;
+		mip_height = (height >> level) ? (height >> level) : 1;
+		if( level > 0 )
+		{
+			mipmap_image( data, width, height, channels,
+					resampled, (1 << level), (1 << level) );
+		}
+		level_data = convert(
+				(level > 0) ? resampled : data,
+				mip_width, mip_height, channels, &level_size );
+		if( NULL == level_data )
+		{
+			free( DDS_data );
+			free( resampled );
+			return 0;
+		}
+		memcpy( DDS_data + DDS_size, level_data, level_size );
+		DDS_size += level_size;
+		free( level_data );
+		++level;
+	} while( ((1 << level) <= width) || ((1 << level) <= height) );
+	free( resampled );
+	/*	save it	*/
+	save_result = write_DDS_FourCC( filename, width, height, FourCC,
+			level, swizzle, DDS_data, DDS_size );
+	free( DDS_data );
+	return save_result;
+}
+
+static int write_DDS_FourCC(
+		const char *filename,
+		int width, int height, unsigned int FourCC,
+		int mipmaps, unsigned int swizzle,
+		const unsigned char *const DDS_data, int DDS_size )
+{
+	FILE *fout;
+	DDS_header header;
+	int block_size = 16;
+	if( (FourCC == (('D' << 0) | ('X' << 8) | ('T' << 16) | ('1' << 24))) ||
+		(FourCC == (('A' << 0) | ('T' << 8) | ('I' << 16) | ('1' << 24))) )
+	{
+		block_size = 8;
+	}
+	memset( &header, 0, sizeof( DDS_header ) );
+	header.dwMagic = ('D' << 0) | ('D' << 8) | ('S' << 16) | (' ' << 24);
+	header.dwSize = 124;
+	header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+	header.dwWidth = width;
+	header.dwHeight = height;
+	/*	the linear size is that of the top level only	*/
+	header.dwPitchOrLinearSize = ((width+3) >> 2) * ((height+3) >> 2) * block_size;
+	header.sPixelFormat.dwSize = 32;
+	header.sPixelFormat.dwFlags = DDPF_FOURCC;
+	header.sPixelFormat.dwFourCC = FourCC;
+	header.sPixelFormat.dwRGBBitCount = swizzle;
+	header.sCaps.dwCaps1 = DDSCAPS_TEXTURE;
+	if( mipmaps > 1 )
+	{
+		header.dwFlags |= DDSD_MIPMAPCOUNT;
+		header.dwMipMapCount = mipmaps;
+		header.sCaps.dwCaps1 |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+	/*	write it out	*/
+	fout = fopen( filename, "wb");
+	if( NULL == fout )
+	{
+		return 0;
+	}
+	fwrite( &header, sizeof( DDS_header ), 1, fout );
+	fwrite( DDS_data, 1, DDS_size, fout );
+	fclose( fout );
+	return 1;
+}
+
+static unsigned char* convert_image_to_BC4_BC5(
+		const unsigned char *const uncompressed,
+		int width, int height, int channels,
+		int two_channels, int *out_size )
+{
+	unsigned char *compressed;
+	int i, j, x, y;
+	unsigned char ublock[16*2];
+	int index = 0, chan_step = 1;
+	int block_size = 8 + 8*two_channels;
+	/*	error check	*/
+	*out_size = 0;
+	if( (width < 1) || (height < 1) ||
+		(NULL == uncompressed) ||
+		(channels < 1) || (channels > 4) )
+	{
+		return NULL;
+	}
+	/*	a single channel image fills both BC5 channels	*/
+	if( channels < 2 )
+	{
+		chan_step = 0;
+	}
+	/*	get the RAM for the compressed image
+		(8 bytes per channel per 4x4 pixel block)	*/
+	*out_size = ((width+3) >> 2) * ((height+3) >> 2) * block_size;
+	compressed = (unsigned char*)malloc( *out_size );
+	if( NULL == compressed )
+	{
+		*out_size = 0;
+		return NULL;
+	}
+	/*	go through each block	*/
+	for( j = 0; j < height; j += 4 )
+	{
+		for( i = 0; i < width; i += 4 )
+		{
+			/*	copy this block, repeating the last row & column
+				past the edges so they do not widen the ranges	*/
+			int idx = 0;
+			for( y = 0; y < 4; ++y )
+			{
+				int sy = (j+y < height) ? j+y : height-1;
+				for( x = 0; x < 4; ++x )
+				{
+					int sx = (i+x < width) ? i+x : width-1;
+					const unsigned char *texel = &uncompressed[(sy*width+sx)*channels];
+					ublock[idx++] = texel[0];
+					ublock[idx++] = texel[chan_step];
+				}
+			}
+			/*	BC5 stores the red block, then the green block	*/
+			compress_DDS_channel_block( 2, ublock, &compressed[index] );
+			index += 8;
+			if( two_channels )
+			{
+				compress_DDS_channel_block( 2, ublock+1, &compressed[index] );
+				index += 8;
+			}
+		}
+	}
+	return compressed;
+}
+
 int convert_bit_range( int c, int from_bits, int to_bits )
 {
 	int b = (1 << (from_bits - 1)) + c * ((1 << to_bits) - 1);
@@ -630,3 +1125,187 @@ void
 	}
 	/*	done compressing to DXT1	*/
 }
+
+/*	builds the 8 entry palette for a pair of BC4 endpoints,
+	rounding the way the hardware does	*/
+static void BC4_palette( int e0, int e1, int palette[8] )
+{
+	int i;
+	palette[0] = e0;
+	palette[1] = e1;
+	if( e0 > e1 )
+	{
+		/*	6 interpolated values	*/
+		for( i = 1; i < 7; ++i )
+		{
+			palette[i+1] = ((7-i)*e0 + i*e1 + 3) / 7;
+		}
+	} else
+	{
+		/*	4 interpolated values, plus 0 and 255	*/
+		for( i = 1; i < 5; ++i )
+		{
+			palette[i+1] = ((5-i)*e0 + i*e1 + 2) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+/*	picks the nearest palette entry for each texel,
+	returns the total squared error	*/
+static int BC4_fit_indices(
+		int stride,
+		const unsigned char *const uncompressed,
+		const int palette[8], int indices[16] )
+{
+	int i, k, error = 0;
+	for( i = 0; i < 16; ++i )
+	{
+		int value = uncompressed[i*stride];
+		int best = 0, best_error = 256*256;
+		for( k = 0; k < 8; ++k )
+		{
+			int e = (value - palette[k]) * (value - palette[k]);
+			if( e < best_error )
+			{
+				best_error = e;
+				best = k;
+			}
+		}
+		indices[i] = best;
+		error += best_error;
+	}
+	return error;
+}
+
+void
+	compress_DDS_channel_block
+	(
+		int stride,
+		const unsigned char *const uncompressed,
+		unsigned char compressed[8]
+	)
+{
+	/*	variables	*/
+	int i, next_bit;
+	int vmin, vmax, inner_min, inner_max;
+	int e0, e1, error;
+	int best_e0, best_e1, best_error;
+	int palette[8], indices[16], best_indices[16];
+	/*	get the full range, and the range without 0 and 255	*/
+	vmin = vmax = uncompressed[0];
+	inner_min = 255;
+	inner_max = 0;
+	for( i = 0; i < 16; ++i )
+	{
+		int value = uncompressed[i*stride];
+		if( value < vmin )
+		{
+			vmin = value;
+		}
+		if( value > vmax )
+		{
+			vmax = value;
+		}
+		if( (value > 0) && (value < 255) )
+		{
+			if( value < inner_min )
+			{
+				inner_min = value;
+			}
+			if( value > inner_max )
+			{
+				inner_max = value;
+			}
+		}
+	}
+	/*	1st try: 8 value mode spanning the whole range
+		(a flat block also lands here, every index is 0)	*/
+	best_e0 = vmax;
+	best_e1 = vmin;
+	BC4_palette( best_e0, best_e1, palette );
+	best_error = BC4_fit_indices( stride, uncompressed, palette, best_indices );
+	/*	refine the endpoints with a least squares fit to those indices	*/
+	if( best_error > 0 )
+	{
+		float sum_aa = 0.0f, sum_ab = 0.0f, sum_bb = 0.0f;
+		float sum_ax = 0.0f, sum_bx = 0.0f, det;
+		for( i = 0; i < 16; ++i )
+		{
+			/*	weight of e1 for this index	*/
+			float b = (best_indices[i] < 2) ? (float)best_indices[i] : (best_indices[i] - 1) / 7.0f;
+			float a = 1.0f - b;
+			float value = uncompressed[i*stride];
+			sum_aa += a*a;
+			sum_ab += a*b;
+			sum_bb += b*b;
+			sum_ax += a*value;
+			sum_bx += b*value;
+		}
+		det = sum_aa*sum_bb - sum_ab*sum_ab;
+		if( det > 0.0001f )
+		{
+			float f0 = (sum_ax*sum_bb - sum_bx*sum_ab) / det;
+			float f1 = (sum_bx*sum_aa - sum_ax*sum_ab) / det;
+			e0 = (int)(f0 + 0.5f);
+			e1 = (int)(f1 + 0.5f);
+			e0 = (e0 < 0) ? 0 : ((e0 > 255) ? 255 : e0);
+			e1 = (e1 < 0) ? 0 : ((e1 > 255) ? 255 : e1);
+			if( e0 > e1 )
+			{
+				BC4_palette( e0, e1, palette );
+				error = BC4_fit_indices( stride, uncompressed, palette, indices );
+				if( error < best_error )
+				{
+					best_e0 = e0;
+					best_e1 = e1;
+					best_error = error;
+					memcpy( best_indices, indices, sizeof( indices ) );
+				}
+			}
+		}
+	}
+	/*	2nd try: 6 value mode, where 0 and 255 come for free,
+		only worth it when the block actually touches them	*/
+	if( (best_error > 0) && ((vmin == 0) || (vmax == 255)) )
+	{
+		e0 = inner_min;
+		e1 = inner_max;
+		if( e0 > e1 )
+		{
+			/*	nothing but 0s and 255s	*/
+			e0 = e1 = 0;
+		}
+		BC4_palette( e0, e1, palette );
+		error = BC4_fit_indices( stride, uncompressed, palette, indices );
+		if( error < best_error )
+		{
+			best_e0 = e0;
+			best_e1 = e1;
+			best_error = error;
+			memcpy( best_indices, indices, sizeof( indices ) );
+		}
+	}
+	/*	store the endpoints, and zero the rest of the compressed dataset	*/
+	compressed[0] = best_e0;
+	compressed[1] = best_e1;
+	for( i = 2; i < 8; ++i )
+	{
+		compressed[i] = 0;
+	}
+	/*	then all of the 3 bit indices	*/
+	next_bit = 8*2;
+	for( i = 0; i < 16; ++i )
+	{
+		int svalue = best_indices[i];
+		compressed[next_bit >> 3] |= (svalue << (next_bit & 7)) & 255;
+		if( (next_bit & 7) > 5 )
+		{
+			/*	spans 2 bytes, fill in the start of the 2nd byte	*/
+			compressed[1 + (next_bit >> 3)] |= svalue >> (8 - (next_bit & 7) );
+		}
+		next_bit += 3;
+	}
+	/*	done compressing to BC4	*/
+}
@@ -45,6 +45,114 @@ convert_image_to_DXT5
     int *out_size
 );
 
+/**
+	Converts an image to BC4 (ATI1) or BC5 (ATI2), then saves the
+	converted image to disk.  BC4 keeps only the 1st channel, BC5
+	keeps the 1st 2 (red and green for RGB(A) images).
+	\return 0 if failed, otherwise returns 1
+**/
+int
+save_image_as_DDS_BC4
+(
+    const char *filename,
+    int width, int height, int channels,
+    const unsigned char *const data
+);
+
+int
+save_image_as_DDS_BC5
+(
+    const char *filename,
+    int width, int height, int channels,
+    const unsigned char *const data
+);
+
+/**
+	take an image and convert it to BC4 (1st channel only,
+	8 bytes per block, e.g. specular or height maps)
+**/
+unsigned char*
+convert_image_to_BC4
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int *out_size
+);
+
+/**
+	take an image and convert it to BC5 (1st & 2nd channels,
+	16 bytes per block, e.g. the XY of tangent space normal maps)
+**/
+unsigned char*
+convert_image_to_BC5
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int *out_size
+);
+
+/**
+	Converts an opaque RGB(A) image to scaled YCoCg in DXT5, then saves
+	it to disk with a full chain of mipmaps.  The file is flagged with
+	DDS_SWIZZLE_YCOCG_SCALED, a shader has to decode each texel:
+		scale = 1 / (round(B * 31) + 1)
+		Co = (R - 16/31) * scale, Cg = (G - 32/63) * scale, Y = A
+		RGB = (Y + Co - Cg, Y + Cg, Y - Co - Cg)
+	\return 0 if failed, otherwise returns 1
+**/
+int
+save_image_as_DDS_YCoCg
+(
+    const char *filename,
+    int width, int height, int channels,
+    const unsigned char *const data
+);
+
+/**
+	Converts an image to DXT1 ('DXT1'), DXT5 ('DXT5'), BC4 ('ATI1') or
+	BC5 ('ATI2') as picked by the FourCC, with a full chain of mipmaps
+	box filtered from it, then saves it to disk.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+save_image_as_DDS_mipmapped
+(
+    const char *filename,
+    int width, int height, int channels,
+    unsigned int FourCC,
+    const unsigned char *const data
+);
+
+/**
+	take an image and convert it to scaled YCoCg in DXT5 (no alpha,
+	Y goes in the alpha block, Co & Cg in the color block with the
+	per block scale in blue)
+**/
+unsigned char*
+convert_image_to_DXT5_YCoCg
+(
+    const unsigned char *const uncompressed,
+    int width, int height, int channels,
+    int *out_size
+);
+
+/**
+	Saves uncompressed texels to disk as a DDS with the DX10 header,
+	one level per face.  dxgi_format is DXGI_FORMAT_R8G8B8A8_UNORM,
+	DXGI_FORMAT_R9G9B9E5_SHAREDEXP (4 bytes per texel) or
+	DXGI_FORMAT_R16G16B16A16_FLOAT (8 bytes per texel).  With 6 faces
+	the file is a cube map, faces in +X, -X, +Y, -Y, +Z, -Z order.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+save_image_as_DDS_DX10
+(
+    const char *filename,
+    int width, int height, int faces,
+    unsigned int dxgi_format,
+    const unsigned char *const data
+);
+
 /**	A bunch of DirectDraw Surface structures and flags **/
 typedef struct
 {
@@ -85,6 +193,18 @@ typedef struct
 }
 DDS_header ;
 
+/**	The extended header that follows DDS_header when the FourCC is 'DX10',
+	it names the format by DXGI_FORMAT and adds texture arrays	**/
+typedef struct
+{
+    unsigned int    dxgiFormat;
+    unsigned int    resourceDimension;
+    unsigned int    miscFlag;
+    unsigned int    arraySize;
+    unsigned int    miscFlags2;
+}
+DDS_header_DXT10 ;
+
 /*	the following constants were copied directly off the MSDN website	*/
 
 /*	The dwFlags member of the original DDSURFACEDESC2 structure
@@ -120,4 +240,35 @@ DDS_header ;
 #define DDSCAPS2_CUBEMAP_NEGATIVEZ	0x00008000
 #define DDSCAPS2_VOLUME	0x00200000
 
+/*	Swizzle code kept in sPixelFormat.dwRGBBitCount (unused by FourCC
+	formats) of DXT5 files holding scaled YCoCg rather than RGBA	*/
+#define DDS_SWIZZLE_YCOCG_SCALED	(('Y' << 0) | ('C' << 8) | ('G' << 16) | ('S' << 24))
+
+/*	DDS_header_DXT10 resourceDimension and miscFlag values	*/
+#define DDS_DIMENSION_TEXTURE2D	3
+#define DDS_RESOURCE_MISC_TEXTURECUBE	0x00000004
+
+/*	The DXGI_FORMAT values of the DX10 header that can be
+	uploaded directly	*/
+#define DXGI_FORMAT_R16G16B16A16_FLOAT	10
+#define DXGI_FORMAT_R8G8B8A8_UNORM	28
+#define DXGI_FORMAT_R8G8B8A8_UNORM_SRGB	29
+#define DXGI_FORMAT_R9G9B9E5_SHAREDEXP	67
+#define DXGI_FORMAT_BC1_UNORM	71
+#define DXGI_FORMAT_BC1_UNORM_SRGB	72
+#define DXGI_FORMAT_BC2_UNORM	74
+#define DXGI_FORMAT_BC2_UNORM_SRGB	75
+#define DXGI_FORMAT_BC3_UNORM	77
+#define DXGI_FORMAT_BC3_UNORM_SRGB	78
+#define DXGI_FORMAT_BC4_UNORM	80
+#define DXGI_FORMAT_BC4_SNORM	81
+#define DXGI_FORMAT_BC5_UNORM	83
+#define DXGI_FORMAT_BC5_SNORM	84
+#define DXGI_FORMAT_B8G8R8A8_UNORM	87
+#define DXGI_FORMAT_B8G8R8A8_UNORM_SRGB	91
+#define DXGI_FORMAT_BC6H_UF16	95
+#define DXGI_FORMAT_BC6H_SF16	96
+#define DXGI_FORMAT_BC7_UNORM	98
+#define DXGI_FORMAT_BC7_UNORM_SRGB	99
+
 #endif /* HEADER_IMAGE_DXT	*/
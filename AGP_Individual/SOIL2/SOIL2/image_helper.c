@@ -10,6 +10,11 @@
 #include <stdlib.h>
 #include <math.h>
 
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) )
+	#define IMAGE_HELPER_SSE2
+	#include <emmintrin.h>
+#endif
+
 /*	Upscaling the image uses simple bilinear interpolation	*/
 int
 	up_scale_image
@@ -433,3 +438,281 @@ RGBE_to_RGBdivA2
 	}
 	return 1;
 }
+
+/*	RGBE is m * 2^(e-136), RGB9_E5 is m9 * 2^(E-24): with m9 = 2m the
+	exponents line up as E = e - 113, so e in [113,144] converts exactly	*/
+static unsigned int
+RGBE_texel_to_RGB9_E5
+(
+	const unsigned char *rgbe
+)
+{
+	int e = rgbe[3];
+	float scale;
+	if( e == 0 )
+	{
+		return 0;
+	}
+	if( (e >= 113) && (e <= 144) )
+	{
+		return (rgbe[0] << 1) | (rgbe[1] << 10) | (rgbe[2] << 19) | ((unsigned int)(e - 113) << 27);
+	}
+	/*	out of range, round and clamp it the long way	*/
+	scale = (float)ldexp( 1.0f, e - 136 );
+	return float_to_RGB9_E5( rgbe[0] * scale, rgbe[1] * scale, rgbe[2] * scale );
+}
+
+int
+RGBE_to_RGB9_E5
+(
+	const unsigned char *rgbe,
+	unsigned int *rgb9e5,
+	int texels
+)
+{
+	int i = 0;
+	/* error check */
+	if( (!rgbe) || (!rgb9e5) || (texels < 1) )
+	{
+		return 0;
+	}
+#ifdef IMAGE_HELPER_SSE2
+	{
+		const __m128i byte_mask = _mm_set1_epi32( 0xFF );
+		const __m128i lowest = _mm_set1_epi32( 112 );
+		const __m128i highest = _mm_set1_epi32( 145 );
+		const __m128i bias = _mm_set1_epi32( 113 );
+		for( ; i + 4 <= texels; i += 4 )
+		{
+			__m128i texel = _mm_loadu_si128( (const __m128i*)(rgbe + i * 4) );
+			__m128i e = _mm_srli_epi32( texel, 24 );
+			__m128i exact = _mm_and_si128( _mm_cmpgt_epi32( e, lowest ), _mm_cmplt_epi32( e, highest ) );
+			__m128i black = _mm_cmpeq_epi32( e, _mm_setzero_si128() );
+			__m128i r, g, b;
+			if( _mm_movemask_epi8( _mm_or_si128( exact, black ) ) != 0xFFFF )
+			{
+				/*	one of these 4 needs rounding, do them one at a time	*/
+				rgb9e5[i+0] = RGBE_texel_to_RGB9_E5( rgbe + i * 4 + 0 );
+				rgb9e5[i+1] = RGBE_texel_to_RGB9_E5( rgbe + i * 4 + 4 );
+				rgb9e5[i+2] = RGBE_texel_to_RGB9_E5( rgbe + i * 4 + 8 );
+				rgb9e5[i+3] = RGBE_texel_to_RGB9_E5( rgbe + i * 4 + 12 );
+				continue;
+			}
+			r = _mm_slli_epi32( _mm_and_si128( texel, byte_mask ), 1 );
+			g = _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( texel, 8 ), byte_mask ), 10 );
+			b = _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( texel, 16 ), byte_mask ), 19 );
+			e = _mm_slli_epi32( _mm_sub_epi32( e, bias ), 27 );
+			/*	black texels (e = 0) come out as 0	*/
+			texel = _mm_and_si128( _mm_or_si128( _mm_or_si128( r, g ), _mm_or_si128( b, e ) ), exact );
+			_mm_storeu_si128( (__m128i*)(rgb9e5 + i), texel );
+		}
+	}
+#endif
+	for( ; i < texels; ++i )
+	{
+		rgb9e5[i] = RGBE_texel_to_RGB9_E5( rgbe + i * 4 );
+	}
+	return 1;
+}
+
+int
+RGBE_to_RGBA16F
+(
+	const unsigned char *rgbe,
+	unsigned short *rgba16f,
+	int texels
+)
+{
+	/*	m = 2^k * 1.f, so m * 2^(e-136) is a half with the exponent
+		field e - 121 + k and the bits of m below its top one as the
+		mantissa, exactly	*/
+	unsigned short mantissa[256];
+	int top_bit[256];
+	int i, c, k;
+	/* error check */
+	if( (!rgbe) || (!rgba16f) || (texels < 1) )
+	{
+		return 0;
+	}
+	mantissa[0] = 0;
+	top_bit[0] = 0;
+	for( i = 1; i < 256; ++i )
+	{
+		for( k = 7; (i >> k) == 0; --k )
+		{
+		}
+		top_bit[i] = k;
+		mantissa[i] = (unsigned short)((i << (10 - k)) & 0x3FF);
+	}
+	for( i = 0; i < texels; ++i, rgbe += 4, rgba16f += 4 )
+	{
+		int e = rgbe[3];
+		for( c = 0; c < 3; ++c )
+		{
+			int m = rgbe[c];
+			int exponent = e - 121 + top_bit[m];
+			if( (m == 0) || (e == 0) )
+			{
+				rgba16f[c] = 0;
+			} else
+			if( (exponent >= 1) && (exponent <= 30) )
+			{
+				rgba16f[c] = (unsigned short)((exponent << 10) | mantissa[m]);
+			} else
+			{
+				rgba16f[c] = float_to_half( (float)ldexp( (float)m, e - 136 ) );
+			}
+		}
+		/*	alpha is 1.0	*/
+		rgba16f[3] = 0x3C00;
+	}
+	return 1;
+}
+
+unsigned int
+float_to_RGB9_E5
+(
+	float r, float g, float b
+)
+{
+	const float max_value = 65408.0f;	/*	511/512 * 2^16	*/
+	float max_c, denom;
+	int exp_shared, exponent, max_m, rm, gm, bm;
+	/*	clamp, negative numbers and NaNs go to 0	*/
+	r = (r > 0.0f) ? ((r < max_value) ? r : max_value) : 0.0f;
+	g = (g > 0.0f) ? ((g < max_value) ? g : max_value) : 0.0f;
+	b = (b > 0.0f) ? ((b < max_value) ? b : max_value) : 0.0f;
+	max_c = (r > g) ? r : g;
+	max_c = (b > max_c) ? b : max_c;
+	if( max_c == 0.0f )
+	{
+		return 0;
+	}
+	/*	floor( log2( max_c ) ) is exponent - 1	*/
+	frexp( max_c, &exponent );
+	exp_shared = ((exponent - 1 < -16) ? -16 : exponent - 1) + 16;
+	denom = (float)ldexp( 1.0f, exp_shared - 24 );
+	max_m = (int)floor( max_c / denom + 0.5f );
+	if( max_m == 512 )
+	{
+		denom *= 2.0f;
+		++exp_shared;
+	}
+	rm = (int)floor( r / denom + 0.5f );
+	gm = (int)floor( g / denom + 0.5f );
+	bm = (int)floor( b / denom + 0.5f );
+	return rm | (gm << 9) | (bm << 18) | ((unsigned int)exp_shared << 27);
+}
+
+void
+RGB9_E5_to_float
+(
+	unsigned int texel,
+	float *rgb
+)
+{
+	float scale = (float)ldexp( 1.0f, (int)(texel >> 27) - 24 );
+	rgb[0] = (float)(texel & 0x1FF) * scale;
+	rgb[1] = (float)((texel >> 9) & 0x1FF) * scale;
+	rgb[2] = (float)((texel >> 18) & 0x1FF) * scale;
+}
+
+unsigned short
+float_to_half
+(
+	float f
+)
+{
+	union
+	{
+		float f;
+		unsigned int u;
+	} v;
+	unsigned int sign;
+	v.f = f;
+	sign = (v.u >> 16) & 0x8000;
+	v.u &= 0x7FFFFFFF;
+	if( v.u > 0x7F800000 )
+	{
+		/*	NaN	*/
+		return (unsigned short)(sign | 0x7E00);
+	}
+	if( v.u >= 0x477FF000 )
+	{
+		/*	would round to infinity	*/
+		return (unsigned short)(sign | 0x7BFF);
+	}
+	if( v.u < 0x38800000 )
+	{
+		/*	denormal (or 0), in units of 2^-24	*/
+		return (unsigned short)(sign | (unsigned int)(v.f * 16777216.0f + 0.5f));
+	}
+	/*	rebias the exponent and round the mantissa to nearest even	*/
+	v.u += 0xFFF + ((v.u >> 13) & 1);
+	return (unsigned short)(sign | ((v.u - 0x38000000) >> 13));
+}
+
+int
+equirectangular_to_cube_face
+(
+	const unsigned int *rgb9e5,
+	int width, int height,
+	int face, int face_size,
+	float *rgb
+)
+{
+	const float pi = 3.14159265358979f;
+	int x, y, c;
+	/* error check */
+	if( (!rgb9e5) || (!rgb) || (width < 1) || (height < 1) ||
+		(face < 0) || (face > 5) || (face_size < 1) )
+	{
+		return 0;
+	}
+	for( y = 0; y < face_size; ++y )
+	{
+		/*	texel centres, t = 0 is the 1st row	*/
+		float tc = 2.0f * (y + 0.5f) / face_size - 1.0f;
+		for( x = 0; x < face_size; ++x )
+		{
+			float sc = 2.0f * (x + 0.5f) / face_size - 1.0f;
+			float dx, dy, dz, length, u, v, fu, fv;
+			float texel[4][3];
+			int x0, x1, y0, y1;
+			/*	the direction this texel looks in, from the cube map
+				face selection table of the OpenGL spec	*/
+			switch( face )
+			{
+			case 0:		dx = 1.0f;	dy = -tc;	dz = -sc;	break;
+			case 1:		dx = -1.0f;	dy = -tc;	dz = sc;	break;
+			case 2:		dx = sc;	dy = 1.0f;	dz = tc;	break;
+			case 3:		dx = sc;	dy = -1.0f;	dz = -tc;	break;
+			case 4:		dx = sc;	dy = -tc;	dz = 1.0f;	break;
+			default:	dx = -sc;	dy = -tc;	dz = -1.0f;	break;
+			}
+			length = (float)sqrt( dx * dx + dy * dy + dz * dz );
+			/*	longitude across, latitude down, in texels	*/
+			u = ((float)atan2( dx, -dz ) / (2.0f * pi) + 0.5f) * width - 0.5f;
+			v = (float)acos( dy / length ) / pi * height - 0.5f;
+			x0 = (int)floor( u );
+			y0 = (int)floor( v );
+			fu = u - x0;
+			fv = v - y0;
+			x0 = ((x0 % width) + width) % width;
+			x1 = (x0 + 1) % width;
+			y1 = (y0 + 1 < height) ? y0 + 1 : height - 1;
+			y0 = (y0 < 0) ? 0 : y0;
+			RGB9_E5_to_float( rgb9e5[y0 * width + x0], texel[0] );
+			RGB9_E5_to_float( rgb9e5[y0 * width + x1], texel[1] );
+			RGB9_E5_to_float( rgb9e5[y1 * width + x0], texel[2] );
+			RGB9_E5_to_float( rgb9e5[y1 * width + x1], texel[3] );
+			for( c = 0; c < 3; ++c )
+			{
+				float top = texel[0][c] + (texel[1][c] - texel[0][c]) * fu;
+				float bottom = texel[2][c] + (texel[3][c] - texel[2][c]) * fu;
+				rgb[(y * face_size + x) * 3 + c] = top + (bottom - top) * fv;
+			}
+		}
+	}
+	return 1;
+}
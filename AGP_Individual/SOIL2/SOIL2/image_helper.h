@@ -108,6 +108,85 @@ int
 		int rescale_to_max
 	);
 
+/**
+	Converts an HDR image from an array of unsigned chars (RGBE) to
+	GL_RGB9_E5 texels, for GL_UNSIGNED_INT_5_9_9_9_REV uploads.  Both
+	keep a shared exponent, so texels convert exactly with shifts (4 at
+	a time with SSE2); only the very dark or very bright go through
+	float_to_RGB9_E5.  rgbe and rgb9e5 may be the same buffer.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	RGBE_to_RGB9_E5
+	(
+		const unsigned char *rgbe,
+		unsigned int *rgb9e5,
+		int texels
+	);
+
+/**
+	Converts an HDR image from an array of unsigned chars (RGBE) to
+	half floats, RGBA with alpha 1.0, for GL_RGBA16F.  The 8 bit
+	mantissas always fit, so texels convert exactly by table lookup
+	unless they under or overflow a half.
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	RGBE_to_RGBA16F
+	(
+		const unsigned char *rgbe,
+		unsigned short *rgba16f,
+		int texels
+	);
+
+/**
+	Packs an RGB color into one GL_RGB9_E5 texel, as in the
+	EXT_texture_shared_exponent spec (clamped to [0,65408])
+**/
+unsigned int
+	float_to_RGB9_E5
+	(
+		float r, float g, float b
+	);
+
+/**
+	Unpacks a GL_RGB9_E5 texel to 3 floats
+**/
+void
+	RGB9_E5_to_float
+	(
+		unsigned int texel,
+		float *rgb
+	);
+
+/**
+	Converts a float to a half float, rounding to nearest even and
+	clamping to the largest finite half (65504)
+**/
+unsigned short
+	float_to_half
+	(
+		float f
+	);
+
+/**
+	Resamples an equirectangular (latitude / longitude) GL_RGB9_E5
+	image into one face of a cubemap.  face is 0 to 5 in OpenGL's order
+	(+X, -X, +Y, -Y, +Z, -Z) and orientation, the middle of the image
+	looks down -Z and its top row straight up.  Bilinear filtered,
+	wrapping around horizontally.
+	\param rgb receives face_size * face_size RGB float texels
+	\return 0 if failed, otherwise returns 1
+**/
+int
+	equirectangular_to_cube_face
+	(
+		const unsigned int *rgb9e5,
+		int width, int height,
+		int face, int face_size,
+		float *rgb
+	);
+
 #ifdef __cplusplus
 }
 #endif
@@ -210,12 +210,29 @@ RECENT REVISION HISTORY:
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
 //
+// The PNG decoder uses the same SSE2 test for scanline unfiltering; with
+// GCC/Clang on x64 the "up" filter additionally uses AVX2 when the CPU has
+// it (define STBI_NO_AVX2 to turn that off).
+//
 // If for some reason you do not want to use any of SIMD code, or if
 // you have issues compiling it, you can disable it entirely by
 // defining STBI_NO_SIMD.
 //
 // ===========================================================================
 //
+// Threads
+//
+// Large JPEGs are decoded on several threads (Win32 threads or pthreads),
+// which are started for the one image and joined before the load returns.
+// Baseline files with restart intervals (DRI) loaded with one of the
+// *_from_memory functions are entropy decoded in parallel, one run of restart
+// segments per thread; other files only do the IDCT and color conversion in
+// parallel.
+// Use stbi_set_jpeg_thread_count() to limit this at runtime, or define
+// STBI_NO_THREADS to leave the threading code out altogether.
+//
+// ===========================================================================
+//
 // HDR image support   (disable by defining STBI_NO_HDR)
 //
 // stb_image now supports loading HDR images in general, and currently
@@ -356,8 +373,14 @@ STBIDEF stbi_uc *stbi_load               (char              const *filename,
 STBIDEF stbi_uc *stbi_load_from_memory   (stbi_uc           const *buffer, int len   , int *x, int *y, int *channels_in_file, int desired_channels);
 STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk  , void *user, int *x, int *y, int *channels_in_file, int desired_channels);
 
+// reduced-size decode: JPEGs come out at 1/2, 1/4 or 1/8 size (scale_denom
+// 2, 4, 8) straight from a smaller IDCT, rounding the dimensions up. other
+// formats ignore scale_denom and load at full size, so always use *x and *y.
+STBIDEF stbi_uc *stbi_load_scaled_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels, int scale_denom);
+
 #ifndef STBI_NO_STDIO
 STBIDEF stbi_uc *stbi_load_from_file   (FILE *f, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF stbi_uc *stbi_load_scaled      (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels, int scale_denom);
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 #endif
 
@@ -436,6 +459,13 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// number of threads the JPEG decoder may use for large images: 0 (the default)
+// uses one per CPU, 1 decodes on the calling thread only. baseline files with
+// restart markers that are loaded from memory have their entropy decoding split
+// across threads; everything else only runs the IDCT and color conversion in
+// parallel. has no effect when compiled with STBI_NO_THREADS
+STBIDEF void stbi_set_jpeg_thread_count(int thread_count);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -547,12 +577,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -662,6 +694,19 @@ static int stbi__sse2_available()
 #endif
 #endif
 
+// AVX2 is only used for the byte-parallel PNG "up" filter, and only where
+// GCC/Clang let us compile a single function for it and check at run-time.
+// Define STBI_NO_AVX2 to keep the SSE2 path only.
+#if defined(STBI_SSE2) && defined(STBI__X64_TARGET) && (defined(__GNUC__) || defined(__clang__)) && !defined(STBI_NO_AVX2)
+#define STBI_AVX2
+#include <immintrin.h>
+
+static int stbi__avx2_available()
+{
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -677,6 +722,39 @@ static int stbi__sse2_available()
 #define STBI_SIMD_ALIGN(type, name) type name
 #endif
 
+#ifndef STBI_THREAD_LOCAL
+   #if defined(__cplusplus) && __cplusplus >= 201103L
+      #define STBI_THREAD_LOCAL       thread_local
+   #elif defined(_MSC_VER)
+      #define STBI_THREAD_LOCAL       __declspec(thread)
+   #elif defined(__GNUC__)
+      #define STBI_THREAD_LOCAL       __thread
+   #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STBI_THREAD_LOCAL       _Thread_local
+   #else
+      #define STBI_THREAD_LOCAL
+   #endif
+#endif
+
+// threads
+#if !defined(STBI_NO_THREADS) && !defined(_WIN32) && !defined(__unix__) && !defined(__APPLE__)
+#define STBI_NO_THREADS
+#endif
+
+#ifndef STBI_NO_THREADS
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#endif
+
+#define STBI__MAX_THREADS  32
+
 ///////////////////////////////////////////////
 //
 //  stbi__context struct and start_xxx functions
@@ -697,6 +775,8 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   int scale_shift;   // requested 1/(1<<scale_shift) size decode, JPEG only
 } stbi__context;
 
 
@@ -707,6 +787,7 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
 {
    s->io.read = NULL;
    s->read_from_callbacks = 0;
+   s->scale_shift = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
 }
@@ -718,6 +799,7 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
    s->io_user_data = user;
    s->buflen = sizeof(s->buffer_start);
    s->read_from_callbacks = 1;
+   s->scale_shift = 0;
    s->img_buffer_original = s->buffer_start;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
@@ -850,8 +932,8 @@ static void    *stbi__pkm_load(stbi__context *s, int *x, int *y, int *comp, int
 static int      stbi__pkm_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
-// this is not threadsafe
-static const char *stbi__g_failure_reason;
+// each thread has its own, so loads on different threads don't report each other's failures
+static STBI_THREAD_LOCAL const char *stbi__g_failure_reason;
 
 STBIDEF const char *stbi_failure_reason(void)
 {
@@ -975,6 +1057,13 @@ STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
     stbi__vertically_flip_on_load = flag_true_if_should_flip;
 }
 
+static int stbi__jpeg_thread_count = 0;
+
+STBIDEF void stbi_set_jpeg_thread_count(int thread_count)
+{
+    stbi__jpeg_thread_count = thread_count;
+}
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1237,6 +1326,38 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+// 1 -> 0, 2 -> 1, 4 -> 2, 8 or more -> 3; in-between values round down
+static int stbi__scale_shift_for(int scale_denom)
+{
+   if (scale_denom >= 8) return 3;
+   if (scale_denom >= 4) return 2;
+   if (scale_denom >= 2) return 1;
+   return 0;
+}
+
+STBIDEF stbi_uc *stbi_load_scaled_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, int scale_denom)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   s.scale_shift = stbi__scale_shift_for(scale_denom);
+   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_load_scaled(char const *filename, int *x, int *y, int *comp, int req_comp, int scale_denom)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   unsigned char *result;
+   stbi__context s;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   s.scale_shift = stbi__scale_shift_for(scale_denom);
+   result = stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+#endif
+
 #ifndef STBI_NO_LINEAR
 static float *stbi__loadf_main(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
@@ -1644,6 +1765,90 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
 }
 #endif
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  task threads, shared by the JPEG decoder and SOIL's DDS transcoding
+//
+
+static int stbi__cpu_count(void)
+{
+#if defined(STBI_NO_THREADS)
+   return 1;
+#elif defined(_WIN32)
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return (int) info.dwNumberOfProcessors;
+#else
+   long n = sysconf(_SC_NPROCESSORS_ONLN);
+   return n > 0 ? (int) n : 1;
+#endif
+}
+
+typedef void (*stbi__task_func)(void *task);
+
+#ifndef STBI_NO_THREADS
+typedef struct
+{
+   stbi__task_func func;
+   void *task;
+} stbi__thread_start;
+
+#ifdef _WIN32
+static DWORD WINAPI STBI_FORCE_STACK_ALIGN stbi__thread_main(LPVOID arg)
+#else
+static void * STBI_FORCE_STACK_ALIGN stbi__thread_main(void *arg)
+#endif
+{
+   stbi__thread_start *start = (stbi__thread_start *) arg;
+   start->func(start->task);
+   return 0;
+}
+#endif
+
+// run func on 'count' tasks laid out task_size bytes apart, and return once
+// all of them are done. task 0 runs on the calling thread; if a thread can't
+// be started its task runs there as well
+static void stbi__run_tasks(stbi__task_func func, void *tasks, size_t task_size, int count)
+{
+   int i;
+#ifndef STBI_NO_THREADS
+   stbi__thread_start start[STBI__MAX_THREADS];
+   int started[STBI__MAX_THREADS];
+   #ifdef _WIN32
+   HANDLE thread[STBI__MAX_THREADS];
+   #else
+   pthread_t thread[STBI__MAX_THREADS];
+   #endif
+   STBI_ASSERT(count <= STBI__MAX_THREADS);
+   for (i=1; i < count; ++i) {
+      start[i].func = func;
+      start[i].task = (char *) tasks + i*task_size;
+      #ifdef _WIN32
+      thread[i] = CreateThread(NULL, 0, stbi__thread_main, &start[i], 0, NULL);
+      started[i] = thread[i] != NULL;
+      #else
+      started[i] = pthread_create(&thread[i], NULL, stbi__thread_main, &start[i]) == 0;
+      #endif
+   }
+   func(tasks);
+   for (i=1; i < count; ++i) {
+      if (!started[i]) {
+         func(start[i].task);
+         continue;
+      }
+      #ifdef _WIN32
+      WaitForSingleObject(thread[i], INFINITE);
+      CloseHandle(thread[i]);
+      #else
+      pthread_join(thread[i], NULL);
+      #endif
+   }
+#else
+   for (i=0; i < count; ++i)
+      func((char *) tasks + i*task_size);
+#endif
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 //  "baseline" JPEG/JFIF decoder
@@ -1667,6 +1872,15 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
 
 #ifndef STBI_NO_JPEG
 
+// images smaller than this many pixels aren't worth starting threads for
+#define STBI__JPEG_THREAD_MIN_PIXELS  (1 << 18)
+
+static int stbi__jpeg_threads(void)
+{
+   int n = stbi__jpeg_thread_count > 0 ? stbi__jpeg_thread_count : stbi__cpu_count();
+   return n < 1 ? 1 : n > STBI__MAX_THREADS ? STBI__MAX_THREADS : n;
+}
+
 // huffman decoding acceleration
 #define FAST_BITS   9  // larger handles more cases; smaller stomps less cache
 
@@ -1707,7 +1921,7 @@ typedef struct
       stbi_uc *data;
       void *raw_data, *raw_coeff;
       stbi_uc *linebuf;
-      short   *coeff;   // progressive only
+      short   *coeff;   // progressive, or baseline with the IDCT deferred
       int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
    } img_comp[4];
 
@@ -1728,6 +1942,8 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int scale_shift; // decode at 1/(1<<scale_shift) size; blocks are (8>>scale_shift) pixels square
+   int threads;     // threads this image may use, 1 if it's too small to bother
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
@@ -2243,6 +2459,67 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// reduced-size IDCTs for scaled decoding: an n-point IDCT over the n lowest
+// frequencies of each axis gives the block at 1/(8/n) size, already filtered,
+// so 1/2, 1/4 and 1/8 images never go through the full 8x8 transform.
+// stbi__idct_reduced_table[x][u] = c(u)/2 * cos((2x+1)u*pi/2n) * 4096,
+// with c(0) = 1/sqrt(2) and c(u) = 1 otherwise.
+static const int stbi__idct_reduced_table4[4][4] =
+{
+   { 1448,  1892,  1448,   784 },
+   { 1448,   784, -1448, -1892 },
+   { 1448,  -784, -1448,  1892 },
+   { 1448, -1892,  1448,  -784 }
+};
+
+static const int stbi__idct_reduced_table2[2][4] =
+{
+   { 1448,  1448 },
+   { 1448, -1448 }
+};
+
+static void stbi__idct_reduced(stbi_uc *out, int out_stride, short data[64], int n, const int (*t)[4])
+{
+   int tmp[4*4];
+   int u,v,x,y;
+   // rows: coefficient row v -> n samples, kept with one fractional bit
+   for (v=0; v < n; ++v) {
+      for (x=0; x < n; ++x) {
+         int sum = 0;
+         for (u=0; u < n; ++u)
+            sum += t[x][u] * data[v*8+u];
+         tmp[v*4+x] = (sum + (1 << 10)) >> 11;
+      }
+   }
+   // columns: scale is 4096 * 2, so 13 bits come off along with the +128 bias
+   for (y=0; y < n; ++y) {
+      stbi_uc *o = out + y*out_stride;
+      for (x=0; x < n; ++x) {
+         int sum = 0;
+         for (v=0; v < n; ++v)
+            sum += t[y][v] * tmp[v*4+x];
+         o[x] = stbi__clamp((sum + (1 << 12) + (128 << 13)) >> 13);
+      }
+   }
+}
+
+static void stbi__idct_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, 4, stbi__idct_reduced_table4);
+}
+
+static void stbi__idct_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, 2, stbi__idct_reduced_table2);
+}
+
+static void stbi__idct_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   // DC only: the same rounding as stbi__idct_block gives for a flat block
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2666,10 +2943,183 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// one 8x8 block of coefficients per block of the component's interleaved MCUs
+static int stbi__jpeg_alloc_coeff(stbi__jpeg *z, int n)
+{
+   z->img_comp[n].coeff_w = z->img_mcu_x * z->img_comp[n].h;
+   z->img_comp[n].coeff_h = z->img_mcu_y * z->img_comp[n].v;
+   z->img_comp[n].raw_coeff = stbi__malloc_mad3(z->img_comp[n].coeff_w * 8, z->img_comp[n].coeff_h * 8, sizeof(short), 15);
+   if (z->img_comp[n].raw_coeff == NULL)
+      return 0;
+   z->img_comp[n].coeff = (short*) (((size_t) z->img_comp[n].raw_coeff + 15) & ~15);
+   return 1;
+}
+
+// a baseline block goes straight through the IDCT, unless the component is
+// keeping its coefficients for a parallel stbi__jpeg_finish
+stbi_inline static void stbi__jpeg_store_block(stbi__jpeg *z, int n, int bx, int by, short data[64])
+{
+   if (z->img_comp[n].coeff)
+      memcpy(z->img_comp[n].coeff + 64 * (bx + by * z->img_comp[n].coeff_w), data, 64 * sizeof(short));
+   else
+      z->idct_block_kernel(z->img_comp[n].data+(z->img_comp[n].w2*by+bx)*(8 >> z->scale_shift), z->img_comp[n].w2, data);
+}
+
+// decode baseline MCU number m of the current scan
+static int stbi__jpeg_decode_mcu(stbi__jpeg *z, short data[64], int m)
+{
+   int i,j,k,x,y;
+   if (z->scan_n == 1) {
+      // non-interleaved, so every block is an MCU
+      int n = z->order[0];
+      int w = (z->img_comp[n].x+7) >> 3;
+      int ha = z->img_comp[n].ha;
+      if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+      stbi__jpeg_store_block(z, n, m % w, m / w, data);
+      return 1;
+   }
+   i = m % z->img_mcu_x;
+   j = m / z->img_mcu_x;
+   for (k=0; k < z->scan_n; ++k) {
+      int n = z->order[k];
+      for (y=0; y < z->img_comp[n].v; ++y) {
+         for (x=0; x < z->img_comp[n].h; ++x) {
+            int ha = z->img_comp[n].ha;
+            if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+            stbi__jpeg_store_block(z, n, i*z->img_comp[n].h + x, j*z->img_comp[n].v + y, data);
+         }
+      }
+   }
+   return 1;
+}
+
+typedef struct
+{
+   stbi__jpeg z;        // private copy for the bit buffer and dc predictors
+   stbi__context s;
+   stbi_uc **segment;   // start of each restart segment; the scan ends at segment[count]
+   int first, count;    // segments handled by this task
+   int mcus;            // MCUs in the scan
+   int ok;
+   const char *failure; // the worker's failure reason, which is its thread's own
+} stbi__jpeg_restart_task;
+
+static void stbi__jpeg_restart_worker(void *arg)
+{
+   stbi__jpeg_restart_task *t = (stbi__jpeg_restart_task *) arg;
+   stbi__jpeg *z = &t->z;
+   int k, m, last;
+   STBI_SIMD_ALIGN(short, data[64]);
+   z->s = &t->s;
+   t->ok = 1;
+   for (k = t->first; k < t->first + t->count; ++k) {
+      stbi__start_mem(&t->s, t->segment[k], (int) (t->segment[k+1] - t->segment[k]));
+      stbi__jpeg_reset(z);
+      m = k * z->restart_interval;
+      last = m + z->restart_interval < t->mcus ? m + z->restart_interval : t->mcus;
+      for (; m < last; ++m) {
+         if (!stbi__jpeg_decode_mcu(z, data, m)) {
+            t->ok = 0;
+            t->failure = stbi__g_failure_reason;
+            return;
+         }
+      }
+   }
+}
+
+// with restart markers every segment of a baseline scan starts from a clean
+// decoder state, so we can find the markers up front and hand runs of segments
+// to different threads. returns -1 if the segments don't line up with the MCU
+// count (or the data isn't all in memory), in which case nothing was consumed
+// and the scan should be decoded serially
+static int stbi__parse_entropy_coded_data_threaded(stbi__jpeg *z)
+{
+   stbi__jpeg_restart_task *task;
+   stbi_uc **segment;
+   stbi_uc *p = z->s->img_buffer, *end = z->s->img_buffer_end;
+   int mcus, segments, count, threads, k, ok;
+
+   if (z->s->read_from_callbacks)
+      return -1;
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      mcus = ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   } else
+      mcus = z->img_mcu_x * z->img_mcu_y;
+   segments = (mcus + z->restart_interval - 1) / z->restart_interval;
+   if (segments < 2)
+      return -1;
+
+   segment = (stbi_uc **) stbi__malloc_mad2(segments + 1, sizeof(stbi_uc *), 0);
+   if (!segment) return -1;
+
+   // find the RSTn markers, skipping stuffed zeros and fill bytes; any other
+   // marker ends the scan
+   count = 1;
+   segment[0] = p;
+   while (p < end) {
+      p = (stbi_uc *) memchr(p, 0xff, end - p);
+      if (!p || p + 1 >= end) { p = end; break; }
+      if (p[1] == 0x00) { p += 2; continue; }
+      if (p[1] == 0xff) { p += 1; continue; }
+      if (!STBI__RESTART(p[1])) break;
+      if (count == segments) { count = 0; break; }
+      segment[count++] = p + 2;
+      p += 2;
+   }
+   if (count != segments) {
+      STBI_FREE(segment);
+      return -1;
+   }
+   segment[segments] = p;
+
+   threads = z->threads < segments ? z->threads : segments;
+   task = (stbi__jpeg_restart_task *) stbi__malloc_mad2(threads, sizeof(*task), 0);
+   if (!task) {
+      STBI_FREE(segment);
+      return -1;
+   }
+   for (k=0; k < threads; ++k) {
+      task[k].z       = *z;
+      task[k].segment = segment;
+      task[k].first   = segments * k / threads;
+      task[k].count   = segments * (k+1) / threads - task[k].first;
+      task[k].mcus    = mcus;
+   }
+   stbi__run_tasks(stbi__jpeg_restart_worker, task, sizeof(*task), threads);
+
+   // a corrupt segment fails the image, the same as it would serially
+   ok = 1;
+   for (k=0; k < threads; ++k) {
+      if (ok && !task[k].ok) stbi__err(task[k].failure, task[k].failure);
+      ok &= task[k].ok;
+   }
+   STBI_FREE(task);
+   STBI_FREE(segment);
+
+   // carry on reading from the marker that ended the scan
+   z->s->img_buffer = p;
+   z->marker = STBI__MARKER_none;
+   return ok;
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
    if (!z->progressive) {
+      if (z->threads > 1) {
+         int k;
+         if (z->restart_interval) {
+            k = stbi__parse_entropy_coded_data_threaded(z);
+            if (k >= 0) return k;
+         }
+         // the entropy decoding can't be split, but keeping the coefficients
+         // lets stbi__jpeg_finish do the IDCT in parallel (if there's no memory
+         // for them, the blocks just get transformed as we go)
+         for (k=0; k < z->scan_n; ++k)
+            if (!z->img_comp[z->order[k]].coeff)
+               stbi__jpeg_alloc_coeff(z, z->order[k]);
+      }
       if (z->scan_n == 1) {
          int i,j;
          STBI_SIMD_ALIGN(short, data[64]);
@@ -2684,7 +3134,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_store_block(z, n, i, j, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2708,11 +3158,9 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   // by the basic H and V specified for the component
                   for (y=0; y < z->img_comp[n].v; ++y) {
                      for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        stbi__jpeg_store_block(z, n, i*z->img_comp[n].h + x, j*z->img_comp[n].v + y, data);
                      }
                   }
                }
@@ -2797,25 +3245,46 @@ static void stbi__jpeg_dequantize(short *data, stbi__uint16 *dequant)
       data[i] *= dequant[i];
 }
 
-static void stbi__jpeg_finish(stbi__jpeg *z)
+typedef struct
 {
-   if (z->progressive) {
-      // dequantize and idct the data
-      int i,j,n;
-      for (n=0; n < z->s->img_n; ++n) {
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+   stbi__jpeg *z;
+   int index, count; // this task does block rows [h*index/count, h*(index+1)/count) of each component
+} stbi__jpeg_finish_task;
+
+static void stbi__jpeg_finish_worker(void *arg)
+{
+   stbi__jpeg_finish_task *t = (stbi__jpeg_finish_task *) arg;
+   stbi__jpeg *z = t->z;
+   int i,j,n;
+   for (n=0; n < z->s->img_n; ++n) {
+      int w = (z->img_comp[n].x+7) >> 3;
+      int h = (z->img_comp[n].y+7) >> 3;
+      if (!z->img_comp[n].coeff) continue;
+      for (j = h * t->index / t->count; j < h * (t->index+1) / t->count; ++j) {
+         for (i=0; i < w; ++i) {
+            short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+            // baseline blocks were dequantized as they were decoded
+            if (z->progressive)
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-            }
+            z->idct_block_kernel(z->img_comp[n].data+(z->img_comp[n].w2*j+i)*(8 >> z->scale_shift), z->img_comp[n].w2, data);
          }
       }
    }
 }
 
+static void stbi__jpeg_finish(stbi__jpeg *z)
+{
+   // dequantize and idct the data of every component that kept coefficients
+   stbi__jpeg_finish_task task[STBI__MAX_THREADS];
+   int k, count = z->threads;
+   for (k=0; k < count; ++k) {
+      task[k].z = z;
+      task[k].index = k;
+      task[k].count = count;
+   }
+   stbi__run_tasks(stbi__jpeg_finish_worker, task, sizeof(task[0]), count);
+}
+
 static int stbi__process_marker(stbi__jpeg *z, int m)
 {
    int L;
@@ -3039,8 +3508,9 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      // (for scaled decodes the planes only hold the reduced blocks)
+      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * (8 >> z->scale_shift);
+      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * (8 >> z->scale_shift);
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3050,16 +3520,12 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
-         if (z->img_comp[i].raw_coeff == NULL)
+         if (!stbi__jpeg_alloc_coeff(z, i))
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
-         z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
       }
    }
 
+   z->threads = s->img_x >= STBI__JPEG_THREAD_MIN_PIXELS / s->img_y ? stbi__jpeg_threads() : 1;
    return 1;
 }
 
@@ -3132,8 +3598,7 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
       }
       m = stbi__get_marker(j);
    }
-   if (j->progressive)
-      stbi__jpeg_finish(j);
+   stbi__jpeg_finish(j);
    return 1;
 }
 
@@ -3514,6 +3979,8 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
+   j->scale_shift = 0;
+   j->threads = 1;
 
 #ifdef STBI_SSE2
    if (stbi__sse2_available()) {
@@ -3530,6 +3997,17 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
 #endif
 }
 
+// switch to the reduced IDCT for a 1/2, 1/4 or 1/8 size decode
+static void stbi__setup_jpeg_scale(stbi__jpeg *j, int scale_shift)
+{
+   j->scale_shift = scale_shift;
+   switch (scale_shift) {
+      case 1: j->idct_block_kernel = stbi__idct_4x4; break;
+      case 2: j->idct_block_kernel = stbi__idct_2x2; break;
+      case 3: j->idct_block_kernel = stbi__idct_1x1; break;
+   }
+}
+
 // clean up the temporary component buffers
 static void stbi__cleanup_jpeg(stbi__jpeg *j)
 {
@@ -3553,6 +4031,142 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
    return (stbi_uc) ((t + (t >>8)) >> 8);
 }
 
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc *output;
+   int n, decode_n, is_rgb;
+   stbi__resample res_comp[4];
+   stbi_uc *linebuf[4];
+   stbi_uc *last_row;   // the conversions write one byte past a 3-channel row, so the
+                        // last row of a band goes here to not race with the next band
+   unsigned int y0, y1; // output rows this task converts
+} stbi__jpeg_convert_task;
+
+// resample and color-convert rows [y0,y1) of the image
+static void stbi__jpeg_convert_worker(void *arg)
+{
+   stbi__jpeg_convert_task *t = (stbi__jpeg_convert_task *) arg;
+   stbi__jpeg *z = t->z;
+   stbi_uc *output = t->output;
+   stbi__resample *res_comp = t->res_comp;
+   int n = t->n, decode_n = t->decode_n, is_rgb = t->is_rgb;
+   int k;
+   unsigned int i,j;
+   stbi_uc *coutput[4];
+
+   // step the resamplers down to the first row
+   for (k=0; k < decode_n; ++k) {
+      stbi__resample *r = &res_comp[k];
+      for (j=0; j < t->y0; ++j) {
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+   }
+
+   for (j=t->y0; j < t->y1; ++j) {
+      stbi_uc *out = output + n * z->s->img_x * j;
+      if (j+1 == t->y1 && t->last_row) out = t->last_row;
+      for (k=0; k < decode_n; ++k) {
+         stbi__resample *r = &res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         coutput[k] = r->resample(t->linebuf[k],
+                                  y_bot ? r->line1 : r->line0,
+                                  y_bot ? r->line0 : r->line1,
+                                  r->w_lores, r->hs);
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+      if (n >= 3) {
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (is_rgb) {
+               for (i=0; i < z->s->img_x; ++i) {
+                  out[0] = y[i];
+                  out[1] = coutput[1][i];
+                  out[2] = coutput[2][i];
+                  out[3] = 255;
+                  out += n;
+               }
+            } else {
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else if (z->s->img_n == 4) {
+            if (z->app14_color_transform == 0) { // CMYK
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc k = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(coutput[0][i], k);
+                  out[1] = stbi__blinn_8x8(coutput[1][i], k);
+                  out[2] = stbi__blinn_8x8(coutput[2][i], k);
+                  out[3] = 255;
+                  out += n;
+               }
+            } else if (z->app14_color_transform == 2) { // YCCK
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc k = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(255 - out[0], k);
+                  out[1] = stbi__blinn_8x8(255 - out[1], k);
+                  out[2] = stbi__blinn_8x8(255 - out[2], k);
+                  out += n;
+               }
+            } else { // YCbCr + alpha?  Ignore the fourth channel for now
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               out[3] = 255; // not used if n==3
+               out += n;
+            }
+      } else {
+         if (is_rgb) {
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i)
+                  *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+            else {
+               for (i=0; i < z->s->img_x; ++i, out += 2) {
+                  out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                  out[1] = 255;
+               }
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc k = coutput[3][i];
+               stbi_uc r = stbi__blinn_8x8(coutput[0][i], k);
+               stbi_uc g = stbi__blinn_8x8(coutput[1][i], k);
+               stbi_uc b = stbi__blinn_8x8(coutput[2][i], k);
+               out[0] = stbi__compute_y(r, g, b);
+               out[1] = 255;
+               out += n;
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+               out[1] = 255;
+               out += n;
+            }
+         } else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+               for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
+         }
+      }
+   }
+   if (t->last_row)
+      memcpy(output + n * z->s->img_x * (t->y1-1), t->last_row, n * z->s->img_x);
+}
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
    int n, decode_n, is_rgb;
@@ -3564,6 +4178,18 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // after a reduced-size decode everything from here on works on the
+   // smaller image; the component planes were filled at that size already
+   if (z->scale_shift) {
+      int round = (1 << z->scale_shift) - 1;
+      z->s->img_x = (z->s->img_x + round) >> z->scale_shift;
+      z->s->img_y = (z->s->img_y + round) >> z->scale_shift;
+      for (n=0; n < z->s->img_n; ++n) {
+         z->img_comp[n].x = (z->img_comp[n].x + round) >> z->scale_shift;
+         z->img_comp[n].y = (z->img_comp[n].y + round) >> z->scale_shift;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -3576,12 +4202,11 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
    // resample and color-convert
    {
-      int k;
-      unsigned int i,j;
-      stbi_uc *output;
-      stbi_uc *coutput[4];
+      int k, t, count, scratch;
+      stbi_uc *output, *linebuf = NULL;
 
       stbi__resample res_comp[4];
+      stbi__jpeg_convert_task task[STBI__MAX_THREADS];
 
       for (k=0; k < decode_n; ++k) {
          stbi__resample *r = &res_comp[k];
@@ -3609,101 +4234,34 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
       output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
       if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
-      // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
+      // now go ahead and resample; big images are split into bands of rows
+      // that are converted in parallel, each with its own line buffers
+      count = (int) (z->s->img_y / 64);
+      if (count > z->threads) count = z->threads;
+      scratch = decode_n * (z->s->img_x + 3) + n * z->s->img_x + 1;
+      if (count > 1) {
+         linebuf = (stbi_uc *) stbi__malloc_mad2(count, scratch, 0);
+         if (!linebuf) count = 1;
+      }
+      if (count < 1) count = 1;
+      for (t=0; t < count; ++t) {
+         stbi_uc *p = count > 1 ? linebuf + (size_t) t * scratch : NULL;
+         task[t].z        = z;
+         task[t].output   = output;
+         task[t].n        = n;
+         task[t].decode_n = decode_n;
+         task[t].is_rgb   = is_rgb;
+         task[t].y0       = (unsigned int) ((stbi__uint64) z->s->img_y *  t    / count);
+         task[t].y1       = (unsigned int) ((stbi__uint64) z->s->img_y * (t+1) / count);
          for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc k = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], k);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], k);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], k);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc k = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], k);
-                     out[1] = stbi__blinn_8x8(255 - out[1], k);
-                     out[2] = stbi__blinn_8x8(255 - out[2], k);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc k = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], k);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], k);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], k);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
-            }
+            task[t].res_comp[k] = res_comp[k];
+            task[t].linebuf[k]  = t ? p + k * (z->s->img_x + 3) : z->img_comp[k].linebuf;
          }
+         task[t].last_row = t+1 < count ? p + decode_n * (z->s->img_x + 3) : NULL;
       }
+      stbi__run_tasks(stbi__jpeg_convert_worker, task, sizeof(task[0]), count);
+      if (linebuf) STBI_FREE(linebuf);
+
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
       *out_y = z->s->img_y;
@@ -3719,6 +4277,7 @@ static void * STBI_FORCE_STACK_ALIGN stbi__jpeg_load(stbi__context *s, int *x, i
    STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
+   stbi__setup_jpeg_scale(j, s->scale_shift);
    result = load_jpeg_image(j, x,y,comp,req_comp);
    STBI_FREE(j);
    return result;
@@ -3765,6 +4324,8 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
 //      - fast huffman
+//      - 64-bit bit buffer, refilled a word at a time
+//      - pairs of short literal codes resolved with a single table lookup
 
 #ifndef STBI_NO_ZLIB
 
@@ -3772,6 +4333,11 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 
+// literal/length codes short enough that two of them fit in this many bits
+// are decoded together; see stbi__zbuild_literal_pairs
+#define STBI__ZPAIR_BITS  11
+#define STBI__ZPAIR_MASK  ((1 << STBI__ZPAIR_BITS) - 1)
+
 // zlib-style huffman encoding
 // (jpegs packs from left, zlib from right, so can't share code)
 typedef struct
@@ -3858,7 +4424,8 @@ typedef struct
 {
    stbi_uc *zbuffer, *zbuffer_end;
    int num_bits;
-   stbi__uint32 code_buffer;
+   int num_padding;   // zero bytes shifted in after zbuffer_end was reached
+   stbi__uint64 code_buffer;
 
    char *zout;
    char *zout_start;
@@ -3866,6 +4433,10 @@ typedef struct
    int   z_expandable;
 
    stbi__zhuffman z_length, z_distance;
+
+   // (count << 30) | (total code bits << 24) | (second literal << 16) | first symbol,
+   // or 0 if the low STBI__ZPAIR_BITS don't start with a fast-table code
+   stbi__uint32 z_literal_pairs[1 << STBI__ZPAIR_BITS];
 } stbi__zbuf;
 
 stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
@@ -3876,18 +4447,33 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
 
 static void stbi__fill_bits(stbi__zbuf *z)
 {
+#if defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET)
+   // little-endian targets: load a whole word and keep as many complete bytes
+   // as fit, leaving the buffer holding 56..63 valid bits
+   if (z->zbuffer_end - z->zbuffer >= 8) {
+      stbi__uint64 word;
+      int n = z->num_bits | 56;
+      STBI_ASSERT(z->code_buffer < ((stbi__uint64) 1 << z->num_bits));
+      memcpy(&word, z->zbuffer, 8);
+      z->code_buffer |= (word << z->num_bits) & (((stbi__uint64) 1 << n) - 1);
+      z->zbuffer += (n - z->num_bits) >> 3;
+      z->num_bits = n;
+      return;
+   }
+#endif
    do {
-      STBI_ASSERT(z->code_buffer < (1U << z->num_bits));
-      z->code_buffer |= (unsigned int) stbi__zget8(z) << z->num_bits;
+      STBI_ASSERT(z->code_buffer < ((stbi__uint64) 1 << z->num_bits));
+      if (z->zbuffer >= z->zbuffer_end) ++z->num_padding;
+      z->code_buffer |= (stbi__uint64) stbi__zget8(z) << z->num_bits;
       z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= 48);
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) stbi__fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) (z->code_buffer & ((1 << n) - 1));
    z->code_buffer >>= n;
    z->num_bits -= n;
    return k;
@@ -3898,7 +4484,7 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
    int b,s,k;
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = stbi__bit_reverse(a->code_buffer, 16);
+   k = stbi__bit_reverse((int) (a->code_buffer & 0xffff), 16);
    for (s=STBI__ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
@@ -3915,7 +4501,7 @@ stbi_inline static int stbi__zhuffman_decode(stbi__zbuf *a, stbi__zhuffman *z)
 {
    int b,s;
    if (a->num_bits < 16) stbi__fill_bits(a);
-   b = z->fast[a->code_buffer & STBI__ZFAST_MASK];
+   b = z->fast[(int) (a->code_buffer & STBI__ZFAST_MASK)];
    if (b) {
       s = b >> 9;
       a->code_buffer >>= s;
@@ -3958,11 +4544,59 @@ static int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,
 static int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+// builds z_literal_pairs from the fast table of z_length. every index whose low
+// bits start with a code of at most STBI__ZFAST_BITS gets that symbol; if it is
+// a literal and the following code is a literal too, and both fit in
+// STBI__ZPAIR_BITS, the entry carries the second literal as well
+static void stbi__zbuild_literal_pairs(stbi__zbuf *a)
+{
+   stbi__zhuffman *z = &a->z_length;
+   int i;
+   for (i=0; i < (1 << STBI__ZPAIR_BITS); ++i) {
+      int b1 = z->fast[i & STBI__ZFAST_MASK];
+      stbi__uint32 e = 0;
+      if (b1) {
+         int s1 = b1 >> 9;
+         int b2 = z->fast[(i >> s1) & STBI__ZFAST_MASK];
+         int s2 = b2 >> 9;
+         // bits above STBI__ZPAIR_BITS-s1 in the second lookup are not real
+         // input, so the second code is only usable if it fits in the rest
+         if ((b1 & 511) < 256 && b2 && (b2 & 511) < 256 && s1 + s2 <= STBI__ZPAIR_BITS)
+            e = (2u << 30) | ((stbi__uint32) (s1 + s2) << 24) | ((stbi__uint32) (b2 & 255) << 16) | (stbi__uint32) (b1 & 511);
+         else
+            e = (1u << 30) | ((stbi__uint32) s1 << 24) | (stbi__uint32) (b1 & 511);
+      }
+      a->z_literal_pairs[i] = e;
+   }
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+      stbi__uint32 e;
+      if (a->num_bits < 16) stbi__fill_bits(a);
+      e = a->z_literal_pairs[(int) (a->code_buffer & STBI__ZPAIR_MASK)];
+      if (e) {
+         int bits = (int) ((e >> 24) & 31);
+         a->code_buffer >>= bits;
+         a->num_bits -= bits;
+         z = (int) (e & 511);
+         if (z < 256) {
+            int count = (int) (e >> 30);
+            if (zout + count > a->zout_end) {
+               if (!stbi__zexpand(a, zout, count)) return 0;
+               zout = a->zout;
+            }
+            zout[0] = (char) z;
+            if (count == 2) zout[1] = (char) ((e >> 16) & 255);
+            zout += count;
+            continue;
+         }
+      } else {
+         z = stbi__zhuffman_decode_slowpath(a, &a->z_length);
+      }
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4052,17 +4686,23 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
 static int stbi__parse_uncompressed_block(stbi__zbuf *a)
 {
    stbi_uc header[4];
-   int len,nlen,k;
+   int len,nlen,k,excess;
    if (a->num_bits & 7)
       stbi__zreceive(a, a->num_bits & 7); // discard
    // drain the bit-packed data into header
    k = 0;
-   while (a->num_bits > 0) {
+   // (the 64-bit buffer may hold more than the 4 header bytes; anything past
+   // them is stored data and is handed back to the input stream)
+   while (a->num_bits > 0 && k < 4) {
       header[k++] = (stbi_uc) (a->code_buffer & 255); // suppress MSVC run-time check
       a->code_buffer >>= 8;
       a->num_bits -= 8;
    }
-   STBI_ASSERT(a->num_bits == 0);
+   excess = a->num_bits >> 3;
+   a->zbuffer -= excess - (excess < a->num_padding ? excess : a->num_padding);
+   a->code_buffer = 0;
+   a->num_bits = 0;
+   a->num_padding = 0;
    // now fill header the normal way
    while (k < 4)
       header[k++] = stbi__zget8(a);
@@ -4126,6 +4766,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
    if (parse_header)
       if (!stbi__parse_zlib_header(a)) return 0;
    a->num_bits = 0;
+   a->num_padding = 0;
    a->code_buffer = 0;
    do {
       final = stbi__zreceive(a,1);
@@ -4142,6 +4783,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
+         stbi__zbuild_literal_pairs(a);
          if (!stbi__parse_huffman_block(a)) return 0;
       }
    } while (!final);
@@ -4309,6 +4951,151 @@ static int stbi__paeth(int a, int b, int c)
 
 static stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+#ifdef STBI_SSE2
+// SIMD unfiltering for 8-bit scanlines.
+//
+// "up" has no dependency between bytes, so it runs 16 (or 32) bytes at a time.
+// sub/avg/paeth depend on the pixel to the left, so those run one pixel per
+// iteration with all channels of the pixel in one register (after libpng's
+// filter_sse2_intrinsics.c); this only pays off for 3 and 4 channel images.
+// All kernels take 'n' bytes that follow the first pixel of the row, so cur-bpp
+// and prior-bpp are valid.
+
+// bpp is always a constant 3 or 4 after inlining
+stbi_inline static __m128i stbi__png_load_pixel(const stbi_uc *p, int bpp)
+{
+   int v;
+   if (bpp == 4)
+      memcpy(&v, p, 4);
+   else
+      v = p[0] | (p[1] << 8) | (p[2] << 16);
+   return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static void stbi__png_store_pixel(stbi_uc *p, __m128i v, int bpp)
+{
+   int x = _mm_cvtsi128_si32(v);
+   if (bpp == 4) {
+      memcpy(p, &x, 4);
+   } else {
+      p[0] = STBI__BYTECAST(x);
+      p[1] = STBI__BYTECAST(x >> 8);
+      p[2] = STBI__BYTECAST(x >> 16);
+   }
+}
+
+#ifdef STBI_AVX2
+__attribute__((target("avx2")))
+static int stbi__png_unfilter_up_avx2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n)
+{
+   int k = 0;
+   for (; k+32 <= n; k += 32) {
+      __m256i r = _mm256_loadu_si256((const __m256i *) (raw+k));
+      __m256i p = _mm256_loadu_si256((const __m256i *) (prior+k));
+      _mm256_storeu_si256((__m256i *) (cur+k), _mm256_add_epi8(r, p));
+   }
+   return k;
+}
+#endif
+
+static void stbi__png_unfilter_up_sse2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n)
+{
+   int k = 0;
+#ifdef STBI_AVX2
+   if (stbi__avx2_available())
+      k = stbi__png_unfilter_up_avx2(cur, raw, prior, n);
+#endif
+   for (; k+16 <= n; k += 16) {
+      __m128i r = _mm_loadu_si128((const __m128i *) (raw+k));
+      __m128i p = _mm_loadu_si128((const __m128i *) (prior+k));
+      _mm_storeu_si128((__m128i *) (cur+k), _mm_add_epi8(r, p));
+   }
+   for (; k < n; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+
+stbi_inline static void stbi__png_unfilter_sub_sse2(stbi_uc *cur, const stbi_uc *raw, int n, int bpp)
+{
+   __m128i a = stbi__png_load_pixel(cur-bpp, bpp);
+   int k;
+   for (k=0; k < n; k += bpp) {
+      a = _mm_add_epi8(a, stbi__png_load_pixel(raw+k, bpp));
+      stbi__png_store_pixel(cur+k, a, bpp);
+   }
+}
+
+stbi_inline static void stbi__png_unfilter_avg_sse2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n, int bpp)
+{
+   const __m128i one = _mm_set1_epi8(1);
+   __m128i a = stbi__png_load_pixel(cur-bpp, bpp);
+   int k;
+   for (k=0; k < n; k += bpp) {
+      __m128i b = stbi__png_load_pixel(prior+k, bpp);
+      // _mm_avg_epu8 rounds up, png wants (a+b)>>1; the two differ when a+b is odd
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(stbi__png_load_pixel(raw+k, bpp), avg);
+      stbi__png_store_pixel(cur+k, a, bpp);
+   }
+}
+
+stbi_inline static void stbi__png_unfilter_paeth_sse2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n, int bpp)
+{
+   const __m128i zero = _mm_setzero_si128();
+   __m128i a = _mm_unpacklo_epi8(stbi__png_load_pixel(cur-bpp, bpp), zero);
+   __m128i c = _mm_unpacklo_epi8(stbi__png_load_pixel(prior-bpp, bpp), zero);
+   int k;
+   for (k=0; k < n; k += bpp) {
+      __m128i b = _mm_unpacklo_epi8(stbi__png_load_pixel(prior+k, bpp), zero);
+      __m128i d = _mm_unpacklo_epi8(stbi__png_load_pixel(raw+k, bpp), zero);
+      // with p = a+b-c: |p-a| = |b-c|, |p-b| = |a-c|, |p-c| = |(b-c)+(a-c)|
+      __m128i pa = _mm_sub_epi16(b, c);
+      __m128i pb = _mm_sub_epi16(a, c);
+      __m128i pc = _mm_add_epi16(pa, pb);
+      __m128i smallest, use_a, use_b, nearest;
+      pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+      pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+      pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+      smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+      // ties go to a, then b, then c, same as stbi__paeth
+      use_a = _mm_cmpeq_epi16(smallest, pa);
+      use_b = _mm_andnot_si128(use_a, _mm_cmpeq_epi16(smallest, pb));
+      nearest = _mm_or_si128(_mm_and_si128(use_a, a), _mm_andnot_si128(use_a, _mm_or_si128(_mm_and_si128(use_b, b), _mm_andnot_si128(use_b, c))));
+      // add per byte so the sum wraps at 256; the high bytes stay zero
+      d = _mm_add_epi8(d, nearest);
+      stbi__png_store_pixel(cur+k, _mm_packus_epi16(d, d), bpp);
+      a = d;
+      c = b;
+   }
+}
+
+// returns 1 if the rest of the scanline was unfiltered here
+static int stbi__png_unfilter_sse2(int filter, stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n, int bpp, int depth)
+{
+   if (!stbi__sse2_available()) return 0;
+   if (filter == STBI__F_up) {
+      stbi__png_unfilter_up_sse2(cur, raw, prior, n);
+      return 1;
+   }
+   if (depth != 8 || (bpp != 3 && bpp != 4)) return 0;
+   // separate calls per bpp so each kernel is specialised for it
+   switch (filter) {
+      case STBI__F_sub:
+         if (bpp == 3) stbi__png_unfilter_sub_sse2(cur, raw, n, 3);
+         else          stbi__png_unfilter_sub_sse2(cur, raw, n, 4);
+         return 1;
+      case STBI__F_avg:
+         if (bpp == 3) stbi__png_unfilter_avg_sse2(cur, raw, prior, n, 3);
+         else          stbi__png_unfilter_avg_sse2(cur, raw, prior, n, 4);
+         return 1;
+      case STBI__F_paeth:
+         if (bpp == 3) stbi__png_unfilter_paeth_sse2(cur, raw, prior, n, 3);
+         else          stbi__png_unfilter_paeth_sse2(cur, raw, prior, n, 4);
+         return 1;
+   }
+   return 0;
+}
+#endif // STBI_SSE2
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4390,6 +5177,12 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       // this is a little gross, so that we don't switch per-pixel or per-component
       if (depth < 8 || img_n == out_n) {
          int nk = (width - 1)*filter_bytes;
+#ifdef STBI_SSE2
+         if (stbi__png_unfilter_sse2(filter, cur, raw, prior, nk, filter_bytes, depth)) {
+            raw += nk;
+            continue;
+         }
+#endif
          #define STBI__CASE(f) \
              case f:     \
                 for (k=0; k < nk; ++k)
@@ -76,6 +76,10 @@ int      stbi__dds_test_callbacks      (stbi_io_callbacks const *clbk, void *use
 }
 
 //	helper functions
+void stbi_decode_BC4_channel_block(
+			unsigned char uncompressed[16*4],
+			unsigned char compressed[8],
+			int channel );
 int stbi_convert_bit_range( int c, int from_bits, int to_bits )
 {
 	int b = (1 << (from_bits - 1)) + c * ((1 << to_bits) - 1);
@@ -160,6 +164,13 @@ void stbi_decode_DXT23_alpha_block(
 void stbi_decode_DXT45_alpha_block(
 			unsigned char uncompressed[16*4],
 			unsigned char compressed[8] )
+{
+	stbi_decode_BC4_channel_block( uncompressed, compressed, 3 );
+}
+void stbi_decode_BC4_channel_block(
+			unsigned char uncompressed[16*4],
+			unsigned char compressed[8],
+			int channel )
 {
 	int i, next_bit = 8*2;
 	unsigned char decode_alpha[8];
@@ -185,7 +196,7 @@ void stbi_decode_DXT45_alpha_block(
 		decode_alpha[6] = 0;
 		decode_alpha[7] = 255;
 	}
-	for( i = 3; i < 16*4; i += 4 )
+	for( i = channel; i < 16*4; i += 4 )
 	{
 		int idx = 0, bit;
 		bit = (compressed[next_bit>>3] >> (next_bit&7)) & 1;
@@ -342,7 +353,7 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 	stbi_uc *dds_data = NULL;
 	stbi_uc block[16*4];
 	stbi_uc compressed[8];
-	int flags, DXT_family;
+	int flags, DXT_family, RGTC_channels = 0;
 	int has_alpha, has_mipmap;
 	int is_compressed, cubemap_faces;
 	int block_pitch, num_blocks;
@@ -391,13 +402,27 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 		/*	compressed	*/
 		//	note: header.sPixelFormat.dwFourCC is something like (('D'<<0)|('X'<<8)|('T'<<16)|('1'<<24))
 		DXT_family = 1 + (header.sPixelFormat.dwFourCC >> 24) - '1';
-		if( (DXT_family < 1) || (DXT_family > 5) ) return NULL;
+		if( (header.sPixelFormat.dwFourCC == (('A'<<0)|('T'<<8)|('I'<<16)|('1'<<24))) ||
+			(header.sPixelFormat.dwFourCC == (('B'<<0)|('C'<<8)|('4'<<16)|('U'<<24))) )
+		{
+			//	BC4, a single channel
+			RGTC_channels = 1;
+		} else if( (header.sPixelFormat.dwFourCC == (('A'<<0)|('T'<<8)|('I'<<16)|('2'<<24))) ||
+			(header.sPixelFormat.dwFourCC == (('B'<<0)|('C'<<8)|('5'<<16)|('U'<<24))) )
+		{
+			//	BC5, red and green
+			RGTC_channels = 2;
+		} else if( (header.sPixelFormat.dwFourCC & 0x00FFFFFF) != (('D'<<0)|('X'<<8)|('T'<<16)) )
+		{
+			return NULL;
+		}
+		if( (RGTC_channels == 0) && ((DXT_family < 1) || (DXT_family > 5)) ) return NULL;
 		/*	check the expected size...oops, nevermind...
 			those non-compliant writers leave
 			dwPitchOrLinearSize == 0	*/
 		//	passed all the tests, get the RAM for decoding
 		sz = (s->img_x)*(s->img_y)*4*cubemap_faces;
-		dds_data = (unsigned char*)malloc( sz );
+		dds_data = (unsigned char*)STBI_MALLOC( sz );
 		/*	do this once for each face	*/
 		for( cf = 0; cf < cubemap_faces; ++ cf )
 		{
@@ -409,7 +434,29 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 				int ref_x = 4 * (i % block_pitch);
 				int ref_y = 4 * (i / block_pitch);
 				//	get the next block's worth of compressed data, and decompress it
-				if( DXT_family == 1 )
+				if( RGTC_channels == 1 )
+				{
+					//	BC4, shows up as grey
+					stbi__getn( s, compressed, 8 );
+					stbi_decode_BC4_channel_block( block, compressed, 0 );
+					for( bx = 0; bx < 16*4; bx += 4 )
+					{
+						block[bx+1] = block[bx+2] = block[bx];
+						block[bx+3] = 255;
+					}
+				} else if( RGTC_channels == 2 )
+				{
+					//	BC5, no blue
+					stbi__getn( s, compressed, 8 );
+					stbi_decode_BC4_channel_block( block, compressed, 0 );
+					stbi__getn( s, compressed, 8 );
+					stbi_decode_BC4_channel_block( block, compressed, 1 );
+					for( bx = 0; bx < 16*4; bx += 4 )
+					{
+						block[bx+2] = 0;
+						block[bx+3] = 255;
+					}
+				} else if( DXT_family == 1 )
 				{
 					//	DXT1
 					stbi__getn( s, compressed, 8 );
@@ -428,6 +475,26 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 					stbi_decode_DXT45_alpha_block ( block, compressed );
 					stbi__getn( s, compressed, 8 );
 					stbi_decode_DXT_color_block ( block, compressed );
+					if( header.sPixelFormat.dwRGBBitCount == DDS_SWIZZLE_YCOCG_SCALED )
+					{
+						//	scaled YCoCg (Co, Cg, scale, Y), back to opaque RGB
+						for( bx = 0; bx < 16*4; bx += 4 )
+						{
+							float scale = (float)((block[bx+2]*31 + 127) / 255 + 1);
+							float Co = (block[bx+0] - 255.0f*16/31) / scale;
+							float Cg = (block[bx+1] - 255.0f*32/63) / scale;
+							float Y = block[bx+3];
+							float rgb[3];
+							rgb[0] = Y + Co - Cg;
+							rgb[1] = Y + Cg;
+							rgb[2] = Y - Co - Cg;
+							for( by = 0; by < 3; ++by )
+							{
+								block[bx+by] = (stbi_uc)((rgb[by] < 0.0f) ? 0 : ((rgb[by] > 255.0f) ? 255 : (int)(rgb[by] + 0.5f)));
+							}
+							block[bx+3] = 255;
+						}
+					}
 				}
 				//	is this a partial block?
 				if( ref_x + 4 > (int)s->img_x )
@@ -454,7 +521,7 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 			if( has_mipmap )
 			{
 				int block_size = 16;
-				if( DXT_family == 1 )
+				if( (RGTC_channels == 1) || ((RGTC_channels == 0) && (DXT_family == 1)) )
 				{
 					block_size = 8;
 				}
@@ -485,7 +552,7 @@ static void * stbi__dds_load(stbi__context *s, int *x, int *y, int *comp, int re
 		}
 		*comp = s->img_n;
 		sz = s->img_x*s->img_y*s->img_n*cubemap_faces;
-		dds_data = (unsigned char*)malloc( sz );
+		dds_data = (unsigned char*)STBI_MALLOC( sz );
 		/*	do this once for each face	*/
 		for( cf = 0; cf < cubemap_faces; ++ cf )
 		{
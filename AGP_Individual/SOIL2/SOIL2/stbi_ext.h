@@ -25,4 +25,13 @@ extern int      stbi_test					(char const *filename);
 extern int      stbi_test_from_file        (FILE *f);
 #endif
 
+#ifndef STBI_NO_HDR
+// Radiance .hdr files as the raw RGBE bytes, 4 per pixel, value = RGB * 2^(E-136)
+extern stbi_uc *stbi_load_rgbe_from_memory (stbi_uc const *buffer, int len, int *x, int *y);
+
+#ifndef STBI_NO_STDIO
+extern stbi_uc *stbi_load_rgbe             (char const *filename, int *x, int *y);
+#endif
+#endif
+
 #endif /* HEADER_STB_IMAGE_EXT */
@@ -72,3 +72,119 @@ int stbi_test_from_callbacks(stbi_io_callbacks const *clbk, void *user)
    stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
    return stbi_test_main(&s);
 }
+
+#ifndef STBI_NO_HDR
+// same parsing as stbi__hdr_load, but keeps the RGBE bytes instead of
+// converting them to floats, a quarter of the memory and exact
+static stbi_uc *stbi__hdr_load_rgbe(stbi__context *s, int *x, int *y)
+{
+   char buffer[STBI__HDR_BUFLEN];
+   char *token;
+   int valid = 0;
+   int width, height;
+   stbi_uc *rgbe;
+   int i, j, k, z, c1, c2, len;
+   stbi_uc count, value;
+
+   token = stbi__hdr_gettoken(s,buffer);
+   if (strcmp(token, "#?RADIANCE") != 0 && strcmp(token, "#?RGBE") != 0)
+      return stbi__errpuc("not HDR", "Corrupt HDR image");
+
+   for(;;) {
+      token = stbi__hdr_gettoken(s,buffer);
+      if (token[0] == 0) break;
+      if (strcmp(token, "FORMAT=32-bit_rle_rgbe") == 0) valid = 1;
+   }
+   if (!valid) return stbi__errpuc("unsupported format", "Unsupported HDR format");
+
+   token = stbi__hdr_gettoken(s,buffer);
+   if (strncmp(token, "-Y ", 3)) return stbi__errpuc("unsupported data layout", "Unsupported HDR format");
+   token += 3;
+   height = (int) strtol(token, &token, 10);
+   while (*token == ' ') ++token;
+   if (strncmp(token, "+X ", 3)) return stbi__errpuc("unsupported data layout", "Unsupported HDR format");
+   token += 3;
+   width = (int) strtol(token, NULL, 10);
+
+   if (width <= 0 || height <= 0 || !stbi__mad3sizes_valid(width, height, 4, 0))
+      return stbi__errpuc("too large", "HDR image is too large");
+   rgbe = (stbi_uc *) stbi__malloc_mad3(width, height, 4, 0);
+   if (!rgbe) return stbi__errpuc("outofmem", "Out of memory");
+
+   if (width < 8 || width >= 32768) {
+      // flat data
+      if (!stbi__getn(s, rgbe, width * height * 4)) {
+         STBI_FREE(rgbe);
+         return stbi__errpuc("truncated", "HDR file too short");
+      }
+   } else {
+      for (j = 0; j < height; ++j) {
+         stbi_uc *row = rgbe + j * width * 4;
+         c1 = stbi__get8(s);
+         c2 = stbi__get8(s);
+         len = stbi__get8(s);
+         if (c1 != 2 || c2 != 2 || (len & 0x80)) {
+            // not run-length encoded, the rest of the file is flat pixels
+            row[0] = (stbi_uc) c1;
+            row[1] = (stbi_uc) c2;
+            row[2] = (stbi_uc) len;
+            row[3] = stbi__get8(s);
+            if (!stbi__getn(s, row + 4, (height - j) * width * 4 - 4)) {
+               STBI_FREE(rgbe);
+               return stbi__errpuc("truncated", "HDR file too short");
+            }
+            break;
+         }
+         len <<= 8;
+         len |= stbi__get8(s);
+         if (len != width) { STBI_FREE(rgbe); return stbi__errpuc("invalid decoded scanline length", "corrupt HDR"); }
+         // each row is the 4 channels one after the other
+         for (k = 0; k < 4; ++k) {
+            i = 0;
+            while (i < width) {
+               count = stbi__get8(s);
+               if (count > 128) {
+                  value = stbi__get8(s);
+                  count -= 128;
+                  if (count > width - i) { STBI_FREE(rgbe); return stbi__errpuc("corrupt", "bad RLE data in HDR"); }
+                  for (z = 0; z < count; ++z)
+                     row[i++ * 4 + k] = value;
+               } else {
+                  if (count == 0 || count > width - i) { STBI_FREE(rgbe); return stbi__errpuc("corrupt", "bad RLE data in HDR"); }
+                  for (z = 0; z < count; ++z)
+                     row[i++ * 4 + k] = stbi__get8(s);
+               }
+            }
+         }
+      }
+   }
+   *x = width;
+   *y = height;
+   return rgbe;
+}
+
+stbi_uc *stbi_load_rgbe_from_memory(stbi_uc const *buffer, int len, int *x, int *y)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   if (!stbi__hdr_test(&s)) return stbi__errpuc("not HDR", "Image not of any known type, or corrupt");
+   return stbi__hdr_load_rgbe(&s,x,y);
+}
+
+#ifndef STBI_NO_STDIO
+stbi_uc *stbi_load_rgbe(char const *filename, int *x, int *y)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   stbi_uc *result;
+   stbi__context s;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   if (!stbi__hdr_test(&s))
+      result = stbi__errpuc("not HDR", "Image not of any known type, or corrupt");
+   else
+      result = stbi__hdr_load_rgbe(&s,x,y);
+   fclose(f);
+   return result;
+}
+#endif //!STBI_NO_STDIO
+#endif //!STBI_NO_HDR
@@ -0,0 +1,399 @@
+#pragma once
+#include <atomic>
+#include <new>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <dbghelp.h>
+#pragma comment(lib, "dbghelp.lib")
+#define ALLOCATION_TRACKER_NOINLINE __declspec(noinline)
+#else
+#include <execinfo.h>
+#define ALLOCATION_TRACKER_NOINLINE __attribute__((noinline))
+#endif
+
+using std::cout;
+using std::endl;
+
+// Counts the heap allocations made while a frame is drawn, from BeginFrame to the
+// EndFrame after the swap, and where they were made. A steady frame shouldn't
+// allocate at all: ALLOCATION_CHECK=report prints every frame that does, with the
+// call stacks that allocated, and ALLOCATION_CHECK=strict aborts on the first, so a
+// benchmark fails the moment something starts allocating again. The first frames
+// are left out, as they still grow the frame arena and the driver's own buffers.
+//
+// Everything reaching operator new is counted once main.cpp defines
+// ALLOCATION_TRACKER_IMPLEMENTATION, and so is malloc where we call it ourselves
+// (SOIL falling back to the heap, arenas taking chunks), through Record.
+class AllocationTracker
+{
+public:
+	enum Mode
+	{
+		ALLOCATIONS_OFF,
+		ALLOCATIONS_REPORT,
+		ALLOCATIONS_STRICT
+	};
+
+	static Mode ParseMode(const char *mode)
+	{
+		if (!mode || !strcmp(mode, "off"))
+		{
+			return ALLOCATIONS_OFF;
+		}
+
+		if (!strcmp(mode, "report"))
+		{
+			return ALLOCATIONS_REPORT;
+		}
+
+		if (!strcmp(mode, "strict"))
+		{
+			return ALLOCATIONS_STRICT;
+		}
+
+		cout << "ERROR::ALLOCATIONS::UNKNOWN_MODE " << mode << ", expected off, report or strict" << endl;
+		return ALLOCATIONS_OFF;
+	}
+
+	static void Start(Mode mode)
+	{
+		State &state = Get();
+		state.mode = mode;
+
+		if (mode != ALLOCATIONS_OFF)
+		{
+			// The first backtrace loads the unwinder, which allocates
+			void *frames[StackDepth];
+			captureStack(frames);
+		}
+	}
+
+	static void BeginFrame()
+	{
+		State &state = Get();
+
+		if (state.mode != ALLOCATIONS_OFF && state.frames >= WarmupFrames)
+		{
+			state.frameAllocations = 0;
+			state.armed = true;
+		}
+	}
+
+	static void EndFrame()
+	{
+		State &state = Get();
+		state.armed = false;
+
+		if (state.mode == ALLOCATIONS_OFF || state.frames++ < WarmupFrames)
+		{
+			return;
+		}
+
+		state.checkedFrames++;
+		unsigned allocations = state.frameAllocations;
+
+		if (!allocations)
+		{
+			return;
+		}
+
+		state.allocatingFrames++;
+		state.totalAllocations += allocations;
+		bool strict = state.mode == ALLOCATIONS_STRICT;
+
+		cout << (strict ? "ERROR::ALLOCATIONS::FRAME " : "ALLOCATIONS::FRAME ") << state.frames << ":: " << allocations << " heap allocations" << endl;
+		printSites();
+
+		if (strict)
+		{
+			cout << "ERROR::ALLOCATIONS:: a steady frame must not allocate, aborting" << endl;
+			std::abort();
+		}
+	}
+
+	// Counts an allocation if a frame is being checked. Called by operator new, and
+	// by anything else that goes to the heap.
+	static ALLOCATION_TRACKER_NOINLINE void Record()
+	{
+		State &state = Get();
+
+		if (!state.armed || Recording())
+		{
+			return;
+		}
+
+		Recording() = true;
+		state.frameAllocations++;
+
+		void *frames[StackDepth];
+		memset(frames, 0, sizeof(frames));
+		captureStack(frames);
+
+		// Each distinct stack gets a slot, found by its hash; slots are claimed with a
+		// compare and swap so the tracker never allocates itself
+		uint64_t hash = 14695981039346656037ull;
+
+		for (int i = 0; i < StackDepth; i++)
+		{
+			hash = (hash ^ (uint64_t)(uintptr_t)frames[i]) * 1099511628211ull;
+		}
+
+		hash = hash ? hash : 1;
+
+		for (unsigned probe = 0; probe < SiteCount; probe++)
+		{
+			Site &site = state.sites[(hash + probe) % SiteCount];
+			uint64_t expected = 0;
+
+			if (site.hash.load() == hash || site.hash.compare_exchange_strong(expected, hash) || expected == hash)
+			{
+				if (site.count++ == 0)
+				{
+					memcpy(site.frames, frames, sizeof(frames));
+				}
+
+				break;
+			}
+		}
+
+		Recording() = false;
+	}
+
+	// A summary of every frame checked, for the end of a run
+	static void Report()
+	{
+		State &state = Get();
+
+		if (state.mode == ALLOCATIONS_OFF)
+		{
+			return;
+		}
+
+		cout << "ALLOCATIONS:: " << state.checkedFrames << " frames checked, " << state.allocatingFrames << " allocated, "
+			<< state.totalAllocations << " heap allocations in all" << endl;
+	}
+
+private:
+	static const int StackDepth = 6;
+	static const unsigned SiteCount = 256;
+	static const unsigned WarmupFrames = 3;
+
+	struct Site
+	{
+		std::atomic<uint64_t> hash;
+		std::atomic<unsigned> count;
+		void *frames[StackDepth];
+	};
+
+	// Plain zero initialised data, ready before the first operator new of any constructor
+	struct State
+	{
+		std::atomic<bool> armed;
+		std::atomic<unsigned> frameAllocations;
+		Mode mode;
+		unsigned frames;
+		unsigned checkedFrames;
+		unsigned allocatingFrames;
+		size_t totalAllocations;
+		Site sites[SiteCount];
+	};
+
+	static State &Get()
+	{
+		static State state;
+		return state;
+	}
+
+	// Set while a thread is inside Record, so nothing it calls is counted again
+	static bool &Recording()
+	{
+		static thread_local bool recording = false;
+		return recording;
+	}
+
+	static ALLOCATION_TRACKER_NOINLINE void captureStack(void **frames)
+	{
+#if defined(_WIN32)
+		// Skip this function and Record, leaving operator new and whatever called it
+		CaptureStackBackTrace(2, StackDepth, frames, NULL);
+#else
+		void *stack[StackDepth + 2];
+		int depth = backtrace(stack, StackDepth + 2);
+
+		for (int i = 2; i < depth; i++)
+		{
+			frames[i - 2] = stack[i];
+		}
+#endif
+	}
+
+	// Prints the stacks that allocated this frame, most often first, and clears them
+	static void printSites()
+	{
+		State &state = Get();
+
+		for (;;)
+		{
+			Site *most = NULL;
+
+			for (unsigned i = 0; i < SiteCount; i++)
+			{
+				if (state.sites[i].count && (!most || state.sites[i].count > most->count))
+				{
+					most = &state.sites[i];
+				}
+			}
+
+			if (!most)
+			{
+				break;
+			}
+
+			cout << "  " << most->count << "x from" << endl;
+			printStack(most->frames);
+			most->count = 0;
+			most->hash = 0;
+		}
+	}
+
+	static void printStack(void *const *frames)
+	{
+#if defined(_WIN32)
+		static bool symbols = SymInitialize(GetCurrentProcess(), NULL, TRUE) != FALSE;
+		char buffer[sizeof(SYMBOL_INFO) + 256];
+
+		for (int i = 0; i < StackDepth && frames[i]; i++)
+		{
+			SYMBOL_INFO *symbol = (SYMBOL_INFO *)buffer;
+			memset(buffer, 0, sizeof(buffer));
+			symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+			symbol->MaxNameLen = 255;
+
+			IMAGEHLP_LINE64 line;
+			memset(&line, 0, sizeof(line));
+			line.SizeOfStruct = sizeof(line);
+			DWORD lineOffset = 0;
+			DWORD64 address = (DWORD64)(uintptr_t)frames[i];
+
+			cout << "    ";
+
+			if (symbols && SymFromAddr(GetCurrentProcess(), address, NULL, symbol))
+			{
+				cout << symbol->Name;
+			}
+			else
+			{
+				cout << frames[i];
+			}
+
+			if (symbols && SymGetLineFromAddr64(GetCurrentProcess(), address, &lineOffset, &line))
+			{
+				cout << " (" << line.FileName << ":" << line.LineNumber << ")";
+			}
+
+			cout << endl;
+		}
+#else
+		int depth = 0;
+
+		while (depth < StackDepth && frames[depth])
+		{
+			depth++;
+		}
+
+		char **names = backtrace_symbols((void *const *)frames, depth);
+
+		for (int i = 0; i < depth; i++)
+		{
+			cout << "    " << (names ? names[i] : "?") << endl;
+		}
+
+		free(names);
+#endif
+	}
+};
+
+// The replaceable global allocation functions, defined in the one file that sets
+// ALLOCATION_TRACKER_IMPLEMENTATION before including this
+#if defined(ALLOCATION_TRACKER_IMPLEMENTATION)
+
+void *operator new(size_t size)
+{
+	AllocationTracker::Record();
+	void *memory = malloc(size ? size : 1);
+
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+
+	return memory;
+}
+
+void *operator new[](size_t size)
+{
+	AllocationTracker::Record();
+	void *memory = malloc(size ? size : 1);
+
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+
+	return memory;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	AllocationTracker::Record();
+	return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	AllocationTracker::Record();
+	return malloc(size ? size : 1);
+}
+
+void operator delete(void *memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept
+{
+	free(memory);
+}
+
+#endif
@@ -0,0 +1,985 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include <GL/glew.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/DefaultIOSystem.h>
+#include "SOIL2\SOIL2\SOIL2.h"
+#include "model.h"
+#include "objLoader.h"
+#include "scratchArena.h"
+
+// Opens files like assimp normally does, keeping a list of them so the cooker knows
+// what a model depends on (its .mtl files and so on)
+class RecordingIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+	std::vector<std::string> opened;
+
+	Assimp::IOStream *Open(const char *file, const char *mode = "rb")
+	{
+		Assimp::IOStream *stream = Assimp::DefaultIOSystem::Open(file, mode);
+
+		if (stream)
+		{
+			this->opened.push_back(file);
+		}
+
+		return stream;
+	}
+};
+
+// Turns the source assets under a set of directories into what the loaders can use as
+// they are, and writes the manifest they find them through:
+//	models		the meshes' vertices, indices and BVHs, see Model::CookedMagic
+//	textures	DDS with a full mip chain, YCoCg DXT5 (opaque diffuse), DXT5 (diffuse with
+//				alpha), BC4 (specular) or BC5 (normal maps), the role coming from the materials
+//	.hdr		an RGB9_E5 cubemap DDS
+//	cubemaps	the 6 faces in one RGBA8 cubemap DDS
+//	shaders		copies that compiled and linked on this machine's driver
+// Each asset is skipped while the hash of its settings, its source and everything the
+// source pulled in still matches the manifest's. Everything but the shaders is cooked
+// in parallel.
+class AssetCooker
+{
+public:
+	AssetCooker(const std::string &cacheDirectory = "cooked") : cacheDirectory(cacheDirectory),
+		cookedCount(0), skippedCount(0), failedCount(0)
+	{
+	}
+
+	void AddRoot(const std::string &directory)
+	{
+		this->roots.push_back(directory);
+	}
+
+	// Faces in +X, -X, +Y, -Y, +Z, -Z order, they aren't cooked on their own
+	void AddCubemap(const std::vector<std::string> &faces)
+	{
+		if (faces.size() == 6)
+		{
+			this->cubemaps.push_back(faces);
+		}
+	}
+
+	std::string ManifestPath() const
+	{
+		return this->cacheDirectory + "/manifest.txt";
+	}
+
+	const AssetManifest &Manifest() const
+	{
+		return this->manifest;
+	}
+
+	// Cooks whatever changed since the last run, or everything when force is set, on
+	// threadCount threads (0 for one a core). The shaders are compiled on the calling
+	// thread, which needs a current GL context. False if anything failed to cook.
+	bool Run(bool force = false, unsigned threadCount = 0)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		this->previous = AssetManifest();
+		this->previous.Load(this->ManifestPath());
+		this->manifest = AssetManifest();
+		this->cookedCount = this->skippedCount = this->failedCount = 0;
+
+		// Sort the sources into jobs
+		std::vector<std::string> files;
+		std::set<std::string> faces;
+		std::map<std::string, std::vector<std::string> > shaderGroups;
+		std::vector<std::string> images;
+		std::vector<Job> modelJobs, imageJobs, shaderJobs;
+		Assimp::Importer importer;
+
+		for (size_t i = 0; i < this->roots.size(); i++)
+		{
+			ListFiles(this->roots[i], files);
+		}
+
+		for (size_t i = 0; i < this->cubemaps.size(); i++)
+		{
+			Job job(JOB_CUBEMAP, "cubemap rgba8 v1", this->cubemaps[i]);
+			imageJobs.push_back(job);
+
+			for (size_t f = 0; f < this->cubemaps[i].size(); f++)
+			{
+				faces.insert(AssetPack::NormalisePath(this->cubemaps[i][f]));
+			}
+		}
+
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			std::string extension = Extension(files[i]);
+
+			if (faces.count(AssetPack::NormalisePath(files[i])))
+			{
+				continue;
+			}
+
+			if (extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" ||
+				extension == "bmp" || extension == "psd" || extension == "gif")
+			{
+				images.push_back(files[i]);
+			}
+			else if (extension == "hdr")
+			{
+				imageJobs.push_back(Job(JOB_HDR, "hdr rgb9e5 v1", std::vector<std::string>(1, files[i])));
+			}
+			else if (extension == "vs" || extension == "vert" || extension == "fs" || extension == "frag" ||
+				extension == "gs" || extension == "geom" || extension == "comp")
+			{
+				shaderGroups[files[i].substr(0, files[i].size() - extension.size() - 1)].push_back(files[i]);
+			}
+			else if (extension == "gltf" || extension == "glb" || extension == "bin")
+			{
+				// Already laid out for the GPU, GltfModel loads them as they are
+			}
+			else if (extension != "mtl" && importer.IsExtensionSupported("." + extension))
+			{
+				modelJobs.push_back(Job(JOB_MODEL, "model triangulate flipuvs v4", std::vector<std::string>(1, files[i])));
+			}
+		}
+
+		for (std::map<std::string, std::vector<std::string> >::iterator i = shaderGroups.begin(); i != shaderGroups.end(); ++i)
+		{
+			shaderJobs.push_back(Job(JOB_SHADER, "shader glsl v1", i->second));
+		}
+
+		if (threadCount == 0)
+		{
+			threadCount = std::thread::hardware_concurrency();
+			threadCount = threadCount ? threadCount : 1;
+		}
+
+		// Models first, their materials say what each texture is for
+		this->RunJobs(modelJobs, force, threadCount);
+
+		std::map<std::string, TextureRole> roles;
+
+		for (size_t i = 0; i < modelJobs.size(); i++)
+		{
+			for (size_t t = 0; t < modelJobs[i].textures.size(); t++)
+			{
+				roles.insert(std::make_pair(AssetPack::NormalisePath(modelJobs[i].textures[t].first), modelJobs[i].textures[t].second));
+			}
+		}
+
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			// A model that was up to date hasn't said, its textures kept their last role
+			std::map<std::string, TextureRole>::const_iterator role = roles.find(AssetPack::NormalisePath(images[i]));
+			const AssetManifest::Entry *entry = this->previous.Find(images[i]);
+			TextureRole textureRole = (role != roles.end()) ? role->second : entry ? RoleFromSettings(entry->settings) : TEXTURE_ROLE_DIFFUSE;
+
+			Job job(JOB_TEXTURE, TextureSettings(textureRole), std::vector<std::string>(1, images[i]));
+			job.role = textureRole;
+			imageJobs.push_back(job);
+		}
+
+		this->RunJobs(imageJobs, force, threadCount);
+
+		// GL calls all have to come from this thread
+		for (size_t i = 0; i < shaderJobs.size(); i++)
+		{
+			this->RunJob(shaderJobs[i], force);
+		}
+
+		this->Collect(modelJobs);
+		this->Collect(imageJobs);
+		this->Collect(shaderJobs);
+
+		MakeDirectories(this->ManifestPath());
+		bool saved = this->manifest.Save(this->ManifestPath());
+
+		double milliseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+		cout << "COOKER:: " << this->cookedCount << " cooked, " << this->skippedCount << " up to date, " << this->failedCount
+			<< " failed in " << milliseconds << " ms on " << threadCount << " threads" << endl;
+
+		return saved && this->failedCount == 0;
+	}
+
+	// Packs the manifest and every cooked file, so a build ships one file of runtime formats
+	bool BuildPack(const std::string &packPath) const
+	{
+		std::vector<std::string> files(1, this->ManifestPath());
+		std::set<std::string> added;
+
+		for (std::map<std::string, AssetManifest::Entry>::const_iterator i = this->manifest.Entries().begin(); i != this->manifest.Entries().end(); ++i)
+		{
+			if (added.insert(i->second.cooked).second)
+			{
+				files.push_back(i->second.cooked);
+			}
+		}
+
+		return AssetPack::Build(packPath, files);
+	}
+
+private:
+	enum JobKind
+	{
+		JOB_MODEL,
+		JOB_TEXTURE,
+		JOB_HDR,
+		JOB_CUBEMAP,
+		JOB_SHADER
+	};
+
+	enum JobResult
+	{
+		JOB_FAILED,
+		JOB_COOKED,
+		JOB_UP_TO_DATE
+	};
+
+	struct Job
+	{
+		Job(JobKind kind, const std::string &settings, const std::vector<std::string> &sources) :
+			kind(kind), settings(settings), sources(sources), role(TEXTURE_ROLE_DIFFUSE), result(JOB_FAILED)
+		{
+		}
+
+		JobKind kind;
+		std::string settings;
+		std::vector<std::string> sources;		// the faces of a cubemap, the stages of a shader
+		TextureRole role;
+		std::string cooked;
+		std::vector<std::string> dependencies;	// read by the sources, like a model's .mtl
+		std::vector<std::pair<std::string, TextureRole> > textures;	// used by a model's materials
+		std::vector<AssetManifest::Entry> entries;
+		JobResult result;
+	};
+
+	std::string cacheDirectory;
+	std::vector<std::string> roots;
+	std::vector<std::vector<std::string> > cubemaps;
+	AssetManifest previous;
+	AssetManifest manifest;
+	std::mutex logLock;
+	size_t cookedCount;
+	size_t skippedCount;
+	size_t failedCount;
+
+	void RunJobs(std::vector<Job> &jobs, bool force, unsigned threadCount)
+	{
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> workers;
+		threadCount = (threadCount < jobs.size()) ? threadCount : (unsigned)jobs.size();
+
+		for (unsigned t = 0; t < threadCount; t++)
+		{
+			workers.push_back(std::thread(&AssetCooker::Work, this, &jobs, &next, force));
+		}
+
+		for (size_t t = 0; t < workers.size(); t++)
+		{
+			workers[t].join();
+		}
+	}
+
+	// Worker thread, takes jobs off the list until there are none left
+	void Work(std::vector<Job> *jobs, std::atomic<size_t> *next, bool force)
+	{
+		size_t i;
+
+		while ((i = (*next)++) < jobs->size())
+		{
+			this->RunJob((*jobs)[i], force);
+		}
+	}
+
+	void RunJob(Job &job, bool force)
+	{
+		if (!force && this->UpToDate(job))
+		{
+			job.result = JOB_UP_TO_DATE;
+			return;
+		}
+
+		job.cooked = this->CookedPath(job);
+		MakeDirectories(job.cooked);
+
+		bool cooked = false;
+
+		// The job's image decoding and compression come from its own arena, so the
+		// workers don't contend for the heap
+		ScratchArena arena;
+		ArenaScope scope(arena);
+
+		switch (job.kind)
+		{
+		case JOB_MODEL:
+			cooked = this->CookModel(job);
+			break;
+		case JOB_TEXTURE:
+			cooked = this->CookTexture(job);
+			break;
+		case JOB_HDR:
+			cooked = SOIL_save_HDR_cubemap(job.cooked.c_str(), job.sources[0].c_str(), SOIL_HDR_RGB9_E5, 0) != 0;
+			break;
+		case JOB_CUBEMAP:
+			cooked = SOIL_save_cubemap(job.cooked.c_str(), job.sources[0].c_str(), job.sources[1].c_str(), job.sources[2].c_str(),
+				job.sources[3].c_str(), job.sources[4].c_str(), job.sources[5].c_str()) != 0;
+			break;
+		case JOB_SHADER:
+			cooked = this->CookShaders(job);
+			break;
+		}
+
+		if (!cooked)
+		{
+			// SOIL's last result is the worker thread's own, so it's this job's
+			bool soil = job.kind == JOB_TEXTURE || job.kind == JOB_HDR || job.kind == JOB_CUBEMAP;
+			this->Log("ERROR::COOKER::COOK_FAILED " + job.sources[0] + (soil ? std::string(" ") + SOIL_last_result() : std::string()));
+			job.result = JOB_FAILED;
+			return;
+		}
+
+		// Every source of the job shares its hash, each lists the others as dependencies
+		std::vector<std::string> hashed(job.sources);
+		hashed.insert(hashed.end(), job.dependencies.begin(), job.dependencies.end());
+		uint64_t hash = HashFiles(job.settings, hashed);
+
+		for (size_t i = 0; i < job.sources.size(); i++)
+		{
+			AssetManifest::Entry entry;
+			entry.source = job.sources[i];
+			entry.cooked = (job.kind == JOB_SHADER) ? this->cacheDirectory + "/" + job.sources[i] : job.cooked;
+			entry.settings = job.settings;
+			entry.hash = hash;
+
+			for (size_t d = 0; d < hashed.size(); d++)
+			{
+				if (d != i)
+				{
+					entry.dependencies.push_back(hashed[d]);
+				}
+			}
+
+			job.entries.push_back(entry);
+		}
+
+		job.result = JOB_COOKED;
+		this->Log("COOKER::COOKED " + job.sources[0] + " -> " + job.cooked + " (" + std::to_string(arena.Allocations()) + " scratch allocations)");
+	}
+
+	// Up to date when the manifest has it with the same settings, the cooked file is still
+	// there and the source and its dependencies hash the same as when it was cooked
+	bool UpToDate(Job &job)
+	{
+		const AssetManifest::Entry *entry = this->previous.Find(job.sources[0]);
+
+		if (!entry || entry->settings != job.settings || !FileExists(entry->cooked))
+		{
+			return false;
+		}
+
+		std::vector<std::string> hashed(1, entry->source);
+		hashed.insert(hashed.end(), entry->dependencies.begin(), entry->dependencies.end());
+
+		if (HashFiles(entry->settings, hashed) != entry->hash)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < job.sources.size(); i++)
+		{
+			const AssetManifest::Entry *sourceEntry = this->previous.Find(job.sources[i]);
+
+			if (!sourceEntry || sourceEntry->hash != entry->hash)
+			{
+				return false;
+			}
+
+			job.entries.push_back(*sourceEntry);
+		}
+
+		return true;
+	}
+
+	std::string CookedPath(const Job &job) const
+	{
+		switch (job.kind)
+		{
+		case JOB_MODEL:
+			return this->cacheDirectory + "/" + job.sources[0] + ".mesh";
+		case JOB_CUBEMAP:
+			return this->cacheDirectory + "/" + job.sources[0] + ".cube.dds";
+		case JOB_SHADER:
+			return this->cacheDirectory + "/" + job.sources[0];
+		default:
+			return this->cacheDirectory + "/" + job.sources[0] + ".dds";
+		}
+	}
+
+	// A model's mesh as the cooked file stores it
+	struct CookedMesh
+	{
+		vector<Vertex> vertices;
+		vector<GLuint> indices;
+		std::vector<std::pair<aiTextureType, std::string> > textures;
+	};
+
+	// Writes the meshes in the order Model loads them: ObjLoader's for OBJ files, the
+	// node walk's for everything assimp imports, each once however many nodes use it,
+	// and then where the nodes place them
+	bool CookModel(Job &job)
+	{
+		std::vector<CookedMesh> meshes;
+		std::vector<MeshInstance> instances;
+		bool read = ObjLoader::IsObj(job.sources[0]) ? this->ReadObjModel(job, meshes, instances) : this->ReadAssimpModel(job, meshes, instances);
+
+		if (!read)
+		{
+			return false;
+		}
+
+		std::vector<unsigned char> bytes;
+		std::string directory = job.sources[0].substr(0, job.sources[0].find_last_of('/'));
+		uint32_t header[4] = { Model::CookedMagic, Model::CookedVersion, (uint32_t)sizeof(Vertex), (uint32_t)meshes.size() };
+		Append(bytes, header, sizeof(header));
+
+		for (size_t m = 0; m < meshes.size(); m++)
+		{
+			const CookedMesh &mesh = meshes[m];
+
+			// Model only draws the diffuse and specular maps, the rest are there so they
+			// get cooked in the format their role wants
+			uint32_t drawn = 0;
+
+			for (size_t t = 0; t < mesh.textures.size(); t++)
+			{
+				drawn += IsDrawnTexture(mesh.textures[t].first) ? 1 : 0;
+			}
+
+			uint32_t counts[3] = { (uint32_t)mesh.vertices.size(), (uint32_t)mesh.indices.size(), drawn };
+			Append(bytes, counts, sizeof(counts));
+			Append(bytes, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+			Append(bytes, mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+
+			for (size_t t = 0; t < mesh.textures.size(); t++)
+			{
+				job.textures.push_back(std::make_pair(directory + "/" + mesh.textures[t].second, Model::textureRoleFor(mesh.textures[t].first)));
+
+				if (IsDrawnTexture(mesh.textures[t].first))
+				{
+					uint32_t texture[2] = { (uint32_t)mesh.textures[t].first, (uint32_t)mesh.textures[t].second.size() };
+					Append(bytes, texture, sizeof(texture));
+					Append(bytes, mesh.textures[t].second.data(), mesh.textures[t].second.size());
+				}
+			}
+
+			// Built here so loading a cooked model never has to
+			TriangleBvh bvh;
+
+			if (!mesh.vertices.empty())
+			{
+				bvh = TriangleBvh::Build(&mesh.vertices[0].Position, sizeof(Vertex), mesh.vertices.size(), mesh.indices);
+			}
+
+			bvh.Save(bytes);
+		}
+
+		uint32_t instanceCount = (uint32_t)instances.size();
+		Append(bytes, &instanceCount, sizeof(instanceCount));
+
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			uint32_t mesh = instances[i].mesh;
+			Append(bytes, &mesh, sizeof(mesh));
+			Append(bytes, glm::value_ptr(instances[i].transform), 16 * sizeof(float));
+		}
+
+		std::ofstream file(job.cooked.c_str(), std::ios::out | std::ios::binary);
+		file.write((const char *)bytes.data(), bytes.size());
+		return file.good();
+	}
+
+	// The texture types Model binds when it draws, as processMesh and loadObjModel load them
+	static bool IsDrawnTexture(aiTextureType type)
+	{
+		return type == aiTextureType_DIFFUSE || type == aiTextureType_SPECULAR;
+	}
+
+	bool ReadObjModel(Job &job, std::vector<CookedMesh> &meshes, std::vector<MeshInstance> &instances)
+	{
+		// One thread a model, the cooker already runs one a core. It's quiet, so what it
+		// has to say goes through Log with everything else the workers print.
+		ObjLoader loader(1, true);
+		bool loaded = loader.Load(job.sources[0]);
+
+		if (!loader.Messages().empty())
+		{
+			this->Log(loader.Messages());
+		}
+
+		if (!loaded)
+		{
+			this->Log("ERROR::OBJ:: " + loader.Error());
+			return false;
+		}
+
+		job.dependencies = loader.MaterialLibraries();
+
+		for (size_t m = 0; m < loader.Meshes().size(); m++)
+		{
+			ObjMesh &source = loader.Meshes()[m];
+			CookedMesh mesh;
+			mesh.vertices = std::move(source.vertices);
+			mesh.indices = std::move(source.indices);
+
+			if (source.material >= 0)
+			{
+				const ObjMaterial &material = loader.Materials()[source.material];
+
+				for (size_t t = 0; t < material.diffuseMaps.size(); t++)
+				{
+					mesh.textures.push_back(std::make_pair(aiTextureType_DIFFUSE, material.diffuseMaps[t]));
+				}
+
+				for (size_t t = 0; t < material.specularMaps.size(); t++)
+				{
+					mesh.textures.push_back(std::make_pair(aiTextureType_SPECULAR, material.specularMaps[t]));
+				}
+
+				// map_Bump and the like, as assimp reports them
+				for (size_t t = 0; t < material.normalMaps.size(); t++)
+				{
+					mesh.textures.push_back(std::make_pair(aiTextureType_HEIGHT, material.normalMaps[t]));
+				}
+			}
+
+			MeshInstance instance = { (GLuint)meshes.size(), glm::mat4(1.0f) };
+			instances.push_back(instance);
+			meshes.push_back(std::move(mesh));
+		}
+
+		return true;
+	}
+
+	bool ReadAssimpModel(Job &job, std::vector<CookedMesh> &meshes, std::vector<MeshInstance> &instances)
+	{
+		Assimp::Importer importer;
+		RecordingIOSystem *io = new RecordingIOSystem();
+		importer.SetIOHandler(io);
+
+		const aiScene *scene = importer.ReadFile(job.sources[0], aiProcess_Triangulate | aiProcess_FlipUVs);
+
+		if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		{
+			this->Log("ERROR::ASSIMP:: " + std::string(importer.GetErrorString()));
+			return false;
+		}
+
+		for (size_t i = 0; i < io->opened.size(); i++)
+		{
+			if (AssetPack::NormalisePath(io->opened[i]) != AssetPack::NormalisePath(job.sources[0]))
+			{
+				job.dependencies.push_back(io->opened[i]);
+			}
+		}
+
+		std::vector<int> slots(scene->mNumMeshes, -1);
+		std::vector<const aiMesh *> sources;
+		Model::processNode(scene->mRootNode, scene, glm::mat4(1.0f), slots, sources, instances);
+		aiTextureType types[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_NORMALS, aiTextureType_HEIGHT };
+
+		for (size_t m = 0; m < sources.size(); m++)
+		{
+			CookedMesh mesh;
+			Model::extractGeometry(sources[m], mesh.vertices, mesh.indices);
+
+			const aiMaterial *material = scene->mMaterials[sources[m]->mMaterialIndex];
+
+			for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++)
+			{
+				for (unsigned j = 0; j < material->GetTextureCount(types[t]); j++)
+				{
+					aiString str;
+					material->GetTexture(types[t], j, &str);
+					mesh.textures.push_back(std::make_pair(types[t], std::string(str.C_Str())));
+				}
+			}
+
+			meshes.push_back(std::move(mesh));
+		}
+
+		return true;
+	}
+
+	bool CookTexture(Job &job)
+	{
+		int width, height, channels;
+		int forceChannels = (job.role == TEXTURE_ROLE_SPECULAR) ? SOIL_LOAD_L : SOIL_LOAD_RGBA;
+		unsigned char *image = SOIL_load_image(job.sources[0].c_str(), &width, &height, &channels, forceChannels);
+
+		if (!image)
+		{
+			return false;
+		}
+
+		int saveType = SOIL_SAVE_TYPE_DDS_MIPMAPS;
+		int saveChannels = forceChannels;
+
+		if (job.role == TEXTURE_ROLE_SPECULAR)
+		{
+			saveType = SOIL_SAVE_TYPE_DDS_BC4_MIPMAPS;
+		}
+		else if (job.role == TEXTURE_ROLE_NORMAL)
+		{
+			saveType = SOIL_SAVE_TYPE_DDS_BC5_MIPMAPS;
+		}
+		else
+		{
+			// Opaque diffuse maps go to YCoCg, packed down to RGB in place
+			bool hasAlpha = false;
+			size_t texels = (size_t)width * height;
+
+			for (size_t i = 0; i < texels && !hasAlpha; i++)
+			{
+				hasAlpha = image[i * 4 + 3] != 255;
+			}
+
+			if (!hasAlpha)
+			{
+				for (size_t i = 0; i < texels; i++)
+				{
+					image[i * 3 + 0] = image[i * 4 + 0];
+					image[i * 3 + 1] = image[i * 4 + 1];
+					image[i * 3 + 2] = image[i * 4 + 2];
+				}
+
+				saveType = SOIL_SAVE_TYPE_DDS_YCOCG;
+				saveChannels = 3;
+			}
+		}
+
+		bool saved = SOIL_save_image(job.cooked.c_str(), saveType, width, height, saveChannels, image) != 0;
+		SOIL_free_image_data(image);
+		return saved;
+	}
+
+	// Compiles each stage and links the vertex and fragment stages of a group together,
+	// or a compute stage on its own. Compute shaders are copied as they are where the
+	// driver can't compile them; the game culls on the CPU there anyway.
+	bool CookShaders(Job &job)
+	{
+		std::vector<GLuint> shaders;
+		bool valid = true;
+
+		for (size_t i = 0; i < job.sources.size() && valid; i++)
+		{
+			std::string extension = Extension(job.sources[i]);
+			GLenum stage = (extension == "vs" || extension == "vert") ? GL_VERTEX_SHADER :
+				(extension == "gs" || extension == "geom") ? GL_GEOMETRY_SHADER :
+				(extension == "comp") ? GL_COMPUTE_SHADER : GL_FRAGMENT_SHADER;
+
+			std::vector<unsigned char> source;
+			valid = ReadFile(job.sources[i], source);
+
+			if (valid && stage == GL_COMPUTE_SHADER && !GLEW_VERSION_4_3)
+			{
+				continue;
+			}
+
+			if (valid)
+			{
+				const GLchar *code = (const GLchar *)source.data();
+				GLint length = (GLint)source.size();
+				GLint success;
+				GLchar infoLog[512];
+				GLuint shader = glCreateShader(stage);
+
+				glShaderSource(shader, 1, &code, &length);
+				glCompileShader(shader);
+				glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+
+				if (!success)
+				{
+					glGetShaderInfoLog(shader, 512, NULL, infoLog);
+					this->Log("ERROR::COOKER::SHADER_COMPILATION_FAILED " + job.sources[i] + "\n" + infoLog);
+					valid = false;
+				}
+
+				shaders.push_back(shader);
+			}
+		}
+
+		bool hasVertex = false, hasFragment = false, hasCompute = false;
+
+		for (size_t i = 0; i < shaders.size(); i++)
+		{
+			GLint type;
+			glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+			hasVertex = hasVertex || type == GL_VERTEX_SHADER;
+			hasFragment = hasFragment || type == GL_FRAGMENT_SHADER;
+			hasCompute = hasCompute || type == GL_COMPUTE_SHADER;
+		}
+
+		if (valid && ((hasVertex && hasFragment) || hasCompute))
+		{
+			GLint success;
+			GLchar infoLog[512];
+			GLProgram program = GLProgram::Generate();
+
+			for (size_t i = 0; i < shaders.size(); i++)
+			{
+				glAttachShader(program, shaders[i]);
+			}
+
+			glLinkProgram(program);
+			glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+			if (!success)
+			{
+				glGetProgramInfoLog(program, 512, NULL, infoLog);
+				this->Log("ERROR::COOKER::SHADER_LINKING_FAILED " + job.sources[0] + "\n" + infoLog);
+				valid = false;
+			}
+		}
+
+		for (size_t i = 0; i < shaders.size(); i++)
+		{
+			glDeleteShader(shaders[i]);
+		}
+
+		for (size_t i = 0; i < job.sources.size() && valid; i++)
+		{
+			std::vector<unsigned char> source;
+			std::string cooked = this->cacheDirectory + "/" + job.sources[i];
+			MakeDirectories(cooked);
+			ReadFile(job.sources[i], source);
+
+			std::ofstream file(cooked.c_str(), std::ios::out | std::ios::binary);
+			file.write((const char *)source.data(), source.size());
+			valid = file.good();
+		}
+
+		return valid;
+	}
+
+	// Adds the jobs' entries to the new manifest and counts how they went
+	void Collect(const std::vector<Job> &jobs)
+	{
+		for (size_t i = 0; i < jobs.size(); i++)
+		{
+			for (size_t e = 0; e < jobs[i].entries.size(); e++)
+			{
+				this->manifest.Set(jobs[i].entries[e]);
+			}
+
+			this->cookedCount += jobs[i].result == JOB_COOKED;
+			this->skippedCount += jobs[i].result == JOB_UP_TO_DATE;
+			this->failedCount += jobs[i].result == JOB_FAILED;
+		}
+	}
+
+	void Log(const std::string &message)
+	{
+		std::lock_guard<std::mutex> lock(this->logLock);
+		cout << message << endl;
+	}
+
+	static std::string TextureSettings(TextureRole role)
+	{
+		switch (role)
+		{
+		case TEXTURE_ROLE_SPECULAR:
+			return "texture specular bc4 v1";
+		case TEXTURE_ROLE_NORMAL:
+			return "texture normal bc5 v1";
+		default:
+			return "texture diffuse ycocg-dxt5 v1";
+		}
+	}
+
+	static TextureRole RoleFromSettings(const std::string &settings)
+	{
+		if (settings.compare(0, 17, "texture specular ") == 0)
+		{
+			return TEXTURE_ROLE_SPECULAR;
+		}
+
+		if (settings.compare(0, 15, "texture normal ") == 0)
+		{
+			return TEXTURE_ROLE_NORMAL;
+		}
+
+		return TEXTURE_ROLE_DIFFUSE;
+	}
+
+	// FNV-1a over the settings and each file's normalised path and contents
+	static uint64_t HashFiles(const std::string &settings, const std::vector<std::string> &files)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		hash = HashBytes(hash, (const unsigned char *)settings.data(), settings.size() + 1);
+
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			std::string name = AssetPack::NormalisePath(files[i]);
+			std::vector<unsigned char> contents;
+			uint64_t size = ReadFile(files[i], contents) ? contents.size() : ~0ULL;
+
+			hash = HashBytes(hash, (const unsigned char *)name.c_str(), name.size() + 1);
+			hash = HashBytes(hash, (const unsigned char *)&size, sizeof(size));
+			hash = HashBytes(hash, contents.data(), contents.size());
+		}
+
+		return hash;
+	}
+
+	static uint64_t HashBytes(uint64_t hash, const unsigned char *bytes, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ULL;
+		}
+
+		return hash;
+	}
+
+	static void Append(std::vector<unsigned char> &bytes, const void *data, size_t size)
+	{
+		bytes.insert(bytes.end(), (const unsigned char *)data, (const unsigned char *)data + size);
+	}
+
+	static bool ReadFile(const std::string &path, std::vector<unsigned char> &contents)
+	{
+		std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	static bool FileExists(const std::string &path)
+	{
+		return std::ifstream(path.c_str()).good();
+	}
+
+	static std::string Extension(const std::string &path)
+	{
+		size_t dot = path.find_last_of('.');
+		size_t slash = path.find_last_of('/');
+
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		{
+			return std::string();
+		}
+
+		std::string extension = path.substr(dot + 1);
+
+		for (size_t i = 0; i < extension.size(); i++)
+		{
+			extension[i] = (char)tolower(extension[i]);
+		}
+
+		return extension;
+	}
+
+	// Every file under a directory, as directory/sub/name
+	static void ListFiles(const std::string &directory, std::vector<std::string> &files)
+	{
+#if defined(_WIN32)
+		WIN32_FIND_DATAA found;
+		HANDLE search = FindFirstFileA((directory + "/*").c_str(), &found);
+
+		if (search == INVALID_HANDLE_VALUE)
+		{
+			return;
+		}
+
+		do
+		{
+			std::string name = found.cFileName;
+
+			if (name == "." || name == "..")
+			{
+				continue;
+			}
+
+			if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			{
+				ListFiles(directory + "/" + name, files);
+			}
+			else
+			{
+				files.push_back(directory + "/" + name);
+			}
+		} while (FindNextFileA(search, &found));
+
+		FindClose(search);
+#else
+		DIR *search = opendir(directory.c_str());
+		struct dirent *found;
+
+		if (!search)
+		{
+			return;
+		}
+
+		while ((found = readdir(search)) != NULL)
+		{
+			std::string name = found->d_name;
+			std::string path = directory + "/" + name;
+			struct stat info;
+
+			if (name == "." || name == ".." || stat(path.c_str(), &info) != 0)
+			{
+				continue;
+			}
+
+			if (S_ISDIR(info.st_mode))
+			{
+				ListFiles(path, files);
+			}
+			else
+			{
+				files.push_back(path);
+			}
+		}
+
+		closedir(search);
+#endif
+	}
+
+	// Creates the directories a file is going to be written in
+	static void MakeDirectories(const std::string &path)
+	{
+		for (size_t slash = path.find('/'); slash != std::string::npos; slash = path.find('/', slash + 1))
+		{
+#if defined(_WIN32)
+			_mkdir(path.substr(0, slash).c_str());
+#else
+			mkdir(path.substr(0, slash).c_str(), 0755);
+#endif
+		}
+	}
+};
@@ -0,0 +1,186 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include "asyncFileReader.h"
+
+using std::cout;
+using std::endl;
+
+// Maps each source asset to the runtime-ready file the cooker made from it. The loaders
+// resolve every path through the mounted manifest, so a cooked build never opens a
+// source format. Sources the manifest doesn't know are loaded as they are.
+// Saved as text, one asset a line: hash, settings, source, cooked file and the files
+// the source depends on, separated by tabs (dependencies by '|').
+class AssetManifest
+{
+public:
+	struct Entry
+	{
+		std::string source;
+		std::string cooked;
+		std::string settings;					// what it was cooked as, e.g. "texture specular bc4"
+		uint64_t hash = 0;						// of the settings, the source and its dependencies
+		std::vector<std::string> dependencies;	// other files the cooked file was made from
+	};
+
+	// Reads a manifest from the mounted pack or reader, or the disk
+	bool Load(const std::string &path)
+	{
+		std::string text;
+		AssetSlice slice;
+
+		if (AsyncFileReader::ReadAsset(path, slice))
+		{
+			text.assign((const char *)slice.data, slice.size);
+		}
+		else
+		{
+			std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+
+			if (!file)
+			{
+				return false;
+			}
+
+			std::stringstream stream;
+			stream << file.rdbuf();
+			text = stream.str();
+		}
+
+		std::istringstream lines(text);
+		std::string line;
+
+		if (!std::getline(lines, line) || line.compare(0, strlen(Magic), Magic) != 0)
+		{
+			cout << "ERROR::MANIFEST::NOT_A_MANIFEST " << path << endl;
+			return false;
+		}
+
+		this->entries.clear();
+
+		while (std::getline(lines, line))
+		{
+			if (!line.empty() && line[line.size() - 1] == '\r')
+			{
+				line.erase(line.size() - 1);
+			}
+
+			std::vector<std::string> fields = Split(line, '\t');
+
+			if (fields.size() < 4)
+			{
+				continue;
+			}
+
+			Entry entry;
+			entry.hash = strtoull(fields[0].c_str(), NULL, 16);
+			entry.settings = fields[1];
+			entry.source = fields[2];
+			entry.cooked = fields[3];
+
+			if (fields.size() > 4 && !fields[4].empty())
+			{
+				entry.dependencies = Split(fields[4], '|');
+			}
+
+			this->Set(entry);
+		}
+
+		return true;
+	}
+
+	bool Save(const std::string &path) const
+	{
+		std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+
+		if (!file)
+		{
+			cout << "ERROR::MANIFEST::SAVE_FAILED " << path << endl;
+			return false;
+		}
+
+		file << Magic << "\n";
+
+		for (std::map<std::string, Entry>::const_iterator i = this->entries.begin(); i != this->entries.end(); ++i)
+		{
+			const Entry &entry = i->second;
+			char hash[17];
+			snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)entry.hash);
+			file << hash << '\t' << entry.settings << '\t' << entry.source << '\t' << entry.cooked << '\t';
+
+			for (size_t d = 0; d < entry.dependencies.size(); d++)
+			{
+				file << (d ? "|" : "") << entry.dependencies[d];
+			}
+
+			file << "\n";
+		}
+
+		return file.good();
+	}
+
+	void Set(const Entry &entry)
+	{
+		this->entries[AssetPack::NormalisePath(entry.source)] = entry;
+	}
+
+	const Entry *Find(const std::string &source) const
+	{
+		std::map<std::string, Entry>::const_iterator entry = this->entries.find(AssetPack::NormalisePath(source));
+		return (entry == this->entries.end()) ? NULL : &entry->second;
+	}
+
+	// The cooked file for a source, or the source itself when it wasn't cooked
+	std::string Resolve(const std::string &source) const
+	{
+		const Entry *entry = this->Find(source);
+		return entry ? entry->cooked : source;
+	}
+
+	const std::map<std::string, Entry> &Entries() const
+	{
+		return this->entries;
+	}
+
+	// The manifest the loaders resolve through, NULL when running on the sources
+	static AssetManifest *&Mounted()
+	{
+		static AssetManifest *mounted = NULL;
+		return mounted;
+	}
+
+	static std::string ResolveMounted(const std::string &source)
+	{
+		return Mounted() ? Mounted()->Resolve(source) : source;
+	}
+
+private:
+	std::map<std::string, Entry> entries;	// by normalised source path
+
+	static const char *const Magic;
+
+	static std::vector<std::string> Split(const std::string &text, char separator)
+	{
+		std::vector<std::string> fields;
+		size_t start = 0, end;
+
+		while ((end = text.find(separator, start)) != std::string::npos)
+		{
+			fields.push_back(text.substr(start, end - start));
+			start = end + 1;
+		}
+
+		fields.push_back(text.substr(start));
+		return fields;
+	}
+};
+
+const char *const AssetManifest::Magic = "AGP_ASSET_MANIFEST 1";
@@ -0,0 +1,775 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+#include <iterator>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+// A file read out of an AssetPack. Stored files point straight into the pack's
+// mapping, compressed ones are decoded into their own buffer first.
+struct AssetSlice
+{
+	const unsigned char *data = NULL;
+	size_t size = 0;
+	std::vector<unsigned char> decoded;
+};
+
+// A whole file mapped read only, or read into memory where it can't be mapped, so
+// whatever points into it never needs a copy of its own
+class MappedFile
+{
+public:
+	MappedFile() : data(NULL), length(0), mapping(NULL) { }
+	~MappedFile() { this->Close(); }
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool Open(const std::string &path)
+	{
+		this->Close();
+
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (file != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER size;
+			HANDLE view = NULL;
+
+			if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+			{
+				view = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+				if (view)
+				{
+					this->data = (const unsigned char *)MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+
+					if (this->data)
+					{
+						this->length = (size_t)size.QuadPart;
+						this->mapping = view;
+					}
+					else
+					{
+						CloseHandle(view);
+					}
+				}
+			}
+
+			CloseHandle(file);
+
+			if (this->data)
+			{
+				return true;
+			}
+		}
+#else
+		int file = open(path.c_str(), O_RDONLY);
+
+		if (file >= 0)
+		{
+			struct stat status;
+			void *view = MAP_FAILED;
+
+			if (fstat(file, &status) == 0 && status.st_size > 0)
+			{
+				view = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+			}
+
+			close(file);
+
+			if (view != MAP_FAILED)
+			{
+				this->data = (const unsigned char *)view;
+				this->length = (size_t)status.st_size;
+				this->mapping = view;
+				return true;
+			}
+		}
+#endif
+		// No mapping, read the whole file instead
+		std::ifstream stream(path.c_str(), std::ios::binary | std::ios::ate);
+
+		if (!stream)
+		{
+			return false;
+		}
+
+		std::streamoff size = stream.tellg();
+
+		if (size <= 0)
+		{
+			return false;
+		}
+
+		unsigned char *buffer = new unsigned char[(size_t)size];
+		stream.seekg(0);
+		stream.read((char *)buffer, size);
+
+		if (!stream)
+		{
+			delete[] buffer;
+			return false;
+		}
+
+		this->data = buffer;
+		this->length = (size_t)size;
+		return true;
+	}
+
+	void Close()
+	{
+		if (this->data)
+		{
+#if defined(_WIN32)
+			if (this->mapping)
+			{
+				UnmapViewOfFile(this->data);
+				CloseHandle((HANDLE)this->mapping);
+			}
+#else
+			if (this->mapping)
+			{
+				munmap((void *)this->data, this->length);
+			}
+#endif
+			else
+			{
+				delete[] this->data;
+			}
+		}
+
+		this->data = NULL;
+		this->length = 0;
+		this->mapping = NULL;
+	}
+
+	const unsigned char *Data() const
+	{
+		return this->data;
+	}
+
+	size_t Size() const
+	{
+		return this->length;
+	}
+
+private:
+	const unsigned char *data;
+	size_t length;
+	void *mapping;	// the file mapping, NULL when the file was read into data
+};
+
+// Every asset in one memory mapped file, so a cold start costs one open instead of
+// one per shader, texture and model. The table of contents is an open addressed hash
+// table of the normalised paths, each file starts on a 64 byte boundary and files
+// that shrink by an eighth or more are stored as LZ4 blocks.
+// Nothing in an open pack ever changes, so any number of threads can Read from it
+// at once without locking.
+class AssetPack
+{
+public:
+	AssetPack() : header(NULL), table(NULL), names(NULL) { }
+	~AssetPack() { this->Close(); }
+
+	AssetPack(const AssetPack &) = delete;
+	AssetPack &operator=(const AssetPack &) = delete;
+
+	bool Open(const std::string &path)
+	{
+		this->Close();
+
+		if (!this->file.Open(path))
+		{
+			cout << "ERROR::ASSET_PACK::OPEN_FAILED " << path << endl;
+			return false;
+		}
+
+		const unsigned char *data = this->file.Data();
+		size_t length = this->file.Size();
+		const PackHeader *packHeader = (const PackHeader *)data;
+
+		if (length < sizeof(PackHeader) || packHeader->magic != Magic || packHeader->version != Version ||
+			packHeader->bucketCount == 0 || (packHeader->bucketCount & (packHeader->bucketCount - 1)) != 0 ||
+			packHeader->tableOffset % Alignment != 0 ||
+			packHeader->tableOffset + (uint64_t)packHeader->bucketCount * sizeof(PackEntry) > length ||
+			packHeader->namesOffset + packHeader->namesSize > length ||
+			packHeader->namesSize == 0 || data[packHeader->namesOffset + packHeader->namesSize - 1] != '\0')
+		{
+			cout << "ERROR::ASSET_PACK::CORRUPT " << path << endl;
+			this->Close();
+			return false;
+		}
+
+		this->header = packHeader;
+		this->table = (const PackEntry *)(data + packHeader->tableOffset);
+		this->names = (const char *)(data + packHeader->namesOffset);
+		return true;
+	}
+
+	void Close()
+	{
+		this->file.Close();
+		this->header = NULL;
+		this->table = NULL;
+		this->names = NULL;
+	}
+
+	bool IsOpen() const
+	{
+		return this->header != NULL;
+	}
+
+	uint32_t FileCount() const
+	{
+		return this->header ? this->header->entryCount : 0;
+	}
+
+	bool Contains(const std::string &path) const
+	{
+		return this->Find(path) != NULL;
+	}
+
+	// Fills slice with the file at path, false if the pack doesn't have it
+	bool Read(const std::string &path, AssetSlice &slice) const
+	{
+		const PackEntry *entry = this->Find(path);
+
+		slice.data = NULL;
+		slice.size = 0;
+		slice.decoded.clear();
+
+		if (!entry)
+		{
+			return false;
+		}
+
+		const unsigned char *stored = this->file.Data() + entry->offset;
+
+		if (!(entry->flags & ASSET_PACK_COMPRESSED))
+		{
+			slice.data = stored;
+			slice.size = entry->size;
+			return true;
+		}
+
+		slice.decoded.resize(entry->rawSize);
+
+		if (!Decompress(stored, entry->size, slice.decoded.data(), entry->rawSize))
+		{
+			cout << "ERROR::ASSET_PACK::CORRUPT_FILE " << path << endl;
+			slice.decoded.clear();
+			return false;
+		}
+
+		slice.data = slice.decoded.data();
+		slice.size = slice.decoded.size();
+		return true;
+	}
+
+	// The pack the loaders read from before looking for loose files, NULL for none
+	static AssetPack *&Mounted()
+	{
+		static AssetPack *mounted = NULL;
+		return mounted;
+	}
+
+	static bool ReadMounted(const std::string &path, AssetSlice &slice)
+	{
+		return Mounted() && Mounted()->Read(path, slice);
+	}
+
+	// Writes the given files into a new pack at packPath, under their normalised paths
+	static bool Build(const std::string &packPath, const std::vector<std::string> &files, bool compress = true)
+	{
+		std::vector<PackEntry> entries;
+		std::vector<std::string> entryNames;
+		std::string nameBlock;
+
+		std::ofstream pack(packPath.c_str(), std::ios::binary | std::ios::trunc);
+
+		if (!pack)
+		{
+			cout << "ERROR::ASSET_PACK::WRITE_FAILED " << packPath << endl;
+			return false;
+		}
+
+		// The header is written last, once the offsets are known
+		uint64_t offset = Alignment;
+		std::vector<char> padding(Alignment, 0);
+		pack.write(padding.data(), Alignment);
+
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			std::string name = NormalisePath(files[i]);
+			bool duplicate = false;
+
+			for (size_t j = 0; j < entryNames.size() && !duplicate; j++)
+			{
+				duplicate = entryNames[j] == name;
+			}
+
+			if (duplicate)
+			{
+				continue;
+			}
+
+			std::ifstream file(files[i].c_str(), std::ios::binary);
+
+			if (!file)
+			{
+				cout << "ERROR::ASSET_PACK::FILE_NOT_FOUND " << files[i] << endl;
+				return false;
+			}
+
+			std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+			if (contents.size() > 0x7FFFFFFF)
+			{
+				cout << "ERROR::ASSET_PACK::FILE_TOO_BIG " << files[i] << endl;
+				return false;
+			}
+
+			PackEntry entry;
+			entry.hash = Hash(name);
+			entry.offset = offset;
+			entry.size = (uint32_t)contents.size();
+			entry.rawSize = (uint32_t)contents.size();
+			entry.nameOffset = (uint32_t)nameBlock.size();
+			entry.flags = 0;
+
+			// Already compressed formats (PNG, JPEG) don't get smaller, keep those mapped
+			std::vector<unsigned char> packed;
+
+			if (compress && !contents.empty())
+			{
+				packed.resize(CompressBound(contents.size()));
+				size_t packedSize = Compress(contents.data(), contents.size(), packed.data(), packed.size());
+
+				if (packedSize > 0 && packedSize <= contents.size() - contents.size() / 8)
+				{
+					packed.resize(packedSize);
+					entry.size = (uint32_t)packedSize;
+					entry.flags = ASSET_PACK_COMPRESSED;
+				}
+			}
+
+			const std::vector<unsigned char> &stored = (entry.flags & ASSET_PACK_COMPRESSED) ? packed : contents;
+			pack.write((const char *)stored.data(), stored.size());
+			offset += stored.size();
+
+			uint64_t aligned = (offset + Alignment - 1) / Alignment * Alignment;
+			pack.write(padding.data(), aligned - offset);
+			offset = aligned;
+
+			entries.push_back(entry);
+			entryNames.push_back(name);
+			nameBlock += name;
+			nameBlock += '\0';
+		}
+
+		// Twice as many buckets as files keeps the probes short
+		uint32_t bucketCount = 2;
+
+		while (bucketCount < entries.size() * 2)
+		{
+			bucketCount *= 2;
+		}
+
+		std::vector<PackEntry> buckets(bucketCount);
+
+		for (uint32_t i = 0; i < bucketCount; i++)
+		{
+			memset(&buckets[i], 0, sizeof(PackEntry));
+			buckets[i].nameOffset = EmptyBucket;
+		}
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			uint32_t bucket = (uint32_t)entries[i].hash & (bucketCount - 1);
+
+			while (buckets[bucket].nameOffset != EmptyBucket)
+			{
+				bucket = (bucket + 1) & (bucketCount - 1);
+			}
+
+			buckets[bucket] = entries[i];
+		}
+
+		PackHeader packHeader;
+		packHeader.magic = Magic;
+		packHeader.version = Version;
+		packHeader.entryCount = (uint32_t)entries.size();
+		packHeader.bucketCount = bucketCount;
+		packHeader.tableOffset = offset;
+		packHeader.namesOffset = offset + (uint64_t)bucketCount * sizeof(PackEntry);
+		packHeader.namesSize = (uint32_t)nameBlock.size() + 1;
+		packHeader.reserved = 0;
+
+		pack.write((const char *)buckets.data(), bucketCount * sizeof(PackEntry));
+		pack.write(nameBlock.c_str(), nameBlock.size() + 1);
+		pack.seekp(0);
+		pack.write((const char *)&packHeader, sizeof(PackHeader));
+
+		if (!pack)
+		{
+			cout << "ERROR::ASSET_PACK::WRITE_FAILED " << packPath << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	// Paths are matched with forward slashes, in lower case and without "." or ".."
+	// parts, the way Windows would find the loose file
+	static std::string NormalisePath(const std::string &path)
+	{
+		std::vector<std::string> parts;
+		std::string part;
+
+		for (size_t i = 0; i <= path.size(); i++)
+		{
+			char c = (i < path.size()) ? path[i] : '/';
+
+			if (c != '/' && c != '\\')
+			{
+				part += (char)tolower((unsigned char)c);
+				continue;
+			}
+
+			if (part == "..")
+			{
+				if (!parts.empty() && parts.back() != "..")
+				{
+					parts.pop_back();
+				}
+				else
+				{
+					parts.push_back(part);
+				}
+			}
+			else if (!part.empty() && part != ".")
+			{
+				parts.push_back(part);
+			}
+
+			part.clear();
+		}
+
+		std::string normalised;
+
+		for (size_t i = 0; i < parts.size(); i++)
+		{
+			normalised += (i > 0) ? "/" + parts[i] : parts[i];
+		}
+
+		return normalised;
+	}
+
+	// 64 bit FNV-1a
+	static uint64_t Hash(const std::string &name)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+
+		for (size_t i = 0; i < name.size(); i++)
+		{
+			hash ^= (unsigned char)name[i];
+			hash *= 1099511628211ULL;
+		}
+
+		return hash;
+	}
+
+	// Largest size Compress can produce for size bytes
+	static size_t CompressBound(size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	// Greedy LZ4 block compression, the format the LZ4 library reads. Returns the
+	// compressed size, or 0 if it didn't fit in capacity.
+	static size_t Compress(const unsigned char *source, size_t size, unsigned char *destination, size_t capacity)
+	{
+		const size_t lastLiterals = 5, matchFindLimit = 12;
+		std::vector<uint32_t> positions(1 << HashBits, 0);
+		size_t anchor = 0, out = 0;
+
+		if (size > matchFindLimit)
+		{
+			size_t matchLimit = size - lastLiterals;
+			size_t i = 0;
+
+			while (i < size - matchFindLimit)
+			{
+				uint32_t sequence = Read32(source + i);
+				uint32_t slot = (sequence * 2654435761u) >> (32 - HashBits);
+				size_t candidate = positions[slot];
+				positions[slot] = (uint32_t)i;
+
+				if (candidate >= i || i - candidate > 65535 || Read32(source + candidate) != sequence)
+				{
+					// Step further the longer nothing has matched, so data that doesn't
+					// compress goes through quickly
+					i += 1 + ((i - anchor) >> 6);
+					continue;
+				}
+
+				size_t matchLength = 4;
+
+				while (i + matchLength < matchLimit && source[candidate + matchLength] == source[i + matchLength])
+				{
+					matchLength++;
+				}
+
+				size_t literals = i - anchor;
+
+				if (out + 1 + literals + literals / 255 + 1 + 2 + matchLength / 255 + 1 > capacity)
+				{
+					return 0;
+				}
+
+				unsigned char *token = destination + out++;
+				out = WriteLength(destination, out, literals, token, 4);
+				memcpy(destination + out, source + anchor, literals);
+				out += literals;
+
+				destination[out++] = (unsigned char)((i - candidate) & 0xFF);
+				destination[out++] = (unsigned char)((i - candidate) >> 8);
+				out = WriteLength(destination, out, matchLength - 4, token, 0);
+
+				i += matchLength;
+				anchor = i;
+			}
+		}
+
+		// The block always ends with literals
+		size_t literals = size - anchor;
+
+		if (out + 1 + literals + literals / 255 + 1 > capacity)
+		{
+			return 0;
+		}
+
+		unsigned char *token = destination + out++;
+		out = WriteLength(destination, out, literals, token, 4);
+		memcpy(destination + out, source + anchor, literals);
+		return out + literals;
+	}
+
+	// Decodes an LZ4 block of size bytes into exactly rawSize bytes, checking every
+	// length and offset against both buffers
+	static bool Decompress(const unsigned char *source, size_t size, unsigned char *destination, size_t rawSize)
+	{
+		size_t in = 0, out = 0;
+
+		while (in < size)
+		{
+			unsigned char token = source[in++];
+			size_t literals = token >> 4;
+
+			if (literals == 15 && !ReadLength(source, size, in, literals))
+			{
+				return false;
+			}
+
+			if (literals > size - in || literals > rawSize - out)
+			{
+				return false;
+			}
+
+			memcpy(destination + out, source + in, literals);
+			in += literals;
+			out += literals;
+
+			if (in == size)
+			{
+				break;
+			}
+
+			if (size - in < 2)
+			{
+				return false;
+			}
+
+			size_t distance = source[in] | (source[in + 1] << 8);
+			in += 2;
+
+			if (distance == 0 || distance > out)
+			{
+				return false;
+			}
+
+			size_t matchLength = token & 15;
+
+			if (matchLength == 15 && !ReadLength(source, size, in, matchLength))
+			{
+				return false;
+			}
+
+			matchLength += 4;
+
+			if (matchLength > rawSize - out)
+			{
+				return false;
+			}
+
+			const unsigned char *match = destination + out - distance;
+
+			if (distance >= matchLength)
+			{
+				memcpy(destination + out, match, matchLength);
+			}
+			else
+			{
+				// Overlapping, repeats the last distance bytes
+				for (size_t i = 0; i < matchLength; i++)
+				{
+					destination[out + i] = match[i];
+				}
+			}
+
+			out += matchLength;
+		}
+
+		return out == rawSize;
+	}
+
+private:
+	enum AssetPackFlags
+	{
+		ASSET_PACK_COMPRESSED = 1	// an LZ4 block, rawSize bytes once decoded
+	};
+
+	static const uint32_t Magic = 'A' | ('G' << 8) | ('P' << 16) | ('K' << 24);
+	static const uint32_t Version = 1;
+	static const uint32_t Alignment = 64;
+	static const uint32_t EmptyBucket = 0xFFFFFFFF;
+	static const int HashBits = 16;
+
+	struct PackHeader
+	{
+		uint32_t magic, version;
+		uint32_t entryCount, bucketCount;	// bucketCount is a power of 2
+		uint64_t tableOffset, namesOffset;
+		uint32_t namesSize, reserved;
+	};
+
+	struct PackEntry
+	{
+		uint64_t hash;			// of the normalised path
+		uint64_t offset;		// from the start of the pack
+		uint32_t size;			// as stored
+		uint32_t rawSize;		// once decoded
+		uint32_t nameOffset;	// into the names, EmptyBucket for an unused bucket
+		uint32_t flags;
+	};
+
+	MappedFile file;
+	const PackHeader *header;
+	const PackEntry *table;
+	const char *names;
+
+	const PackEntry *Find(const std::string &path) const
+	{
+		if (!this->header)
+		{
+			return NULL;
+		}
+
+		std::string name = NormalisePath(path);
+		uint64_t hash = Hash(name);
+		uint32_t mask = this->header->bucketCount - 1;
+
+		for (uint32_t probe = 0, bucket = (uint32_t)hash & mask; probe <= mask; probe++, bucket = (bucket + 1) & mask)
+		{
+			const PackEntry *entry = &this->table[bucket];
+
+			if (entry->nameOffset == EmptyBucket)
+			{
+				return NULL;
+			}
+
+			if (entry->hash == hash && entry->nameOffset < this->header->namesSize &&
+				name == this->names + entry->nameOffset &&
+				entry->offset + entry->size <= this->file.Size())
+			{
+				return entry;
+			}
+		}
+
+		return NULL;
+	}
+
+	static uint32_t Read32(const unsigned char *bytes)
+	{
+		uint32_t value;
+		memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	// Puts a length in the token's nibble at shift, with 255s and the rest after it
+	// when it doesn't fit
+	static size_t WriteLength(unsigned char *destination, size_t out, size_t length, unsigned char *token, int shift)
+	{
+		if (shift)
+		{
+			*token = 0;
+		}
+
+		if (length < 15)
+		{
+			*token |= (unsigned char)(length << shift);
+			return out;
+		}
+
+		*token |= (unsigned char)(15 << shift);
+
+		for (length -= 15; length >= 255; length -= 255)
+		{
+			destination[out++] = 255;
+		}
+
+		destination[out++] = (unsigned char)length;
+		return out;
+	}
+
+	static bool ReadLength(const unsigned char *source, size_t size, size_t &in, size_t &length)
+	{
+		unsigned char byte;
+
+		do
+		{
+			if (in >= size)
+			{
+				return false;
+			}
+
+			byte = source[in++];
+			length += byte;
+		} while (byte == 255);
+
+		return true;
+	}
+};
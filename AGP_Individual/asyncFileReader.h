@@ -0,0 +1,586 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include "assetPack.h"
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// io_uring needs Linux 5.1 and its uapi header, everything else reads on a thread pool
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ASYNC_READ_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+
+using std::cout;
+using std::endl;
+
+// Reads loose files in batches instead of one blocking read at a time. Everything
+// queued is read at once when the batch is submitted: through io_uring on Linux,
+// otherwise by a pool of threads each doing whole file preads. Loaders pick the
+// files up with ReadAsset, which waits for the batch if it's still in flight.
+// Queue, Submit, Wait and Read all belong to the thread that owns the reader.
+class AsyncFileReader
+{
+public:
+	AsyncFileReader(unsigned depth = 64) : depth(depth ? depth : 1), pending(false), next(0),
+		fileCount(0), byteCount(0), seconds(0.0), peakDepth(0)
+	{
+#if defined(ASYNC_READ_IO_URING)
+		this->ring = -1;
+		this->inFlight = 0;
+		this->unsubmitted = 0;
+		this->completed = 0;
+		this->OpenRing();
+#endif
+	}
+
+	~AsyncFileReader()
+	{
+		this->Wait();
+#if defined(ASYNC_READ_IO_URING)
+		this->CloseRing();
+#endif
+	}
+
+	AsyncFileReader(const AsyncFileReader &) = delete;
+	AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+
+	// Adds a file to the next batch. Files in the mounted pack and files already
+	// queued are skipped.
+	void Queue(const std::string &path)
+	{
+		if (this->pending)
+		{
+			this->Wait();
+		}
+
+		std::string key = AssetPack::NormalisePath(path);
+
+		if (this->files.count(key) || (AssetPack::Mounted() && AssetPack::Mounted()->Contains(path)))
+		{
+			return;
+		}
+
+		FileRead &file = this->files[key];
+		file.path = path;
+		this->batch.push_back(&file);
+	}
+
+	// Starts reading everything queued, without waiting for any of it
+	void Submit()
+	{
+		if (this->pending || this->batch.empty())
+		{
+			return;
+		}
+
+		this->pending = true;
+		this->started = std::chrono::steady_clock::now();
+
+#if defined(ASYNC_READ_IO_URING)
+		if (this->ring >= 0)
+		{
+			this->next = 0;
+			this->completed = 0;
+			this->FillRing();
+			this->Enter(0);
+			return;
+		}
+#endif
+
+		// the workers mostly wait on the disk, so there are at least 4 even on 1 or 2 cores
+		unsigned workerCount = std::thread::hardware_concurrency();
+		workerCount = (workerCount > 4) ? workerCount : 4;
+		workerCount = (workerCount < this->depth) ? workerCount : this->depth;
+		workerCount = (workerCount < this->batch.size()) ? workerCount : (unsigned)this->batch.size();
+
+		this->next = 0;
+		this->peakDepth = (workerCount > this->peakDepth) ? workerCount : this->peakDepth;
+
+		for (unsigned i = 0; i < workerCount; i++)
+		{
+			this->workers.push_back(std::thread(&AsyncFileReader::Work, this));
+		}
+	}
+
+	// Blocks until the submitted batch has been read, submitting it first if needed
+	void Wait()
+	{
+		if (!this->pending)
+		{
+			this->Submit();
+
+			if (!this->pending)
+			{
+				return;
+			}
+		}
+
+#if defined(ASYNC_READ_IO_URING)
+		while (this->ring >= 0 && this->completed < this->batch.size())
+		{
+			this->Enter(this->inFlight ? 1 : 0);
+
+			if (this->ring >= 0)
+			{
+				this->Reap();
+				this->FillRing();
+			}
+		}
+#endif
+
+		for (size_t i = 0; i < this->workers.size(); i++)
+		{
+			this->workers[i].join();
+		}
+		this->workers.clear();
+
+		for (size_t i = 0; i < this->batch.size(); i++)
+		{
+			if (this->batch[i]->ok)
+			{
+				this->fileCount++;
+				this->byteCount += this->batch[i]->data.size();
+			}
+		}
+
+		this->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - this->started).count();
+		this->batch.clear();
+		this->pending = false;
+	}
+
+	// Points slice at a file read by an earlier batch. It stays valid until the file is
+	// released or the reader is destroyed.
+	bool Read(const std::string &path, AssetSlice &slice)
+	{
+		if (this->files.empty())
+		{
+			return false;
+		}
+
+		this->Wait();
+
+		std::map<std::string, FileRead>::const_iterator file = this->files.find(AssetPack::NormalisePath(path));
+
+		if (file == this->files.end() || !file->second.ok)
+		{
+			return false;
+		}
+
+		slice.decoded.clear();
+		slice.data = file->second.data.empty() ? NULL : &file->second.data[0];
+		slice.size = file->second.data.size();
+		return true;
+	}
+
+	// Frees a file once nothing needs it any more
+	void Release(const std::string &path)
+	{
+		this->Wait();
+		this->files.erase(AssetPack::NormalisePath(path));
+	}
+
+	void Clear()
+	{
+		this->Wait();
+		this->files.clear();
+	}
+
+	void Report(const std::string &name) const
+	{
+		double milliseconds = this->seconds * 1000.0;
+		double bandwidth = (this->seconds > 0.0) ? this->byteCount / (1024.0 * 1024.0) / this->seconds : 0.0;
+
+		cout << "ASYNC_READ::" << name << ":: " << this->fileCount << " files, " << this->byteCount / 1024 << " KB in "
+			<< milliseconds << " ms (" << bandwidth << " MB/s), queue depth " << this->peakDepth << " on " << this->Backend() << endl;
+	}
+
+	const char *Backend() const
+	{
+#if defined(ASYNC_READ_IO_URING)
+		if (this->ring >= 0)
+		{
+			return "io_uring";
+		}
+#endif
+#if defined(_WIN32)
+		return "read threads";
+#else
+		return "pread threads";
+#endif
+	}
+
+	// The reader the texture, shader and model loaders look in, NULL when there isn't one
+	static AsyncFileReader *&Mounted()
+	{
+		static AsyncFileReader *mounted = NULL;
+		return mounted;
+	}
+
+	// Where the loaders get their files from: the mounted pack, then whatever the
+	// mounted reader has read ahead. False means the loose file has to be read.
+	static bool ReadAsset(const std::string &path, AssetSlice &slice)
+	{
+		return AssetPack::ReadMounted(path, slice) || (Mounted() && Mounted()->Read(path, slice));
+	}
+
+private:
+	struct FileRead
+	{
+		std::string path;
+		std::vector<unsigned char> data;
+		size_t done = 0;
+		int handle = -1;
+		bool ok = false;
+#if defined(ASYNC_READ_IO_URING)
+		struct iovec buffer;
+#endif
+	};
+
+	unsigned depth;
+	std::map<std::string, FileRead> files;	// by normalised path, so nodes never move
+	std::vector<FileRead *> batch;
+	bool pending;
+	std::atomic<size_t> next;
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point started;
+
+	size_t fileCount;
+	size_t byteCount;
+	double seconds;
+	unsigned peakDepth;
+
+	// Pool worker, takes files off the batch until there are none left
+	void Work()
+	{
+		size_t i;
+
+		while ((i = this->next++) < this->batch.size())
+		{
+			ReadWhole(*this->batch[i]);
+		}
+	}
+
+	static void ReadWhole(FileRead &file)
+	{
+#if defined(_WIN32)
+		std::ifstream stream(file.path.c_str(), std::ios::in | std::ios::binary);
+
+		if (!stream)
+		{
+			return;
+		}
+
+		stream.seekg(0, std::ios::end);
+		std::streamoff size = stream.tellg();
+		stream.seekg(0, std::ios::beg);
+
+		if (size < 0)
+		{
+			return;
+		}
+
+		file.data.resize((size_t)size);
+		file.ok = size == 0 || stream.read((char *)&file.data[0], size).gcount() == size;
+#else
+		int handle = open(file.path.c_str(), O_RDONLY);
+		struct stat info;
+
+		if (handle < 0)
+		{
+			return;
+		}
+
+		if (fstat(handle, &info) == 0 && info.st_size >= 0)
+		{
+			file.data.resize((size_t)info.st_size);
+
+			while (file.done < file.data.size())
+			{
+				ssize_t count = pread(handle, &file.data[file.done], file.data.size() - file.done, (off_t)file.done);
+
+				if (count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+
+				if (count <= 0)
+				{
+					break;
+				}
+
+				file.done += (size_t)count;
+			}
+
+			file.ok = file.done == file.data.size();
+		}
+
+		close(handle);
+#endif
+	}
+
+#if defined(ASYNC_READ_IO_URING)
+	int ring;
+	unsigned inFlight;		// reads the kernel has yet to complete
+	unsigned unsubmitted;	// entries pushed since the last io_uring_enter
+	size_t completed;
+
+	void *sqRing;
+	void *cqRing;
+	size_t sqRingSize;
+	size_t cqRingSize;
+	struct io_uring_sqe *sqes;
+	unsigned sqEntries;
+	unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+	unsigned *cqHead, *cqTail, *cqMask;
+	struct io_uring_cqe *cqes;
+
+	// Falls back to the thread pool when the kernel is too old or io_uring is blocked
+	void OpenRing()
+	{
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+
+		this->ring = (int)syscall(__NR_io_uring_setup, this->depth, &params);
+
+		if (this->ring < 0)
+		{
+			return;
+		}
+
+		this->sqEntries = params.sq_entries;
+
+		this->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		this->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+		if (params.features & IORING_FEAT_SINGLE_MMAP)
+		{
+			this->sqRingSize = (this->cqRingSize > this->sqRingSize) ? this->cqRingSize : this->sqRingSize;
+			this->cqRingSize = this->sqRingSize;
+		}
+
+		this->sqRing = mmap(NULL, this->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring, IORING_OFF_SQ_RING);
+		this->cqRing = (params.features & IORING_FEAT_SINGLE_MMAP) ? this->sqRing :
+			mmap(NULL, this->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring, IORING_OFF_CQ_RING);
+		this->sqes = (struct io_uring_sqe *)mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring, IORING_OFF_SQES);
+
+		if (this->sqRing == MAP_FAILED || this->cqRing == MAP_FAILED || this->sqes == MAP_FAILED)
+		{
+			this->CloseRing();
+			return;
+		}
+
+		unsigned char *sq = (unsigned char *)this->sqRing;
+		unsigned char *cq = (unsigned char *)this->cqRing;
+		this->sqHead = (unsigned *)(sq + params.sq_off.head);
+		this->sqTail = (unsigned *)(sq + params.sq_off.tail);
+		this->sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+		this->sqArray = (unsigned *)(sq + params.sq_off.array);
+		this->cqHead = (unsigned *)(cq + params.cq_off.head);
+		this->cqTail = (unsigned *)(cq + params.cq_off.tail);
+		this->cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+		this->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	}
+
+	void CloseRing()
+	{
+		if (this->ring < 0)
+		{
+			return;
+		}
+
+		if (this->sqes != MAP_FAILED)
+		{
+			munmap(this->sqes, this->sqEntries * sizeof(struct io_uring_sqe));
+		}
+
+		if (this->cqRing != MAP_FAILED && this->cqRing != this->sqRing)
+		{
+			munmap(this->cqRing, this->cqRingSize);
+		}
+
+		if (this->sqRing != MAP_FAILED)
+		{
+			munmap(this->sqRing, this->sqRingSize);
+		}
+
+		close(this->ring);
+		this->ring = -1;
+	}
+
+	// Opens the next files in the batch and queues their reads, as many as the ring holds.
+	// Opening stays synchronous, IORING_OP_OPENAT would need Linux 5.6.
+	void FillRing()
+	{
+		while (this->next < this->batch.size() && this->inFlight < this->sqEntries)
+		{
+			FileRead &file = *this->batch[this->next++];
+			struct stat info;
+
+			file.handle = open(file.path.c_str(), O_RDONLY);
+
+			if (file.handle < 0 || fstat(file.handle, &info) != 0 || info.st_size < 0)
+			{
+				this->Finish(file, false);
+				continue;
+			}
+
+			file.data.resize((size_t)info.st_size);
+
+			if (file.data.empty())
+			{
+				this->Finish(file, true);
+				continue;
+			}
+
+			this->Push(file);
+		}
+	}
+
+	// Queues a read of whatever is left of the file
+	void Push(FileRead &file)
+	{
+		unsigned tail = *this->sqTail;
+		unsigned index = tail & *this->sqMask;
+		struct io_uring_sqe *sqe = &this->sqes[index];
+
+		file.buffer.iov_base = &file.data[file.done];
+		file.buffer.iov_len = file.data.size() - file.done;
+
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READV;
+		sqe->fd = file.handle;
+		sqe->addr = (uint64_t)(uintptr_t)&file.buffer;
+		sqe->len = 1;
+		sqe->off = file.done;
+		sqe->user_data = (uint64_t)(uintptr_t)&file;
+
+		this->sqArray[index] = index;
+		__atomic_store_n(this->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+		this->unsubmitted++;
+		this->inFlight++;
+		this->peakDepth = (this->inFlight > this->peakDepth) ? this->inFlight : this->peakDepth;
+	}
+
+	// Hands the kernel everything pushed so far, waiting for minComplete reads to finish
+	void Enter(unsigned minComplete)
+	{
+		while (this->unsubmitted || minComplete)
+		{
+			int submitted = (int)syscall(__NR_io_uring_enter, this->ring, this->unsubmitted, minComplete,
+				minComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+
+			if (submitted < 0)
+			{
+				if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				{
+					continue;
+				}
+
+				cout << "ERROR::ASYNC_READ::IO_URING_ENTER " << strerror(errno) << endl;
+				this->FailInFlight();
+				return;
+			}
+
+			this->unsubmitted -= ((unsigned)submitted < this->unsubmitted) ? (unsigned)submitted : this->unsubmitted;
+			minComplete = 0;
+		}
+	}
+
+	// Takes the finished reads off the completion queue, queuing the rest of short reads
+	void Reap()
+	{
+		unsigned head = *this->cqHead;
+
+		while (head != __atomic_load_n(this->cqTail, __ATOMIC_ACQUIRE))
+		{
+			struct io_uring_cqe *cqe = &this->cqes[head & *this->cqMask];
+			FileRead &file = *(FileRead *)(uintptr_t)cqe->user_data;
+			int result = cqe->res;
+
+			head++;
+			__atomic_store_n(this->cqHead, head, __ATOMIC_RELEASE);
+			this->inFlight--;
+
+			if (result == -EINTR || result == -EAGAIN)
+			{
+				this->Push(file);
+			}
+			else if (result <= 0)
+			{
+				this->Finish(file, false);
+			}
+			else if ((file.done += (size_t)result) < file.data.size())
+			{
+				this->Push(file);
+			}
+			else
+			{
+				this->Finish(file, true);
+			}
+		}
+	}
+
+	void Finish(FileRead &file, bool ok)
+	{
+		if (file.handle >= 0)
+		{
+			close(file.handle);
+			file.handle = -1;
+		}
+
+		file.ok = ok;
+		this->completed++;
+	}
+
+	// The ring is unusable, so whatever it still had is read on this thread instead
+	void FailInFlight()
+	{
+		// closing the ring first makes sure the kernel is done with the buffers
+		this->CloseRing();
+
+		for (size_t i = 0; i < this->batch.size(); i++)
+		{
+			FileRead &file = *this->batch[i];
+
+			if (file.handle >= 0)
+			{
+				close(file.handle);
+				file.handle = -1;
+				file.done = 0;
+				ReadWhole(file);
+				this->completed++;
+			}
+		}
+
+		for (; this->next < this->batch.size(); this->next++)
+		{
+			ReadWhole(*this->batch[this->next]);
+			this->completed++;
+		}
+
+		this->inFlight = 0;
+		this->unsubmitted = 0;
+	}
+#endif
+};
@@ -0,0 +1,537 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "glHandle.h"
+#include "shader.h"
+#include "mesh.h"
+#include "depthPyramid.h"
+#include "streamBuffer.h"
+
+using std::cout;
+using std::endl;
+
+// Frustum and occlusion culling for every object in the scene, then back facing and
+// off screen culling for the meshlets of the objects left, and drawing what's left
+// with one call a mesh however many objects there are. Objects are added once and
+// kept on the GPU; each frame Cull tests them all against the view and last frame's
+// depth pyramid, and Draw draws the visible ones.
+//
+// On GL 4.3 cull.comp does the tests. Every meshlet has an indirect draw command, and
+// each of an object's meshlets that may be seen gets its matrix written into the
+// instance buffer and counted into its command, so the CPU never sees the objects at
+// all. Elsewhere the same tests run here, against the pyramid's read back levels: a
+// mesh of one meshlet draws its visible objects instanced from the frame's stream, a
+// larger one draws each object's visible meshlets in one multi-draw.
+class CullingPass
+{
+public:
+	CullingPass(DepthPyramid &pyramid, bool gpu) : pyramid(pyramid), gpu(gpu), dirty(false), visibleCount(0), rangeCount(0),
+		frames(0), culledOutside(0), culledOccluded(0), tested(0), meshletsTested(0), meshletsCulled(0)
+	{
+		if (this->gpu)
+		{
+			this->cullShader.reset(new Shader("res/shaders/cull.comp"));
+			this->viewProjectionLocation = glGetUniformLocation(this->cullShader->Program, "viewProjection");
+			this->eyeLocation = glGetUniformLocation(this->cullShader->Program, "eye");
+			this->objectCountLocation = glGetUniformLocation(this->cullShader->Program, "objectCount");
+			this->pyramidLocation = glGetUniformLocation(this->cullShader->Program, "pyramid");
+			this->pyramidSizeLocation = glGetUniformLocation(this->cullShader->Program, "pyramidSize");
+			this->pyramidLevelsLocation = glGetUniformLocation(this->cullShader->Program, "pyramidLevels");
+
+			GLuint statistics[4] = { 0, 0, 0, 0 };
+			this->statisticsBuffer = GLBuffer::Generate();
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->statisticsBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(statistics), statistics, GL_DYNAMIC_COPY);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+	}
+
+	CullingPass(const CullingPass &) = delete;
+	CullingPass &operator=(const CullingPass &) = delete;
+
+	// Compute shaders, storage buffers and indirect draws with base instances
+	static bool Supported()
+	{
+		return GLEW_VERSION_4_3 != 0;
+	}
+
+	// Adds an object: mesh drawn with transform. The mesh has to outlive the pass.
+	void Add(const Mesh &mesh, const glm::mat4 &transform)
+	{
+		GLuint index = (GLuint)(std::find(this->meshes.begin(), this->meshes.end(), &mesh) - this->meshes.begin());
+
+		if (index == this->meshes.size())
+		{
+			this->meshes.push_back(&mesh);
+		}
+
+		Object object;
+		object.transform = transform;
+		object.boundsMin = glm::vec4(mesh.BoundsMin(), 1.0f);
+		object.boundsMax = glm::vec4(mesh.BoundsMax(), 1.0f);
+		object.mesh = index;
+		object.firstCommand = object.meshletCount = object.pad = 0;
+		this->objects.push_back(object);
+		this->dirty = true;
+	}
+
+	// Works out what's visible from viewProjection, with the eye at eye, ready for Draw
+	void Cull(const glm::mat4 &viewProjection, const glm::vec3 &eye)
+	{
+		if (this->dirty)
+		{
+			this->upload();
+		}
+
+		if (this->objects.empty())
+		{
+			return;
+		}
+
+		this->frames++;
+		this->tested += this->objects.size();
+
+		if (this->gpu)
+		{
+			this->cullOnGpu(viewProjection, eye);
+		}
+		else
+		{
+			this->cullOnCpu(viewProjection, eye);
+		}
+	}
+
+	// Draws what the last Cull left, one draw call for each mesh
+	void Draw(const Shader &shader)
+	{
+		if (this->objects.empty() || this->dirty)
+		{
+			return;
+		}
+
+		if (this->gpu)
+		{
+			for (GLuint m = 0; m < this->meshes.size(); m++)
+			{
+				this->meshes[m]->DrawIndirect(shader, this->instanceBuffer, this->commandBuffer,
+					this->meshRuns[m].firstCommand * sizeof(DrawCommand), this->meshRuns[m].meshletCount);
+			}
+
+			return;
+		}
+
+		// Larger meshes draw their objects one by one, with only the meshlets in view
+		for (GLuint m = 0; m < this->meshes.size(); m++)
+		{
+			if (this->meshRuns[m].meshletCount > 1)
+			{
+				for (GLuint i = this->runs[m].first; i < this->runs[m].first + this->runs[m].count; i++)
+				{
+					const Run &ranges = this->visibleRanges[i];
+					this->meshes[m]->DrawRanges(shader, this->visible[i], &this->rangeCounts[ranges.first], &this->rangeOffsets[ranges.first], ranges.count);
+				}
+			}
+		}
+
+		StreamBuffer *stream = StreamBuffer::Mounted();
+		StreamAllocation allocation;
+		bool streamed = stream && this->visibleCount &&
+			stream->Allocate(this->visibleCount * sizeof(glm::mat4), sizeof(glm::mat4), allocation);
+
+		if (streamed)
+		{
+			memcpy(allocation.pointer, this->visible.data(), this->visibleCount * sizeof(glm::mat4));
+			stream->Commit();
+		}
+
+		for (GLuint m = 0; m < this->meshes.size(); m++)
+		{
+			if (this->meshRuns[m].meshletCount != 1 || !this->runs[m].count)
+			{
+				continue;
+			}
+
+			if (streamed)
+			{
+				this->meshes[m]->DrawInstanced(shader, stream->Buffer(), allocation.offset + this->runs[m].first * sizeof(glm::mat4), this->runs[m].count);
+			}
+			else
+			{
+				this->meshes[m]->Draw(shader, this->visible.data() + this->runs[m].first, this->runs[m].count);
+			}
+		}
+	}
+
+	bool IsGpu() const
+	{
+		return this->gpu;
+	}
+
+	// What was culled over every frame, reading the GPU's counts back
+	void Report(const std::string &name)
+	{
+		if (this->gpu && this->frames)
+		{
+			// The compute shader's atomic writes have to land before they're read back
+			GLuint statistics[4];
+			glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->statisticsBuffer);
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(statistics), statistics);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			this->culledOutside = statistics[0];
+			this->culledOccluded = statistics[1];
+			this->meshletsTested = statistics[2];
+			this->meshletsCulled = statistics[3];
+		}
+
+		double tested = this->tested ? (double)this->tested : 1.0;
+		double meshletsTested = this->meshletsTested ? (double)this->meshletsTested : 1.0;
+		cout << "CULLING::" << name << ":: " << (this->gpu ? "compute pass, indirect draws" : "on the CPU") << ", "
+			<< this->objects.size() << " objects, " << this->meshes.size() << " draws a frame, "
+			<< 100.0 * this->culledOutside / tested << "% outside the frustum and " << 100.0 * this->culledOccluded / tested
+			<< "% occluded, " << 100.0 * this->meshletsCulled / meshletsTested << "% of the visible objects' meshlets culled over "
+			<< this->frames << " frames" << endl;
+	}
+
+private:
+	// std430 layouts of cull.comp's Object, DrawCommand and Meshlet
+	struct Object
+	{
+		glm::mat4 transform;
+		glm::vec4 boundsMin;
+		glm::vec4 boundsMax;
+		GLuint mesh;
+		GLuint firstCommand;	// the mesh's first meshlet's
+		GLuint meshletCount;
+		GLuint pad;
+	};
+
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	struct Meshlet
+	{
+		glm::vec4 sphere;		// centre and radius
+		glm::vec4 cone;			// axis and cutoff
+	};
+
+	// A mesh's objects, an object's visible meshlet ranges
+	struct Run
+	{
+		GLuint first;
+		GLuint count;
+	};
+
+	// A mesh's meshlets' commands. Meshlet j's instances start at firstInstance + j
+	// times the mesh's object count, room for every object in each.
+	struct MeshRun
+	{
+		GLuint firstCommand;
+		GLuint meshletCount;
+		GLuint firstInstance;
+	};
+
+	enum Visibility
+	{
+		VISIBLE,
+		OUTSIDE,
+		OCCLUDED
+	};
+
+	DepthPyramid &pyramid;
+	bool gpu;
+	bool dirty;
+	std::vector<const Mesh *> meshes;
+	std::vector<MeshRun> meshRuns;
+	std::vector<Object> objects;			// sorted by mesh once uploaded
+
+	// The CPU cull's output, each as long as it can get so nothing grows in a frame
+	std::vector<Run> runs;					// by mesh, into visible
+	std::vector<glm::mat4> visible;
+	GLuint visibleCount;
+	std::vector<Run> visibleRanges;			// by visible object, into the ranges
+	std::vector<GLsizei> rangeCounts;
+	std::vector<const GLvoid *> rangeOffsets;
+	GLuint rangeCount;
+	std::vector<GLuint> meshletScratch;
+
+	std::unique_ptr<Shader> cullShader;
+	GLint viewProjectionLocation, eyeLocation, objectCountLocation, pyramidLocation, pyramidSizeLocation, pyramidLevelsLocation;
+	GLBuffer objectBuffer;
+	GLBuffer meshletBuffer;
+	GLBuffer commandTemplate;				// the commands with no instances, copied over the live ones every frame
+	GLBuffer commandBuffer;
+	GLBuffer instanceBuffer;
+	GLBuffer statisticsBuffer;
+
+	size_t frames;
+	size_t culledOutside, culledOccluded, tested;
+	size_t meshletsTested, meshletsCulled;
+
+	// Sorts the objects by mesh, gives each mesh's meshlets their commands and instance
+	// ranges, and sends everything to the GPU
+	void upload()
+	{
+		this->dirty = false;
+		std::stable_sort(this->objects.begin(), this->objects.end(),
+			[](const Object &a, const Object &b) { return a.mesh < b.mesh; });
+
+		this->runs.assign(this->meshes.size(), Run());
+		this->meshRuns.assign(this->meshes.size(), MeshRun());
+
+		for (GLuint i = 0; i < this->objects.size(); i++)
+		{
+			this->runs[this->objects[i].mesh].count++;
+		}
+
+		GLuint commandCount = 0, instanceCount = 0, rangeCapacity = 0, largest = 0;
+
+		for (GLuint m = 0, first = 0; m < this->meshes.size(); m++)
+		{
+			GLuint meshlets = this->meshes[m]->Meshlets().Count();
+			this->runs[m].first = first;
+			first += this->runs[m].count;
+
+			this->meshRuns[m].firstCommand = commandCount;
+			this->meshRuns[m].meshletCount = meshlets;
+			this->meshRuns[m].firstInstance = instanceCount;
+			commandCount += meshlets;
+			instanceCount += meshlets * this->runs[m].count;
+			largest = std::max(largest, meshlets);
+
+			if (meshlets > 1)
+			{
+				rangeCapacity += meshlets * this->runs[m].count;
+			}
+		}
+
+		for (GLuint i = 0; i < this->objects.size(); i++)
+		{
+			this->objects[i].firstCommand = this->meshRuns[this->objects[i].mesh].firstCommand;
+			this->objects[i].meshletCount = this->meshRuns[this->objects[i].mesh].meshletCount;
+		}
+
+		if (!this->gpu)
+		{
+			this->visible.resize(this->objects.size());
+			this->visibleRanges.resize(this->objects.size());
+			this->rangeCounts.resize(rangeCapacity);
+			this->rangeOffsets.resize(rangeCapacity);
+			this->meshletScratch.resize(largest + 4);
+			return;
+		}
+
+		std::vector<DrawCommand> commands(commandCount);
+		std::vector<Meshlet> meshlets(commandCount);
+
+		for (GLuint m = 0; m < this->meshes.size(); m++)
+		{
+			const MeshletSet &set = this->meshes[m]->Meshlets();
+
+			for (GLuint j = 0; j < set.Count(); j++)
+			{
+				DrawCommand &command = commands[this->meshRuns[m].firstCommand + j];
+				command.count = set.indexCount[j];
+				command.instanceCount = 0;
+				command.firstIndex = set.firstIndex[j];
+				command.baseVertex = 0;
+				command.baseInstance = this->meshRuns[m].firstInstance + j * this->runs[m].count;
+
+				Meshlet &meshlet = meshlets[this->meshRuns[m].firstCommand + j];
+				meshlet.sphere = glm::vec4(set.centerX[j], set.centerY[j], set.centerZ[j], set.radius[j]);
+				meshlet.cone = glm::vec4(set.axisX[j], set.axisY[j], set.axisZ[j], set.cutoff[j]);
+			}
+		}
+
+		this->objectBuffer = GLBuffer::Generate();
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->objectBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, this->objects.size() * sizeof(Object), this->objects.data(), GL_STATIC_DRAW);
+
+		this->meshletBuffer = GLBuffer::Generate();
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->meshletBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, meshlets.size() * sizeof(Meshlet), meshlets.data(), GL_STATIC_DRAW);
+
+		this->commandTemplate = GLBuffer::Generate();
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->commandTemplate);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawCommand), commands.data(), GL_STATIC_COPY);
+
+		this->commandBuffer = GLBuffer::Generate();
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->commandBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawCommand), NULL, GL_DYNAMIC_COPY);
+
+		this->instanceBuffer = GLBuffer::Generate();
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->instanceBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCount * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		cout << "CULLING:: " << this->objects.size() << " objects, " << commandCount << " meshlets drawn indirectly, "
+			<< instanceCount * sizeof(glm::mat4) / 1024 << " KB of instance slots" << endl;
+	}
+
+	void cullOnGpu(const glm::mat4 &viewProjection, const glm::vec3 &eye)
+	{
+		// The instance counts start from nothing again, without a trip through the CPU
+		GLsizeiptr commandBytes = (this->meshRuns.back().firstCommand + this->meshRuns.back().meshletCount) * sizeof(DrawCommand);
+		glBindBuffer(GL_COPY_READ_BUFFER, this->commandTemplate);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->commandBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commandBytes);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		this->cullShader->Use();
+		glUniformMatrix4fv(this->viewProjectionLocation, 1, GL_FALSE, &viewProjection[0][0]);
+		glUniform3f(this->eyeLocation, eye.x, eye.y, eye.z);
+		glUniform1ui(this->objectCountLocation, (GLuint)this->objects.size());
+		glUniform2i(this->pyramidSizeLocation, this->pyramid.Width(), this->pyramid.Height());
+		glUniform1i(this->pyramidLevelsLocation, this->pyramid.Levels());
+		glUniform1i(this->pyramidLocation, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, this->pyramid.Texture());
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->objectBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->commandBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->instanceBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, this->statisticsBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, this->meshletBuffer);
+
+		glDispatchCompute(((GLuint)this->objects.size() + 63) / 64, 1, 1);
+
+		// The draws read the commands and the instances the pass wrote
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void cullOnCpu(const glm::mat4 &viewProjection, const glm::vec3 &eye)
+	{
+		this->pyramid.Readback();
+		GLuint count = 0;
+		this->rangeCount = 0;
+
+		for (GLuint m = 0, i = 0; m < this->meshes.size(); m++)
+		{
+			const MeshletSet &set = this->meshes[m]->Meshlets();
+			this->runs[m].first = count;
+
+			for (; i < this->objects.size() && this->objects[i].mesh == m; i++)
+			{
+				Visibility visibility = this->test(this->objects[i], viewProjection);
+
+				if (visibility == OUTSIDE)
+				{
+					this->culledOutside++;
+					continue;
+				}
+
+				if (visibility == OCCLUDED)
+				{
+					this->culledOccluded++;
+					continue;
+				}
+
+				// The meshlets are tested in the object's own space
+				const glm::mat4 &transform = this->objects[i].transform;
+				glm::vec4 planes[6];
+				MeshletSet::FrustumPlanes(viewProjection * transform, planes);
+				glm::vec3 objectEye = glm::vec3(glm::inverse(transform) * glm::vec4(eye, 1.0f));
+				GLuint meshlets = set.Cull(planes, objectEye, this->meshletScratch.data());
+
+				this->meshletsTested += set.Count();
+				this->meshletsCulled += set.Count() - meshlets;
+
+				if (!meshlets)
+				{
+					continue;
+				}
+
+				if (set.Count() > 1)
+				{
+					this->addRanges(set, meshlets, this->visibleRanges[count]);
+				}
+
+				this->visible[count++] = transform;
+			}
+
+			this->runs[m].count = count - this->runs[m].first;
+		}
+
+		this->visibleCount = count;
+	}
+
+	// Turns the visible meshlets in meshletScratch into index ranges, those next to
+	// each other in the indices joined into one
+	void addRanges(const MeshletSet &set, GLuint meshlets, Run &ranges)
+	{
+		ranges.first = this->rangeCount;
+
+		for (GLuint k = 0; k < meshlets; k++)
+		{
+			GLuint j = this->meshletScratch[k];
+
+			if (k && this->meshletScratch[k - 1] == j - 1)
+			{
+				this->rangeCounts[this->rangeCount - 1] += set.indexCount[j];
+				continue;
+			}
+
+			this->rangeCounts[this->rangeCount] = set.indexCount[j];
+			this->rangeOffsets[this->rangeCount] = (const GLvoid *)(set.firstIndex[j] * sizeof(GLuint));
+			this->rangeCount++;
+		}
+
+		ranges.count = this->rangeCount - ranges.first;
+	}
+
+	// cull.comp's Visible, on the CPU
+	Visibility test(const Object &object, const glm::mat4 &viewProjection) const
+	{
+		glm::mat4 clipFromObject = viewProjection * object.transform;
+		glm::vec3 ndcMin(1e30f), ndcMax(-1e30f);
+		int behind = 0;
+
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec3 corner((i & 1) ? object.boundsMax.x : object.boundsMin.x, (i & 2) ? object.boundsMax.y : object.boundsMin.y,
+				(i & 4) ? object.boundsMax.z : object.boundsMin.z);
+			glm::vec4 clip = clipFromObject * glm::vec4(corner, 1.0f);
+
+			if (clip.w <= 0.0f)
+			{
+				behind++;
+				continue;
+			}
+
+			glm::vec3 ndc = glm::vec3(clip) / clip.w;
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+
+		if (behind == 8 || (behind == 0 && (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMax.z < -1.0f ||
+			ndcMin.x > 1.0f || ndcMin.y > 1.0f || ndcMin.z > 1.0f)))
+		{
+			return OUTSIDE;
+		}
+
+		if (behind > 0)
+		{
+			return VISIBLE;
+		}
+
+		glm::vec2 uvMin = glm::clamp(glm::vec2(ndcMin) * 0.5f + 0.5f, 0.0f, 1.0f);
+		glm::vec2 uvMax = glm::clamp(glm::vec2(ndcMax) * 0.5f + 0.5f, 0.0f, 1.0f);
+
+		return this->pyramid.Occluded(uvMin, uvMax, ndcMin.z * 0.5f + 0.5f) ? OCCLUDED : VISIBLE;
+	}
+};
@@ -0,0 +1,295 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "glHandle.h"
+#include "shader.h"
+
+// The frame's depth buffer reduced level by level, each texel the farthest depth of
+// the 2x2 under it (3x3 along the edge of an odd sized level), for occlusion culling.
+// A box on screen is behind what was drawn if its nearest depth is farther than the
+// farthest depth at the level where it spans no more than 2x2 texels, four reads
+// whatever its size.
+//
+// Build runs a fragment pass a level, so it works on GL 3.3. Where culling happens
+// on the CPU, Readback copies the coarse levels back a frame or two late.
+class DepthPyramid
+{
+public:
+	DepthPyramid(GLsizei width, GLsizei height) : width(width), height(height), levels(1),
+		shader("res/shaders/depthPyramid.vs", "res/shaders/depthPyramid.frag"), readbackLevel(0), readbackFence(0), downloaded(false)
+	{
+		while ((std::max(width, height) >> this->levels) > 0)
+		{
+			this->levels++;
+		}
+
+		// The coarse levels are small enough to copy back every frame, from about 64 wide
+		while (this->readbackLevel + 1 < this->levels && this->LevelWidth(this->readbackLevel) > ReadbackWidth)
+		{
+			this->readbackLevel++;
+		}
+
+		this->texture = GLTexture::Generate();
+		glBindTexture(GL_TEXTURE_2D, this->texture);
+
+		for (GLint level = 0; level < this->levels; level++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, this->LevelWidth(level), this->LevelHeight(level), 0, GL_RED, GL_FLOAT, NULL);
+		}
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, this->levels - 1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// Until a frame has been drawn everything is at the far plane, so nothing is occluded
+		this->framebuffer = GLFramebuffer::Generate();
+		glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+
+		for (GLint level = 0; level < this->levels; level++)
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, level);
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		// The passes draw one triangle over the level from gl_VertexID, with no vertices
+		this->vertexArray = GLVertexArray::Generate();
+		this->sourceLocation = glGetUniformLocation(this->shader.Program, "source");
+		this->firstLocation = glGetUniformLocation(this->shader.Program, "first");
+
+		this->cpuLevels.resize(this->levels);
+
+		for (GLint level = this->readbackLevel; level < this->levels; level++)
+		{
+			this->cpuLevels[level].assign(this->LevelWidth(level) * this->LevelHeight(level), 1.0f);
+		}
+
+		this->readbackBuffer = GLBuffer::Generate();
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbackBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, this->cpuLevels[this->readbackLevel].size() * sizeof(float), NULL, GL_STREAM_READ);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	DepthPyramid(const DepthPyramid &) = delete;
+	DepthPyramid &operator=(const DepthPyramid &) = delete;
+
+	~DepthPyramid()
+	{
+		if (this->readbackFence)
+		{
+			glDeleteSync(this->readbackFence);
+		}
+	}
+
+	// Rebuilds every level from depthTexture, which must be width by height. The
+	// framebuffer, viewport and depth test are left as they were.
+	void Build(GLuint depthTexture)
+	{
+		GLint framebuffer, viewport[4];
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+		glDisable(GL_DEPTH_TEST);
+		glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+		glBindVertexArray(this->vertexArray);
+		this->shader.Use();
+		glActiveTexture(GL_TEXTURE0);
+		glUniform1i(this->sourceLocation, 0);
+
+		for (GLint level = 0; level < this->levels; level++)
+		{
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, level);
+			glViewport(0, 0, this->LevelWidth(level), this->LevelHeight(level));
+			glUniform1i(this->firstLocation, level == 0);
+
+			if (level == 0)
+			{
+				glBindTexture(GL_TEXTURE_2D, depthTexture);
+			}
+			else
+			{
+				// Only the level above is read, so it's never the one being written
+				glBindTexture(GL_TEXTURE_2D, this->texture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+			}
+
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, this->texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, this->levels - 1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindVertexArray(0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+		if (depthTest)
+		{
+			glEnable(GL_DEPTH_TEST);
+		}
+	}
+
+	// Takes in the last copy of the coarse levels if the GPU has finished it, and
+	// starts another of the pyramid as it is now. Never waits on the GPU.
+	void Readback()
+	{
+		if (this->readbackFence)
+		{
+			if (glClientWaitSync(this->readbackFence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				return;
+			}
+
+			glDeleteSync(this->readbackFence);
+			this->readbackFence = 0;
+
+			std::vector<float> &texels = this->cpuLevels[this->readbackLevel];
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbackBuffer);
+			const float *mapped = (const float *)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, texels.size() * sizeof(float), GL_MAP_READ_BIT);
+
+			if (mapped)
+			{
+				memcpy(texels.data(), mapped, texels.size() * sizeof(float));
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				this->downloaded = true;
+			}
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			// The levels past the copy are reduced here, the same way the passes do it
+			for (GLint level = this->readbackLevel + 1; level < this->levels; level++)
+			{
+				this->reduce(level);
+			}
+		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, this->readbackBuffer);
+		glBindTexture(GL_TEXTURE_2D, this->texture);
+		glGetTexImage(GL_TEXTURE_2D, this->readbackLevel, GL_RED, GL_FLOAT, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		this->readbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	// Whether the box from uvMin to uvMax on screen, in [0, 1], with nearest as its
+	// nearest window depth, is behind the read back pyramid. cull.comp does the same
+	// test on the GPU, against every level.
+	bool Occluded(const glm::vec2 &uvMin, const glm::vec2 &uvMax, float nearest) const
+	{
+		if (!this->downloaded)
+		{
+			return false;
+		}
+
+		GLint x0 = std::min((GLint)(uvMin.x * this->width), this->width - 1), y0 = std::min((GLint)(uvMin.y * this->height), this->height - 1);
+		GLint x1 = std::min((GLint)(uvMax.x * this->width), this->width - 1), y1 = std::min((GLint)(uvMax.y * this->height), this->height - 1);
+		GLint level = this->readbackLevel;
+
+		while (level + 1 < this->levels && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+		{
+			level++;
+		}
+
+		const std::vector<float> &texels = this->cpuLevels[level];
+		GLsizei levelWidth = this->LevelWidth(level), levelHeight = this->LevelHeight(level);
+		x0 = std::min(x0 >> level, levelWidth - 1);
+		x1 = std::min(x1 >> level, levelWidth - 1);
+		y0 = std::min(y0 >> level, levelHeight - 1);
+		y1 = std::min(y1 >> level, levelHeight - 1);
+
+		float farthest = std::max(std::max(texels[y0 * levelWidth + x0], texels[y0 * levelWidth + x1]),
+			std::max(texels[y1 * levelWidth + x0], texels[y1 * levelWidth + x1]));
+
+		return nearest > farthest;
+	}
+
+	GLuint Texture() const
+	{
+		return this->texture;
+	}
+
+	GLsizei Width() const
+	{
+		return this->width;
+	}
+
+	GLsizei Height() const
+	{
+		return this->height;
+	}
+
+	GLint Levels() const
+	{
+		return this->levels;
+	}
+
+	// Mip sizes round down, as GL's do
+	GLsizei LevelWidth(GLint level) const
+	{
+		return std::max(this->width >> level, 1);
+	}
+
+	GLsizei LevelHeight(GLint level) const
+	{
+		return std::max(this->height >> level, 1);
+	}
+
+private:
+	static const GLsizei ReadbackWidth = 64;
+
+	GLsizei width, height;
+	GLint levels;
+	GLTexture texture;
+	GLFramebuffer framebuffer;
+	GLVertexArray vertexArray;
+	Shader shader;
+	GLint sourceLocation, firstLocation;
+	GLint readbackLevel;
+	GLBuffer readbackBuffer;
+	GLsync readbackFence;
+	bool downloaded;
+	std::vector<std::vector<float> > cpuLevels;		// only from readbackLevel on
+
+	// Builds a CPU level from the one above it, folding in the last row and column of
+	// an odd sized level like depthPyramid.frag
+	void reduce(GLint level)
+	{
+		const std::vector<float> &source = this->cpuLevels[level - 1];
+		std::vector<float> &destination = this->cpuLevels[level];
+		GLsizei sourceWidth = this->LevelWidth(level - 1), sourceHeight = this->LevelHeight(level - 1);
+		GLsizei levelWidth = this->LevelWidth(level), levelHeight = this->LevelHeight(level);
+
+		for (GLsizei y = 0; y < levelHeight; y++)
+		{
+			for (GLsizei x = 0; x < levelWidth; x++)
+			{
+				GLsizei right = (x * 2 + 2 == sourceWidth - 1) ? 2 : 1, bottom = (y * 2 + 2 == sourceHeight - 1) ? 2 : 1;
+				float farthest = 0.0f;
+
+				for (GLsizei j = 0; j <= bottom; j++)
+				{
+					for (GLsizei i = 0; i <= right; i++)
+					{
+						GLsizei sx = std::min(x * 2 + i, sourceWidth - 1), sy = std::min(y * 2 + j, sourceHeight - 1);
+						farthest = std::max(farthest, source[sy * sourceWidth + sx]);
+					}
+				}
+
+				destination[y * levelWidth + x] = farthest;
+			}
+		}
+	}
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <GL/glew.h>
+
+// Owns one OpenGL object, deleting it when the handle goes out of scope or is given
+// another. Handles can be moved but not copied, so every object has exactly one owner
+// and anything holding one (Mesh, Shader, Model) is move-only too. A handle converts
+// to its GLuint name, so it can be passed straight to the GL calls that take one.
+template <typename Traits>
+class GLHandle
+{
+public:
+	GLHandle() : name(0)
+	{
+	}
+
+	// Takes ownership of an object made elsewhere, e.g. a texture TextureLoading returned
+	explicit GLHandle(GLuint name) : name(name)
+	{
+	}
+
+	GLHandle(GLHandle &&other) noexcept : name(other.name)
+	{
+		other.name = 0;
+	}
+
+	GLHandle &operator=(GLHandle &&other) noexcept
+	{
+		if (this != &other)
+		{
+			this->Reset(other.name);
+			other.name = 0;
+		}
+
+		return *this;
+	}
+
+	GLHandle(const GLHandle &) = delete;
+	GLHandle &operator=(const GLHandle &) = delete;
+
+	~GLHandle()
+	{
+		this->Reset();
+	}
+
+	// A new object of the handle's kind
+	static GLHandle Generate()
+	{
+		return GLHandle(Traits::Generate());
+	}
+
+	operator GLuint() const
+	{
+		return this->name;
+	}
+
+	GLuint Get() const
+	{
+		return this->name;
+	}
+
+	// Deletes the object held, if any, and takes name instead
+	void Reset(GLuint name = 0)
+	{
+		if (this->name && this->name != name)
+		{
+			Traits::Delete(this->name);
+		}
+
+		this->name = name;
+	}
+
+	// Gives up ownership without deleting the object
+	GLuint Release()
+	{
+		GLuint released = this->name;
+		this->name = 0;
+		return released;
+	}
+
+private:
+	GLuint name;
+};
+
+struct GLBufferTraits
+{
+	static GLuint Generate() { GLuint name; glGenBuffers(1, &name); return name; }
+	static void Delete(GLuint name) { glDeleteBuffers(1, &name); }
+};
+
+struct GLVertexArrayTraits
+{
+	static GLuint Generate() { GLuint name; glGenVertexArrays(1, &name); return name; }
+	static void Delete(GLuint name) { glDeleteVertexArrays(1, &name); }
+};
+
+struct GLTextureTraits
+{
+	static GLuint Generate() { GLuint name; glGenTextures(1, &name); return name; }
+	static void Delete(GLuint name) { glDeleteTextures(1, &name); }
+};
+
+struct GLFramebufferTraits
+{
+	static GLuint Generate() { GLuint name; glGenFramebuffers(1, &name); return name; }
+	static void Delete(GLuint name) { glDeleteFramebuffers(1, &name); }
+};
+
+struct GLRenderbufferTraits
+{
+	static GLuint Generate() { GLuint name; glGenRenderbuffers(1, &name); return name; }
+	static void Delete(GLuint name) { glDeleteRenderbuffers(1, &name); }
+};
+
+struct GLProgramTraits
+{
+	static GLuint Generate() { return glCreateProgram(); }
+	static void Delete(GLuint name) { glDeleteProgram(name); }
+};
+
+typedef GLHandle<GLBufferTraits> GLBuffer;
+typedef GLHandle<GLVertexArrayTraits> GLVertexArray;
+typedef GLHandle<GLTextureTraits> GLTexture;
+typedef GLHandle<GLFramebufferTraits> GLFramebuffer;
+typedef GLHandle<GLRenderbufferTraits> GLRenderbuffer;
+typedef GLHandle<GLProgramTraits> GLProgram;
@@ -0,0 +1,950 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "shader.h"
+#include "Mesh.h"
+#include "skyboxTexture.h"
+#include "asyncFileReader.h"
+#include "json.h"
+
+using std::cout;
+using std::endl;
+
+// A glTF material as the shaders take it. The PBR factors are all kept, but the
+// lighting is still Blinn-Phong, so only the base colour texture and a shininess
+// worked out from the roughness are used for now.
+struct GltfMaterial
+{
+	vector<Texture> textures;			// baseColorTexture as texture_diffuse, normalTexture as texture_normal
+	glm::vec4 baseColorFactor = glm::vec4(1.0f);
+	float metallicFactor = 1.0f;
+	float roughnessFactor = 1.0f;
+	glm::vec3 emissiveFactor = glm::vec3(0.0f);
+	float shininess = 16.0f;			// the Blinn-Phong exponent closest to roughnessFactor
+	bool doubleSided = false;
+};
+
+// One draw of a glTF mesh, reading its attributes straight out of the buffers the
+// file's buffer views were uploaded into
+struct GltfPrimitive
+{
+	GLVertexArray VAO;
+	GLenum mode = GL_TRIANGLES;
+	GLsizei count = 0;					// indices, or vertices when it isn't indexed
+	GLenum indexType = 0;				// 0 when it isn't indexed
+	size_t indexOffset = 0;				// into its element buffer
+	int material = -1;
+	bool hasNormals = false;
+};
+
+struct GltfNode
+{
+	std::string name;
+	int mesh = -1;
+	std::vector<int> children;
+	glm::mat4 local = glm::mat4(1.0f);	// relative to its parent
+	glm::mat4 world = glm::mat4(1.0f);	// relative to the model
+};
+
+// Loads glTF 2.0 models, .gltf with its .bin files and images or a single .glb.
+// Buffers are mapped (or taken from the mounted pack or reader) and each buffer view
+// a mesh reads is uploaded as it is, one glBufferData straight from the mapping, with
+// the accessors becoming vertex attribute pointers into it. Nothing is copied vertex
+// by vertex. The node hierarchy is kept, and a mesh several nodes use is uploaded
+// once and drawn once for each of them.
+class GltfModel
+{
+public:
+	bool Load(const std::string &path)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		this->directory = path.substr(0, path.find_last_of('/') + 1);
+		this->uploadedBytes = 0;
+
+		std::unique_ptr<FileBytes> file(new FileBytes());
+
+		if (!ReadBytes(path, *file))
+		{
+			cout << "ERROR::GLTF::CANT_READ " << path << endl;
+			return false;
+		}
+
+		// A .glb is a header and then chunks, the JSON and the first buffer
+		const unsigned char *json = file->data;
+		size_t jsonSize = file->size;
+		Bytes binary;
+
+		if (file->size >= 12 && Read32(file->data) == GlbMagic)
+		{
+			uint32_t version = Read32(file->data + 4);
+			size_t length = Read32(file->data + 8);
+			json = NULL;
+
+			for (size_t offset = 12; version == 2 && length <= file->size && offset + 8 <= length;)
+			{
+				size_t chunkLength = Read32(file->data + offset);
+				uint32_t chunkType = Read32(file->data + offset + 4);
+
+				if (chunkLength > length - offset - 8)
+				{
+					break;
+				}
+
+				if (chunkType == GlbJson && !json)
+				{
+					json = file->data + offset + 8;
+					jsonSize = chunkLength;
+				}
+				else if (chunkType == GlbBinary && !binary.data)
+				{
+					binary.data = file->data + offset + 8;
+					binary.size = chunkLength;
+				}
+
+				offset += 8 + ((chunkLength + 3) & ~(size_t)3);
+			}
+
+			if (!json)
+			{
+				cout << "ERROR::GLTF::BAD_GLB " << path << endl;
+				return false;
+			}
+		}
+
+		JsonValue document;
+		std::string error;
+
+		if (!JsonValue::Parse((const char *)json, jsonSize, document, error))
+		{
+			cout << "ERROR::GLTF::BAD_JSON " << path << " " << error << endl;
+			return false;
+		}
+
+		if (document["asset"]["version"].String().compare(0, 2, "2.") != 0)
+		{
+			cout << "ERROR::GLTF::UNSUPPORTED_VERSION " << path << " " << document["asset"]["version"].String() << endl;
+			return false;
+		}
+
+		this->files.clear();
+		this->files.push_back(std::move(file));
+		this->filePaths.assign(1, path);
+
+		if (!this->LoadBuffers(document, binary) || !this->LoadViews(document))
+		{
+			this->Release();
+			return false;
+		}
+
+		this->LoadMaterials(document);
+		this->LoadMeshes(document);
+		this->LoadNodes(document);
+
+		double milliseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+		size_t primitiveCount = 0, uploadedViews = 0;
+
+		for (size_t i = 0; i < this->meshes.size(); i++)
+		{
+			primitiveCount += this->meshes[i].size();
+		}
+
+		for (size_t i = 0; i < this->bufferObjects.size(); i++)
+		{
+			uploadedViews += (this->bufferObjects[i] != 0);
+		}
+
+		cout << "GLTF::" << path << ":: " << this->meshes.size() << " meshes, " << primitiveCount << " primitives, "
+			<< this->nodes.size() << " nodes drawing " << this->instances.size() << " instances, "
+			<< this->uploadedBytes / 1024 << " KB uploaded from " << uploadedViews << " buffer views in "
+			<< milliseconds << " ms" << endl;
+		this->textureMemory.Report(path);
+
+		this->Release();
+		return true;
+	}
+
+	bool IsLoaded() const
+	{
+		return !this->meshes.empty();
+	}
+
+	// Draws every node that has a mesh, model placing the whole model
+	void Draw(const Shader &shader, const glm::mat4 &model) const
+	{
+		GLint shininessLocation = glGetUniformLocation(shader.Program, "material.shininess");
+		GLint yCoCgLocation = glGetUniformLocation(shader.Program, "material.diffuseYCoCg");
+		GLint diffuseLocation = glGetUniformLocation(shader.Program, "texture_diffuse1");
+
+		// Nor are the primitives baked, see Mesh::BakedAttribute
+		glVertexAttrib3f(Mesh::BakedAttribute, -1.0f, -1.0f, 1.0f);
+
+		for (size_t i = 0; i < this->instances.size(); i++)
+		{
+			// The primitives' arrays leave the model matrix attribute disabled, so it's a constant
+			glm::mat4 transform = model * this->instances[i].second;
+
+			for (GLuint c = 0; c < 4; c++)
+			{
+				glVertexAttrib4fv(Mesh::ModelAttribute + c, &transform[c][0]);
+			}
+
+			const std::vector<GltfPrimitive> &primitives = this->meshes[this->instances[i].first];
+
+			for (size_t p = 0; p < primitives.size(); p++)
+			{
+				const GltfPrimitive &primitive = primitives[p];
+				const GltfMaterial *material = (primitive.material >= 0) ? &this->materials[primitive.material] : NULL;
+				const Texture *diffuse = NULL;
+
+				for (size_t t = 0; material && t < material->textures.size() && !diffuse; t++)
+				{
+					diffuse = (material->textures[t].type == "texture_diffuse") ? &material->textures[t] : NULL;
+				}
+
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, diffuse ? diffuse->id : 0);
+				glUniform1i(diffuseLocation, 0);
+				glUniform1i(yCoCgLocation, diffuse && diffuse->yCoCg);
+				glUniform1f(shininessLocation, material ? material->shininess : 16.0f);
+
+				if (!primitive.hasNormals)
+				{
+					glVertexAttrib3f(1, 0.0f, 1.0f, 0.0f);
+				}
+
+				glBindVertexArray(primitive.VAO);
+
+				if (primitive.indexType)
+				{
+					glDrawElements(primitive.mode, primitive.count, primitive.indexType, (GLvoid *)primitive.indexOffset);
+				}
+				else
+				{
+					glDrawArrays(primitive.mode, 0, primitive.count);
+				}
+			}
+		}
+
+		glBindVertexArray(0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	const std::vector<GltfNode> &Nodes() const
+	{
+		return this->nodes;
+	}
+
+	const std::vector<GltfMaterial> &Materials() const
+	{
+		return this->materials;
+	}
+
+	static bool IsGltf(const std::string &path)
+	{
+		size_t dot = path.find_last_of('.');
+		std::string extension = (dot == std::string::npos) ? "" : path.substr(dot + 1);
+
+		for (size_t i = 0; i < extension.size(); i++)
+		{
+			extension[i] = (char)tolower((unsigned char)extension[i]);
+		}
+
+		return extension == "gltf" || extension == "glb";
+	}
+
+private:
+	static const uint32_t GlbMagic = 0x46546C67;	// "glTF"
+	static const uint32_t GlbJson = 0x4E4F534A;		// "JSON"
+	static const uint32_t GlbBinary = 0x004E4942;	// "BIN\0"
+
+	// A file's bytes, pointing into the mounted pack or reader or a mapping of its own
+	struct FileBytes
+	{
+		AssetSlice slice;
+		MappedFile mapped;
+		std::vector<unsigned char> decoded;	// a data: URI's
+		const unsigned char *data = NULL;
+		size_t size = 0;
+	};
+
+	struct Bytes
+	{
+		const unsigned char *data = NULL;
+		size_t size = 0;
+	};
+
+	struct BufferView
+	{
+		Bytes bytes;
+		size_t stride = 0;
+	};
+
+	std::string directory;
+	std::vector<std::vector<GltfPrimitive> > meshes;
+	std::vector<GltfMaterial> materials;
+	std::vector<GltfNode> nodes;
+	std::vector<std::pair<int, glm::mat4> > instances;	// mesh and transform of every node that draws one, by mesh
+	std::vector<GLBuffer> bufferObjects;				// for each buffer view, 0 until a mesh reads it
+	std::vector<GLTexture> textures;					// every texture the materials use
+	TextureMemory textureMemory;
+	size_t uploadedBytes = 0;
+
+	// Only needed while loading
+	std::vector<std::unique_ptr<FileBytes> > files;
+	std::vector<std::string> filePaths;
+	std::vector<Bytes> buffers;
+	std::vector<BufferView> views;
+	std::map<std::pair<int, TextureRole>, Texture> imageTextures;
+
+	// Lets go of the files, which were only needed until everything was uploaded
+	void Release()
+	{
+		AsyncFileReader *reader = AsyncFileReader::Mounted();
+
+		for (size_t i = 0; reader && i < this->filePaths.size(); i++)
+		{
+			reader->Release(this->filePaths[i]);
+		}
+
+		this->files.clear();
+		this->filePaths.clear();
+		this->buffers.clear();
+		this->views.clear();
+		this->imageTextures.clear();
+	}
+
+	bool LoadBuffers(const JsonValue &document, const Bytes &binary)
+	{
+		const JsonValue &buffers = document["buffers"];
+		this->buffers.assign(buffers.Size(), Bytes());
+
+		for (size_t i = 0; i < buffers.Size(); i++)
+		{
+			const JsonValue &buffer = buffers[i];
+			size_t length = (size_t)buffer["byteLength"].Number();
+			Bytes &bytes = this->buffers[i];
+
+			if (!buffer.Has("uri"))
+			{
+				// The .glb's own binary chunk, which may be padded past byteLength
+				bytes = binary;
+			}
+			else
+			{
+				std::unique_ptr<FileBytes> file(new FileBytes());
+				const std::string &uri = buffer["uri"].String();
+
+				if (uri.compare(0, 5, "data:") == 0)
+				{
+					size_t comma = uri.find(',');
+
+					if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos ||
+						!DecodeBase64(uri.c_str() + comma + 1, file->decoded))
+					{
+						cout << "ERROR::GLTF::BAD_DATA_URI buffer " << i << endl;
+						return false;
+					}
+
+					file->data = file->decoded.data();
+					file->size = file->decoded.size();
+				}
+				else if (ReadBytes(this->directory + DecodeUri(uri), *file))
+				{
+					this->filePaths.push_back(this->directory + DecodeUri(uri));
+				}
+				else
+				{
+					cout << "ERROR::GLTF::CANT_READ " << this->directory + DecodeUri(uri) << endl;
+					return false;
+				}
+
+				bytes.data = file->data;
+				bytes.size = file->size;
+				this->files.push_back(std::move(file));
+			}
+
+			if (!bytes.data || bytes.size < length)
+			{
+				cout << "ERROR::GLTF::BUFFER_TOO_SHORT buffer " << i << endl;
+				return false;
+			}
+
+			bytes.size = length;
+		}
+
+		return true;
+	}
+
+	bool LoadViews(const JsonValue &document)
+	{
+		const JsonValue &views = document["bufferViews"];
+		this->views.assign(views.Size(), BufferView());
+		this->bufferObjects.clear();
+		this->bufferObjects.resize(views.Size());
+
+		for (size_t i = 0; i < views.Size(); i++)
+		{
+			const JsonValue &view = views[i];
+			size_t buffer = (size_t)view["buffer"].Int(-1);
+			size_t offset = (size_t)view["byteOffset"].Number();
+			size_t length = (size_t)view["byteLength"].Number();
+
+			if (buffer >= this->buffers.size() || offset > this->buffers[buffer].size || length > this->buffers[buffer].size - offset)
+			{
+				cout << "ERROR::GLTF::BAD_BUFFER_VIEW " << i << endl;
+				return false;
+			}
+
+			this->views[i].bytes.data = this->buffers[buffer].data + offset;
+			this->views[i].bytes.size = length;
+			this->views[i].stride = (size_t)view["byteStride"].Number();
+		}
+
+		return true;
+	}
+
+	// The GL buffer holding a buffer view, uploaded the first time it's asked for
+	GLuint ViewBuffer(size_t view)
+	{
+		if (!this->bufferObjects[view])
+		{
+			this->bufferObjects[view] = GLBuffer::Generate();
+			glBindBuffer(GL_ARRAY_BUFFER, this->bufferObjects[view]);
+			glBufferData(GL_ARRAY_BUFFER, this->views[view].bytes.size, this->views[view].bytes.data, GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			this->uploadedBytes += this->views[view].bytes.size;
+		}
+
+		return this->bufferObjects[view];
+	}
+
+	struct Accessor
+	{
+		size_t view;
+		size_t offset;		// into the view
+		size_t stride;		// 0 for tightly packed
+		GLenum componentType;
+		GLint components;
+		GLboolean normalized;
+		GLsizei count;
+	};
+
+	// Checks an accessor reads only from inside its buffer view
+	bool ReadAccessor(const JsonValue &document, int index, Accessor &accessor) const
+	{
+		const JsonValue &json = document["accessors"][(size_t)index];
+		static const char *types[] = { "SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4" };
+		static const GLint componentCounts[] = { 1, 2, 3, 4, 4, 9, 16 };
+
+		if (!json.IsObject() || !json.Has("bufferView") || json.Has("sparse"))
+		{
+			return false;
+		}
+
+		accessor.view = (size_t)json["bufferView"].Int(-1);
+		accessor.offset = (size_t)json["byteOffset"].Number();
+		accessor.componentType = (GLenum)json["componentType"].Int();
+		accessor.normalized = json["normalized"].Bool() ? GL_TRUE : GL_FALSE;
+		accessor.count = (GLsizei)json["count"].Number();
+		accessor.components = 0;
+
+		for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++)
+		{
+			accessor.components = (json["type"].String() == types[t]) ? componentCounts[t] : accessor.components;
+		}
+
+		size_t componentSize = 0;
+
+		switch (accessor.componentType)
+		{
+		case GL_BYTE:
+		case GL_UNSIGNED_BYTE:
+			componentSize = 1;
+			break;
+		case GL_SHORT:
+		case GL_UNSIGNED_SHORT:
+			componentSize = 2;
+			break;
+		case GL_UNSIGNED_INT:
+		case GL_FLOAT:
+			componentSize = 4;
+			break;
+		}
+
+		if (accessor.view >= this->views.size() || !componentSize || !accessor.components || accessor.count <= 0)
+		{
+			return false;
+		}
+
+		size_t elementSize = componentSize * accessor.components;
+		accessor.stride = this->views[accessor.view].stride;
+		size_t step = accessor.stride ? accessor.stride : elementSize;
+		size_t viewSize = this->views[accessor.view].bytes.size;
+
+		return accessor.offset <= viewSize && (size_t)(accessor.count - 1) * step + elementSize <= viewSize - accessor.offset;
+	}
+
+	// Whether every index an accessor holds names one of vertexCount vertices
+	bool IndicesInRange(const Accessor &indices, GLsizei vertexCount) const
+	{
+		size_t size = (indices.componentType == GL_UNSIGNED_BYTE) ? 1 : (indices.componentType == GL_UNSIGNED_SHORT) ? 2 : 4;
+		size_t step = indices.stride ? indices.stride : size;
+		const unsigned char *data = this->views[indices.view].bytes.data + indices.offset;
+
+		for (GLsizei i = 0; i < indices.count; i++, data += step)
+		{
+			uint32_t index = (size == 1) ? data[0] : 0;
+
+			if (size == 2)
+			{
+				uint16_t shortIndex;
+				memcpy(&shortIndex, data, sizeof(shortIndex));
+				index = shortIndex;
+			}
+			else if (size == 4)
+			{
+				memcpy(&index, data, sizeof(index));
+			}
+
+			if (index >= (uint32_t)vertexCount)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void LoadMeshes(const JsonValue &document)
+	{
+		const JsonValue &meshes = document["meshes"];
+		// glTF's attributes and where the model shaders take them
+		static const char *attributes[] = { "POSITION", "NORMAL", "TEXCOORD_0", "TANGENT" };
+
+		this->meshes.clear();
+		this->meshes.resize(meshes.Size());
+
+		for (size_t m = 0; m < meshes.Size(); m++)
+		{
+			const JsonValue &primitives = meshes[m]["primitives"];
+
+			for (size_t p = 0; p < primitives.Size(); p++)
+			{
+				const JsonValue &json = primitives[p];
+				GltfPrimitive primitive;
+				Accessor position, indices;
+				bool indexed = json.Has("indices");
+
+				if (!this->ReadAccessor(document, json["attributes"]["POSITION"].Int(-1), position) ||
+					(indexed && !this->ReadAccessor(document, json["indices"].Int(-1), indices)))
+				{
+					cout << "ERROR::GLTF::UNSUPPORTED_PRIMITIVE mesh " << m << " primitive " << p << endl;
+					continue;
+				}
+
+				if (indexed && indices.componentType != GL_UNSIGNED_BYTE && indices.componentType != GL_UNSIGNED_SHORT &&
+					indices.componentType != GL_UNSIGNED_INT)
+				{
+					cout << "ERROR::GLTF::INDICES_NOT_INTEGERS mesh " << m << " primitive " << p << endl;
+					continue;
+				}
+
+				// Every attribute is read as far as the positions go, and the indices can't go further
+				Accessor accessors[sizeof(attributes) / sizeof(attributes[0])];
+				bool present[sizeof(attributes) / sizeof(attributes[0])];
+				bool tooShort = false;
+
+				for (GLuint location = 0; location < sizeof(attributes) / sizeof(attributes[0]); location++)
+				{
+					present[location] = this->ReadAccessor(document, json["attributes"][attributes[location]].Int(-1), accessors[location]);
+					tooShort = tooShort || (present[location] && accessors[location].count < position.count);
+				}
+
+				if (tooShort)
+				{
+					cout << "ERROR::GLTF::ATTRIBUTE_SHORTER_THAN_POSITION mesh " << m << " primitive " << p << endl;
+					continue;
+				}
+
+				if (indexed && !this->IndicesInRange(indices, position.count))
+				{
+					cout << "ERROR::GLTF::INDEX_OUT_OF_RANGE mesh " << m << " primitive " << p << endl;
+					continue;
+				}
+
+				primitive.mode = (GLenum)json["mode"].Int(GL_TRIANGLES);
+				primitive.material = json["material"].Int(-1);
+				primitive.material = (primitive.material < (int)this->materials.size()) ? primitive.material : -1;
+				primitive.count = position.count;
+
+				primitive.VAO = GLVertexArray::Generate();
+				glBindVertexArray(primitive.VAO);
+
+				for (GLuint location = 0; location < sizeof(attributes) / sizeof(attributes[0]); location++)
+				{
+					if (!present[location])
+					{
+						continue;
+					}
+
+					const Accessor &accessor = accessors[location];
+					glBindBuffer(GL_ARRAY_BUFFER, this->ViewBuffer(accessor.view));
+					glEnableVertexAttribArray(location);
+					glVertexAttribPointer(location, accessor.components, accessor.componentType, accessor.normalized,
+						(GLsizei)accessor.stride, (GLvoid *)accessor.offset);
+					primitive.hasNormals |= (location == 1);
+				}
+
+				if (indexed)
+				{
+					glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->ViewBuffer(indices.view));
+					primitive.indexType = indices.componentType;
+					primitive.indexOffset = indices.offset;
+					primitive.count = indices.count;
+				}
+
+				glBindVertexArray(0);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+				this->meshes[m].push_back(std::move(primitive));
+			}
+		}
+	}
+
+	void LoadMaterials(const JsonValue &document)
+	{
+		const JsonValue &materials = document["materials"];
+		this->materials.assign(materials.Size(), GltfMaterial());
+
+		for (size_t i = 0; i < materials.Size(); i++)
+		{
+			const JsonValue &json = materials[i];
+			const JsonValue &pbr = json["pbrMetallicRoughness"];
+			GltfMaterial &material = this->materials[i];
+
+			for (int c = 0; c < 4; c++)
+			{
+				material.baseColorFactor[c] = (float)pbr["baseColorFactor"][c].Number(1.0);
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				material.emissiveFactor[c] = (float)json["emissiveFactor"][c].Number(0.0);
+			}
+
+			material.metallicFactor = (float)pbr["metallicFactor"].Number(1.0);
+			material.roughnessFactor = (float)pbr["roughnessFactor"].Number(1.0);
+			material.doubleSided = json["doubleSided"].Bool();
+
+			// Blinn-Phong exponent for a GGX alpha of roughness squared
+			float alpha = material.roughnessFactor * material.roughnessFactor;
+			material.shininess = glm::clamp(2.0f / glm::max(alpha * alpha, 1e-4f) - 2.0f, 1.0f, 256.0f);
+
+			if (pbr.Has("baseColorTexture"))
+			{
+				this->AddTexture(document, pbr["baseColorTexture"]["index"].Int(-1), TEXTURE_ROLE_DIFFUSE, "texture_diffuse", material);
+			}
+
+			if (json.Has("normalTexture"))
+			{
+				this->AddTexture(document, json["normalTexture"]["index"].Int(-1), TEXTURE_ROLE_NORMAL, "texture_normal", material);
+			}
+		}
+	}
+
+	void AddTexture(const JsonValue &document, int index, TextureRole role, const char *type, GltfMaterial &material)
+	{
+		const JsonValue &texture = document["textures"][(size_t)index];
+		int image = texture["source"].Int(-1);
+		std::map<std::pair<int, TextureRole>, Texture>::iterator loaded = this->imageTextures.find(std::make_pair(image, role));
+
+		if (loaded != this->imageTextures.end())
+		{
+			material.textures.push_back(loaded->second);
+			material.textures.back().type = type;
+			return;
+		}
+
+		const JsonValue &json = document["images"][(size_t)image];
+		Texture result;
+		result.type = type;
+		result.id = 0;
+
+		if (json.Has("uri") && json["uri"].String().compare(0, 5, "data:") != 0)
+		{
+			std::string path = this->directory + DecodeUri(json["uri"].String());
+			result.path.Set(json["uri"].String());
+			result.id = TextureLoading::LoadTexture(path.c_str(), role, &this->textureMemory, &result.yCoCg);
+		}
+		else
+		{
+			// Embedded in a buffer view or a data: URI, decoded from memory under a made up
+			// name whose extension says what it is
+			AssetSlice slice;
+			std::string name = "image" + std::to_string((long long)image);
+			std::string mimeType = json["mimeType"].String();
+
+			if (json.Has("bufferView") && (size_t)json["bufferView"].Int(-1) < this->views.size())
+			{
+				const Bytes &bytes = this->views[json["bufferView"].Int()].bytes;
+				slice.data = bytes.data;
+				slice.size = bytes.size;
+			}
+			else if (json.Has("uri"))
+			{
+				const std::string &uri = json["uri"].String();
+				size_t comma = uri.find(',');
+				mimeType = uri.substr(5, uri.find_first_of(";,") - 5);
+
+				if (comma != std::string::npos && DecodeBase64(uri.c_str() + comma + 1, slice.decoded))
+				{
+					slice.data = slice.decoded.data();
+					slice.size = slice.decoded.size();
+				}
+			}
+
+			name += (mimeType == "image/png") ? ".png" : (mimeType == "image/jpeg") ? ".jpg" : "";
+			result.path.Set(name);
+
+			if (slice.data)
+			{
+				result.id = TextureLoading::LoadTexture((this->directory + name).c_str(), role, &this->textureMemory, &result.yCoCg, &slice);
+			}
+		}
+
+		if (!result.id)
+		{
+			cout << "ERROR::GLTF::TEXTURE_FAILED image " << image << endl;
+			return;
+		}
+
+		this->ApplySampler(document["samplers"][(size_t)texture["sampler"].Int(-1)], result.id);
+		this->textures.push_back(GLTexture(result.id));
+		this->imageTextures[std::make_pair(image, role)] = result;
+		material.textures.push_back(result);
+	}
+
+	// Wrap modes and filters from a glTF sampler, the loader's defaults where it has none
+	void ApplySampler(const JsonValue &sampler, GLuint texture) const
+	{
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler["wrapS"].Int(GL_REPEAT));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler["wrapT"].Int(GL_REPEAT));
+
+		if (sampler.Has("magFilter"))
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler["magFilter"].Int());
+		}
+
+		if (sampler.Has("minFilter"))
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler["minFilter"].Int());
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void LoadNodes(const JsonValue &document)
+	{
+		const JsonValue &nodes = document["nodes"];
+		this->nodes.assign(nodes.Size(), GltfNode());
+
+		for (size_t i = 0; i < nodes.Size(); i++)
+		{
+			const JsonValue &json = nodes[i];
+			GltfNode &node = this->nodes[i];
+			node.name = json["name"].String();
+			node.mesh = json["mesh"].Int(-1);
+			node.mesh = (node.mesh < (int)this->meshes.size()) ? node.mesh : -1;
+
+			for (size_t c = 0; c < json["children"].Size(); c++)
+			{
+				int child = json["children"][c].Int(-1);
+
+				if (child >= 0 && child < (int)nodes.Size())
+				{
+					node.children.push_back(child);
+				}
+			}
+
+			if (json.Has("matrix"))
+			{
+				float matrix[16];
+
+				for (int e = 0; e < 16; e++)
+				{
+					matrix[e] = (float)json["matrix"][e].Number((e % 5 == 0) ? 1.0 : 0.0);
+				}
+
+				node.local = glm::make_mat4(matrix);
+			}
+			else
+			{
+				const JsonValue &t = json["translation"], &r = json["rotation"], &s = json["scale"];
+				glm::quat rotation((float)r[3].Number(1.0), (float)r[0].Number(), (float)r[1].Number(), (float)r[2].Number());
+
+				node.local = glm::translate(glm::mat4(1.0f), glm::vec3((float)t[0].Number(), (float)t[1].Number(), (float)t[2].Number())) *
+					glm::mat4_cast(rotation) *
+					glm::scale(glm::mat4(1.0f), glm::vec3((float)s[0].Number(1.0), (float)s[1].Number(1.0), (float)s[2].Number(1.0)));
+			}
+		}
+
+		// The default scene's roots, or every node nothing has as a child when there are no scenes
+		std::vector<int> roots;
+		const JsonValue &scene = document["scenes"][(size_t)document["scene"].Int(0)];
+
+		if (scene.IsObject())
+		{
+			for (size_t i = 0; i < scene["nodes"].Size(); i++)
+			{
+				roots.push_back(scene["nodes"][i].Int(-1));
+			}
+		}
+		else
+		{
+			std::vector<bool> isChild(this->nodes.size(), false);
+
+			for (size_t i = 0; i < this->nodes.size(); i++)
+			{
+				for (size_t c = 0; c < this->nodes[i].children.size(); c++)
+				{
+					isChild[this->nodes[i].children[c]] = true;
+				}
+			}
+
+			for (size_t i = 0; i < this->nodes.size(); i++)
+			{
+				if (!isChild[i])
+				{
+					roots.push_back((int)i);
+				}
+			}
+		}
+
+		// Walk down from the roots, a node reached twice (a broken file) is only placed once
+		std::vector<bool> placed(this->nodes.size(), false);
+		std::vector<std::pair<int, glm::mat4> > stack;
+		this->instances.clear();
+
+		for (size_t i = roots.size(); i-- > 0;)
+		{
+			stack.push_back(std::make_pair(roots[i], glm::mat4(1.0f)));
+		}
+
+		while (!stack.empty())
+		{
+			int index = stack.back().first;
+			glm::mat4 parent = stack.back().second;
+			stack.pop_back();
+
+			if (index < 0 || index >= (int)this->nodes.size() || placed[index])
+			{
+				continue;
+			}
+
+			GltfNode &node = this->nodes[index];
+			placed[index] = true;
+			node.world = parent * node.local;
+
+			if (node.mesh >= 0)
+			{
+				this->instances.push_back(std::make_pair(node.mesh, node.world));
+			}
+
+			for (size_t c = node.children.size(); c-- > 0;)
+			{
+				stack.push_back(std::make_pair(node.children[c], node.world));
+			}
+		}
+
+		// Draws of the same mesh next to each other
+		std::stable_sort(this->instances.begin(), this->instances.end(),
+			[](const std::pair<int, glm::mat4> &a, const std::pair<int, glm::mat4> &b) { return a.first < b.first; });
+	}
+
+	static bool ReadBytes(const std::string &path, FileBytes &file)
+	{
+		if (AsyncFileReader::ReadAsset(path, file.slice))
+		{
+			file.data = file.slice.data;
+			file.size = file.slice.size;
+			return true;
+		}
+
+		if (!file.mapped.Open(path))
+		{
+			return false;
+		}
+
+		file.data = file.mapped.Data();
+		file.size = file.mapped.Size();
+		return true;
+	}
+
+	static uint32_t Read32(const unsigned char *bytes)
+	{
+		return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+	}
+
+	// Undoes the %XX escapes of a relative URI
+	static std::string DecodeUri(const std::string &uri)
+	{
+		std::string path;
+
+		for (size_t i = 0; i < uri.size(); i++)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2]))
+			{
+				path += (char)strtol(uri.substr(i + 1, 2).c_str(), NULL, 16);
+				i += 2;
+			}
+			else
+			{
+				path += uri[i];
+			}
+		}
+
+		return path;
+	}
+
+	static bool DecodeBase64(const char *text, std::vector<unsigned char> &bytes)
+	{
+		uint32_t bits = 0;
+		int count = 0;
+		bytes.clear();
+
+		for (; *text && *text != '='; text++)
+		{
+			const char *digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			const char *digit = strchr(digits, *text);
+
+			if (!digit)
+			{
+				return false;
+			}
+
+			bits = (bits << 6) | (uint32_t)(digit - digits);
+			count += 6;
+
+			if (count >= 8)
+			{
+				count -= 8;
+				bytes.push_back((unsigned char)(bits >> count));
+			}
+		}
+
+		return true;
+	}
+};
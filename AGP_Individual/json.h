@@ -0,0 +1,496 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+// A parsed JSON document, as much of JSON as the glTF loader needs. Objects keep their
+// members in the order they were written. Looking up a missing member or element
+// gives a null value, so lookups can be chained without checking each step.
+class JsonValue
+{
+public:
+	enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+	JsonValue() : type(JSON_NULL), number(0.0), boolean(false)
+	{
+	}
+
+	// Parses a whole document, error saying where it went wrong when it returns false
+	static bool Parse(const char *text, size_t size, JsonValue &value, std::string &error)
+	{
+		Parser parser = { text, text + size, 0, "" };
+		value = JsonValue();
+
+		if (!parser.ParseValue(value) || (parser.SkipSpace(), parser.p != parser.end))
+		{
+			error = parser.error.empty() ? "unexpected text" : parser.error;
+			error += " at byte " + std::to_string((long long)(parser.p - text));
+			value = JsonValue();
+			return false;
+		}
+
+		return true;
+	}
+
+	Type GetType() const
+	{
+		return this->type;
+	}
+
+	bool IsNull() const
+	{
+		return this->type == JSON_NULL;
+	}
+
+	bool IsNumber() const
+	{
+		return this->type == JSON_NUMBER;
+	}
+
+	bool IsString() const
+	{
+		return this->type == JSON_STRING;
+	}
+
+	bool IsArray() const
+	{
+		return this->type == JSON_ARRAY;
+	}
+
+	bool IsObject() const
+	{
+		return this->type == JSON_OBJECT;
+	}
+
+	bool Has(const char *key) const
+	{
+		return this->Find(key) != NULL;
+	}
+
+	// Elements of an array or members of an object
+	size_t Size() const
+	{
+		return (this->type == JSON_OBJECT) ? this->members.size() : this->elements.size();
+	}
+
+	const JsonValue &operator[](size_t index) const
+	{
+		return (this->type == JSON_ARRAY && index < this->elements.size()) ? this->elements[index] : Null();
+	}
+
+	// So a literal index like [0] isn't taken for a null key
+	const JsonValue &operator[](int index) const
+	{
+		return (index >= 0) ? (*this)[(size_t)index] : Null();
+	}
+
+	const JsonValue &operator[](const char *key) const
+	{
+		const JsonValue *member = this->Find(key);
+		return member ? *member : Null();
+	}
+
+	double Number(double fallback = 0.0) const
+	{
+		return (this->type == JSON_NUMBER) ? this->number : fallback;
+	}
+
+	int Int(int fallback = 0) const
+	{
+		return (this->type == JSON_NUMBER) ? (int)this->number : fallback;
+	}
+
+	bool Bool(bool fallback = false) const
+	{
+		return (this->type == JSON_BOOL) ? this->boolean : fallback;
+	}
+
+	const std::string &String() const
+	{
+		return this->text;
+	}
+
+	const std::vector<std::pair<std::string, JsonValue> > &Members() const
+	{
+		return this->members;
+	}
+
+private:
+	Type type;
+	double number;
+	bool boolean;
+	std::string text;
+	std::vector<JsonValue> elements;
+	std::vector<std::pair<std::string, JsonValue> > members;
+
+	static const JsonValue &Null()
+	{
+		static const JsonValue null;
+		return null;
+	}
+
+	const JsonValue *Find(const char *key) const
+	{
+		for (size_t i = 0; this->type == JSON_OBJECT && i < this->members.size(); i++)
+		{
+			if (this->members[i].first == key)
+			{
+				return &this->members[i].second;
+			}
+		}
+
+		return NULL;
+	}
+
+	struct Parser
+	{
+		const char *p;
+		const char *end;
+		int depth;
+		std::string error;
+
+		// Deep enough for any glTF file, shallow enough not to run out of stack
+		static const int MaximumDepth = 256;
+
+		void SkipSpace()
+		{
+			while (this->p < this->end && (*this->p == ' ' || *this->p == '\t' || *this->p == '\n' || *this->p == '\r'))
+			{
+				this->p++;
+			}
+		}
+
+		bool Fail(const char *message)
+		{
+			if (this->error.empty())
+			{
+				this->error = message;
+			}
+
+			return false;
+		}
+
+		bool Literal(const char *word)
+		{
+			size_t length = strlen(word);
+
+			if ((size_t)(this->end - this->p) < length || memcmp(this->p, word, length) != 0)
+			{
+				return this->Fail("unknown literal");
+			}
+
+			this->p += length;
+			return true;
+		}
+
+		bool ParseValue(JsonValue &value)
+		{
+			this->SkipSpace();
+
+			if (this->p == this->end)
+			{
+				return this->Fail("unexpected end");
+			}
+
+			switch (*this->p)
+			{
+			case '{':
+				return this->ParseObject(value);
+			case '[':
+				return this->ParseArray(value);
+			case '"':
+				value.type = JSON_STRING;
+				return this->ParseString(value.text);
+			case 't':
+				value.type = JSON_BOOL;
+				value.boolean = true;
+				return this->Literal("true");
+			case 'f':
+				value.type = JSON_BOOL;
+				value.boolean = false;
+				return this->Literal("false");
+			case 'n':
+				value.type = JSON_NULL;
+				return this->Literal("null");
+			default:
+				return this->ParseNumber(value);
+			}
+		}
+
+		bool ParseObject(JsonValue &value)
+		{
+			if (++this->depth > MaximumDepth)
+			{
+				return this->Fail("nested too deeply");
+			}
+
+			value.type = JSON_OBJECT;
+			this->p++;
+			this->SkipSpace();
+
+			if (this->p < this->end && *this->p == '}')
+			{
+				this->p++;
+				this->depth--;
+				return true;
+			}
+
+			while (true)
+			{
+				this->SkipSpace();
+				value.members.push_back(std::make_pair(std::string(), JsonValue()));
+				std::pair<std::string, JsonValue> &member = value.members.back();
+
+				if (this->p == this->end || *this->p != '"' || !this->ParseString(member.first))
+				{
+					return this->Fail("expected a member name");
+				}
+
+				this->SkipSpace();
+
+				if (this->p == this->end || *this->p != ':')
+				{
+					return this->Fail("expected ':'");
+				}
+
+				this->p++;
+
+				if (!this->ParseValue(member.second))
+				{
+					return false;
+				}
+
+				this->SkipSpace();
+
+				if (this->p < this->end && *this->p == ',')
+				{
+					this->p++;
+				}
+				else if (this->p < this->end && *this->p == '}')
+				{
+					this->p++;
+					this->depth--;
+					return true;
+				}
+				else
+				{
+					return this->Fail("expected ',' or '}'");
+				}
+			}
+		}
+
+		bool ParseArray(JsonValue &value)
+		{
+			if (++this->depth > MaximumDepth)
+			{
+				return this->Fail("nested too deeply");
+			}
+
+			value.type = JSON_ARRAY;
+			this->p++;
+			this->SkipSpace();
+
+			if (this->p < this->end && *this->p == ']')
+			{
+				this->p++;
+				this->depth--;
+				return true;
+			}
+
+			while (true)
+			{
+				value.elements.push_back(JsonValue());
+
+				if (!this->ParseValue(value.elements.back()))
+				{
+					return false;
+				}
+
+				this->SkipSpace();
+
+				if (this->p < this->end && *this->p == ',')
+				{
+					this->p++;
+				}
+				else if (this->p < this->end && *this->p == ']')
+				{
+					this->p++;
+					this->depth--;
+					return true;
+				}
+				else
+				{
+					return this->Fail("expected ',' or ']'");
+				}
+			}
+		}
+
+		bool ParseNumber(JsonValue &value)
+		{
+			// strtod wants a terminated string, numbers are short so copy one out
+			const char *start = this->p;
+
+			while (this->p < this->end && *this->p && strchr("+-.0123456789eE", *this->p))
+			{
+				this->p++;
+			}
+
+			if (this->p == start || this->p - start > 64)
+			{
+				return this->Fail("bad number");
+			}
+
+			char digits[65];
+			char *stop;
+			memcpy(digits, start, this->p - start);
+			digits[this->p - start] = '\0';
+
+			value.type = JSON_NUMBER;
+			value.number = strtod(digits, &stop);
+
+			if (*stop != '\0')
+			{
+				this->p = start + (stop - digits);
+				return this->Fail("bad number");
+			}
+
+			return true;
+		}
+
+		bool ParseString(std::string &text)
+		{
+			this->p++;
+
+			while (this->p < this->end && *this->p != '"')
+			{
+				if (*this->p != '\\')
+				{
+					text += *this->p++;
+					continue;
+				}
+
+				if (++this->p == this->end)
+				{
+					break;
+				}
+
+				char escaped = *this->p++;
+
+				switch (escaped)
+				{
+				case 'b': text += '\b'; break;
+				case 'f': text += '\f'; break;
+				case 'n': text += '\n'; break;
+				case 'r': text += '\r'; break;
+				case 't': text += '\t'; break;
+				case 'u':
+				{
+					uint32_t code;
+
+					if (!this->ParseHex(code))
+					{
+						return false;
+					}
+
+					// A surrogate pair makes one code point, half of one on its own isn't one
+					if (code >= 0xD800 && code < 0xDC00)
+					{
+						uint32_t low;
+
+						if (this->end - this->p < 6 || this->p[0] != '\\' || this->p[1] != 'u')
+						{
+							return this->Fail("bad escape");
+						}
+
+						this->p += 2;
+
+						if (!this->ParseHex(low))
+						{
+							return false;
+						}
+
+						if (low < 0xDC00 || low > 0xDFFF)
+						{
+							return this->Fail("bad escape");
+						}
+
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					else if (code >= 0xDC00 && code <= 0xDFFF)
+					{
+						return this->Fail("bad escape");
+					}
+
+					AppendUtf8(text, code);
+					break;
+				}
+				default:
+					text += escaped;
+					break;
+				}
+			}
+
+			if (this->p == this->end)
+			{
+				return this->Fail("unterminated string");
+			}
+
+			this->p++;
+			return true;
+		}
+
+		bool ParseHex(uint32_t &code)
+		{
+			if (this->end - this->p < 4)
+			{
+				return this->Fail("bad escape");
+			}
+
+			code = 0;
+
+			for (int i = 0; i < 4; i++, this->p++)
+			{
+				char c = *this->p;
+				int digit = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+
+				if (digit < 0)
+				{
+					return this->Fail("bad escape");
+				}
+
+				code = code * 16 + digit;
+			}
+
+			return true;
+		}
+
+		static void AppendUtf8(std::string &text, uint32_t code)
+		{
+			if (code < 0x80)
+			{
+				text += (char)code;
+			}
+			else if (code < 0x800)
+			{
+				text += (char)(0xC0 | (code >> 6));
+				text += (char)(0x80 | (code & 0x3F));
+			}
+			else if (code < 0x10000)
+			{
+				text += (char)(0xE0 | (code >> 12));
+				text += (char)(0x80 | ((code >> 6) & 0x3F));
+				text += (char)(0x80 | (code & 0x3F));
+			}
+			else
+			{
+				text += (char)(0xF0 | (code >> 18));
+				text += (char)(0x80 | ((code >> 12) & 0x3F));
+				text += (char)(0x80 | ((code >> 6) & 0x3F));
+				text += (char)(0x80 | (code & 0x3F));
+			}
+		}
+	};
+};
@@ -0,0 +1,606 @@
+#pragma once
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "lightmapCharts.h"
+#include "triangleBvh.h"
+
+// A light that never moves, lit the way modelShader lights its directional and point
+// lights, minus the specular, which depends on where it's seen from
+struct BakeLight
+{
+	bool directional;
+	glm::vec3 position;			// point lights
+	glm::vec3 direction;		// directional lights, the way the light travels
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	float constant, linear, quadratic;
+
+	static BakeLight Directional(const glm::vec3 &direction, const glm::vec3 &ambient, const glm::vec3 &diffuse)
+	{
+		BakeLight light = { true, glm::vec3(0.0f), direction, ambient, diffuse, 1.0f, 0.0f, 0.0f };
+		return light;
+	}
+
+	static BakeLight Point(const glm::vec3 &position, const glm::vec3 &ambient, const glm::vec3 &diffuse, float constant, float linear, float quadratic)
+	{
+		BakeLight light = { false, position, glm::vec3(0.0f), ambient, diffuse, constant, linear, quadratic };
+		return light;
+	}
+};
+
+// Path traces the static lights through the static scene, on every core, against the
+// meshes' BVHs. A lightmap mesh gets each texel's light: the diffuse of every light
+// it can see, their ambient darkened by ambient occlusion, and one bounce off the
+// scene. A vertex of a mesh that moves gets its ambient occlusion, to darken the
+// ambient its lights still give it live.
+//
+// The lightmap holds light, not colour: the shader multiplies it by the diffuse map.
+// Every texel and vertex has its own random numbers, seeded by its index, so a bake
+// comes out the same however many threads do it.
+class LightBaker
+{
+public:
+	static const size_t ChunkSize = 64;			// texels or vertices a thread takes at a time
+
+	// samples hemisphere rays a texel or vertex, rounded up to a packet; occlusion
+	// counts hits closer than occlusionRadius; threadCount 0 for one a core
+	LightBaker(unsigned samples = 64, float occlusionRadius = 1.0f, unsigned threadCount = 0)
+		: samples((samples + TriangleBvh::PacketSize - 1) / TriangleBvh::PacketSize * TriangleBvh::PacketSize),
+		occlusionRadius(occlusionRadius), threadCount(threadCount), boundsMin(FLT_MAX), boundsMax(-FLT_MAX), bias(1e-4f),
+		texelCount(0), vertexCount(0), rayCount(0), milliseconds(0.0)
+	{
+		if (this->threadCount == 0)
+		{
+			this->threadCount = std::thread::hardware_concurrency();
+			this->threadCount = this->threadCount ? this->threadCount : 1;
+		}
+
+		if (this->samples == 0)
+		{
+			this->samples = TriangleBvh::PacketSize;
+		}
+	}
+
+	// Something that casts shadows and bounces light, placed by transform. The mesh's
+	// BVH is used where it is, so the mesh has to outlive the baker.
+	void AddOccluder(const Mesh &mesh, const glm::mat4 &transform)
+	{
+		Occluder occluder;
+		occluder.bvh = &mesh.Bvh();
+		occluder.objectFromWorld = glm::inverse(transform);
+		occluder.normalMatrix = glm::transpose(occluder.objectFromWorld);
+		this->occluders.push_back(occluder);
+
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 local((corner & 1) ? mesh.BoundsMax().x : mesh.BoundsMin().x, (corner & 2) ? mesh.BoundsMax().y : mesh.BoundsMin().y,
+				(corner & 4) ? mesh.BoundsMax().z : mesh.BoundsMin().z);
+			glm::vec3 world(transform * glm::vec4(local, 1.0f));
+			this->boundsMin = glm::min(this->boundsMin, world);
+			this->boundsMax = glm::max(this->boundsMax, world);
+		}
+
+		// Rays start this far off a surface so they don't hit it again
+		this->bias = std::max(glm::length(this->boundsMax - this->boundsMin) * 1e-4f, 1e-4f);
+	}
+
+	void AddLight(const BakeLight &light)
+	{
+		this->lights.push_back(light);
+	}
+
+	// The light of each of resolution * resolution texels of a mesh placed by transform,
+	// laid out by its lightmap coordinates. The mesh needs its vertices in memory.
+	std::vector<glm::vec3> BakeLightmap(const Mesh &mesh, const glm::mat4 &transform, GLsizei resolution)
+	{
+		const std::vector<glm::vec2> &coords = mesh.LightmapCoords();
+
+		if (mesh.vertices.empty() || coords.size() != mesh.vertices.size() || resolution <= 0)
+		{
+			cout << "ERROR::BAKER::NO_LIGHTMAP_COORDS" << endl;
+			return std::vector<glm::vec3>();
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::vector<Texel> texels((size_t)resolution * resolution);
+		this->rasterise(mesh, transform, resolution, texels);
+
+		std::vector<glm::vec3> light(texels.size(), glm::vec3(0.0f));
+		std::atomic<uint64_t> rays(0);
+
+		this->parallel(texels.size(), [&](size_t i)
+		{
+			const Texel &texel = texels[i];
+			uint64_t texelRays = 0;
+
+			if (texel.covered)
+			{
+				Random random(i);
+				float occlusion;
+				glm::vec3 bounce = this->gather(texel.position, texel.geometricNormal, texel.normal, random, occlusion, texelRays);
+				light[i] = this->direct(texel.position, texel.geometricNormal, texel.normal, texelRays) + this->ambient(texel.position) * occlusion + bounce;
+			}
+
+			rays += texelRays;
+		});
+
+		dilate(texels, light, resolution);
+
+		this->texelCount += texels.size();
+		this->rayCount += rays;
+		this->milliseconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+		return light;
+	}
+
+	// Ambient occlusion at each vertex of a mesh placed by transform, 1 where nothing is
+	// within occlusionRadius. The mesh needs its vertices in memory.
+	std::vector<float> BakeOcclusion(const Mesh &mesh, const glm::mat4 &transform)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		glm::mat4 normalMatrix = glm::transpose(glm::inverse(transform));
+		std::vector<float> occlusion(mesh.vertices.size(), 1.0f);
+		std::atomic<uint64_t> rays(0);
+
+		this->parallel(mesh.vertices.size(), [&](size_t i)
+		{
+			glm::vec3 position(transform * glm::vec4(mesh.vertices[i].Position, 1.0f));
+			glm::vec3 normal(normalMatrix * glm::vec4(mesh.vertices[i].Normal, 0.0f));
+
+			if (glm::length(normal) > 0.0f)
+			{
+				Random random(i);
+				normal = glm::normalize(normal);
+				occlusion[i] = this->occlusion(position, normal, random);
+				rays += this->samples;
+			}
+		});
+
+		this->vertexCount += mesh.vertices.size();
+		this->rayCount += rays;
+		this->milliseconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+		return occlusion;
+	}
+
+	// Prints what has been baked so far
+	void Report(const std::string &name) const
+	{
+		cout << "BAKER::" << name << ":: " << this->texelCount << " texels, " << this->vertexCount << " vertices, " << this->rayCount
+			<< " rays in " << this->milliseconds << " ms on " << this->threadCount << " threads" << endl;
+	}
+
+private:
+	struct Occluder
+	{
+		const TriangleBvh *bvh;
+		glm::mat4 objectFromWorld;
+		glm::mat4 normalMatrix;		// takes the BVH's normals into the world
+	};
+
+	// Where a texel centre lands on the mesh, in the world
+	struct Texel
+	{
+		bool covered;
+		glm::vec3 position;
+		glm::vec3 normal;			// interpolated from the vertices
+		glm::vec3 geometricNormal;	// the triangle's, which rays are pushed off along
+	};
+
+	// A small xorshift generator, one a texel or vertex
+	struct Random
+	{
+		uint64_t state;
+
+		explicit Random(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 0x2545F4914F6CDD1Dull)
+		{
+			this->Next();
+		}
+
+		uint64_t Next()
+		{
+			this->state ^= this->state >> 12;
+			this->state ^= this->state << 25;
+			this->state ^= this->state >> 27;
+			return this->state * 0x2545F4914F6CDD1Dull;
+		}
+
+		// In [0, 1)
+		float Float()
+		{
+			return (float)(this->Next() >> 40) / 16777216.0f;
+		}
+	};
+
+	std::vector<Occluder> occluders;
+	std::vector<BakeLight> lights;
+	unsigned samples;
+	float occlusionRadius;
+	unsigned threadCount;
+	glm::vec3 boundsMin, boundsMax;
+	float bias;
+	size_t texelCount, vertexCount;
+	uint64_t rayCount;
+	double milliseconds;
+
+	// What fraction of the light at a hit goes on, the same for every surface
+	static float bounceAlbedo()
+	{
+		return 0.5f;
+	}
+
+	// Runs job(i) for every i below count on the baker's threads, a chunk at a time
+	template <class Job>
+	void parallel(size_t count, const Job &job) const
+	{
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> workers;
+		size_t chunks = (count + ChunkSize - 1) / ChunkSize;
+		unsigned threadCount = (this->threadCount < chunks) ? this->threadCount : (unsigned)chunks;
+
+		for (unsigned t = 0; t < threadCount; t++)
+		{
+			workers.push_back(std::thread([&]()
+			{
+				size_t first;
+
+				while ((first = (next++) * ChunkSize) < count)
+				{
+					for (size_t i = first; i < first + ChunkSize && i < count; i++)
+					{
+						job(i);
+					}
+				}
+			}));
+		}
+
+		for (size_t t = 0; t < workers.size(); t++)
+		{
+			workers[t].join();
+		}
+	}
+
+	// Finds the texels whose centres fall in each triangle of the lightmap
+	static void rasterise(const Mesh &mesh, const glm::mat4 &transform, GLsizei resolution, std::vector<Texel> &texels)
+	{
+		const std::vector<glm::vec2> &coords = mesh.LightmapCoords();
+		glm::mat4 normalMatrix = glm::transpose(glm::inverse(transform));
+
+		for (size_t i = 0; i < texels.size(); i++)
+		{
+			texels[i].covered = false;
+		}
+
+		for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+		{
+			const Vertex *v[3] = { &mesh.vertices[mesh.indices[t]], &mesh.vertices[mesh.indices[t + 1]], &mesh.vertices[mesh.indices[t + 2]] };
+			glm::vec2 p[3];
+
+			for (int c = 0; c < 3; c++)
+			{
+				p[c] = glm::vec2(coords[mesh.indices[t + c]].x * resolution, coords[mesh.indices[t + c]].y * resolution);
+			}
+
+			float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+
+			if (std::fabs(area) < 1e-12f)
+			{
+				continue;
+			}
+
+			glm::vec3 geometricNormal(normalMatrix * glm::vec4(glm::cross(v[1]->Position - v[0]->Position, v[2]->Position - v[0]->Position), 0.0f));
+
+			if (glm::length(geometricNormal) <= 0.0f)
+			{
+				continue;
+			}
+
+			geometricNormal = glm::normalize(geometricNormal);
+
+			GLsizei x0 = std::max((GLsizei)std::floor(std::min(p[0].x, std::min(p[1].x, p[2].x))), 0);
+			GLsizei y0 = std::max((GLsizei)std::floor(std::min(p[0].y, std::min(p[1].y, p[2].y))), 0);
+			GLsizei x1 = std::min((GLsizei)std::ceil(std::max(p[0].x, std::max(p[1].x, p[2].x))), resolution - 1);
+			GLsizei y1 = std::min((GLsizei)std::ceil(std::max(p[0].y, std::max(p[1].y, p[2].y))), resolution - 1);
+
+			for (GLsizei y = y0; y <= y1; y++)
+			{
+				for (GLsizei x = x0; x <= x1; x++)
+				{
+					// Barycentrics of the texel centre, all three positive inside
+					float cx = x + 0.5f, cy = y + 0.5f;
+					float b1 = ((cx - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (cy - p[0].y)) / area;
+					float b2 = ((p[1].x - p[0].x) * (cy - p[0].y) - (cx - p[0].x) * (p[1].y - p[0].y)) / area;
+					float b0 = 1.0f - b1 - b2;
+
+					if (b0 < 0.0f || b1 < 0.0f || b2 < 0.0f)
+					{
+						continue;
+					}
+
+					Texel &texel = texels[(size_t)y * resolution + x];
+					glm::vec3 position = v[0]->Position * b0 + v[1]->Position * b1 + v[2]->Position * b2;
+					glm::vec3 normal(normalMatrix * glm::vec4(v[0]->Normal * b0 + v[1]->Normal * b1 + v[2]->Normal * b2, 0.0f));
+
+					texel.covered = true;
+					texel.position = glm::vec3(transform * glm::vec4(position, 1.0f));
+					texel.normal = (glm::length(normal) > 0.0f) ? glm::normalize(normal) : geometricNormal;
+
+					// Rays leave on the side the normals face, whichever way the triangle is wound
+					texel.geometricNormal = (glm::dot(geometricNormal, texel.normal) < 0.0f) ? geometricNormal * -1.0f : geometricNormal;
+				}
+			}
+		}
+	}
+
+	// Spreads the light of covered texels into the empty ones around them, so
+	// filtering at a chart's edge never reads black
+	static void dilate(std::vector<Texel> &texels, std::vector<glm::vec3> &light, GLsizei resolution)
+	{
+		for (GLsizei pass = 0; pass < LightmapCharts::Gutter; pass++)
+		{
+			std::vector<Texel> covered(texels);
+			std::vector<glm::vec3> spread(light);
+
+			for (GLsizei y = 0; y < resolution; y++)
+			{
+				for (GLsizei x = 0; x < resolution; x++)
+				{
+					size_t i = (size_t)y * resolution + x;
+
+					if (covered[i].covered)
+					{
+						continue;
+					}
+
+					glm::vec3 sum(0.0f);
+					int count = 0;
+
+					for (GLsizei ny = std::max(y - 1, 0); ny <= std::min(y + 1, resolution - 1); ny++)
+					{
+						for (GLsizei nx = std::max(x - 1, 0); nx <= std::min(x + 1, resolution - 1); nx++)
+						{
+							size_t n = (size_t)ny * resolution + nx;
+
+							if (covered[n].covered)
+							{
+								sum += light[n];
+								count++;
+							}
+						}
+					}
+
+					if (count)
+					{
+						spread[i] = sum / (float)count;
+						texels[i].covered = true;
+					}
+				}
+			}
+
+			light.swap(spread);
+		}
+	}
+
+	// The lights' ambient where it isn't occluded
+	glm::vec3 ambient(const glm::vec3 &position) const
+	{
+		glm::vec3 sum(0.0f);
+
+		for (size_t l = 0; l < this->lights.size(); l++)
+		{
+			sum += this->lights[l].ambient * this->attenuation(this->lights[l], position);
+		}
+
+		return sum;
+	}
+
+	float attenuation(const BakeLight &light, const glm::vec3 &position) const
+	{
+		if (light.directional)
+		{
+			return 1.0f;
+		}
+
+		float distance = glm::length(light.position - position);
+		return 1.0f / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	}
+
+	// The diffuse of every light that can see a point, one shadow ray each
+	glm::vec3 direct(const glm::vec3 &position, const glm::vec3 &geometricNormal, const glm::vec3 &normal, uint64_t &rays) const
+	{
+		glm::vec3 sum(0.0f);
+		glm::vec3 origin = position + geometricNormal * this->bias;
+
+		for (size_t l = 0; l < this->lights.size(); l++)
+		{
+			const BakeLight &light = this->lights[l];
+
+			// To a point light the ray's direction is unnormalised, so it stops just short at t = 1
+			Ray ray = light.directional ? Ray(origin, glm::normalize(light.direction) * -1.0f) : Ray(origin, light.position - origin, 1.0f - 1e-4f);
+			float cosine = glm::dot(normal, glm::normalize(ray.direction));
+
+			if (cosine <= 0.0f)
+			{
+				continue;
+			}
+
+			rays++;
+
+			if (!this->occluded(ray))
+			{
+				sum += light.diffuse * (cosine * this->attenuation(light, position));
+			}
+		}
+
+		return sum;
+	}
+
+	// Casts the hemisphere above a texel, cosine weighted, four rays at a time. Returns
+	// the light bounced back at it, and the fraction of rays that got further than
+	// occlusionRadius in occlusion.
+	glm::vec3 gather(const glm::vec3 &position, const glm::vec3 &geometricNormal, const glm::vec3 &normal, Random &random, float &occlusion, uint64_t &rays) const
+	{
+		glm::vec3 tangent, bitangent;
+		basis(normal, tangent, bitangent);
+
+		glm::vec3 bounce(0.0f);
+		GLuint open = 0;
+
+		for (GLuint s = 0; s < this->samples; s += TriangleBvh::PacketSize)
+		{
+			Ray packet[TriangleBvh::PacketSize];
+			RayHit hits[TriangleBvh::PacketSize];
+			glm::vec3 hitNormals[TriangleBvh::PacketSize];
+
+			for (GLuint lane = 0; lane < TriangleBvh::PacketSize; lane++)
+			{
+				packet[lane] = Ray(position + geometricNormal * this->bias, hemisphere(normal, tangent, bitangent, random));
+			}
+
+			GLuint found = this->intersect(packet, hits, hitNormals);
+			rays += TriangleBvh::PacketSize;
+
+			for (GLuint lane = 0; lane < TriangleBvh::PacketSize; lane++)
+			{
+				if (!(found & (1u << lane)))
+				{
+					open++;
+					continue;
+				}
+
+				if (hits[lane].t >= this->occlusionRadius)
+				{
+					open++;
+				}
+
+				// The hit faces back along the ray, whichever way its triangle was wound
+				glm::vec3 hitPosition = packet[lane].origin + packet[lane].direction * hits[lane].t;
+				glm::vec3 hitNormal = (glm::dot(hitNormals[lane], packet[lane].direction) > 0.0f) ? hitNormals[lane] * -1.0f : hitNormals[lane];
+				bounce += this->direct(hitPosition, hitNormal, hitNormal, rays);
+			}
+		}
+
+		occlusion = (float)open / this->samples;
+		return bounce * (bounceAlbedo() / this->samples);
+	}
+
+	// The fraction of the hemisphere above a vertex open for occlusionRadius
+	float occlusion(const glm::vec3 &position, const glm::vec3 &normal, Random &random) const
+	{
+		glm::vec3 tangent, bitangent;
+		basis(normal, tangent, bitangent);
+		GLuint open = 0;
+
+		for (GLuint s = 0; s < this->samples; s += TriangleBvh::PacketSize)
+		{
+			Ray packet[TriangleBvh::PacketSize];
+
+			for (GLuint lane = 0; lane < TriangleBvh::PacketSize; lane++)
+			{
+				packet[lane] = Ray(position + normal * this->bias, hemisphere(normal, tangent, bitangent, random), this->occlusionRadius);
+			}
+
+			GLuint blocked = 0;
+
+			for (size_t o = 0; o < this->occluders.size() && blocked != (1u << TriangleBvh::PacketSize) - 1; o++)
+			{
+				Ray local[TriangleBvh::PacketSize];
+
+				for (GLuint lane = 0; lane < TriangleBvh::PacketSize; lane++)
+				{
+					local[lane] = packet[lane].Transformed(this->occluders[o].objectFromWorld);
+					local[lane].tMax = (blocked & (1u << lane)) ? 0.0f : packet[lane].tMax;
+				}
+
+				blocked |= this->occluders[o].bvh->OccludedPacket(local);
+			}
+
+			for (GLuint lane = 0; lane < TriangleBvh::PacketSize; lane++)
+			{
+				open += !(blocked & (1u << lane));
+			}
+		}
+
+		return (float)open / this->samples;
+	}
+
+	// The nearest hits of a packet across every occluder, with their normals in the world
+	GLuint intersect(const Ray *packet, RayHit *hits, glm::vec3 *normals) const
+	{
+		Ray local[TriangleBvh::PacketSize];
+		GLuint found = 0;
+
+		for (GLuint lane = 0; lane < TriangleBvh::PacketSize; lane++)
+		{
+			hits[lane].t = packet[lane].tMax;
+		}
+
+		for (size_t o = 0; o < this->occluders.size(); o++)
+		{
+			const Occluder &occluder = this->occluders[o];
+			RayHit occluderHits[TriangleBvh::PacketSize];
+
+			// Each occluder only has to beat the nearest hit so far
+			for (GLuint lane = 0; lane < TriangleBvh::PacketSize; lane++)
+			{
+				local[lane] = packet[lane].Transformed(occluder.objectFromWorld);
+				local[lane].tMax = hits[lane].t;
+			}
+
+			GLuint occluderFound = occluder.bvh->IntersectPacket(local, occluderHits);
+
+			for (GLuint lane = 0; lane < TriangleBvh::PacketSize; lane++)
+			{
+				if (occluderFound & (1u << lane))
+				{
+					hits[lane] = occluderHits[lane];
+					normals[lane] = glm::vec3(occluder.normalMatrix * glm::vec4(occluderHits[lane].normal, 0.0f));
+					normals[lane] = glm::normalize(normals[lane]);
+				}
+			}
+
+			found |= occluderFound;
+		}
+
+		return found;
+	}
+
+	bool occluded(const Ray &ray) const
+	{
+		for (size_t o = 0; o < this->occluders.size(); o++)
+		{
+			if (this->occluders[o].bvh->Occluded(ray.Transformed(this->occluders[o].objectFromWorld)))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Two directions at right angles to normal and each other
+	static void basis(const glm::vec3 &normal, glm::vec3 &tangent, glm::vec3 &bitangent)
+	{
+		glm::vec3 other = (std::fabs(normal.x) < 0.9f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		tangent = glm::normalize(glm::cross(normal, other));
+		bitangent = glm::cross(normal, tangent);
+	}
+
+	// A direction above the surface, more likely the nearer it is to the normal
+	static glm::vec3 hemisphere(const glm::vec3 &normal, const glm::vec3 &tangent, const glm::vec3 &bitangent, Random &random)
+	{
+		float u = random.Float(), angle = 6.28318530718f * random.Float();
+		float radius = std::sqrt(u);
+		return tangent * (radius * std::cos(angle)) + bitangent * (radius * std::sin(angle)) + normal * std::sqrt(1.0f - u);
+	}
+};
@@ -0,0 +1,254 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Second texture coordinates for a mesh, laid out for a lightmap: no two triangles
+// share a texel, and the charts they're grouped into sit apart so bilinear
+// filtering never reads across from one to another.
+//
+// Triangles are grouped by the axis their normal points along most, and a chart is
+// the triangles of one group joined by their edges, projected flat along that axis.
+// A vertex used by more than one chart is split, a copy a chart.
+struct LightmapCharts
+{
+	static const GLsizei Gutter = 2;		// texels left around each chart
+
+	// Lays out the triangles of indices in a square of resolution texels. remap gets the
+	// vertex each new vertex copies, coords their lightmap coordinates, and indices are
+	// rewritten to use them. False, with nothing changed, when the charts can't fit or an
+	// index is past vertexCount.
+	static bool Build(const void *positions, size_t stride, size_t vertexCount, std::vector<GLuint> &indices, GLsizei resolution,
+		std::vector<GLuint> &remap, std::vector<glm::vec2> &coords)
+	{
+		GLuint triangleCount = (GLuint)(indices.size() / 3);
+
+		if (!triangleCount)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < triangleCount * 3; i++)
+		{
+			if (indices[i] >= vertexCount)
+			{
+				return false;
+			}
+		}
+
+		// Which way each triangle faces: +X, -X, +Y, -Y, +Z or -Z
+		std::vector<unsigned char> facing(triangleCount);
+
+		for (GLuint t = 0; t < triangleCount; t++)
+		{
+			glm::vec3 p0 = position(positions, stride, indices[t * 3]);
+			glm::vec3 normal = glm::cross(position(positions, stride, indices[t * 3 + 1]) - p0, position(positions, stride, indices[t * 3 + 2]) - p0);
+			int axis = (std::fabs(normal.x) >= std::fabs(normal.y) && std::fabs(normal.x) >= std::fabs(normal.z)) ? 0 :
+				(std::fabs(normal.y) >= std::fabs(normal.z)) ? 1 : 2;
+			facing[t] = (unsigned char)(axis * 2 + (normal[axis] < 0.0f));
+		}
+
+		// Triangles facing the same way across an edge join one chart
+		std::vector<GLuint> parent(triangleCount);
+
+		for (GLuint t = 0; t < triangleCount; t++)
+		{
+			parent[t] = t;
+		}
+
+		std::vector<std::pair<uint64_t, GLuint> > edges;
+		edges.reserve(triangleCount * 3);
+
+		for (GLuint t = 0; t < triangleCount; t++)
+		{
+			for (GLuint e = 0; e < 3; e++)
+			{
+				uint64_t a = indices[t * 3 + e], b = indices[t * 3 + (e + 1) % 3];
+				edges.push_back(std::make_pair(std::min(a, b) << 32 | std::max(a, b), t));
+			}
+		}
+
+		std::sort(edges.begin(), edges.end());
+
+		for (size_t i = 1; i < edges.size(); i++)
+		{
+			if (edges[i].first == edges[i - 1].first && facing[edges[i].second] == facing[edges[i - 1].second])
+			{
+				parent[find(parent, edges[i].second)] = find(parent, edges[i - 1].second);
+			}
+		}
+
+		// Each chart's box, flattened along the axis its triangles face
+		std::vector<GLuint> chartOf(triangleCount, 0);
+		std::vector<Chart> charts;
+		std::unordered_map<GLuint, GLuint> chartOfRoot;
+
+		for (GLuint t = 0; t < triangleCount; t++)
+		{
+			GLuint root = find(parent, t);
+			std::unordered_map<GLuint, GLuint>::iterator found = chartOfRoot.find(root);
+
+			if (found == chartOfRoot.end())
+			{
+				found = chartOfRoot.insert(std::make_pair(root, (GLuint)charts.size())).first;
+				Chart chart;
+				chart.axis = facing[t] / 2;
+				chart.boundsMin = glm::vec2(FLT_MAX);
+				chart.boundsMax = glm::vec2(-FLT_MAX);
+				charts.push_back(chart);
+			}
+
+			Chart &chart = charts[found->second];
+			chartOf[t] = found->second;
+
+			for (GLuint c = 0; c < 3; c++)
+			{
+				glm::vec2 flat = project(position(positions, stride, indices[t * 3 + c]), chart.axis);
+				chart.boundsMin = glm::vec2(std::min(chart.boundsMin.x, flat.x), std::min(chart.boundsMin.y, flat.y));
+				chart.boundsMax = glm::vec2(std::max(chart.boundsMax.x, flat.x), std::max(chart.boundsMax.y, flat.y));
+			}
+		}
+
+		if (!pack(charts, resolution))
+		{
+			return false;
+		}
+
+		// A vertex for each chart using it, in the order the triangles reach them
+		std::unordered_map<uint64_t, GLuint> split;
+		std::vector<GLuint> newRemap;
+		std::vector<glm::vec2> newCoords;
+		std::vector<GLuint> newIndices(triangleCount * 3);
+
+		for (GLuint i = 0; i < triangleCount * 3; i++)
+		{
+			GLuint chartIndex = chartOf[i / 3];
+			uint64_t key = (uint64_t)chartIndex << 32 | indices[i];
+			std::unordered_map<uint64_t, GLuint>::iterator found = split.find(key);
+
+			if (found == split.end())
+			{
+				const Chart &chart = charts[chartIndex];
+				glm::vec2 flat = project(position(positions, stride, indices[i]), chart.axis);
+				glm::vec2 texel((flat.x - chart.boundsMin.x) * chart.scale + chart.x + Gutter, (flat.y - chart.boundsMin.y) * chart.scale + chart.y + Gutter);
+
+				found = split.insert(std::make_pair(key, (GLuint)newRemap.size())).first;
+				newRemap.push_back(indices[i]);
+				newCoords.push_back(glm::vec2(texel.x / resolution, texel.y / resolution));
+			}
+
+			newIndices[i] = found->second;
+		}
+
+		indices.swap(newIndices);
+		remap.swap(newRemap);
+		coords.swap(newCoords);
+		return true;
+	}
+
+private:
+	struct Chart
+	{
+		int axis;
+		glm::vec2 boundsMin, boundsMax;		// flattened, in the mesh's units
+		float scale;						// texels a unit, the same for every chart
+		GLsizei x, y;						// where its rectangle starts, gutter included
+	};
+
+	static glm::vec3 position(const void *positions, size_t stride, GLuint vertex)
+	{
+		const float *p = (const float *)((const unsigned char *)positions + vertex * stride);
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+
+	static glm::vec2 project(const glm::vec3 &p, int axis)
+	{
+		return glm::vec2(p[(axis + 1) % 3], p[(axis + 2) % 3]);
+	}
+
+	static GLuint find(std::vector<GLuint> &parent, GLuint t)
+	{
+		while (parent[t] != t)
+		{
+			parent[t] = parent[parent[t]];
+			t = parent[t];
+		}
+
+		return t;
+	}
+
+	// The chart's rectangle in texels at scale, gutter included
+	static GLsizei width(const Chart &chart, float scale)
+	{
+		return (GLsizei)std::ceil((chart.boundsMax.x - chart.boundsMin.x) * scale) + 1 + Gutter * 2;
+	}
+
+	static GLsizei height(const Chart &chart, float scale)
+	{
+		return (GLsizei)std::ceil((chart.boundsMax.y - chart.boundsMin.y) * scale) + 1 + Gutter * 2;
+	}
+
+	// Puts the charts on shelves, tallest first, at the largest scale that fits, starting
+	// from the one that would fill the square if the charts had no gutters
+	static bool pack(std::vector<Chart> &charts, GLsizei resolution)
+	{
+		float area = 0.0f;
+
+		for (size_t c = 0; c < charts.size(); c++)
+		{
+			area += (charts[c].boundsMax.x - charts[c].boundsMin.x) * (charts[c].boundsMax.y - charts[c].boundsMin.y);
+		}
+
+		float scale = (area > 0.0f) ? std::sqrt((float)resolution * resolution / area) : (float)resolution;
+		std::vector<GLuint> order(charts.size());
+
+		for (GLuint c = 0; c < order.size(); c++)
+		{
+			order[c] = c;
+		}
+
+		std::sort(order.begin(), order.end(), [&](GLuint a, GLuint b)
+		{
+			return charts[a].boundsMax.y - charts[a].boundsMin.y > charts[b].boundsMax.y - charts[b].boundsMin.y;
+		});
+
+		for (int attempt = 0; attempt < 200 && scale > 0.0f; attempt++, scale *= 0.95f)
+		{
+			GLsizei x = 0, y = 0, shelf = 0;
+			bool fits = true;
+
+			for (size_t i = 0; i < order.size() && fits; i++)
+			{
+				Chart &chart = charts[order[i]];
+				GLsizei w = width(chart, scale), h = height(chart, scale);
+
+				if (x + w > resolution)
+				{
+					x = 0;
+					y += shelf;
+					shelf = 0;
+				}
+
+				fits = x + w <= resolution && y + h <= resolution;
+				chart.scale = scale;
+				chart.x = x;
+				chart.y = y;
+				x += w;
+				shelf = std::max(shelf, h);
+			}
+
+			if (fits)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+};
@@ -5,13 +5,25 @@ B00324366 & B00282889
 */
 
 #include <string>
+#include <cstdlib>
+#include <fstream>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+// Counts what the frames allocate, see AllocationTracker. First, as the other headers include it too.
+#define ALLOCATION_TRACKER_IMPLEMENTATION
+#include "allocationTracker.h"
+
 #include "shader.h"
 #include "camera.h"
 #include "model.h"
 #include "skyboxTexture.h"
+#include "assetCooker.h"
+#include "scratchArena.h"
+#include "streamBuffer.h"
+#include "depthPyramid.h"
+#include "cullingPass.h"
+#include "lightBaker.h"
 
 // GLM Mathemtics
 #include <glm/glm.hpp>
@@ -27,13 +39,17 @@ int screenWidth, screenHeight;
 // Function prototypes
 void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mode);
 void MouseCallback(GLFWwindow *window, double xPos, double yPos);
+void MouseButtonCallback(GLFWwindow *window, int button, int action, int mode);
 void DoMovement();
+vector<const GLchar *> SkyboxFaces();
+int CookAssets(int argc, char **argv);
 
 // Camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 bool keys[1024];
 GLfloat lastX = 400, lastY = 300;
 bool firstMouse = true;
+bool pickRequested = false;
 
 //Light
 glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
@@ -41,7 +57,57 @@ glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 GLfloat deltaTime = 0.0f;
 GLfloat lastFrame = 0.0f;
 
-GLuint initQuadVAO()
+// modelShader's uniform blocks in std140 layout, written into the stream every frame.
+// Each float sits in the gap std140 leaves after the vec3 before it.
+struct CameraBlock
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec3 viewPos;
+	float pad;
+};
+
+struct LightsBlock
+{
+	struct
+	{
+		glm::vec3 direction; float pad0;
+		glm::vec3 ambient; float pad1;
+		glm::vec3 diffuse; float pad2;
+		glm::vec3 specular; float pad3;
+	} dirLight;
+
+	struct
+	{
+		glm::vec3 position; float constant;
+		glm::vec3 ambient; float linear;
+		glm::vec3 diffuse; float quadratic;
+		glm::vec3 specular; float pad;
+	} pointLights[1];
+
+	struct
+	{
+		glm::vec3 position; float cutOff;
+		glm::vec3 direction; float outerCutOff;
+		glm::vec3 ambient; float constant;
+		glm::vec3 diffuse; float linear;
+		glm::vec3 specular; float quadratic;
+	} spotLight;
+};
+
+// Where the blocks are bound
+const GLuint CameraBinding = 0, LightsBinding = 1;
+
+// Terminates GLFW as main returns, after the GL objects declared below it are deleted
+struct GlfwSession
+{
+	~GlfwSession()
+	{
+		glfwTerminate();
+	}
+};
+
+GLVertexArray initQuadVAO(GLBuffer &quadVBO)
 {
 	// Configure VAO/VBO
 	GLfloat vertices[] = {
@@ -56,9 +122,8 @@ GLuint initQuadVAO()
 	};
 
 	// screen quad VAO
-	unsigned int quadVAO, quadVBO;
-	glGenVertexArrays(1, &quadVAO);
-	glGenBuffers(1, &quadVBO);
+	GLVertexArray quadVAO = GLVertexArray::Generate();
+	quadVBO = GLBuffer::Generate();
 	glBindVertexArray(quadVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), &vertices, GL_STATIC_DRAW);
@@ -71,15 +136,21 @@ GLuint initQuadVAO()
 }
 
 
-int main()
+int main(int argc, char **argv)
 {
+	// "--cook" runs the asset cooker instead of the demo, in a hidden window so the
+	// shaders can be compiled
+	bool cook = argc > 1 && std::string(argv[1]) == "--cook";
+
 	// Init GLFW
 	glfwInit();
+	GlfwSession glfwSession;
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, cook ? GL_FALSE : GL_TRUE);
 
 	// Create a GLFWwindow object that we can use for GLFW's functions
 	GLFWwindow *window = glfwCreateWindow(width, height, "AGP Group Project", nullptr, nullptr);
@@ -96,6 +167,7 @@ int main()
 	glfwGetFramebufferSize(window, &screenWidth, &screenHeight);
 	glfwSetKeyCallback(window, KeyCallback);
 	glfwSetCursorPosCallback(window, MouseCallback);
+	glfwSetMouseButtonCallback(window, MouseButtonCallback);
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glewExperimental = GL_TRUE;
 	
@@ -106,18 +178,78 @@ int main()
 		return EXIT_FAILURE;
 	}
 
+	// SOIL and stb_image allocate from the current thread's scratch arena, if it has one
+	ScratchArena::InstallSoilAllocator();
+
+	if (cook)
+	{
+		int result = CookAssets(argc, argv);
+		glfwTerminate();
+
+		return result;
+	}
+
 	// Define the viewport dimensions
 	glViewport(0, 0, screenWidth, screenHeight);
 
 	// OpenGL options
 	glEnable(GL_DEPTH_TEST);
 
+	// Shaders, textures and models come out of assets.pak when there is one,
+	// anything it doesn't have is still read from the loose files
+	AssetPack assetPack;
+	std::ifstream assetPackFile("assets.pak");
+
+	if (assetPackFile.good())
+	{
+		assetPackFile.close();
+
+		if (assetPack.Open("assets.pak"))
+		{
+			AssetPack::Mounted() = &assetPack;
+		}
+	}
+
+	// A cooked build loads what the cooker made instead of the sources
+	AssetManifest assetManifest;
+
+	if (assetManifest.Load("cooked/manifest.txt"))
+	{
+		AssetManifest::Mounted() = &assetManifest;
+	}
+
+	// Everything startup needs from loose files is read in one batch up front, so
+	// the loaders below find it in memory instead of each blocking on its own read
+	AsyncFileReader assetReader;
+	AsyncFileReader::Mounted() = &assetReader;
+
+	const char *startupFiles[] = {
+		"res/shaders/skybox.vs", "res/shaders/skybox.frag",
+		"res/shaders/modelShader.vs", "res/shaders/modelShader.frag",
+		"res/shaders/greyscale-fbo.vert", "res/shaders/greyscale-fbo.frag",
+		"res/shaders/modelLoading.vs", "res/shaders/modelLoading.frag",
+		"res/shaders/depthPyramid.vs", "res/shaders/depthPyramid.frag", "res/shaders/cull.comp",
+		"skybox/sky.hdr", "skybox/rt.tga", "skybox/lf.tga", "skybox/up2.tga",
+		"skybox/dn.tga", "skybox/bk.tga", "skybox/ft.tga",
+		"res/models/nanosuit.obj", "res/models/nanosuit.mtl",
+		"res/models/cube.obj", "res/models/cube.mtl"
+	};
+
+	for (size_t i = 0; i < sizeof(startupFiles) / sizeof(startupFiles[0]); i++)
+	{
+		assetReader.Queue(AssetManifest::ResolveMounted(startupFiles[i]));
+	}
+	assetReader.Submit();
+
 	// Setup and compile our shaders
 	Shader skyboxShader("res/shaders/skybox.vs", "res/shaders/skybox.frag");
 	Shader modelShader("res/shaders/modelShader.vs", "res/shaders/modelShader.frag");
 	Shader greyscaleFilter("res/shaders/greyscale-fbo.vert", "res/shaders/greyscale-fbo.frag");
 	Shader shader("res/shaders/modelLoading.vs", "res/shaders/modelLoading.frag");
 
+	glUniformBlockBinding(modelShader.Program, glGetUniformBlockIndex(modelShader.Program, "Camera"), CameraBinding);
+	glUniformBlockBinding(modelShader.Program, glGetUniformBlockIndex(modelShader.Program, "Lights"), LightsBinding);
+
 	GLfloat skyboxVertices[] = {
 		// Positions
 		-1.0f,  1.0f, -1.0f,
@@ -168,14 +300,12 @@ int main()
 		glm::vec3(0.0f, 0.0f, 2.0f),
 	};
 
-	GLuint VBO;
-	glGenBuffers(1, &VBO);
+	GLBuffer VBO = GLBuffer::Generate();
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
 	// Setup skybox VAO
-	GLuint skyboxVAO, skyboxVBO;
-	glGenVertexArrays(1, &skyboxVAO);
-	glGenBuffers(1, &skyboxVBO);
+	GLVertexArray skyboxVAO = GLVertexArray::Generate();
+	GLBuffer skyboxVBO = GLBuffer::Generate();
 	glBindVertexArray(skyboxVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
@@ -183,8 +313,7 @@ int main()
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid *)0);
 	glBindVertexArray(0);
 
-	GLuint lightVAO;
-	glGenVertexArrays(1, &lightVAO);
+	GLVertexArray lightVAO = GLVertexArray::Generate();
 	glBindVertexArray(lightVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid *)0);
@@ -192,15 +321,13 @@ int main()
 	glBindVertexArray(0);
 
 	//fbo
-	unsigned int fbo;
-	glGenFramebuffers(1, &fbo); //Creates the framebuffer
+	GLFramebuffer fbo = GLFramebuffer::Generate(); //Creates the framebuffer
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);//binds the fbo as the active framebuffer
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) //checks the status of the framebuffer to see if we have completed the requirments.
 		std::cout << "framebuffer not complete" << std::endl;
 
 	//creates the texture for the framebuffer
-	unsigned int textureColorbuffer;
-	glGenTextures(1, &textureColorbuffer);
+	GLTexture textureColorbuffer = GLTexture::Generate();
 	glBindTexture(GL_TEXTURE_2D, textureColorbuffer);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 800, 600, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -209,37 +336,150 @@ int main()
 	//attaches the texture to the framebuffer
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColorbuffer, 0);
 
+	// and a depth texture, which the depth pyramid is built from after the scene is drawn
+	GLTexture depthTexture = GLTexture::Generate();
+	glBindTexture(GL_TEXTURE_2D, depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, 800, 600, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
 	//quad for second pass texture
 
-	GLuint quadVAO = initQuadVAO();
+	GLBuffer quadVBO;
+	GLVertexArray quadVAO = initQuadVAO(quadVBO);
+
+	// Texture quality, e.g. TEXTURE_QUALITY=half on machines short of video memory.
+	// The visor textures are tiny already and the skybox fills the screen, so
+	// those never go below 128 and 256 texels.
+	const char *textureQuality = getenv("TEXTURE_QUALITY");
+
+	if (textureQuality)
+	{
+		TextureLoading::Quality() = TextureLoading::ParseQuality(textureQuality);
+	}
+
+	TextureLoading::SetLimits("glass_dif.png", 128, 0);
+	TextureLoading::SetLimits("glass_ddn.png", 128, 0);
+	TextureLoading::SetLimits("rt.tga", 256, 0);
 
 	// Cubemap (Skybox)
-	vector<const GLchar*> faces;
-	faces.push_back("skybox/rt.tga");
-	faces.push_back("skybox/lf.tga");
-	faces.push_back("skybox/up2.tga");
-	faces.push_back("skybox/dn.tga");
-	faces.push_back("skybox/bk.tga");
-	faces.push_back("skybox/ft.tga");
-	GLuint cubemapTexture = TextureLoading::LoadCubemap(faces);
+	vector<const GLchar*> faces = SkyboxFaces();
+	TextureMemory skyboxMemory;
+	GLTexture cubemapTexture;
+	bool hdrSkybox = false;
+	ScratchArena skyboxArena;
+
+	{
+		ArenaScope scope(skyboxArena);
+
+		// An HDR environment replaces the faces when there is one
+		std::ifstream hdrSky("skybox/sky.hdr");
+
+		if (hdrSky.good() || (AssetPack::Mounted() && AssetPack::Mounted()->Contains("skybox/sky.hdr")))
+		{
+			hdrSky.close();
+			cubemapTexture.Reset(TextureLoading::LoadHDRCubemap("skybox/sky.hdr", &skyboxMemory));
+			hdrSkybox = cubemapTexture != 0;
+		}
 
-	// Load models
-	Model ourModel("res/models/nanosuit.obj", false);
+		if (!hdrSkybox)
+		{
+			cubemapTexture.Reset(TextureLoading::LoadCubemap(faces, &skyboxMemory));
+		}
+	}
+	skyboxMemory.Report("skybox");
+	skyboxArena.Report("skybox");
+
+	// Load models. Nothing reads their geometry back, so it only needs to be on the GPU
+	Model ourModel("res/models/nanosuit.obj", false, GEOMETRY_RELEASE);
 
 	//Loads ground plain
-	Model ourGroundPlain("res/models/cube.obj", true);
+	Model ourGroundPlain("res/models/cube.obj", true, GEOMETRY_RELEASE);
+
+	// The models don't move, so they're placed once and handed to the culling pass,
+	// which draws them from then on. It culls in a compute pass where there's GL 4.3,
+	// on the CPU elsewhere or with CULLING=cpu.
+	glm::mat4 model;
+	model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // Translate it down a bit so it's at the center of the scene
+	model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));	// It's a bit too big for our scene, so scale it down
+
+	glm::mat4 groundPlain;
+	groundPlain = glm::translate(groundPlain, glm::vec3(0.0f, -1.75f, -1.0f)); // Translate it down a bit so it's at the center of the scene
+	groundPlain = glm::scale(groundPlain, glm::vec3(1.0f, 1.0f, 1.0f));	// It's a bit too big for our scene, so scale it down
+
+	// The directional and point lights never move, so they're baked: into lightmaps on
+	// the ground, which then ignores them, and into ambient occlusion on the nanosuit.
+	// BAKE=off leaves everything lit live.
+	LightsBlock lightsBlock;
+	lightsBlock.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	lightsBlock.dirLight.ambient = glm::vec3(0.5f, 0.5f, 0.5f);
+	lightsBlock.dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+	lightsBlock.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+
+	lightsBlock.pointLights[0].position = pointLightPos[0];
+	lightsBlock.pointLights[0].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	lightsBlock.pointLights[0].diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+	lightsBlock.pointLights[0].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+	lightsBlock.pointLights[0].constant = 1.0f;
+	lightsBlock.pointLights[0].linear = 0.09f;
+	lightsBlock.pointLights[0].quadratic = 0.032f;
+
+	const char *bake = getenv("BAKE");
+
+	if (!(bake && std::string(bake) == "off"))
+	{
+		LightBaker baker;
+		ourModel.AddTo(baker, model);
+		ourGroundPlain.AddTo(baker, groundPlain);
+		baker.AddLight(BakeLight::Directional(lightsBlock.dirLight.direction, lightsBlock.dirLight.ambient, lightsBlock.dirLight.diffuse));
+		baker.AddLight(BakeLight::Point(lightsBlock.pointLights[0].position, lightsBlock.pointLights[0].ambient, lightsBlock.pointLights[0].diffuse,
+			lightsBlock.pointLights[0].constant, lightsBlock.pointLights[0].linear, lightsBlock.pointLights[0].quadratic));
+
+		// The ground's lightmap is baked before either model goes to the culling pass,
+		// as unwrapping it splits its vertices and rebuilds its meshlets
+		ourGroundPlain.BakeLightmaps(baker, groundPlain, 128);
+		ourModel.BakeOcclusion(baker, model);
+		baker.Report("scene");
+	}
+
+	const char *culling = getenv("CULLING");
+	DepthPyramid depthPyramid(800, 600);
+	CullingPass cullingPass(depthPyramid, CullingPass::Supported() && !(culling && std::string(culling) == "cpu"));
+	ourModel.AddTo(cullingPass, model);
+	ourGroundPlain.AddTo(cullingPass, groundPlain);
+
+	assetReader.Report("startup");
+	assetReader.Clear();
 
 	modelShader.Use();
 	glm::mat4 projection = glm::perspective(camera.GetZoom(), (float)screenWidth / (float)screenHeight, 0.1f, 100.0f);
 
+	// Scratch memory for a frame is taken from here and all given back at the swap
+	ScratchArena frameArena(64 * 1024);
+	ArenaScope frameScope(frameArena);
+
+	// Per frame uniforms and instance matrices, three frames of them in flight
+	StreamBuffer frameStream(1 << 20);
+	StreamBuffer::Mounted() = &frameStream;
+	GLint uniformAlignment = StreamBuffer::UniformAlignment();
+
+	// ALLOCATION_CHECK=report lists the frames that allocate, =strict aborts on them
+	AllocationTracker::Start(AllocationTracker::ParseMode(getenv("ALLOCATION_CHECK")));
+
 	int counter(0);
 	// Game loop
 	while (!glfwWindowShouldClose(window))
 	{
 		if (counter == 0)
 		{
+			AllocationTracker::BeginFrame();
+			frameStream.BeginFrame();
+
 			//// first pass
 			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			glEnable(GL_DEPTH_TEST); // The second pass turns it off for the screen quad
 
 			// Set frame time
 			GLfloat currentFrame = glfwGetTime();
@@ -250,6 +490,37 @@ int main()
 			glfwPollEvents();
 			DoMovement();
 
+			// A click picks whatever is under the crosshair: the cursor turns the camera
+			if (pickRequested)
+			{
+				pickRequested = false;
+				Ray ray(camera.GetPosition(), camera.GetFront());
+				RayHit hit;
+				GLuint mesh;
+				const char *picked = "nothing";
+
+				if (ourModel.Intersect(ray, model, hit, &mesh))
+				{
+					ray.tMax = hit.t;
+					picked = "the nanosuit";
+				}
+
+				if (ourGroundPlain.Intersect(ray, groundPlain, hit, &mesh))
+				{
+					ray.tMax = hit.t;
+					picked = "the ground";
+				}
+
+				cout << "PICK:: " << picked;
+
+				if (ray.tMax < FLT_MAX)
+				{
+					cout << ", mesh " << mesh << " at " << ray.tMax << " along the view";
+				}
+
+				cout << endl;
+			}
+
 			// Clear the colorbuffer
 			glClearColor(0.05f, 1.05f, 0.05f, 1.0f);
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -267,6 +538,8 @@ int main()
 
 			glUniformMatrix4fv(glGetUniformLocation(skyboxShader.Program, "view"), 1, GL_FALSE, glm::value_ptr(view_sky));
 			glUniformMatrix4fv(glGetUniformLocation(skyboxShader.Program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+			glUniform1i(glGetUniformLocation(skyboxShader.Program, "hdr"), hdrSkybox);
+			glUniform1f(glGetUniformLocation(skyboxShader.Program, "exposure"), 1.0f);
 
 			// skybox cube
 			glBindVertexArray(skyboxVAO);
@@ -275,65 +548,45 @@ int main()
 			glBindVertexArray(0);
 			glDepthFunc(GL_LESS); // Set depth function back to default
 
+			// What's visible is worked out against last frame's depth, before anything is drawn
+			cullingPass.Cull(projection * view, camera.GetPosition());
+
 			modelShader.Use();
-			// Draw the loaded model
-			glm::mat4 model;
-			model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f)); // Translate it down a bit so it's at the center of the scene
-			model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));	// It's a bit too big for our scene, so scale it down
-			glUniformMatrix4fv(glGetUniformLocation(modelShader.Program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-			glUniformMatrix4fv(glGetUniformLocation(modelShader.Program, "view"), 1, GL_FALSE, glm::value_ptr(view));
-			glUniformMatrix4fv(glGetUniformLocation(modelShader.Program, "model"), 1, GL_FALSE, glm::value_ptr(model));
-			ourModel.Draw(modelShader);
-
-			// Draw the loaded ground plain
-			glm::mat4 groundPlain;
-			groundPlain = glm::translate(groundPlain, glm::vec3(0.0f, -1.75f, -1.0f)); // Translate it down a bit so it's at the center of the scene
-			groundPlain = glm::scale(groundPlain, glm::vec3(1.0f, 1.0f, 1.0f));	// It's a bit too big for our scene, so scale it down
-			glUniformMatrix4fv(glGetUniformLocation(modelShader.Program, "model"), 1, GL_FALSE, glm::value_ptr(groundPlain));
-			ourGroundPlain.Draw(modelShader);
-
-			GLint viewPosLoc = glGetUniformLocation(modelShader.Program, "viewPos");
-			glUniform3f(viewPosLoc, camera.GetPosition().x, camera.GetPosition().y, camera.GetPosition().z);
-			glUniform1f(glGetUniformLocation(modelShader.Program, "material.shininess"), 32.0f);
-
-			//Setting uniforms for types of light
-			//Room For more efficiency
-
-			// Directional Light
-			glUniform3f(glGetUniformLocation(modelShader.Program, "dirLight.direction"), -0.2f, -1.0f, -0.3f);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "dirLight.ambient"), 0.5f, 0.5f, 0.5f);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "dirLight.diffuse"), 0.4f, 0.4f, 0.4f);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "dirLight.specular"), 0.5f, 0.5f, 0.5f);
-
-			// Point Light
-			glUniform3f(glGetUniformLocation(modelShader.Program, "pointLights[0].position"), pointLightPos[0].x, pointLightPos[0].y, pointLightPos[0].z);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "pointLights[0].ambient"), 0.05f, 0.05f, 0.05f);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "pointLights[0].diffuse"), 0.8f, 0.8f, 0.8f);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "pointLights[0].specular"), 1.0f, 1.0f, 1.0f);
-			glUniform1f(glGetUniformLocation(modelShader.Program, "pointLights[0].constant"), 1.0f);
-			glUniform1f(glGetUniformLocation(modelShader.Program, "pointLights[0].linear"), 0.09f);
-			glUniform1f(glGetUniformLocation(modelShader.Program, "pointLights[0].quadratic"), 0.032f);
-
-			// Spot Light
-			glUniform3f(glGetUniformLocation(modelShader.Program, "spotLight.position"), camera.GetPosition().x, camera.GetPosition().y, camera.GetPosition().z);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "spotLight.direction"), camera.GetFront().x, camera.GetFront().y, camera.GetFront().z);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "spotLight.ambient"), 0.5f, 0.5f, 0.5f);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "spotLight.diffuse"), 0.8f, 0.8f, 0.8f);
-			glUniform3f(glGetUniformLocation(modelShader.Program, "spotLight.specular"), 0.8f, 0.8f, 0.8f);
-			glUniform1f(glGetUniformLocation(modelShader.Program, "spotLight.constant"), 1.0f);
-			glUniform1f(glGetUniformLocation(modelShader.Program, "spotLight.linear"), 0.09f);
-			glUniform1f(glGetUniformLocation(modelShader.Program, "spotLight.quadratic"), 0.032f);
-			glUniform1f(glGetUniformLocation(modelShader.Program, "spotLight.cutOff"), glm::cos(glm::radians(12.5f)));
-			glUniform1f(glGetUniformLocation(modelShader.Program, "spotLight.outerCutOff"), glm::cos(glm::radians(15.0f)));
-
-
-			GLint modelLoc = glGetUniformLocation(modelShader.Program, "model");
-			GLint viewLoc = glGetUniformLocation(modelShader.Program, "view");
-			GLint projLoc = glGetUniformLocation(modelShader.Program, "projection");
-
-			//Pass the matrices to the shader
-			glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-			glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+
+			// The camera and lights, set before anything is drawn with them
+			CameraBlock cameraBlock;
+			cameraBlock.projection = projection;
+			cameraBlock.view = view;
+			cameraBlock.viewPos = camera.GetPosition();
+
+			// The directional and point lights never change, only the spot light follows the camera
+			lightsBlock.spotLight.position = camera.GetPosition();
+			lightsBlock.spotLight.direction = camera.GetFront();
+			lightsBlock.spotLight.ambient = glm::vec3(0.5f, 0.5f, 0.5f);
+			lightsBlock.spotLight.diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+			lightsBlock.spotLight.specular = glm::vec3(0.8f, 0.8f, 0.8f);
+			lightsBlock.spotLight.constant = 1.0f;
+			lightsBlock.spotLight.linear = 0.09f;
+			lightsBlock.spotLight.quadratic = 0.032f;
+			lightsBlock.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+			lightsBlock.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+
+			GLintptr cameraOffset = frameStream.Write(&cameraBlock, sizeof(cameraBlock), uniformAlignment);
+			GLintptr lightsOffset = frameStream.Write(&lightsBlock, sizeof(lightsBlock), uniformAlignment);
+
+			if (cameraOffset >= 0 && lightsOffset >= 0)
+			{
+				glBindBufferRange(GL_UNIFORM_BUFFER, CameraBinding, frameStream.Buffer(), cameraOffset, sizeof(cameraBlock));
+				glBindBufferRange(GL_UNIFORM_BUFFER, LightsBinding, frameStream.Buffer(), lightsOffset, sizeof(lightsBlock));
+			}
+
+			// Draw the loaded model and ground plain, and any glTF primitives the pass doesn't cull
+			cullingPass.Draw(modelShader);
+			ourModel.DrawUnculled(modelShader, model);
+			ourGroundPlain.DrawUnculled(modelShader, groundPlain);
+
+			// Next frame culls against what was drawn this one
+			depthPyramid.Build(depthTexture);
 
 			counter++;
 
@@ -355,21 +608,91 @@ int main()
 			glBindVertexArray(quadVAO);
 			glDrawArrays(GL_TRIANGLES, 0, 6);
 
-			glDeleteVertexArrays(1, &lightVAO);
-			glDeleteBuffers(1, &VBO);
+			lightVAO.Reset();
+			VBO.Reset();
 			counter = 0;
 			// Swap the buffers
+			frameStream.EndFrame();
 			glfwSwapBuffers(window);
+			frameArena.EndFrame();
+			AllocationTracker::EndFrame();
 		}
 
 	}
 
+	frameArena.Report("frame");
+	frameStream.Report("frame");
+	cullingPass.Report("scene");
+	StreamBuffer::Mounted() = NULL;
+	AllocationTracker::Report();
+
 
 
-	glfwTerminate();
 	return 0;
 }
 
+// The skybox's cubemap faces, in +X, -X, +Y, -Y, +Z, -Z order
+vector<const GLchar *> SkyboxFaces()
+{
+	vector<const GLchar*> faces;
+	faces.push_back("skybox/rt.tga");
+	faces.push_back("skybox/lf.tga");
+	faces.push_back("skybox/up2.tga");
+	faces.push_back("skybox/dn.tga");
+	faces.push_back("skybox/bk.tga");
+	faces.push_back("skybox/ft.tga");
+
+	return faces;
+}
+
+// Cooks res/ and skybox/ into cooked/ for a build that never loads a source format:
+//	--cook [--force] [--jobs N] [--pack]
+// --force cooks everything again, --jobs sets the number of threads (one a core by
+// default) and --pack puts the manifest and cooked files into assets.pak
+int CookAssets(int argc, char **argv)
+{
+	bool force = false, pack = false;
+	unsigned jobs = 0;
+
+	for (int i = 2; i < argc; i++)
+	{
+		std::string argument = argv[i];
+
+		if (argument == "--force")
+		{
+			force = true;
+		}
+		else if (argument == "--pack")
+		{
+			pack = true;
+		}
+		else if (argument == "--jobs" && i + 1 < argc)
+		{
+			jobs = (unsigned)atoi(argv[++i]);
+		}
+		else
+		{
+			std::cout << "ERROR::COOKER::UNKNOWN_ARGUMENT " << argument << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	vector<const GLchar *> faces = SkyboxFaces();
+	AssetCooker cooker("cooked");
+	cooker.AddRoot("res");
+	cooker.AddRoot("skybox");
+	cooker.AddCubemap(vector<std::string>(faces.begin(), faces.end()));
+
+	bool cooked = cooker.Run(force, jobs);
+
+	if (pack && !cooker.BuildPack("assets.pak"))
+	{
+		return EXIT_FAILURE;
+	}
+
+	return cooked ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 // Moves/alters the camera positions based on user input
 void DoMovement()
 {
@@ -433,3 +756,12 @@ void MouseCallback(GLFWwindow *window, double xPos, double yPos)
 
 	camera.ProcessMouseMovement(xOffset, yOffset);
 }
+
+// A left click asks the game loop to pick what's in front of the camera
+void MouseButtonCallback(GLFWwindow *window, int button, int action, int mode)
+{
+	if (GLFW_MOUSE_BUTTON_LEFT == button && GLFW_PRESS == action)
+	{
+		pickRequested = true;
+	}
+}
@@ -5,10 +5,17 @@
 #include <sstream>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "glHandle.h"
+#include "lightmapCharts.h"
+#include "meshlets.h"
+#include "triangleBvh.h"
 
 using namespace std;
 
@@ -27,92 +34,570 @@ struct Texture
 	GLuint id;
 	string type;
 	aiString path;
+	bool yCoCg = false;	// diffuse cooked as scaled YCoCg DXT5, decoded in the shader
+};
+
+// What a mesh keeps in memory once it's on the GPU, which only needs the buffers to draw
+enum GeometryResidency
+{
+	GEOMETRY_KEEP,		// vertices and indices as they were loaded
+	GEOMETRY_COMPACT,	// quantised positions and the smallest indices, enough for picking and physics
+	GEOMETRY_RELEASE	// nothing, read back from the GPU if it's needed again
+};
+
+// Positions quantised to 16 bits across the mesh's bounds, a 2048th of its size at
+// worst, and indices in 16 bits when the mesh has few enough vertices
+struct CompactGeometry
+{
+	glm::vec3 origin;				// the bounds' minimum
+	glm::vec3 step;					// the bounds' size over 65535
+	vector<uint16_t> positions;		// three a vertex
+	vector<uint16_t> shortIndices;	// when every index fits
+	vector<GLuint> indices;			// when they don't
+
+	size_t VertexCount() const
+	{
+		return this->positions.size() / 3;
+	}
+
+	size_t IndexCount() const
+	{
+		return this->shortIndices.empty() ? this->indices.size() : this->shortIndices.size();
+	}
+
+	glm::vec3 Position(size_t vertex) const
+	{
+		const uint16_t *p = &this->positions[vertex * 3];
+		return glm::vec3(this->origin.x + p[0] * this->step.x, this->origin.y + p[1] * this->step.y, this->origin.z + p[2] * this->step.z);
+	}
+
+	GLuint Index(size_t i) const
+	{
+		return this->shortIndices.empty() ? this->indices[i] : this->shortIndices[i];
+	}
+
+	size_t Bytes() const
+	{
+		return this->positions.size() * sizeof(uint16_t) + this->shortIndices.size() * sizeof(uint16_t) + this->indices.size() * sizeof(GLuint);
+	}
 };
 
 class Mesh
 {
 public:
 	/*  Mesh Data  */
-	vector<Vertex> vertices;
+	vector<Vertex> vertices;		// empty unless the residency is GEOMETRY_KEEP
 	vector<GLuint> indices;
 	vector<Texture> textures;
 
 	/*  Functions  */
-	// Constructor
-	Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures)
+	// Constructor, moving the data in: pass the vectors with std::move to avoid copying
+	// them. A Mesh owns its buffers, so it can be moved but not copied. Cooked meshes
+	// bring their BVH along; anything else has one built here.
+	Mesh(vector<Vertex> vertices, vector<GLuint> indices, vector<Texture> textures, TriangleBvh bvh = TriangleBvh())
+		: vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures)),
+		vertexCount((GLsizei)this->vertices.size()), indexCount((GLsizei)this->indices.size()), residency(GEOMETRY_KEEP), bvh(std::move(bvh)), lightmapBytes(0)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		if (this->bvh.Empty() && !this->vertices.empty())
+		{
+			this->bvh = TriangleBvh::Build(&this->vertices[0].Position, sizeof(Vertex), this->vertices.size(), this->indices);
+		}
+
+		// The indices are put in meshlet order before they're uploaded, see MeshletSet
+		if (!this->vertices.empty())
+		{
+			this->meshlets = MeshletSet::Build(&this->vertices[0].Position, sizeof(Vertex), this->vertices.size(), this->indices);
+		}
 
 		// Now that we have all the required data, set the vertex buffers and its attribute pointers.
 		this->setupMesh();
 	}
 
-	// Render the mesh
-	void Draw(Shader shader)
+	// The model matrix is a per instance attribute, its four columns from this location
+	// on, read from a stream buffer by DrawInstanced or set as constant values by Draw
+	static const GLuint ModelAttribute = 5;
+
+	// What a light bake left at each vertex: its lightmap coordinates, -1 where it has
+	// none, and its ambient occlusion. Meshes that weren't baked read it as a constant.
+	static const GLuint BakedAttribute = 9;
+
+	// Render the mesh, once for each of count model matrices when transforms are given
+	void Draw(const Shader &shader, const glm::mat4 *transforms = NULL, GLuint count = 1) const
+	{
+		this->bindTextures(shader);
+		glBindVertexArray(this->VAO);
+
+		for (GLuint c = 0; c < 4; c++)
+		{
+			glDisableVertexAttribArray(ModelAttribute + c);
+		}
+
+		for (GLuint i = 0; i < count; i++)
+		{
+			glm::mat4 transform = transforms ? transforms[i] : glm::mat4(1.0f);
+
+			for (GLuint c = 0; c < 4; c++)
+			{
+				glVertexAttrib4fv(ModelAttribute + c, &transform[c][0]);
+			}
+
+			glDrawElements(GL_TRIANGLES, this->indexCount, GL_UNSIGNED_INT, 0);
+		}
+
+		glBindVertexArray(0);
+		this->unbindTextures();
+	}
+
+	// Render count instances in one call, their model matrices read from buffer at offset
+	void DrawInstanced(const Shader &shader, GLuint buffer, GLintptr offset, GLuint count) const
+	{
+		this->bindTextures(shader);
+		glBindVertexArray(this->VAO);
+
+		// GL 3.3 has no base instance, so the attributes are pointed at this draw's matrices
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+		for (GLuint c = 0; c < 4; c++)
+		{
+			glEnableVertexAttribArray(ModelAttribute + c);
+			glVertexAttribPointer(ModelAttribute + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid *)(offset + c * sizeof(glm::vec4)));
+		}
+
+		glDrawElementsInstanced(GL_TRIANGLES, this->indexCount, GL_UNSIGNED_INT, 0, count);
+
+		glBindVertexArray(0);
+		this->unbindTextures();
+	}
+
+	// Render the instances a GPU pass wrote, with the drawCount indirect commands from
+	// commandOffset in commands, a meshlet each. Their base instances pick out their
+	// matrices in instances (GL 4.3).
+	void DrawIndirect(const Shader &shader, GLuint instances, GLuint commands, GLintptr commandOffset, GLsizei drawCount) const
+	{
+		this->bindTextures(shader);
+		glBindVertexArray(this->VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, instances);
+
+		for (GLuint c = 0; c < 4; c++)
+		{
+			glEnableVertexAttribArray(ModelAttribute + c);
+			glVertexAttribPointer(ModelAttribute + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid *)(c * sizeof(glm::vec4)));
+		}
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (GLvoid *)commandOffset, drawCount, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+		glBindVertexArray(0);
+		this->unbindTextures();
+	}
+
+	// Render count ranges of the indices, e.g. the meshlets left after culling, with
+	// one model matrix
+	void DrawRanges(const Shader &shader, const glm::mat4 &transform, const GLsizei *counts, const GLvoid *const *offsets, GLsizei count) const
+	{
+		this->bindTextures(shader);
+		glBindVertexArray(this->VAO);
+
+		for (GLuint c = 0; c < 4; c++)
+		{
+			glDisableVertexAttribArray(ModelAttribute + c);
+			glVertexAttrib4fv(ModelAttribute + c, &transform[c][0]);
+		}
+
+		glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, count);
+
+		glBindVertexArray(0);
+		this->unbindTextures();
+	}
+
+	GLsizei IndexCount() const
+	{
+		return this->indexCount;
+	}
+
+	const MeshletSet &Meshlets() const
+	{
+		return this->meshlets;
+	}
+
+	// For ray casts against the mesh, in its own space or placed by an instance's matrix
+	const TriangleBvh &Bvh() const
+	{
+		return this->bvh;
+	}
+
+	// The box around the vertices, in the mesh's own space, for culling
+	const glm::vec3 &BoundsMin() const
+	{
+		return this->boundsMin;
+	}
+
+	const glm::vec3 &BoundsMax() const
+	{
+		return this->boundsMax;
+	}
+
+	// Lays out second texture coordinates for a lightmap of resolution texels, see
+	// LightmapCharts, unless the mesh has them. Vertices are split where charts meet, so
+	// the buffers, meshlets and BVH are all built again.
+	bool UnwrapLightmap(GLsizei resolution)
+	{
+		if (!this->lightmapCoords.empty())
+		{
+			return true;
+		}
+
+		GeometryResidency residency = this->residency;
+		this->SetResidency(GEOMETRY_KEEP);
+
+		vector<GLuint> remap;
+		vector<glm::vec2> coords;
+		bool unwrapped = !this->vertices.empty() &&
+			LightmapCharts::Build(&this->vertices[0].Position, sizeof(Vertex), this->vertices.size(), this->indices, resolution, remap, coords);
+
+		if (unwrapped)
+		{
+			vector<Vertex> split(remap.size());
+			vector<float> occlusion(this->occlusion.empty() ? 0 : remap.size());
+
+			for (GLuint i = 0; i < remap.size(); i++)
+			{
+				split[i] = this->vertices[remap[i]];
+
+				if (!occlusion.empty())
+				{
+					occlusion[i] = this->occlusion[remap[i]];
+				}
+			}
+
+			this->vertices.swap(split);
+			this->occlusion.swap(occlusion);
+			this->lightmapCoords.swap(coords);
+			this->vertexCount = (GLsizei)this->vertices.size();
+			this->indexCount = (GLsizei)this->indices.size();
+			this->bvh = TriangleBvh::Build(&this->vertices[0].Position, sizeof(Vertex), this->vertices.size(), this->indices);
+			this->meshlets = MeshletSet::Build(&this->vertices[0].Position, sizeof(Vertex), this->vertices.size(), this->indices);
+
+			// The copy write target leaves the element array binding of whatever VAO is bound alone
+			glBindBuffer(GL_COPY_WRITE_BUFFER, this->VBO);
+			glBufferData(GL_COPY_WRITE_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, this->EBO);
+			glBufferData(GL_COPY_WRITE_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			this->uploadBaked();
+		}
+		else
+		{
+			cout << "ERROR::MESH::LIGHTMAP_UNWRAP_FAILED" << endl;
+		}
+
+		this->SetResidency(residency);
+		return unwrapped;
+	}
+
+	// For a mesh that brings its own second texture coordinates, one a vertex
+	void SetLightmapCoords(vector<glm::vec2> coords)
+	{
+		if (coords.size() != (size_t)this->vertexCount)
+		{
+			cout << "ERROR::MESH::LIGHTMAP_COORDS_DONT_MATCH" << endl;
+			return;
+		}
+
+		this->lightmapCoords = std::move(coords);
+		this->uploadBaked();
+	}
+
+	const vector<glm::vec2> &LightmapCoords() const
+	{
+		return this->lightmapCoords;
+	}
+
+	// The light baked into each of resolution * resolution texels, in half floats so
+	// it can go over 1
+	void SetLightmap(const vector<glm::vec3> &texels, GLsizei resolution)
+	{
+		if (texels.size() != (size_t)resolution * resolution)
+		{
+			cout << "ERROR::MESH::LIGHTMAP_SIZE" << endl;
+			return;
+		}
+
+		this->lightmap = GLTexture::Generate();
+		glBindTexture(GL_TEXTURE_2D, this->lightmap);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, resolution, resolution, 0, GL_RGB, GL_FLOAT, &texels[0]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		this->lightmapBytes = texels.size() * 3 * sizeof(GLushort);
+	}
+
+	// Ambient occlusion baked at each vertex
+	void SetOcclusion(vector<float> occlusion)
+	{
+		if (occlusion.size() != (size_t)this->vertexCount)
+		{
+			cout << "ERROR::MESH::OCCLUSION_DOESNT_MATCH" << endl;
+			return;
+		}
+
+		this->occlusion = std::move(occlusion);
+		this->uploadBaked();
+	}
+
+	// Drops the vertices and indices, or swaps them for the compact copy. Going back to
+	// GEOMETRY_KEEP reads them back out of the GPU buffers.
+	void SetResidency(GeometryResidency residency)
+	{
+		if (residency == this->residency)
+		{
+			return;
+		}
+
+		if (this->residency != GEOMETRY_KEEP)
+		{
+			this->readBack();
+		}
+
+		if (residency == GEOMETRY_COMPACT)
+		{
+			this->compact();
+		}
+		else
+		{
+			this->compactGeometry = CompactGeometry();
+		}
+
+		if (residency != GEOMETRY_KEEP)
+		{
+			vector<Vertex>().swap(this->vertices);
+			vector<GLuint>().swap(this->indices);
+		}
+
+		this->residency = residency;
+	}
+
+	GeometryResidency Residency() const
+	{
+		return this->residency;
+	}
+
+	// Only filled in while the residency is GEOMETRY_COMPACT
+	const CompactGeometry &Compact() const
+	{
+		return this->compactGeometry;
+	}
+
+	// CPU memory the geometry takes as it is, and as it was uploaded
+	size_t ResidentBytes() const
+	{
+		return this->vertices.capacity() * sizeof(Vertex) + this->indices.capacity() * sizeof(GLuint) + this->compactGeometry.Bytes() +
+			this->meshlets.Bytes() + this->bvh.Bytes() + this->lightmapCoords.capacity() * sizeof(glm::vec2) + this->occlusion.capacity() * sizeof(float);
+	}
+
+	size_t UploadedBytes() const
+	{
+		return this->vertexCount * sizeof(Vertex) + this->indexCount * sizeof(GLuint) + (this->bakedVBO ? this->vertexCount * sizeof(glm::vec3) : 0) +
+			this->lightmapBytes;
+	}
+
+private:
+	/*  Render data  */
+	GLVertexArray VAO;
+	GLBuffer VBO, EBO;
+	GLsizei vertexCount, indexCount;	// what was uploaded, whatever is still kept
+	GeometryResidency residency;
+	CompactGeometry compactGeometry;
+	glm::vec3 boundsMin, boundsMax;
+	MeshletSet meshlets;
+	TriangleBvh bvh;
+	GLBuffer bakedVBO;					// only once something was baked, see BakedAttribute
+	GLTexture lightmap;
+	size_t lightmapBytes;
+	vector<glm::vec2> lightmapCoords;	// kept for baking, like the BVH
+	vector<float> occlusion;
+
+	// Copies the vertices and indices back out of the buffers they were uploaded to
+	void readBack()
+	{
+		this->vertices.resize(this->vertexCount);
+		this->indices.resize(this->indexCount);
+
+		// The copy read target leaves the element array binding of whatever VAO is bound alone
+		glBindBuffer(GL_COPY_READ_BUFFER, this->VBO);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, this->vertexCount * sizeof(Vertex), this->vertices.data());
+		glBindBuffer(GL_COPY_READ_BUFFER, this->EBO);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, this->indexCount * sizeof(GLuint), this->indices.data());
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+
+	void compact()
+	{
+		CompactGeometry &compact = this->compactGeometry;
+		glm::vec3 low(0.0f), high(0.0f);
+
+		for (GLuint i = 0; i < this->vertices.size(); i++)
+		{
+			const glm::vec3 &p = this->vertices[i].Position;
+			low = i ? glm::vec3(std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z)) : p;
+			high = i ? glm::vec3(std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z)) : p;
+		}
+
+		compact.origin = low;
+		compact.step = glm::vec3((high.x - low.x) / 65535.0f, (high.y - low.y) / 65535.0f, (high.z - low.z) / 65535.0f);
+		compact.positions.resize(this->vertices.size() * 3);
+
+		for (GLuint i = 0; i < this->vertices.size(); i++)
+		{
+			const glm::vec3 &p = this->vertices[i].Position;
+			float position[3] = { p.x, p.y, p.z }, origin[3] = { low.x, low.y, low.z }, step[3] = { compact.step.x, compact.step.y, compact.step.z };
+
+			for (int c = 0; c < 3; c++)
+			{
+				compact.positions[i * 3 + c] = (step[c] > 0.0f) ? (uint16_t)((position[c] - origin[c]) / step[c] + 0.5f) : 0;
+			}
+		}
+
+		if (this->vertices.size() <= 65536)
+		{
+			compact.shortIndices.resize(this->indices.size());
+
+			for (GLuint i = 0; i < this->indices.size(); i++)
+			{
+				compact.shortIndices[i] = (uint16_t)this->indices[i];
+			}
+		}
+		else
+		{
+			compact.indices = this->indices;
+		}
+	}
+
+	// Binds the mesh's textures and points the shader's samplers at them
+	void bindTextures(const Shader &shader) const
 	{
 		// Bind appropriate textures
 		GLuint diffuseNr = 1;
 		GLuint specularNr = 1;
 		GLuint normalNr = 1;
+		bool diffuseYCoCg = false;
 
 		for (GLuint i = 0; i < this->textures.size(); i++)
 		{
 			glActiveTexture(GL_TEXTURE0 + i); // Active proper texture unit before binding
 											  // Retrieve texture number (the N in diffuse_textureN)
-			stringstream ss;
-			string number;
-			string name = this->textures[i].type;
+			// The uniform's name is built on the stack, so drawing allocates nothing
+			const string &name = this->textures[i].type;
+			GLuint number = 0;
+			char uniform[64];
 
 			if (name == "texture_diffuse")
 			{
-				ss << diffuseNr++; // Transfer GLuint to stream
+				number = diffuseNr++;
+				diffuseYCoCg = diffuseYCoCg || this->textures[i].yCoCg;
 			}
 			else if (name == "texture_specular")
 			{
-				ss << specularNr++; // Transfer GLuint to stream
+				number = specularNr++;
 			}
 			/*else if (name == "texture_normal")
 			{
-				ss << normalNr++; // Transfer GLuint to stream
+				number = normalNr++;
 			}*/
 
-			number = ss.str();
+			if (number)
+			{
+				snprintf(uniform, sizeof(uniform), "%s%u", name.c_str(), number);
+			}
+			else
+			{
+				snprintf(uniform, sizeof(uniform), "%s", name.c_str());
+			}
+
 			// Now set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(shader.Program, (name + number).c_str()), i);
+			glUniform1i(glGetUniformLocation(shader.Program, uniform), i);
 			// And finally bind the texture
 			glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
 		}
 
+		// Tell the shader whether the diffuse map needs converting back to RGB
+		glUniform1i(glGetUniformLocation(shader.Program, "material.diffuseYCoCg"), diffuseYCoCg);
+
 		// Also set each mesh's shininess property to a default value (if you want you could extend this to another mesh property and possibly change this value)
 		glUniform1f(glGetUniformLocation(shader.Program, "material.shininess"), 16.0f);
 
-		// Draw mesh
-		glBindVertexArray(this->VAO);
-		glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+		// Meshes without the baked attribute read it as no lightmap and no occlusion
+		glVertexAttrib3f(BakedAttribute, -1.0f, -1.0f, 1.0f);
 
+		// The lightmap goes in the unit after the mesh's textures
+		if (this->lightmap)
+		{
+			glActiveTexture(GL_TEXTURE0 + (GLuint)this->textures.size());
+			glUniform1i(glGetUniformLocation(shader.Program, "lightmap"), (GLint)this->textures.size());
+			glBindTexture(GL_TEXTURE_2D, this->lightmap);
+		}
+	}
+
+	void unbindTextures() const
+	{
 		// Always good practice to set everything back to defaults once configured.
 		for (GLuint i = 0; i < this->textures.size(); i++)
 		{
 			glActiveTexture(GL_TEXTURE0 + i);
 			glBindTexture(GL_TEXTURE_2D, 0);
 		}
+
+		if (this->lightmap)
+		{
+			glActiveTexture(GL_TEXTURE0 + (GLuint)this->textures.size());
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
 	}
 
-private:
-	/*  Render data  */
-	GLuint VAO, VBO, EBO;
+	// Fills the baked attribute's buffer from the lightmap coordinates and occlusion
+	void uploadBaked()
+	{
+		vector<glm::vec3> baked(this->vertexCount);
+
+		for (GLsizei i = 0; i < this->vertexCount; i++)
+		{
+			baked[i] = glm::vec3(this->lightmapCoords.empty() ? -1.0f : this->lightmapCoords[i].x, this->lightmapCoords.empty() ? -1.0f : this->lightmapCoords[i].y,
+				this->occlusion.empty() ? 1.0f : this->occlusion[i]);
+		}
+
+		if (!this->bakedVBO)
+		{
+			this->bakedVBO = GLBuffer::Generate();
+		}
+
+		glBindVertexArray(this->VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, this->bakedVBO);
+		glBufferData(GL_ARRAY_BUFFER, baked.size() * sizeof(glm::vec3), baked.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(BakedAttribute);
+		glVertexAttribPointer(BakedAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLvoid *)0);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
 
 	/*  Functions    */
 	// Initializes all the buffer objects/arrays
 	void setupMesh()
 	{
+		this->boundsMin = this->boundsMax = this->vertices.empty() ? glm::vec3(0.0f) : this->vertices[0].Position;
+
+		for (GLuint i = 1; i < this->vertices.size(); i++)
+		{
+			this->boundsMin = glm::min(this->boundsMin, this->vertices[i].Position);
+			this->boundsMax = glm::max(this->boundsMax, this->vertices[i].Position);
+		}
+
 		// Create buffers/arrays
-		glGenVertexArrays(1, &this->VAO);
-		glGenBuffers(1, &this->VBO);
-		glGenBuffers(1, &this->EBO);
+		this->VAO = GLVertexArray::Generate();
+		this->VBO = GLBuffer::Generate();
+		this->EBO = GLBuffer::Generate();
 
 		glBindVertexArray(this->VAO);
 		// Load data into vertex buffers
@@ -135,6 +620,11 @@ private:
 		// Vertex Texture Coords
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid *)offsetof(Vertex, TexCoords));
+		// Model matrix columns, which advance once an instance
+		for (GLuint c = 0; c < 4; c++)
+		{
+			glVertexAttribDivisor(ModelAttribute + c, 1);
+		}
 
 		glBindVertexArray(0);
 	}
@@ -0,0 +1,348 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define MESHLETS_SSE2
+#include <emmintrin.h>
+#endif
+
+// A mesh split into meshlets: clusters of at most MaxVertices vertices and
+// MaxTriangles triangles, each a range of the mesh's indices, with a bounding sphere
+// and a cone around its triangles' normals. A meshlet off screen, or whose
+// triangles all face away from the eye, is skipped without drawing the rest of the
+// mesh any differently, so a large mesh only sends the side of it in view.
+//
+// The bounds are kept as a structure of arrays, padded to a multiple of four with
+// meshlets nothing can see, so Cull tests four at a time.
+struct MeshletSet
+{
+	static const GLuint MaxVertices = 64;
+	static const GLuint MaxTriangles = 124;
+
+	std::vector<GLuint> firstIndex;
+	std::vector<GLuint> indexCount;
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> axisX, axisY, axisZ, cutoff;		// cutoff 1 for a cone too wide to cull by
+
+	GLuint Count() const
+	{
+		return (GLuint)this->firstIndex.size();
+	}
+
+	size_t Bytes() const
+	{
+		return this->firstIndex.capacity() * sizeof(GLuint) * 2 + this->centerX.capacity() * sizeof(float) * 8;
+	}
+
+	// Groups the triangles into meshlets, reordering indices so each one's are
+	// together. A meshlet grows from a triangle through the triangles sharing its
+	// vertices, taking whichever adds the fewest new ones, so it stays compact and its
+	// bounds tight. Positions are read through a stride, so any vertex layout will do.
+	static MeshletSet Build(const void *positions, size_t stride, size_t vertexCount, std::vector<GLuint> &indices)
+	{
+		MeshletSet set;
+		GLuint triangleCount = (GLuint)(indices.size() / 3);
+
+		if (!triangleCount)
+		{
+			return set;
+		}
+
+		// The triangles using each vertex, as offsets into one list
+		std::vector<GLuint> adjacencyStart(vertexCount + 1, 0), adjacency(triangleCount * 3);
+
+		for (GLuint i = 0; i < triangleCount * 3; i++)
+		{
+			adjacencyStart[indices[i] + 1]++;
+		}
+
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			adjacencyStart[v + 1] += adjacencyStart[v];
+		}
+
+		std::vector<GLuint> filled(adjacencyStart.begin(), adjacencyStart.end() - 1);
+
+		for (GLuint i = 0; i < triangleCount * 3; i++)
+		{
+			adjacency[filled[indices[i]]++] = i / 3;
+		}
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<int> local(vertexCount, -1);	// the vertex's place in the meshlet being built
+		std::vector<GLuint> used, reordered;
+		reordered.reserve(triangleCount * 3);
+		used.reserve(MaxVertices);
+		GLuint next = 0;
+
+		while (next < triangleCount)
+		{
+			if (emitted[next])
+			{
+				next++;
+				continue;
+			}
+
+			GLuint first = (GLuint)reordered.size(), triangle = next, triangles = 0;
+
+			for (;;)
+			{
+				emitted[triangle] = true;
+				triangles++;
+
+				for (int c = 0; c < 3; c++)
+				{
+					GLuint vertex = indices[triangle * 3 + c];
+					reordered.push_back(vertex);
+
+					if (local[vertex] < 0)
+					{
+						local[vertex] = (int)used.size();
+						used.push_back(vertex);
+					}
+				}
+
+				if (triangles == MaxTriangles)
+				{
+					break;
+				}
+
+				// The neighbours of the triangle just added first, then of the whole meshlet
+				int newVertices = 3;
+				GLuint best = bestNeighbour(indices, adjacencyStart, adjacency, emitted, local, &indices[triangle * 3], 3, newVertices);
+
+				if (newVertices == 3)
+				{
+					best = bestNeighbour(indices, adjacencyStart, adjacency, emitted, local, used.data(), used.size(), newVertices);
+				}
+
+				if (newVertices == 3 || used.size() + newVertices > MaxVertices)
+				{
+					break;
+				}
+
+				triangle = best;
+			}
+
+			set.add(positions, stride, reordered, first, (GLuint)reordered.size() - first);
+
+			for (size_t i = 0; i < used.size(); i++)
+			{
+				local[used[i]] = -1;
+			}
+
+			used.clear();
+		}
+
+		indices.swap(reordered);
+		set.pad();
+		return set;
+	}
+
+	// Writes the meshlets that may be seen to visible, returning how many. planes are
+	// the frustum's, pointing in and normalised, and eye the viewer, all in the mesh's
+	// own space: sides of planes don't change under any transform, so testing there
+	// is exact however the mesh is placed.
+	GLuint Cull(const glm::vec4 *planes, const glm::vec3 &eye, GLuint *visible) const
+	{
+		GLuint count = 0, meshlets = this->Count();
+
+#if defined(MESHLETS_SSE2)
+		__m128 eyeX = _mm_set1_ps(eye.x), eyeY = _mm_set1_ps(eye.y), eyeZ = _mm_set1_ps(eye.z);
+
+		for (GLuint i = 0; i < meshlets; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(&this->centerX[i]), y = _mm_loadu_ps(&this->centerY[i]), z = _mm_loadu_ps(&this->centerZ[i]);
+			__m128 r = _mm_loadu_ps(&this->radius[i]);
+			__m128 negativeR = _mm_sub_ps(_mm_setzero_ps(), r);
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(planes[p].x)), _mm_mul_ps(y, _mm_set1_ps(planes[p].y))),
+					_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(planes[p].z)), _mm_set1_ps(planes[p].w)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeR));
+			}
+
+			// Back facing: the view of the centre is along the cone past its cutoff
+			__m128 toX = _mm_sub_ps(x, eyeX), toY = _mm_sub_ps(y, eyeY), toZ = _mm_sub_ps(z, eyeZ);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toX, toX), _mm_mul_ps(toY, toY)), _mm_mul_ps(toZ, toZ)));
+			__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toX, _mm_loadu_ps(&this->axisX[i])), _mm_mul_ps(toY, _mm_loadu_ps(&this->axisY[i]))),
+				_mm_mul_ps(toZ, _mm_loadu_ps(&this->axisZ[i])));
+			__m128 away = _mm_cmpgt_ps(along, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&this->cutoff[i]), length), r));
+
+			int mask = _mm_movemask_ps(_mm_andnot_ps(away, inside));
+
+			for (GLuint lane = 0; mask; lane++, mask >>= 1)
+			{
+				if (mask & 1)
+				{
+					visible[count++] = i + lane;
+				}
+			}
+		}
+#else
+		for (GLuint i = 0; i < meshlets; i++)
+		{
+			bool inside = true;
+
+			for (int p = 0; p < 6 && inside; p++)
+			{
+				inside = this->centerX[i] * planes[p].x + this->centerY[i] * planes[p].y + this->centerZ[i] * planes[p].z + planes[p].w >= -this->radius[i];
+			}
+
+			glm::vec3 to(this->centerX[i] - eye.x, this->centerY[i] - eye.y, this->centerZ[i] - eye.z);
+			float along = to.x * this->axisX[i] + to.y * this->axisY[i] + to.z * this->axisZ[i];
+
+			if (inside && !(along > this->cutoff[i] * std::sqrt(to.x * to.x + to.y * to.y + to.z * to.z) + this->radius[i]))
+			{
+				visible[count++] = i;
+			}
+		}
+#endif
+
+		return count;
+	}
+
+	// The frustum planes of clipFromObject, pointing in and normalised, for Cull
+	static void FrustumPlanes(const glm::mat4 &clipFromObject, glm::vec4 *planes)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int side = 0; side < 2; side++)
+			{
+				glm::vec4 &plane = planes[axis * 2 + side];
+				float sign = side ? -1.0f : 1.0f;
+
+				for (int c = 0; c < 4; c++)
+				{
+					plane[c] = clipFromObject[c][3] + sign * clipFromObject[c][axis];
+				}
+
+				float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+				plane = glm::vec4(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+			}
+		}
+	}
+
+private:
+	// The unused triangle next to vertices adding the fewest new vertices to the
+	// meshlet, with how many in newVertices, 3 when there's none
+	static GLuint bestNeighbour(const std::vector<GLuint> &indices, const std::vector<GLuint> &adjacencyStart, const std::vector<GLuint> &adjacency,
+		const std::vector<bool> &emitted, const std::vector<int> &local, const GLuint *vertices, size_t vertexCount, int &newVertices)
+	{
+		GLuint best = 0;
+		newVertices = 3;
+
+		for (size_t v = 0; v < vertexCount && newVertices > 0; v++)
+		{
+			for (GLuint a = adjacencyStart[vertices[v]]; a < adjacencyStart[vertices[v] + 1]; a++)
+			{
+				GLuint triangle = adjacency[a];
+
+				if (emitted[triangle])
+				{
+					continue;
+				}
+
+				int added = (local[indices[triangle * 3]] < 0) + (local[indices[triangle * 3 + 1]] < 0) + (local[indices[triangle * 3 + 2]] < 0);
+
+				if (added < newVertices)
+				{
+					best = triangle;
+					newVertices = added;
+				}
+			}
+		}
+
+		return best;
+	}
+
+	// Adds the meshlet of count indices from first, working out its bounds
+	void add(const void *positions, size_t stride, const std::vector<GLuint> &indices, GLuint first, GLuint count)
+	{
+		glm::vec3 low(0.0f), high(0.0f), normals(0.0f);
+
+		for (GLuint i = 0; i < count; i++)
+		{
+			const glm::vec3 &p = position(positions, stride, indices[first + i]);
+			low = i ? glm::min(low, p) : p;
+			high = i ? glm::max(high, p) : p;
+		}
+
+		glm::vec3 center = (low + high) * 0.5f;
+		float radius = 0.0f;
+
+		for (GLuint i = 0; i < count; i++)
+		{
+			glm::vec3 offset = position(positions, stride, indices[first + i]) - center;
+			radius = std::max(radius, glm::dot(offset, offset));
+		}
+
+		// The cone's axis is the triangles' average facing, and it's as wide as the one
+		// furthest from it. Past a right angle some face each other and it can't cull.
+		for (GLuint i = 0; i < count; i += 3)
+		{
+			normals += triangleNormal(positions, stride, &indices[first + i]);
+		}
+
+		float axisLength = glm::length(normals);
+		glm::vec3 axis = axisLength > 0.0f ? normals / axisLength : glm::vec3(0.0f);
+		float spread = axisLength > 0.0f ? 1.0f : -1.0f;
+
+		for (GLuint i = 0; i < count; i += 3)
+		{
+			glm::vec3 normal = triangleNormal(positions, stride, &indices[first + i]);
+
+			if (glm::dot(normal, normal) > 0.0f)
+			{
+				spread = std::min(spread, glm::dot(normal, axis));
+			}
+		}
+
+		this->firstIndex.push_back(first);
+		this->indexCount.push_back(count);
+		this->centerX.push_back(center.x);
+		this->centerY.push_back(center.y);
+		this->centerZ.push_back(center.z);
+		this->radius.push_back(std::sqrt(radius));
+		this->axisX.push_back(axis.x);
+		this->axisY.push_back(axis.y);
+		this->axisZ.push_back(axis.z);
+		this->cutoff.push_back(spread > 0.0f ? std::sqrt(1.0f - spread * spread) : 1.0f);
+	}
+
+	// Fills the bounds out to a multiple of four with meshlets behind every plane
+	void pad()
+	{
+		while (this->centerX.size() % 4)
+		{
+			this->centerX.push_back(0.0f);
+			this->centerY.push_back(0.0f);
+			this->centerZ.push_back(0.0f);
+			this->radius.push_back(-1e30f);
+			this->axisX.push_back(0.0f);
+			this->axisY.push_back(0.0f);
+			this->axisZ.push_back(0.0f);
+			this->cutoff.push_back(1.0f);
+		}
+	}
+
+	static const glm::vec3 &position(const void *positions, size_t stride, GLuint vertex)
+	{
+		return *(const glm::vec3 *)((const unsigned char *)positions + vertex * stride);
+	}
+
+	static glm::vec3 triangleNormal(const void *positions, size_t stride, const GLuint *triangle)
+	{
+		const glm::vec3 &a = position(positions, stride, triangle[0]);
+		glm::vec3 normal = glm::cross(position(positions, stride, triangle[1]) - a, position(positions, stride, triangle[2]) - a);
+		float length = glm::length(normal);
+		return length > 0.0f ? normal / length : glm::vec3(0.0f);
+	}
+};
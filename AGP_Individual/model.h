@@ -6,99 +6,316 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "SOIL2\SOIL2\SOIL2.h"
+#include "skyboxTexture.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include "packIOSystem.h"
+#include "assetManifest.h"
+#include "scratchArena.h"
+#include "streamBuffer.h"
 
 
 #include "Mesh.h"
+#include "objLoader.h"
+#include "gltfModel.h"
+#include "cullingPass.h"
+#include "lightBaker.h"
 
 using namespace std;
 
-GLint TextureFromFile(const char *path, string directory);
+// One placement of a mesh: the meshes several nodes share are uploaded once and
+// drawn once for each of them
+struct MeshInstance
+{
+	GLuint mesh;
+	glm::mat4 transform;	// the node's transform, accumulated down from the root
+};
+
+GLint TextureFromFile(const char *path, string directory, TextureRole role = TEXTURE_ROLE_DIFFUSE, TextureMemory *memory = NULL, bool *yCoCg = NULL);
 
 class Model
 {
 public:
 	/*  Functions   */
-	// Constructor, expects a filepath to a 3D model.
-	Model(GLchar *path, bool _b)
+	// Constructor, expects a filepath to a 3D model. residency says what the meshes
+	// keep in memory once they're uploaded, see GeometryResidency.
+	Model(GLchar *path, bool _b, GeometryResidency residency = GEOMETRY_KEEP)
 	{
-		this->loadModel(path, _b);
+		// What SOIL and stb_image allocate decoding the textures comes from one arena,
+		// reused image after image instead of going back to the heap for each
+		ScratchArena arena;
+		{
+			ArenaScope scope(arena);
+			this->loadModel(path, _b);
+		}
+		arena.Report(path);
+		this->SetResidency(residency);
+
+		if (!this->meshes.empty())
+		{
+			this->ReportGeometry(path);
+		}
 	}
 
-	// Draws the model, and thus all its meshes
-	void Draw(Shader shader)
+	// Changes what every mesh keeps in memory, reading their geometry back from the
+	// GPU when it's wanted again
+	void SetResidency(GeometryResidency residency)
 	{
 		for (GLuint i = 0; i < this->meshes.size(); i++)
 		{
-			this->meshes[i].Draw(shader);
+			this->meshes[i].SetResidency(residency);
 		}
 	}
 
-private:
-	/*  Model Data  */
-	vector<Mesh> meshes;
-	string directory;
-	vector<Texture> textures_loaded;	// Stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+	const vector<Mesh> &Meshes() const
+	{
+		return this->meshes;
+	}
 
-										/*  Functions   */
-										// Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-	void loadModel(string path, bool flag_uv)
+	void ReportGeometry(const string &name) const
 	{
-		// Read file via ASSIMP
-		Assimp::Importer importer;
-		const aiScene *scene;
+		size_t resident = 0, uploaded = 0;
 
-		if(flag_uv)
-			scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+		{
+			resident += this->meshes[i].ResidentBytes();
+			uploaded += this->meshes[i].UploadedBytes();
+		}
+
+		cout << "GEOMETRY::" << name << ":: " << this->meshes.size() << " meshes, " << uploaded / 1024 << " KB on the GPU, "
+			<< resident / 1024 << " KB kept in memory" << endl;
+	}
+
+	// Draws the model, and thus all its meshes, placed by model. Each mesh is drawn at
+	// every node that uses it, its textures bound once for all of them.
+	void Draw(const Shader &shader, const glm::mat4 &model)
+	{
+		// Every instance's matrix goes into the frame's stream at once, and each mesh
+		// is drawn in one instanced call reading its run of them
+		StreamBuffer *stream = StreamBuffer::Mounted();
+		StreamAllocation allocation;
+
+		if (stream && !this->instances.empty() &&
+			stream->Allocate(this->instances.size() * sizeof(glm::mat4), sizeof(glm::mat4), allocation))
+		{
+			glm::mat4 *transforms = (glm::mat4 *)allocation.pointer;
+
+			for (GLuint i = 0; i < this->instances.size(); i++)
+			{
+				transforms[i] = model * this->instances[i].transform;
+			}
+
+			stream->Commit();
+
+			for (GLuint i = 0; i < this->instances.size();)
+			{
+				GLuint mesh = this->instances[i].mesh, first = i;
+
+				while (i < this->instances.size() && this->instances[i].mesh == mesh)
+				{
+					i++;
+				}
+
+				this->meshes[mesh].DrawInstanced(shader, stream->Buffer(), allocation.offset + first * sizeof(glm::mat4), i - first);
+			}
+		}
 		else
-			scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+		{
+			this->drawEachInstance(shader, model);
+		}
 
-		// Check for errors
-		if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+		if (this->gltf.IsLoaded())
 		{
-			cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-			return;
+			this->gltf.Draw(shader, model);
 		}
-		// Retrieve the directory path of the filepath
-		this->directory = path.substr(0, path.find_last_of('/'));
+	}
+
+	// Hands every instance of the model, placed by model, to a culling pass to draw
+	// from then on. glTF primitives aren't culled; DrawUnculled draws those.
+	void AddTo(CullingPass &culling, const glm::mat4 &model) const
+	{
+		for (GLuint i = 0; i < this->instances.size(); i++)
+		{
+			culling.Add(this->meshes[this->instances[i].mesh], model * this->instances[i].transform);
+		}
+	}
+
+	// Draws what AddTo leaves out of the culling pass, placed by model
+	void DrawUnculled(const Shader &shader, const glm::mat4 &model) const
+	{
+		if (this->gltf.IsLoaded())
+		{
+			this->gltf.Draw(shader, model);
+		}
+	}
+
+	// The nearest hit along ray of any instance of the model, placed by model, with the
+	// mesh it hit in mesh when that's given. glTF primitives aren't hit.
+	bool Intersect(const Ray &ray, const glm::mat4 &model, RayHit &hit, GLuint *mesh = NULL) const
+	{
+		Ray nearest = ray;
+		bool found = false;
+
+		for (GLuint i = 0; i < this->instances.size(); i++)
+		{
+			if (this->meshes[this->instances[i].mesh].Bvh().Intersect(nearest, model * this->instances[i].transform, hit))
+			{
+				nearest.tMax = hit.t;
+				found = true;
+
+				if (mesh)
+				{
+					*mesh = this->instances[i].mesh;
+				}
+			}
+		}
+
+		return found;
+	}
+
+	// Whether any instance of the model, placed by model, is along ray
+	bool Occluded(const Ray &ray, const glm::mat4 &model) const
+	{
+		for (GLuint i = 0; i < this->instances.size(); i++)
+		{
+			if (this->meshes[this->instances[i].mesh].Bvh().Occluded(ray, model * this->instances[i].transform))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Hands every instance of the model, placed by model, to a light baker to cast
+	// shadows and bounce light
+	void AddTo(LightBaker &baker, const glm::mat4 &model) const
+	{
+		for (GLuint i = 0; i < this->instances.size(); i++)
+		{
+			baker.AddOccluder(this->meshes[this->instances[i].mesh], model * this->instances[i].transform);
+		}
+	}
+
+	// Gives each mesh of a model that never moves a lightmap of resolution texels, baked
+	// where its first instance is. The shader then lights it from the lightmap instead
+	// of the static lights.
+	void BakeLightmaps(LightBaker &baker, const glm::mat4 &model, GLsizei resolution)
+	{
+		for (GLuint i = 0; i < this->instances.size(); i++)
+		{
+			Mesh &mesh = this->meshes[this->instances[i].mesh];
+
+			if (i > 0 && this->instances[i - 1].mesh == this->instances[i].mesh)
+			{
+				continue;
+			}
+
+			GeometryResidency residency = mesh.Residency();
+			mesh.SetResidency(GEOMETRY_KEEP);
+
+			if (mesh.UnwrapLightmap(resolution))
+			{
+				vector<glm::vec3> texels = baker.BakeLightmap(mesh, model * this->instances[i].transform, resolution);
+
+				if (!texels.empty())
+				{
+					mesh.SetLightmap(texels, resolution);
+				}
+			}
+
+			mesh.SetResidency(residency);
+		}
+	}
+
+	// Gives each vertex of a model that moves its ambient occlusion, baked where its
+	// mesh's first instance is
+	void BakeOcclusion(LightBaker &baker, const glm::mat4 &model)
+	{
+		for (GLuint i = 0; i < this->instances.size(); i++)
+		{
+			Mesh &mesh = this->meshes[this->instances[i].mesh];
 
-		// Process ASSIMP's root node recursively
-		this->processNode(scene->mRootNode, scene);
+			if (i > 0 && this->instances[i - 1].mesh == this->instances[i].mesh)
+			{
+				continue;
+			}
+
+			GeometryResidency residency = mesh.Residency();
+			mesh.SetResidency(GEOMETRY_KEEP);
+			mesh.SetOcclusion(baker.BakeOcclusion(mesh, model * this->instances[i].transform));
+			mesh.SetResidency(residency);
+		}
 	}
 
-	// Processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-	void processNode(aiNode* node, const aiScene* scene)
+	// Cooked models (see AssetCooker) are the meshes of the model in the order the node
+	// walk finds them, each as its raw vertices and indices followed by its textures:
+	//	uint32 magic, version, sizeof(Vertex), mesh count
+	//	per mesh: uint32 vertex count, index count, texture count, Vertex[], uint32 indices[],
+	//		then per texture uint32 aiTextureType and the path's length and characters,
+	//		then its TriangleBvh, see TriangleBvh::Save
+	//	uint32 instance count, then per instance uint32 mesh and its float[16] transform
+	static const uint32_t CookedMagic = 'A' | ('G' << 8) | ('P' << 16) | ('M' << 24);
+	static const uint32_t CookedVersion = 3;
+
+	// Picks the storage format of a material texture from what it's used for
+	static TextureRole textureRoleFor(aiTextureType type)
 	{
-		// Process each mesh located at the current node
+		switch (type)
+		{
+		case aiTextureType_SPECULAR:
+			return TEXTURE_ROLE_SPECULAR;
+		case aiTextureType_NORMALS:
+		case aiTextureType_HEIGHT:	// OBJ's map_Bump, which the nanosuit uses for its normal maps
+			return TEXTURE_ROLE_NORMAL;
+		default:
+			return TEXTURE_ROLE_DIFFUSE;
+		}
+	}
+
+	// Walks the node tree, collecting each aiMesh once, in the order the walk first
+	// reaches it, and an instance of it for every node that references it. slots maps
+	// assimp's mesh indices to positions in meshes.
+	static void processNode(const aiNode *node, const aiScene *scene, const glm::mat4 &parent, vector<int> &slots,
+		vector<const aiMesh *> &meshes, vector<MeshInstance> &instances)
+	{
+		// assimp's matrices are row major, glm's column major
+		glm::mat4 transform = parent * glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+
 		for (GLuint i = 0; i < node->mNumMeshes; i++)
 		{
-			// The node object only contains indices to index the actual objects in the scene.
-			// The scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+			GLuint index = node->mMeshes[i];
+
+			if (slots[index] < 0)
+			{
+				slots[index] = (int)meshes.size();
+				meshes.push_back(scene->mMeshes[index]);
+			}
 
-			this->meshes.push_back(this->processMesh(mesh, scene));
+			MeshInstance instance = { (GLuint)slots[index], transform };
+			instances.push_back(instance);
 		}
 
-		// After we've processed all of the meshes (if any) we then recursively process each of the children nodes
 		for (GLuint i = 0; i < node->mNumChildren; i++)
 		{
-			this->processNode(node->mChildren[i], scene);
+			processNode(node->mChildren[i], scene, transform, slots, meshes, instances);
 		}
 	}
 
-	Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+	// Copies a mesh's positions, normals, texture coordinates and triangle indices out of assimp
+	static void extractGeometry(const aiMesh *mesh, vector<Vertex> &vertices, vector<GLuint> &indices)
 	{
-		// Data to fill
-		vector<Vertex> vertices;
-		vector<GLuint> indices;
-		vector<Texture> textures;
+		vertices.reserve(vertices.size() + mesh->mNumVertices);
+		indices.reserve(indices.size() + mesh->mNumFaces * 3);
 
 		// Walk through each of the mesh's vertices
 		for (GLuint i = 0; i < mesh->mNumVertices; i++)
@@ -159,6 +376,145 @@ private:
 				indices.push_back(face.mIndices[j]);
 			}
 		}
+	}
+
+private:
+	/*  Model Data  */
+	vector<Mesh> meshes;
+	vector<MeshInstance> instances;		// sorted by mesh, so a mesh's instances are drawn together
+	string directory;
+	vector<Texture> textures_loaded;	// Stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+	vector<GLTexture> textureHandles;	// owns the textures in textures_loaded, which the meshes share
+	TextureMemory textureMemory;		// GPU memory taken by textures_loaded
+	GltfModel gltf;						// a glTF model keeps its own buffers, nodes and materials
+
+										/*  Functions   */
+										// Loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+	void loadModel(string path, bool flag_uv)
+	{
+		// A cooked model skips assimp altogether
+		string cooked = AssetManifest::ResolveMounted(path);
+
+		if (cooked != path && this->loadCookedModel(cooked, path))
+		{
+			return;
+		}
+
+		// glTF is uploaded as it's laid out in the file
+		if (GltfModel::IsGltf(path) && this->gltf.Load(path))
+		{
+			return;
+		}
+
+		// OBJ files, which all our models are, skip assimp too
+		if (ObjLoader::IsObj(path) && this->loadObjModel(path))
+		{
+			return;
+		}
+
+		// Read file via ASSIMP
+		Assimp::Importer importer;
+		const aiScene *scene;
+
+		// A packed or read ahead model is read from memory, along with its material files
+		if (AssetPack::Mounted() || AsyncFileReader::Mounted())
+		{
+			importer.SetIOHandler(new PackIOSystem());
+		}
+
+		if(flag_uv)
+			scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		else
+			scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+
+		// Check for errors
+		if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+		{
+			cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+			return;
+		}
+		// Retrieve the directory path of the filepath
+		this->directory = path.substr(0, path.find_last_of('/'));
+
+		// Read every texture the materials use in one batch before any of them are decoded
+		AsyncFileReader *reader = AsyncFileReader::Mounted();
+		vector<string> texturePaths;
+
+		if (reader)
+		{
+			reader->Release(path);
+			this->queueMaterialTextures(scene, texturePaths);
+		}
+
+		// Upload each aiMesh once, however many nodes use it
+		vector<int> slots(scene->mNumMeshes, -1);
+		vector<const aiMesh *> unique;
+		processNode(scene->mRootNode, scene, glm::mat4(1.0f), slots, unique, this->instances);
+
+		this->meshes.reserve(unique.size());
+
+		for (GLuint i = 0; i < unique.size(); i++)
+		{
+			this->meshes.push_back(this->processMesh(unique[i], scene));
+		}
+
+		this->sortInstances();
+
+		for (GLuint i = 0; reader && i < texturePaths.size(); i++)
+		{
+			reader->Release(texturePaths[i]);
+		}
+
+		this->textureMemory.Report(path);
+	}
+
+	// Draws the instances one at a time, each matrix set as a constant attribute, for
+	// when there's no stream to put them in
+	void drawEachInstance(const Shader &shader, const glm::mat4 &model)
+	{
+		// From the frame's arena when there is one, so drawing doesn't touch the heap
+		vector<glm::mat4, ArenaAllocator<glm::mat4> > transforms;
+		transforms.reserve(this->instances.size());
+
+		for (GLuint i = 0; i < this->instances.size();)
+		{
+			GLuint mesh = this->instances[i].mesh;
+			transforms.clear();
+
+			for (; i < this->instances.size() && this->instances[i].mesh == mesh; i++)
+			{
+				transforms.push_back(model * this->instances[i].transform);
+			}
+
+			this->meshes[mesh].Draw(shader, transforms.data(), (GLuint)transforms.size());
+		}
+	}
+
+	// Groups each mesh's instances together, keeping the node order within them
+	void sortInstances()
+	{
+		stable_sort(this->instances.begin(), this->instances.end(),
+			[](const MeshInstance &a, const MeshInstance &b) { return a.mesh < b.mesh; });
+	}
+
+	// One untransformed instance of every mesh, for formats without a node tree
+	void instanceEachMesh()
+	{
+		for (GLuint i = 0; i < this->meshes.size(); i++)
+		{
+			MeshInstance instance = { i, glm::mat4(1.0f) };
+			this->instances.push_back(instance);
+		}
+	}
+
+	Mesh processMesh(const aiMesh *mesh, const aiScene *scene)
+	{
+		// Data to fill
+		vector<Vertex> vertices;
+		vector<GLuint> indices;
+		vector<Texture> textures;
+
+		this->extractGeometry(mesh, vertices, indices);
 
 		// Process materials
 		if (mesh->mMaterialIndex >= 0)
@@ -171,88 +527,319 @@ private:
 			// Specular: texture_specularN
 			// Normal: texture_normalN
 
+			textures.reserve(material->GetTextureCount(aiTextureType_DIFFUSE) + material->GetTextureCount(aiTextureType_SPECULAR));
+
 			// 1. Diffuse maps
-			vector<Texture> diffuseMaps = this->loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-			textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+			this->loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
 
 			// 2. Specular maps
-			vector<Texture> specularMaps = this->loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-			textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+			this->loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", textures);
 
 			// 3. Normal maps
-			//vector<Texture> normalMaps = this->loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
-			//textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+			//this->loadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal", textures);
 		}
 
 		// Return a mesh object created from the extracted mesh data
-		return Mesh(vertices, indices, textures);
+		return Mesh(std::move(vertices), std::move(indices), std::move(textures));
 	}
 
-	// Checks all material textures of a given type and loads the textures if they're not loaded yet.
-	// The required info is returned as a Texture struct.
-	vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+	// Queues the diffuse and specular maps of every material on the mounted reader and submits them
+	void queueMaterialTextures(const aiScene *scene, vector<string> &texturePaths)
 	{
-		vector<Texture> textures;
+		aiTextureType types[] = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR };
 
+		for (GLuint i = 0; i < scene->mNumMaterials; i++)
+		{
+			for (GLuint t = 0; t < sizeof(types) / sizeof(types[0]); t++)
+			{
+				for (GLuint j = 0; j < scene->mMaterials[i]->GetTextureCount(types[t]); j++)
+				{
+					aiString str;
+					scene->mMaterials[i]->GetTexture(types[t], j, &str);
+					texturePaths.push_back(AssetManifest::ResolveMounted(this->directory + '/' + str.C_Str()));
+					AsyncFileReader::Mounted()->Queue(texturePaths.back());
+				}
+			}
+		}
+
+		AsyncFileReader::Mounted()->Submit();
+	}
+
+	// Checks all material textures of a given type and loads the textures if they're not loaded yet.
+	// The required info is appended to textures as Texture structs.
+	void loadMaterialTextures(aiMaterial *mat, aiTextureType type, const char *typeName, vector<Texture> &textures)
+	{
 		for (GLuint i = 0; i < mat->GetTextureCount(type); i++)
 		{
 			aiString str;
 			mat->GetTexture(type, i, &str);
+			textures.push_back(this->loadTexture(str, type, typeName));
+		}
+	}
+
+	// Loads a material texture unless it was loaded before
+	Texture loadTexture(const aiString &str, aiTextureType type, const char *typeName)
+	{
+		// Check if texture was loaded before and if so, skip loading a new texture
+		for (GLuint j = 0; j < textures_loaded.size(); j++)
+		{
+			if (textures_loaded[j].path == str)
+			{
+				return textures_loaded[j]; // A texture with the same filepath has already been loaded. (optimization)
+			}
+		}
+
+		// If texture hasn't been loaded already, load it
+		Texture texture;
+		texture.id = TextureFromFile(str.C_Str(), this->directory, textureRoleFor(type), &this->textureMemory, &texture.yCoCg);
+		texture.type = typeName;
+		texture.path = str;
+
+		this->textureHandles.push_back(GLTexture(texture.id));
+		this->textures_loaded.push_back(texture);  // Store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+		return texture;
+	}
+
+	// Loads an OBJ model with ObjLoader, false if it can't be read so assimp can have a go
+	bool loadObjModel(const string &path)
+	{
+		ObjLoader loader;
+
+		if (!loader.Load(path))
+		{
+			cout << "ERROR::OBJ:: " << loader.Error() << endl;
+			return false;
+		}
+
+		this->directory = path.substr(0, path.find_last_of('/'));
+
+		// Read every texture the materials use in one batch before any of them are decoded
+		const vector<ObjMaterial> &materials = loader.Materials();
+		AsyncFileReader *reader = AsyncFileReader::Mounted();
+		vector<string> texturePaths;
+
+		for (GLuint i = 0; reader && i < materials.size(); i++)
+		{
+			vector<string> maps(materials[i].diffuseMaps);
+			maps.insert(maps.end(), materials[i].specularMaps.begin(), materials[i].specularMaps.end());
+
+			for (GLuint j = 0; j < maps.size(); j++)
+			{
+				texturePaths.push_back(AssetManifest::ResolveMounted(this->directory + '/' + maps[j]));
+				reader->Queue(texturePaths.back());
+			}
+		}
 
-			// Check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-			GLboolean skip = false;
+		if (reader)
+		{
+			reader->Release(path);
 
-			for (GLuint j = 0; j < textures_loaded.size(); j++)
+			for (GLuint i = 0; i < loader.MaterialLibraries().size(); i++)
 			{
-				if (textures_loaded[j].path == str)
+				reader->Release(loader.MaterialLibraries()[i]);
+			}
+
+			reader->Submit();
+		}
+
+		this->meshes.reserve(loader.Meshes().size());
+
+		for (GLuint m = 0; m < loader.Meshes().size(); m++)
+		{
+			ObjMesh &mesh = loader.Meshes()[m];
+			vector<Texture> textures;
+
+			if (mesh.material >= 0)
+			{
+				// Diffuse then specular, as processMesh orders them
+				const ObjMaterial &material = materials[mesh.material];
+				textures.reserve(material.diffuseMaps.size() + material.specularMaps.size());
+
+				for (GLuint i = 0; i < material.diffuseMaps.size(); i++)
 				{
-					textures.push_back(textures_loaded[j]);
-					skip = true; // A texture with the same filepath has already been loaded, continue to next one. (optimization)
+					aiString str;
+					str.Set(material.diffuseMaps[i]);
+					textures.push_back(this->loadTexture(str, aiTextureType_DIFFUSE, "texture_diffuse"));
+				}
 
-					break;
+				for (GLuint i = 0; i < material.specularMaps.size(); i++)
+				{
+					aiString str;
+					str.Set(material.specularMaps[i]);
+					textures.push_back(this->loadTexture(str, aiTextureType_SPECULAR, "texture_specular"));
 				}
 			}
 
-			if (!skip)
-			{   // If texture hasn't been loaded already, load it
-				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), this->directory);
-				texture.type = typeName;
-				texture.path = str;
-				textures.push_back(texture);
+			this->meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), std::move(textures));
+		}
+
+		this->instanceEachMesh();
+
+		for (GLuint i = 0; reader && i < texturePaths.size(); i++)
+		{
+			reader->Release(texturePaths[i]);
+		}
+
+		this->textureMemory.Report(path);
+		return true;
+	}
+
+	// Loads a model the cooker wrote, false if the file is missing or damaged so the
+	// source can be imported instead
+	bool loadCookedModel(const string &cookedPath, const string &path)
+	{
+		// Parsed where it lies when it's packed or read ahead, so it's never copied
+		AssetSlice bytes;
+
+		if (!AsyncFileReader::ReadAsset(cookedPath, bytes))
+		{
+			ifstream file(cookedPath.c_str(), ios::in | ios::binary);
+			bytes.decoded.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+			bytes.data = bytes.decoded.data();
+			bytes.size = bytes.decoded.size();
+		}
+
+		// Read everything first, so the textures can be read in one batch before any GL work
+		struct CookedMesh
+		{
+			vector<Vertex> vertices;
+			vector<GLuint> indices;
+			vector<pair<aiTextureType, aiString> > textures;
+			TriangleBvh bvh;
+		};
+
+		vector<CookedMesh> cookedMeshes;
+		size_t offset = 0;
+		uint32_t header[4], counts[3], texture[2];
+
+		bool valid = readCooked(bytes, offset, header, sizeof(header)) &&
+			header[0] == CookedMagic && header[1] == CookedVersion && header[2] == sizeof(Vertex);
+
+		for (uint32_t m = 0; valid && m < header[3]; m++)
+		{
+			CookedMesh mesh;
+			valid = readCooked(bytes, offset, counts, sizeof(counts)) &&
+				bytes.size - offset >= (size_t)counts[0] * sizeof(Vertex) + (size_t)counts[1] * sizeof(GLuint);
+
+			if (!valid)
+			{
+				break;
+			}
+
+			mesh.vertices.resize(counts[0]);
+			mesh.indices.resize(counts[1]);
+			readCooked(bytes, offset, mesh.vertices.data(), counts[0] * sizeof(Vertex));
+			readCooked(bytes, offset, mesh.indices.data(), counts[1] * sizeof(GLuint));
+
+			for (uint32_t t = 0; valid && t < counts[2]; t++)
+			{
+				valid = readCooked(bytes, offset, texture, sizeof(texture)) && bytes.size - offset >= texture[1] && texture[1] < MAXLEN;
 
-				this->textures_loaded.push_back(texture);  // Store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+				if (valid)
+				{
+					aiString str;
+					str.Set(string((const char *)bytes.data + offset, texture[1]));
+					offset += texture[1];
+					mesh.textures.push_back(make_pair((aiTextureType)texture[0], str));
+				}
 			}
+
+			valid = valid && mesh.bvh.Load(bytes.data, bytes.size, offset, mesh.vertices.size());
+
+			cookedMeshes.push_back(std::move(mesh));
 		}
 
-		return textures;
+		uint32_t instanceCount = 0;
+		vector<MeshInstance> instances;
+		valid = valid && readCooked(bytes, offset, &instanceCount, sizeof(instanceCount)) &&
+			(bytes.size - offset) / (sizeof(uint32_t) + 16 * sizeof(float)) >= instanceCount;
+
+		for (uint32_t i = 0; valid && i < instanceCount; i++)
+		{
+			uint32_t mesh;
+			float transform[16];
+			readCooked(bytes, offset, &mesh, sizeof(mesh));
+			readCooked(bytes, offset, transform, sizeof(transform));
+			valid = mesh < cookedMeshes.size();
+
+			MeshInstance instance = { mesh, glm::make_mat4(transform) };
+			instances.push_back(instance);
+		}
+
+		if (!valid)
+		{
+			cout << "ERROR::MODEL::COOKED_CORRUPT " << cookedPath << endl;
+			return false;
+		}
+
+		this->directory = path.substr(0, path.find_last_of('/'));
+
+		AsyncFileReader *reader = AsyncFileReader::Mounted();
+		vector<string> texturePaths;
+
+		for (GLuint m = 0; reader && m < cookedMeshes.size(); m++)
+		{
+			for (GLuint t = 0; t < cookedMeshes[m].textures.size(); t++)
+			{
+				texturePaths.push_back(AssetManifest::ResolveMounted(this->directory + '/' + cookedMeshes[m].textures[t].second.C_Str()));
+				reader->Queue(texturePaths.back());
+			}
+		}
+
+		if (reader)
+		{
+			reader->Submit();
+		}
+
+		for (GLuint m = 0; m < cookedMeshes.size(); m++)
+		{
+			vector<Texture> textures;
+
+			for (GLuint t = 0; t < cookedMeshes[m].textures.size(); t++)
+			{
+				aiTextureType type = cookedMeshes[m].textures[t].first;
+				textures.push_back(this->loadTexture(cookedMeshes[m].textures[t].second, type,
+					(type == aiTextureType_SPECULAR) ? "texture_specular" : (type == aiTextureType_DIFFUSE) ? "texture_diffuse" : "texture_normal"));
+			}
+
+			this->meshes.emplace_back(std::move(cookedMeshes[m].vertices), std::move(cookedMeshes[m].indices), std::move(textures), std::move(cookedMeshes[m].bvh));
+		}
+
+		this->instances = instances;
+		this->sortInstances();
+
+		for (GLuint i = 0; reader && i < texturePaths.size(); i++)
+		{
+			reader->Release(texturePaths[i]);
+		}
+
+		this->textureMemory.Report(path);
+		return true;
+	}
+
+	// Copies size bytes of a cooked model out, false when the file ends first
+	static bool readCooked(const AssetSlice &bytes, size_t &offset, void *destination, size_t size)
+	{
+		if (bytes.size - offset < size)
+		{
+			return false;
+		}
+
+		if (size)
+		{
+			memcpy(destination, bytes.data + offset, size);
+		}
+
+		offset += size;
+		return true;
 	}
 };
 
-GLint TextureFromFile(const char *path, string directory)
+GLint TextureFromFile(const char *path, string directory, TextureRole role, TextureMemory *memory, bool *yCoCg)
 {
-	//Generate texture ID and load texture data
+	// Texture paths are relative to the model file
 	string filename = string(path);
 	filename = directory + '/' + filename;
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height;
-
-	unsigned char *image = SOIL_load_image(filename.c_str(), &width, &height, 0, SOIL_LOAD_RGB);
-
-	// Assign texture to ID
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	// Parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	SOIL_free_image_data(image);
 
-	return textureID;
+	return TextureLoading::LoadTexture(filename.c_str(), role, memory, yCoCg);
 }
\ No newline at end of file
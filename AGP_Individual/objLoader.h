@@ -0,0 +1,934 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <assimp/scene.h>
+#include "shader.h"
+#include "Mesh.h"
+#include "asyncFileReader.h"
+
+using std::cout;
+using std::endl;
+
+// A material from an .mtl file, only the texture maps the models use
+struct ObjMaterial
+{
+	std::string name;
+	std::vector<std::string> diffuseMaps;	// map_Kd
+	std::vector<std::string> specularMaps;	// map_Ks
+	std::vector<std::string> normalMaps;	// map_Bump, bump, map_Kn or norm
+};
+
+// The faces of one object that share a material, ready for a Mesh
+struct ObjMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<GLuint> indices;
+	int material = -1;	// into ObjLoader::Materials, -1 when it has none
+};
+
+// Reads Wavefront OBJ models and their .mtl files without assimp, straight into the
+// vertex layout the meshes upload. The file is split at line ends into a chunk a
+// thread which are parsed at the same time, then the meshes are built in parallel,
+// each keeping one vertex per distinct position/texture coordinate/normal triple.
+// Polygons are fanned into triangles and texture coordinates flipped to match the
+// Triangulate | FlipUVs the models were imported with. Faces without normals get
+// smooth ones.
+class ObjLoader
+{
+public:
+	// A quiet loader keeps what it would print in Messages, for callers that print from
+	// several threads and serialise their own output
+	ObjLoader(unsigned threadCount = 0, bool quiet = false) : threadCount(threadCount), quiet(quiet), cornerCount(0), chunkCount(0)
+	{
+		if (this->threadCount == 0)
+		{
+			this->threadCount = std::thread::hardware_concurrency();
+			this->threadCount = this->threadCount ? this->threadCount : 1;
+		}
+	}
+
+	// Reads the model from the mounted pack or reader, or the disk, and the material
+	// libraries it names from next to it
+	bool Load(const std::string &path)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		AssetSlice slice;
+		std::string text;
+		this->meshes.clear();
+		this->materials.clear();
+		this->libraries.clear();
+		this->error.clear();
+		this->messages.clear();
+
+		if (!ReadText(path, slice, text))
+		{
+			this->error = "can't read " + path;
+			return false;
+		}
+
+		std::string directory = path.substr(0, path.find_last_of('/') + 1);
+		const char *data = slice.data ? (const char *)slice.data : text.data();
+		size_t size = slice.data ? slice.size : text.size();
+
+		if (!this->Parse(data, size, directory))
+		{
+			return false;
+		}
+
+		size_t vertexCount = 0;
+
+		for (size_t i = 0; i < this->meshes.size(); i++)
+		{
+			vertexCount += this->meshes[i].vertices.size();
+		}
+
+		double milliseconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+		std::ostringstream line;
+		line << "OBJ::" << path << ":: " << this->meshes.size() << " meshes, " << vertexCount << " vertices from "
+			<< this->cornerCount << " face corners in " << milliseconds << " ms, " << this->chunkCount << " chunks on "
+			<< this->threadCount << " threads";
+		this->report(line.str());
+
+		return true;
+	}
+
+	// Parses a model already in memory, directory being where its material libraries are
+	bool Parse(const char *data, size_t size, const std::string &directory)
+	{
+		// Split into chunks of whole lines, not so small a thread costs more than it saves
+		const size_t minimumChunk = 256 * 1024;
+		size_t chunkCount = size / minimumChunk + 1;
+		chunkCount = (chunkCount < this->threadCount) ? chunkCount : this->threadCount;
+		this->chunkCount = chunkCount;
+
+		std::vector<Chunk> chunks(chunkCount);
+		size_t begin = 0;
+
+		for (size_t c = 0; c < chunkCount; c++)
+		{
+			size_t end = (c + 1 == chunkCount) ? size : size * (c + 1) / chunkCount;
+
+			while (end < size && data[end - 1] != '\n')
+			{
+				end++;
+			}
+
+			end = (end > begin) ? end : begin;
+			chunks[c].begin = data + begin;
+			chunks[c].end = data + end;
+			begin = end;
+		}
+
+		this->RunParallel(&ObjLoader::ParseChunks, &chunks, chunkCount);
+
+		// Material libraries, in the order the file names them
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			for (size_t l = 0; l < chunks[c].libraries.size(); l++)
+			{
+				this->LoadMaterials(directory + chunks[c].libraries[l]);
+			}
+		}
+
+		// Index bases of each chunk, and which mesh each face belongs to: one for each
+		// object/group and material pair, in the order they first turn up
+		std::map<std::pair<std::string, std::string>, size_t> meshIndices;
+		std::string object, material;
+		size_t base[3] = { 0, 0, 0 };
+
+		this->faceLists.clear();
+		this->cornerCount = 0;
+
+		for (size_t c = 0; c < chunks.size(); c++)
+		{
+			Chunk &chunk = chunks[c];
+			chunk.base[0] = base[0];
+			chunk.base[1] = base[1];
+			chunk.base[2] = base[2];
+			base[0] += chunk.positions.size() / 3;
+			base[1] += chunk.texCoords.size() / 2;
+			base[2] += chunk.normals.size() / 3;
+
+			size_t event = 0;
+			size_t mesh = (size_t)-1;
+
+			for (size_t f = 0; f <= chunk.faces.size(); f++)
+			{
+				bool changed = (f == 0);
+
+				for (; event < chunk.events.size() && chunk.events[event].face == f; event++)
+				{
+					(chunk.events[event].material ? material : object) = chunk.events[event].name;
+					changed = true;
+				}
+
+				if (f == chunk.faces.size())
+				{
+					break;
+				}
+
+				if (changed)
+				{
+					std::pair<std::map<std::pair<std::string, std::string>, size_t>::iterator, bool> found =
+						meshIndices.insert(std::make_pair(std::make_pair(object, material), this->faceLists.size()));
+
+					if (found.second)
+					{
+						this->faceLists.push_back(FaceList());
+						this->faceLists.back().material = this->FindMaterial(material);
+					}
+
+					mesh = found.first->second;
+				}
+
+				FaceList &list = this->faceLists[mesh];
+
+				if (list.ranges.empty() || list.ranges.back().chunk != c || list.ranges.back().end != f)
+				{
+					FaceRange range = { c, f, f };
+					list.ranges.push_back(range);
+				}
+
+				list.ranges.back().end = f + 1;
+				list.cornerCount += chunk.faces[f].count;
+				list.indexCount += (chunk.faces[f].count - 2) * 3;
+				this->cornerCount += chunk.faces[f].count;
+			}
+		}
+
+		this->counts[0] = base[0];
+		this->counts[1] = base[1];
+		this->counts[2] = base[2];
+		this->chunks = &chunks;
+		this->meshes.assign(this->faceLists.size(), ObjMesh());
+		this->meshErrors.assign(this->faceLists.size(), std::string());
+
+		this->RunParallel(&ObjLoader::BuildMeshes, NULL, this->faceLists.size());
+
+		this->chunks = NULL;
+
+		for (size_t m = 0; m < this->meshErrors.size(); m++)
+		{
+			if (!this->meshErrors[m].empty())
+			{
+				this->error = this->meshErrors[m];
+				this->meshes.clear();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	const std::vector<ObjMesh> &Meshes() const
+	{
+		return this->meshes;
+	}
+
+	// For moving the meshes' vertices and indices out rather than copying them
+	std::vector<ObjMesh> &Meshes()
+	{
+		return this->meshes;
+	}
+
+	const std::vector<ObjMaterial> &Materials() const
+	{
+		return this->materials;
+	}
+
+	// The .mtl files that were read, for whatever needs to know what the model depends on
+	const std::vector<std::string> &MaterialLibraries() const
+	{
+		return this->libraries;
+	}
+
+	const std::string &Error() const
+	{
+		return this->error;
+	}
+
+	// The lines a quiet loader didn't print during the last Load
+	const std::string &Messages() const
+	{
+		return this->messages;
+	}
+
+	static bool IsObj(const std::string &path)
+	{
+		size_t dot = path.find_last_of('.');
+		std::string extension = (dot == std::string::npos) ? "" : path.substr(dot + 1);
+
+		for (size_t i = 0; i < extension.size(); i++)
+		{
+			extension[i] = (char)tolower((unsigned char)extension[i]);
+		}
+
+		return extension == "obj";
+	}
+
+private:
+	// A state change at the start of a face: a new object/group or material
+	struct Event
+	{
+		size_t face;
+		bool material;
+		std::string name;
+	};
+
+	struct Face
+	{
+		uint32_t firstCorner;
+		uint32_t count;
+		uint32_t seen[3];	// positions, texture coordinates and normals the chunk had by then, for negative indices
+	};
+
+	struct Chunk
+	{
+		const char *begin;
+		const char *end;
+		std::vector<float> positions;	// 3 a vertex
+		std::vector<float> texCoords;	// 2 a vertex
+		std::vector<float> normals;		// 3 a vertex
+		std::vector<int> corners;		// position, texture coordinate and normal index as written, 0 when missing
+		std::vector<Face> faces;
+		std::vector<Event> events;
+		std::vector<std::string> libraries;
+		size_t base[3];					// positions, texture coordinates and normals in the chunks before
+		std::string error;
+	};
+
+	struct FaceRange
+	{
+		size_t chunk;
+		size_t begin;
+		size_t end;
+	};
+
+	struct FaceList
+	{
+		std::vector<FaceRange> ranges;
+		size_t cornerCount = 0;
+		size_t indexCount = 0;	// once fanned into triangles
+		int material = -1;
+	};
+
+	struct CornerKey
+	{
+		int64_t position, texCoord, normal;
+
+		bool operator==(const CornerKey &other) const
+		{
+			return this->position == other.position && this->texCoord == other.texCoord && this->normal == other.normal;
+		}
+	};
+
+	static const GLuint EmptySlot = 0xFFFFFFFF;
+
+	static size_t HashCorner(const CornerKey &key)
+	{
+		uint64_t hash = (uint64_t)key.position * 0x9E3779B97F4A7C15ull;
+		hash ^= (uint64_t)key.texCoord * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+		hash ^= (uint64_t)key.normal * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+		return (size_t)(hash ^ (hash >> 32));
+	}
+
+	unsigned threadCount;
+	bool quiet;
+	std::string messages;
+	std::vector<ObjMesh> meshes;
+	std::vector<ObjMaterial> materials;
+	std::vector<std::string> libraries;
+	std::string error;
+
+	// Shared with the threads while a file is parsed
+	std::vector<Chunk> *chunks = NULL;
+	std::vector<FaceList> faceLists;
+	std::vector<std::string> meshErrors;
+	size_t counts[3];
+	size_t cornerCount;
+	size_t chunkCount;
+
+	// Runs work over items 0 to count - 1 on up to threadCount threads, this one included
+	void RunParallel(void (ObjLoader::*work)(std::vector<Chunk> *, std::atomic<size_t> *, size_t), std::vector<Chunk> *chunks, size_t count)
+	{
+		std::atomic<size_t> next(0);
+		std::vector<std::thread> workers;
+		size_t threads = (this->threadCount < count) ? this->threadCount : count;
+
+		for (size_t t = 1; t < threads; t++)
+		{
+			workers.push_back(std::thread(work, this, chunks, &next, count));
+		}
+
+		(this->*work)(chunks, &next, count);
+
+		for (size_t t = 0; t < workers.size(); t++)
+		{
+			workers[t].join();
+		}
+	}
+
+	void ParseChunks(std::vector<Chunk> *chunks, std::atomic<size_t> *next, size_t count)
+	{
+		for (size_t c = (*next)++; c < count; c = (*next)++)
+		{
+			ParseChunk((*chunks)[c]);
+		}
+	}
+
+	static void ParseChunk(Chunk &chunk)
+	{
+		const char *p = chunk.begin;
+		const char *end = chunk.end;
+
+		while (p < end)
+		{
+			const char *next = (const char *)memchr(p, '\n', end - p);
+			next = next ? next + 1 : end;
+			const char *lineEnd = LineEnd(p, next);
+			p = SkipSpace(p, lineEnd);
+
+			if (p == lineEnd || *p == '#')
+			{
+				p = next;
+				continue;
+			}
+
+			if (p[0] == 'v' && p + 1 < lineEnd && (p[1] == ' ' || p[1] == '\t'))
+			{
+				p = ParseFloats(p + 2, lineEnd, chunk.positions, 3);
+			}
+			else if (p[0] == 'v' && p + 2 < lineEnd && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+			{
+				p = ParseFloats(p + 3, lineEnd, chunk.texCoords, 2);
+				chunk.texCoords.back() = 1.0f - chunk.texCoords.back();
+			}
+			else if (p[0] == 'v' && p + 2 < lineEnd && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+			{
+				p = ParseFloats(p + 3, lineEnd, chunk.normals, 3);
+			}
+			else if (p[0] == 'f' && p + 1 < lineEnd && (p[1] == ' ' || p[1] == '\t'))
+			{
+				ParseFace(p + 2, lineEnd, chunk);
+			}
+			else if ((p[0] == 'o' || p[0] == 'g') && p + 1 < lineEnd && (p[1] == ' ' || p[1] == '\t'))
+			{
+				Event event = { chunk.faces.size(), false, RestOfLine(p + 2, lineEnd) };
+				chunk.events.push_back(event);
+			}
+			else if (Keyword(p, lineEnd, "usemtl"))
+			{
+				Event event = { chunk.faces.size(), true, RestOfLine(p + 6, lineEnd) };
+				chunk.events.push_back(event);
+			}
+			else if (Keyword(p, lineEnd, "mtllib"))
+			{
+				chunk.libraries.push_back(RestOfLine(p + 6, lineEnd));
+			}
+
+			p = next;
+		}
+	}
+
+	// A face's corners are v, v/vt, v//vn or v/vt/vn, with negative indices counting
+	// back from the last vertex so far
+	static void ParseFace(const char *p, const char *end, Chunk &chunk)
+	{
+		Face face = { (uint32_t)(chunk.corners.size() / 3), 0,
+			{ (uint32_t)(chunk.positions.size() / 3), (uint32_t)(chunk.texCoords.size() / 2), (uint32_t)(chunk.normals.size() / 3) } };
+
+		while ((p = SkipSpace(p, end)) < end)
+		{
+			int corner[3] = { 0, 0, 0 };
+
+			for (int i = 0; i < 3 && p < end; i++)
+			{
+				if (*p != '/')
+				{
+					p = ParseInt(p, end, corner[i]);
+				}
+
+				if (p < end && *p == '/')
+				{
+					p++;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			while (p < end && *p != ' ' && *p != '\t')
+			{
+				p++;
+			}
+
+			if (corner[0] != 0)
+			{
+				chunk.corners.insert(chunk.corners.end(), corner, corner + 3);
+				face.count++;
+			}
+		}
+
+		if (face.count >= 3)
+		{
+			chunk.faces.push_back(face);
+		}
+		else
+		{
+			chunk.corners.resize(face.firstCorner * 3);
+		}
+	}
+
+	void BuildMeshes(std::vector<Chunk> *, std::atomic<size_t> *next, size_t count)
+	{
+		for (size_t m = (*next)++; m < count; m = (*next)++)
+		{
+			this->BuildMesh(m);
+		}
+	}
+
+	void BuildMesh(size_t m)
+	{
+		const FaceList &list = this->faceLists[m];
+		ObjMesh &mesh = this->meshes[m];
+		std::vector<GLuint> face;
+		bool missingNormals = false;
+
+		// Open addressed table of the vertices so far, by their corner, at most half full
+		std::vector<CornerKey> keys;
+		std::vector<GLuint> slots;
+		size_t mask = 15;
+
+		while (mask < list.cornerCount * 2)
+		{
+			mask = mask * 2 + 1;
+		}
+
+		slots.assign(mask + 1, (GLuint)EmptySlot);
+		keys.reserve(list.cornerCount);
+		mesh.material = list.material;
+		mesh.vertices.reserve(list.cornerCount);
+		mesh.indices.reserve(list.indexCount);
+
+		for (size_t r = 0; r < list.ranges.size(); r++)
+		{
+			const Chunk &chunk = (*this->chunks)[list.ranges[r].chunk];
+
+			for (size_t f = list.ranges[r].begin; f < list.ranges[r].end; f++)
+			{
+				const Face &source = chunk.faces[f];
+				face.clear();
+
+				for (uint32_t c = 0; c < source.count; c++)
+				{
+					const int *corner = &chunk.corners[(source.firstCorner + c) * 3];
+					CornerKey key;
+
+					if (!this->Resolve(corner[0], chunk, source, 0, key.position) ||
+						!this->Resolve(corner[1], chunk, source, 1, key.texCoord) ||
+						!this->Resolve(corner[2], chunk, source, 2, key.normal) || key.position < 0)
+					{
+						this->meshErrors[m] = "face index out of range";
+						return;
+					}
+
+					size_t slot = HashCorner(key) & mask;
+
+					while (slots[slot] != EmptySlot && !(keys[slots[slot]] == key))
+					{
+						slot = (slot + 1) & mask;
+					}
+
+					if (slots[slot] == EmptySlot)
+					{
+						slots[slot] = (GLuint)keys.size();
+						keys.push_back(key);
+						mesh.vertices.push_back(this->MakeVertex(key));
+						missingNormals |= (key.normal < 0);
+					}
+
+					face.push_back(slots[slot]);
+				}
+
+				// Fan the polygon into triangles
+				for (size_t c = 2; c < face.size(); c++)
+				{
+					mesh.indices.push_back(face[0]);
+					mesh.indices.push_back(face[c - 1]);
+					mesh.indices.push_back(face[c]);
+				}
+			}
+		}
+
+		if (missingNormals)
+		{
+			SmoothNormals(mesh);
+		}
+	}
+
+	// Turns a corner's index as written into one into all the file's vertices of its
+	// kind, -1 when it had none
+	bool Resolve(int index, const Chunk &chunk, const Face &face, int kind, int64_t &resolved) const
+	{
+		if (index == 0)
+		{
+			resolved = -1;
+			return true;
+		}
+
+		resolved = (index > 0) ? (int64_t)index - 1 : (int64_t)chunk.base[kind] + face.seen[kind] + index;
+		return resolved >= 0 && (size_t)resolved < this->counts[kind];
+	}
+
+	Vertex MakeVertex(const CornerKey &key) const
+	{
+		Vertex vertex;
+		const float *position = this->Find(key.position, 0, 3);
+		vertex.Position = glm::vec3(position[0], position[1], position[2]);
+
+		if (key.normal >= 0)
+		{
+			const float *normal = this->Find(key.normal, 2, 3);
+			vertex.Normal = glm::vec3(normal[0], normal[1], normal[2]);
+		}
+		else
+		{
+			vertex.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
+		}
+
+		if (key.texCoord >= 0)
+		{
+			const float *texCoord = this->Find(key.texCoord, 1, 2);
+			vertex.TexCoords = glm::vec2(texCoord[0], texCoord[1]);
+		}
+		else
+		{
+			vertex.TexCoords = glm::vec2(0.0f, 0.0f);
+		}
+
+		return vertex;
+	}
+
+	// The values of one of the file's vertices, from whichever chunk read it
+	const float *Find(int64_t index, int kind, int components) const
+	{
+		const std::vector<Chunk> &chunks = *this->chunks;
+		size_t c = chunks.size() - 1;
+
+		while (c > 0 && (size_t)index < chunks[c].base[kind])
+		{
+			c--;
+		}
+
+		const std::vector<float> &values = (kind == 0) ? chunks[c].positions : (kind == 1) ? chunks[c].texCoords : chunks[c].normals;
+		return &values[(size_t)(index - chunks[c].base[kind]) * components];
+	}
+
+	// Gives vertices that came without a normal the area weighted average of their faces'
+	static void SmoothNormals(ObjMesh &mesh)
+	{
+		std::vector<bool> generated(mesh.vertices.size());
+
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+		{
+			generated[v] = (mesh.vertices[v].Normal.x == 0.0f && mesh.vertices[v].Normal.y == 0.0f && mesh.vertices[v].Normal.z == 0.0f);
+		}
+
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const glm::vec3 &a = mesh.vertices[mesh.indices[i]].Position;
+			const glm::vec3 &b = mesh.vertices[mesh.indices[i + 1]].Position;
+			const glm::vec3 &c = mesh.vertices[mesh.indices[i + 2]].Position;
+			glm::vec3 normal = glm::cross(b - a, c - a);
+
+			for (int corner = 0; corner < 3; corner++)
+			{
+				if (generated[mesh.indices[i + corner]])
+				{
+					mesh.vertices[mesh.indices[i + corner]].Normal += normal;
+				}
+			}
+		}
+
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+		{
+			float length = glm::length(mesh.vertices[v].Normal);
+
+			if (generated[v] && length > 0.0f)
+			{
+				mesh.vertices[v].Normal /= length;
+			}
+		}
+	}
+
+	// Prints a line, or keeps it when the loader is quiet
+	void report(const std::string &line)
+	{
+		if (!this->quiet)
+		{
+			cout << line << endl;
+			return;
+		}
+
+		this->messages += this->messages.empty() ? line : "\n" + line;
+	}
+
+	// Reads the materials of an .mtl file, a missing one leaves the faces untextured
+	void LoadMaterials(const std::string &path)
+	{
+		AssetSlice slice;
+		std::string text;
+
+		if (!ReadText(path, slice, text))
+		{
+			this->report("ERROR::OBJ::MISSING_MATERIAL_LIBRARY " + path);
+			return;
+		}
+
+		this->libraries.push_back(path);
+
+		const char *p = slice.data ? (const char *)slice.data : text.data();
+		const char *end = p + (slice.data ? slice.size : text.size());
+
+		while (p < end)
+		{
+			const char *next = (const char *)memchr(p, '\n', end - p);
+			next = next ? next + 1 : end;
+			const char *lineEnd = LineEnd(p, next);
+			p = SkipSpace(p, lineEnd);
+
+			if (Keyword(p, lineEnd, "newmtl"))
+			{
+				ObjMaterial material;
+				material.name = RestOfLine(p + 6, lineEnd);
+				this->materials.push_back(material);
+			}
+			else if (!this->materials.empty())
+			{
+				ObjMaterial &material = this->materials.back();
+
+				if (Keyword(p, lineEnd, "map_Kd"))
+				{
+					material.diffuseMaps.push_back(MapFile(p + 6, lineEnd));
+				}
+				else if (Keyword(p, lineEnd, "map_Ks"))
+				{
+					material.specularMaps.push_back(MapFile(p + 6, lineEnd));
+				}
+				else if (Keyword(p, lineEnd, "map_Bump") || Keyword(p, lineEnd, "map_bump") || Keyword(p, lineEnd, "map_Kn"))
+				{
+					material.normalMaps.push_back(MapFile(p + ((p[4] == 'K') ? 6 : 8), lineEnd));
+				}
+				else if (Keyword(p, lineEnd, "bump") || Keyword(p, lineEnd, "norm"))
+				{
+					material.normalMaps.push_back(MapFile(p + 4, lineEnd));
+				}
+			}
+
+			p = next;
+		}
+	}
+
+	int FindMaterial(const std::string &name) const
+	{
+		for (size_t i = 0; i < this->materials.size(); i++)
+		{
+			if (this->materials[i].name == name)
+			{
+				return (int)i;
+			}
+		}
+
+		return -1;
+	}
+
+	static bool ReadText(const std::string &path, AssetSlice &slice, std::string &text)
+	{
+		if (AsyncFileReader::ReadAsset(path, slice))
+		{
+			return true;
+		}
+
+		slice = AssetSlice();
+		std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		file.seekg(0, std::ios::end);
+		text.resize((size_t)file.tellg());
+		file.seekg(0, std::ios::beg);
+		file.read(&text[0], text.size());
+		return !file.fail();
+	}
+
+	// A texture map's file name, after any options like "-bm 0.5" or "-o 0 0 0"
+	static std::string MapFile(const char *p, const char *end)
+	{
+		p = SkipSpace(p, end);
+
+		while (p < end && *p == '-' && !(p + 1 < end && (p[1] == '.' || (p[1] >= '0' && p[1] <= '9'))))
+		{
+			// The option, then its arguments: numbers, on/off or a channel
+			while (p < end && *p != ' ' && *p != '\t')
+			{
+				p++;
+			}
+
+			for (p = SkipSpace(p, end); p < end; p = SkipSpace(p, end))
+			{
+				const char *word = p;
+
+				while (p < end && *p != ' ' && *p != '\t')
+				{
+					p++;
+				}
+
+				std::string argument(word, p);
+				bool number = !argument.empty() && strspn(argument.c_str(), "+-.0123456789eE") == argument.size();
+
+				if (!number && argument != "on" && argument != "off" && !(argument.size() == 1 && strchr("rgbmlz", argument[0])))
+				{
+					p = word;
+					break;
+				}
+			}
+		}
+
+		return RestOfLine(p, end);
+	}
+
+	// Where a line's text stops, before its line break and any trailing space
+	static const char *LineEnd(const char *p, const char *next)
+	{
+		while (next > p && (next[-1] == '\n' || next[-1] == '\r' || next[-1] == ' ' || next[-1] == '\t'))
+		{
+			next--;
+		}
+
+		return next;
+	}
+
+	static const char *SkipSpace(const char *p, const char *end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+		{
+			p++;
+		}
+
+		return p;
+	}
+
+	static bool Keyword(const char *p, const char *end, const char *keyword)
+	{
+		size_t length = strlen(keyword);
+		return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+	}
+
+	// The rest of a line without the space before it
+	static std::string RestOfLine(const char *p, const char *end)
+	{
+		p = SkipSpace(p, end);
+		return std::string(p, end);
+	}
+
+	static const char *ParseInt(const char *p, const char *end, int &value)
+	{
+		bool negative = (p < end && *p == '-');
+		p += (p < end && (*p == '-' || *p == '+')) ? 1 : 0;
+		int result = 0;
+
+		while (p < end && (unsigned)(*p - '0') < 10)
+		{
+			result = result * 10 + (*p - '0');
+			p++;
+		}
+
+		value = negative ? -result : result;
+		return p;
+	}
+
+	// Reads count floats, missing ones as 0. Digits are gathered into one integer and
+	// scaled once by a power of ten, much quicker than strtod and free of the locale.
+	static const char *ParseFloats(const char *p, const char *end, std::vector<float> &values, int count)
+	{
+		static const double powers[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		for (int i = 0; i < count; i++)
+		{
+			p = SkipSpace(p, end);
+			bool negative = (p < end && *p == '-');
+			p += (p < end && (*p == '-' || *p == '+')) ? 1 : 0;
+
+			uint64_t mantissa = 0;
+			int digits = 0, exponent = 0;
+
+			for (; p < end && (unsigned)(*p - '0') < 10; p++)
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += (mantissa != 0);
+				}
+				else
+				{
+					exponent++;
+				}
+			}
+
+			if (p < end && *p == '.')
+			{
+				for (p++; p < end && (unsigned)(*p - '0') < 10; p++)
+				{
+					if (digits < 19)
+					{
+						mantissa = mantissa * 10 + (*p - '0');
+						digits += (mantissa != 0);
+						exponent--;
+					}
+				}
+			}
+
+			if (p < end && (*p == 'e' || *p == 'E'))
+			{
+				int written = 0;
+				p = ParseInt(p + 1, end, written);
+				exponent += written;
+			}
+
+			double value = (double)mantissa;
+
+			if (exponent < 0)
+			{
+				value = (exponent >= -22) ? value / powers[-exponent] : value * pow(10.0, exponent);
+			}
+			else if (exponent > 0)
+			{
+				value = (exponent <= 22) ? value * powers[exponent] : value * pow(10.0, exponent);
+			}
+
+			values.push_back((float)(negative ? -value : value));
+		}
+
+		return p;
+	}
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstring>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/DefaultIOSystem.h>
+#include "asyncFileReader.h"
+
+// One packed or read ahead file for assimp to read, straight from memory
+class PackIOStream : public Assimp::IOStream
+{
+public:
+	// Takes over the slice, decoded data and all
+	PackIOStream(AssetSlice &slice) : position(0)
+	{
+		// Swapping keeps the decoded buffer where it is, so data still points into it
+		this->slice.decoded.swap(slice.decoded);
+		this->slice.data = slice.data;
+		this->slice.size = slice.size;
+	}
+
+	size_t Read(void *buffer, size_t size, size_t count)
+	{
+		if (size == 0)
+		{
+			return 0;
+		}
+
+		size_t available = (this->slice.size - this->position) / size;
+		count = (count < available) ? count : available;
+		memcpy(buffer, this->slice.data + this->position, size * count);
+		this->position += size * count;
+		return count;
+	}
+
+	size_t Write(const void *, size_t, size_t)
+	{
+		return 0;
+	}
+
+	aiReturn Seek(size_t offset, aiOrigin origin)
+	{
+		size_t base = (origin == aiOrigin_CUR) ? this->position : (origin == aiOrigin_END) ? this->slice.size : 0;
+
+		if (offset > this->slice.size || base + offset > this->slice.size)
+		{
+			return aiReturn_FAILURE;
+		}
+
+		this->position = base + offset;
+		return aiReturn_SUCCESS;
+	}
+
+	size_t Tell() const
+	{
+		return this->position;
+	}
+
+	size_t FileSize() const
+	{
+		return this->slice.size;
+	}
+
+	void Flush()
+	{
+	}
+
+private:
+	AssetSlice slice;
+	size_t position;
+};
+
+// Lets an Assimp::Importer open a model and the files it refers to (materials,
+// textures it embeds) from the mounted AssetPack or AsyncFileReader instead of the
+// disk, anything neither of them has is opened as usual. The importer deletes it,
+// the pack and reader have to keep their files until the model is loaded.
+class PackIOSystem : public Assimp::IOSystem
+{
+public:
+	bool Exists(const char *file) const
+	{
+		AssetSlice slice;
+
+		// checking the pack's table first saves decoding a compressed file just to find it
+		return (AssetPack::Mounted() && AssetPack::Mounted()->Contains(file)) ||
+			(AsyncFileReader::Mounted() && AsyncFileReader::Mounted()->Read(file, slice)) || this->disk.Exists(file);
+	}
+
+	char getOsSeparator() const
+	{
+		return '/';
+	}
+
+	Assimp::IOStream *Open(const char *file, const char *mode = "rb")
+	{
+		AssetSlice slice;
+
+		if (strchr(mode, 'w') || strchr(mode, 'a') || !AsyncFileReader::ReadAsset(file, slice))
+		{
+			return this->disk.Open(file, mode);
+		}
+
+		return new PackIOStream(slice);
+	}
+
+	void Close(Assimp::IOStream *file)
+	{
+		delete file;
+	}
+
+private:
+	Assimp::DefaultIOSystem disk;
+};
@@ -0,0 +1,39 @@
+#version 330 core
+out float Depth;
+
+// the depth buffer for the first level, after that the level above, as its only level
+uniform sampler2D source;
+uniform bool first;
+
+float Fetch(ivec2 texel, ivec2 size)
+{
+    return texelFetch(source, min(texel, size - 1), 0).r;
+}
+
+void main()
+{
+    ivec2 size = textureSize(source, 0);
+
+    if (first)
+    {
+        Depth = Fetch(ivec2(gl_FragCoord.xy), size);
+        return;
+    }
+
+    // the farthest of the 2x2 under this texel, and of the row or column past them
+    // when it's the last of an odd sized level, which rounded down leaves it out
+    ivec2 texel = ivec2(gl_FragCoord.xy) * 2;
+    int right = (texel.x + 2 == size.x - 1) ? 2 : 1;
+    int bottom = (texel.y + 2 == size.y - 1) ? 2 : 1;
+    float farthest = 0.0;
+
+    for (int j = 0; j <= bottom; j++)
+    {
+        for (int i = 0; i <= right; i++)
+        {
+            farthest = max(farthest, Fetch(texel + ivec2(i, j), size));
+        }
+    }
+
+    Depth = farthest;
+}
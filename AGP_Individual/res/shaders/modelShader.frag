@@ -6,6 +6,7 @@ struct Material {
     sampler2D diffuse;
     sampler2D specular;
     float shininess;
+    bool diffuseYCoCg; // diffuse holds scaled YCoCg (Co, Cg, scale, Y) from a cooked DDS
 }; 
 
 struct DirLight {
@@ -16,31 +17,28 @@ struct DirLight {
     vec3 specular;
 };
 
+// the lights' floats fill the gaps std140 leaves after each vec3
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-	
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
-  
+    vec3 ambient;
     float constant;
+    vec3 diffuse;
     float linear;
+    vec3 specular;
     float quadratic;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;       
 };
 
 #define NR_POINT_LIGHTS 1
@@ -51,17 +49,30 @@ in vec2 TexCoords;
 in vec3 TangentLightPos;
 in vec3 TangentViewPos;
 in vec3 TangentFragPos;
+in vec2 LightmapCoords;
+in float Occlusion;
+
+// written once a frame into the stream buffer
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
 uniform Material material;
 uniform vec3 lightPos;
 uniform sampler2D normalMap;
 uniform sampler2D diffuseMap;
+uniform sampler2D lightmap; // the static lights' light, baked, where LightmapCoords are set
 
 
+vec3 SampleDiffuse(vec2 texCoords);
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -73,21 +84,33 @@ void main()
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
     
-    // directional lighting
-    vec3 result = CalcDirLight(dirLight, norm, viewDir);
-
-    // point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);   
+    vec3 result;
+
+    // the directional and point lights come from the lightmap when there is one
+    if (LightmapCoords.x >= 0.0)
+    {
+        result = texture(lightmap, LightmapCoords).rgb * SampleDiffuse(TexCoords);
+    }
+    else
+    {
+        // directional lighting
+        result = CalcDirLight(dirLight, norm, viewDir);
+
+        // point lights
+        for(int i = 0; i < NR_POINT_LIGHTS; i++)
+            result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);   
+    }
 		
     // spot light
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir); 
 	
 	//normal mapping 
-	//obtain normal from normal map in range [0,1]
-	norm = texture(normalMap, TexCoords).rgb;
-	//transform normal vector to range [-1,1]
-	norm = normalize(norm * 2.0 - 1.0); // this normal is in tangent space
+	//obtain normal XY from the RG8 normal map in range [0,1]
+	vec2 normXY = texture(normalMap, TexCoords).rg;
+	//transform to range [-1,1] and rebuild Z, which always points out of the surface
+	norm.xy = normXY * 2.0 - 1.0;
+	norm.z = sqrt(max(1.0 - dot(norm.xy, norm.xy), 0.0));
+	norm = normalize(norm); // this normal is in tangent space
 
 	//get difuse colour
 	vec3 colour = texture(diffuseMap, TexCoords).rgb;
@@ -107,6 +130,21 @@ void main()
     FragColor = vec4(result, 1.0);
 }
 
+// samples the diffuse map, converting scaled YCoCg back to RGB.
+vec3 SampleDiffuse(vec2 texCoords)
+{
+    vec4 texel = texture(material.diffuse, texCoords);
+    if (!material.diffuseYCoCg)
+        return texel.rgb;
+    // the scale is stored as 0, 1 or 3 in the 5 bits of blue, and the chroma
+    // offsets are where 0 lands exactly in 5 and 6 bits
+    float scale = 1.0 / (floor(texel.b * 31.0 + 0.5) + 1.0);
+    float Co = (texel.r - 16.0 / 31.0) * scale;
+    float Cg = (texel.g - 32.0 / 63.0) * scale;
+    float Y = texel.a;
+    return vec3(Y + Co - Cg, Y + Cg, Y - Co - Cg);
+}
+
 // calculates the color when using a directional light.
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
@@ -116,9 +154,9 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+    // combine results, the ambient darkened by the baked occlusion
+    vec3 ambient = light.ambient * Occlusion * SampleDiffuse(TexCoords);
+    vec3 diffuse = light.diffuse * diff * SampleDiffuse(TexCoords);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
     return (ambient + diffuse + specular);
 }
@@ -135,9 +173,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
-    // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+    // combine results, the ambient darkened by the baked occlusion
+    vec3 ambient = light.ambient * Occlusion * SampleDiffuse(TexCoords);
+    vec3 diffuse = light.diffuse * diff * SampleDiffuse(TexCoords);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
     ambient *= attenuation;
     diffuse *= attenuation;
@@ -162,8 +200,8 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 ambient = light.ambient * SampleDiffuse(TexCoords);
+    vec3 diffuse = light.diffuse * diff * SampleDiffuse(TexCoords);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
@@ -4,6 +4,8 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec4 aBitangent;
+layout (location = 5) in mat4 aModel; // per instance, from the frame's stream buffer
+layout (location = 9) in vec3 aBaked; // lightmap coordinates, -1 without one, and ambient occlusion
 
 out vec3 FragPos;
 out vec3 Normal;
@@ -11,21 +13,27 @@ out vec2 TexCoords;
 out vec3 TangentLightPos;
 out vec3 TangentViewPos;
 out vec3 TangentFragPos;
+out vec2 LightmapCoords;
+out float Occlusion;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// written once a frame into the stream buffer, shared with the fragment shader
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
 uniform vec3 lightPos;
-uniform vec3 viewPos;
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;  
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(aModel))) * aNormal;  
     TexCoords = aTexCoords;
+    LightmapCoords = aBaked.xy;
+    Occlusion = aBaked.z;
     
-	mat3 normalMatrix = transpose(inverse(mat3(model)));
+	mat3 normalMatrix = transpose(inverse(mat3(aModel)));
 	vec3 T = normalize(normalMatrix * aTangent);
 	vec3 N = normalize(normalMatrix * aNormal);
 	T = normalize(T - dot(T, N) * N);
@@ -37,6 +45,6 @@ void main()
 	TangentFragPos = TBN * FragPos;
 
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * aModel * vec4(aPos, 1.0);
 }
 
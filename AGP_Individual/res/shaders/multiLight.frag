@@ -6,6 +6,7 @@ struct Material {
     sampler2D diffuse;
     sampler2D specular;
     float shininess;
+    bool diffuseYCoCg; // diffuse holds scaled YCoCg (Co, Cg, scale, Y) from a cooked DDS
 }; 
 
 struct DirLight {
@@ -56,6 +57,7 @@ uniform SpotLight spotLight;
 uniform Material material;
 
 
+vec3 SampleDiffuse(vec2 texCoords);
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -79,6 +81,21 @@ void main()
     FragColor = vec4(result, 1.0);
 }
 
+// samples the diffuse map, converting scaled YCoCg back to RGB.
+vec3 SampleDiffuse(vec2 texCoords)
+{
+    vec4 texel = texture(material.diffuse, texCoords);
+    if (!material.diffuseYCoCg)
+        return texel.rgb;
+    // the scale is stored as 0, 1 or 3 in the 5 bits of blue, and the chroma
+    // offsets are where 0 lands exactly in 5 and 6 bits
+    float scale = 1.0 / (floor(texel.b * 31.0 + 0.5) + 1.0);
+    float Co = (texel.r - 16.0 / 31.0) * scale;
+    float Cg = (texel.g - 32.0 / 63.0) * scale;
+    float Y = texel.a;
+    return vec3(Y + Co - Cg, Y + Cg, Y - Co - Cg);
+}
+
 // calculates the color when using a directional light.
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
@@ -89,8 +106,8 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDir, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 ambient = light.ambient * SampleDiffuse(TexCoords);
+    vec3 diffuse = light.diffuse * diff * SampleDiffuse(TexCoords);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
     return (ambient + diffuse + specular);
 }
@@ -108,8 +125,8 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 ambient = light.ambient * SampleDiffuse(TexCoords);
+    vec3 diffuse = light.diffuse * diff * SampleDiffuse(TexCoords);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
     ambient *= attenuation;
     diffuse *= attenuation;
@@ -134,8 +151,8 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 ambient = light.ambient * SampleDiffuse(TexCoords);
+    vec3 diffuse = light.diffuse * diff * SampleDiffuse(TexCoords);
     vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
@@ -3,8 +3,16 @@ in vec3 TexCoords;
 out vec4 color;
 
 uniform samplerCube skybox;
+uniform bool hdr;
+uniform float exposure;
 
 void main()
 {
     color = texture(skybox, TexCoords);
+
+    // RGB9_E5 environments go past 1.0, bring them down to the LDR range
+    if (hdr)
+    {
+        color = vec4(vec3(1.0) - exp(-color.rgb * exposure), 1.0);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,407 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "SOIL2\SOIL2\SOIL2.h"
+#include "allocationTracker.h"
+
+using std::cout;
+using std::endl;
+
+// A linear allocator for memory that only lives as long as one job: an import, a
+// cook or a frame. Allocating bumps a pointer through chunks taken from the heap, and
+// freeing only counts, so when everything handed out has been freed the arena starts
+// again from the beginning of its memory. The chunks are kept, so the next image or
+// frame reuses the same memory instead of going back to the heap.
+//
+// Each thread has a current arena (see ArenaScope). SOIL and stb_image allocate from
+// it once InstallSoilAllocator has been called, and from the heap on threads without one.
+class ScratchArena
+{
+public:
+	explicit ScratchArena(size_t chunkSize = 1 << 20) : chunkSize(chunkSize)
+	{
+		std::lock_guard<std::mutex> lock(RegistryMutex());
+		Registry().push_back(this);
+	}
+
+	ScratchArena(const ScratchArena &) = delete;
+	ScratchArena &operator=(const ScratchArena &) = delete;
+
+	~ScratchArena()
+	{
+		{
+			std::lock_guard<std::mutex> lock(RegistryMutex());
+			Registry().erase(std::find(Registry().begin(), Registry().end(), this));
+		}
+
+		for (size_t i = 0; i < this->chunks.size(); i++)
+		{
+			::free(this->chunks[i].data);
+		}
+	}
+
+	// 16 byte aligned, like malloc
+	void *Allocate(size_t size)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		return this->allocate(size);
+	}
+
+	void *Reallocate(void *pointer, size_t size)
+	{
+		if (!pointer)
+		{
+			return this->Allocate(size);
+		}
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		unsigned char *block = (unsigned char *)pointer - HeaderSize;
+		size_t oldSize = *(size_t *)block;
+		Chunk &last = this->chunks.back();
+
+		// The last allocation can grow where it is, which is how stb_image grows its buffers
+		if ((unsigned char *)pointer + Align(oldSize) == last.data + last.used &&
+			(size_t)(block - last.data) + HeaderSize + Align(size) <= last.size)
+		{
+			last.used = (size_t)(block - last.data) + HeaderSize + Align(size);
+			*(size_t *)block = size;
+			this->inUse = this->inUse - Align(oldSize) + Align(size);
+			this->peak = std::max(this->peak, this->inUse);
+			this->allocations++;
+			return pointer;
+		}
+
+		// Out of memory leaves the old block to the caller, as realloc does
+		void *moved = this->allocate(size);
+
+		if (!moved)
+		{
+			return NULL;
+		}
+
+		memcpy(moved, pointer, std::min(oldSize, size));
+		this->release(pointer);
+		return moved;
+	}
+
+	void Free(void *pointer)
+	{
+		if (pointer)
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->release(pointer);
+		}
+	}
+
+	bool Owns(const void *pointer) const
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		for (size_t i = 0; i < this->chunks.size(); i++)
+		{
+			if (pointer >= this->chunks[i].data && pointer < this->chunks[i].data + this->chunks[i].size)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Ends a frame, adding its counts to the per frame figures Report gives. A frame's
+	// scratch memory is all freed by then, so the arena has already started again.
+	void EndFrame()
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->frames++;
+		this->frameAllocationsMost = std::max(this->frameAllocationsMost, this->allocations - this->frameStart);
+		this->frameStart = this->allocations;
+	}
+
+	size_t Allocations() const
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		return this->allocations;
+	}
+
+	void Report(const std::string &name) const
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		size_t capacity = 0;
+
+		for (size_t i = 0; i < this->chunks.size(); i++)
+		{
+			capacity += this->chunks[i].size;
+		}
+
+		cout << "ARENA::" << name << ":: " << this->allocations << " allocations";
+
+		if (this->frames)
+		{
+			cout << " over " << this->frames << " frames (" << this->allocations / this->frames << " a frame, at most "
+				<< this->frameAllocationsMost << ")";
+		}
+
+		cout << ", " << this->peak / 1024 << " KB at most in use, " << capacity / 1024 << " KB taken from the heap in "
+			<< this->chunksAllocated << " chunks" << endl;
+	}
+
+	// The arena the calling thread's scratch memory comes from, NULL for the heap
+	static ScratchArena *&Current()
+	{
+		static thread_local ScratchArena *current = NULL;
+		return current;
+	}
+
+	// Whichever arena pointer came from, NULL when it came from the heap
+	static ScratchArena *Owner(const void *pointer)
+	{
+		std::lock_guard<std::mutex> lock(RegistryMutex());
+
+		for (size_t i = 0; i < Registry().size(); i++)
+		{
+			if (Registry()[i]->Owns(pointer))
+			{
+				return Registry()[i];
+			}
+		}
+
+		return NULL;
+	}
+
+	// Routes SOIL's and stb_image's allocations to the current thread's arena
+	static void InstallSoilAllocator()
+	{
+		SOIL_set_allocator(SoilAllocate, SoilReallocate, SoilFree, NULL);
+	}
+
+private:
+	struct Chunk
+	{
+		unsigned char *data;
+		size_t size;
+		size_t used;
+	};
+
+	// Each allocation starts with its size, padded to keep what follows aligned
+	static const size_t HeaderSize = 16;
+
+	size_t chunkSize;
+	std::vector<Chunk> chunks;
+	mutable std::mutex mutex;
+	size_t live = 0;				// allocations not freed yet
+	size_t inUse = 0;
+	size_t peak = 0;
+	size_t allocations = 0;
+	size_t chunksAllocated = 0;
+	size_t frames = 0;
+	size_t frameStart = 0;			// allocations when the frame began
+	size_t frameAllocationsMost = 0;
+
+	static size_t Align(size_t size)
+	{
+		return (size + 15) & ~(size_t)15;
+	}
+
+	void *allocate(size_t size)
+	{
+		size_t needed = HeaderSize + Align(size);
+
+		if (this->chunks.empty() || this->chunks.back().used + needed > this->chunks.back().size)
+		{
+			Chunk chunk = { NULL, std::max(this->chunkSize, needed), 0 };
+			chunk.data = (unsigned char *)malloc(chunk.size);
+			AllocationTracker::Record();
+
+			if (!chunk.data)
+			{
+				return NULL;
+			}
+
+			this->chunks.push_back(chunk);
+			this->chunksAllocated++;
+		}
+
+		Chunk &chunk = this->chunks.back();
+		unsigned char *block = chunk.data + chunk.used;
+		*(size_t *)block = size;
+		chunk.used += needed;
+
+		this->live++;
+		this->allocations++;
+		this->inUse += Align(size);
+		this->peak = std::max(this->peak, this->inUse);
+		return block + HeaderSize;
+	}
+
+	void release(void *pointer)
+	{
+		this->inUse -= Align(*(size_t *)((unsigned char *)pointer - HeaderSize));
+
+		if (this->live && --this->live == 0)
+		{
+			this->rewind();
+		}
+	}
+
+	// Starts again from the beginning. Memory spread over several chunks becomes one
+	// chunk big enough for all of it, so the next job of the same size doesn't split.
+	void rewind()
+	{
+		if (this->chunks.size() > 1)
+		{
+			size_t total = 0;
+
+			for (size_t i = 0; i < this->chunks.size(); i++)
+			{
+				total += this->chunks[i].size;
+				::free(this->chunks[i].data);
+			}
+
+			Chunk chunk = { (unsigned char *)malloc(total), total, 0 };
+			AllocationTracker::Record();
+			this->chunks.clear();
+
+			if (chunk.data)
+			{
+				this->chunks.push_back(chunk);
+				this->chunksAllocated++;
+			}
+		}
+		else if (!this->chunks.empty())
+		{
+			this->chunks[0].used = 0;
+		}
+
+		this->inUse = 0;
+	}
+
+	static std::vector<ScratchArena *> &Registry()
+	{
+		static std::vector<ScratchArena *> arenas;
+		return arenas;
+	}
+
+	static std::mutex &RegistryMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	static void *SoilAllocate(size_t size, void *)
+	{
+		ScratchArena *arena = Current();
+
+		if (!arena)
+		{
+			AllocationTracker::Record();
+			return malloc(size);
+		}
+
+		return arena->Allocate(size);
+	}
+
+	static void *SoilReallocate(void *pointer, size_t size, void *)
+	{
+		ScratchArena *owner = pointer ? Owner(pointer) : Current();
+
+		if (!owner)
+		{
+			AllocationTracker::Record();
+			return realloc(pointer, size);
+		}
+
+		return owner->Reallocate(pointer, size);
+	}
+
+	static void SoilFree(void *pointer, void *)
+	{
+		ScratchArena *owner = pointer ? Owner(pointer) : NULL;
+
+		if (owner)
+		{
+			owner->Free(pointer);
+		}
+		else
+		{
+			::free(pointer);
+		}
+	}
+};
+
+// Makes arena the current thread's scratch arena until the scope ends
+class ArenaScope
+{
+public:
+	explicit ArenaScope(ScratchArena &arena) : previous(ScratchArena::Current())
+	{
+		ScratchArena::Current() = &arena;
+	}
+
+	ArenaScope(const ArenaScope &) = delete;
+	ArenaScope &operator=(const ArenaScope &) = delete;
+
+	~ArenaScope()
+	{
+		ScratchArena::Current() = this->previous;
+	}
+
+private:
+	ScratchArena *previous;
+};
+
+// Lets standard containers allocate from an arena, the current thread's when it's
+// made, or from the heap when there isn't one
+template <typename T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	ArenaAllocator() : arena(ScratchArena::Current())
+	{
+	}
+
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena)
+	{
+	}
+
+	T *allocate(size_t count)
+	{
+		return (T *)(this->arena ? this->arena->Allocate(count * sizeof(T)) : ::operator new(count * sizeof(T)));
+	}
+
+	void deallocate(T *pointer, size_t)
+	{
+		if (this->arena)
+		{
+			this->arena->Free(pointer);
+		}
+		else
+		{
+			::operator delete(pointer);
+		}
+	}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U> &other) const
+	{
+		return this->arena == other.arena;
+	}
+
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U> &other) const
+	{
+		return this->arena != other.arena;
+	}
+
+	ScratchArena *arena;
+};
@@ -7,51 +7,66 @@
 #include <iostream>
 
 #include <GL/glew.h>
+#include "assetManifest.h"
+#include "glHandle.h"
 
 class Shader
 {
 public:
-	GLuint Program;
+	GLProgram Program;	// deleted with the Shader, which can be moved but not copied
 	// Constructor generates the shader on the fly
 	Shader(const GLchar *vertexPath, const GLchar *fragmentPath)
 	{
+		// Cooked builds compile the copies the cooker validated
+		std::string vertexFile = AssetManifest::ResolveMounted(vertexPath);
+		std::string fragmentFile = AssetManifest::ResolveMounted(fragmentPath);
+		vertexPath = vertexFile.c_str();
+		fragmentPath = fragmentFile.c_str();
 		// 1. Retrieve the vertex/fragment source code from filePath
 		std::string vertexCode;
 		std::string fragmentCode;
 		std::ifstream vShaderFile;
 		std::ifstream fShaderFile;
+		// Packed or read ahead shaders are compiled from memory, other loose files are read
+		AssetSlice vShaderSlice, fShaderSlice;
+		bool packed = AsyncFileReader::ReadAsset(vertexPath, vShaderSlice) && AsyncFileReader::ReadAsset(fragmentPath, fShaderSlice);
 		// ensures ifstream objects can throw exceptions:
 		vShaderFile.exceptions(std::ifstream::badbit);
 		fShaderFile.exceptions(std::ifstream::badbit);
-		try
+		if (!packed)
 		{
-			// Open files
-			vShaderFile.open(vertexPath);
-			fShaderFile.open(fragmentPath);
-			std::stringstream vShaderStream, fShaderStream;
-			// Read file's buffer contents into streams
-			vShaderStream << vShaderFile.rdbuf();
-			fShaderStream << fShaderFile.rdbuf();
-			// close file handlers
-			vShaderFile.close();
-			fShaderFile.close();
-			// Convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
+			try
+			{
+				// Open files
+				vShaderFile.open(vertexPath);
+				fShaderFile.open(fragmentPath);
+				std::stringstream vShaderStream, fShaderStream;
+				// Read file's buffer contents into streams
+				vShaderStream << vShaderFile.rdbuf();
+				fShaderStream << fShaderFile.rdbuf();
+				// close file handlers
+				vShaderFile.close();
+				fShaderFile.close();
+				// Convert stream into string
+				vertexCode = vShaderStream.str();
+				fragmentCode = fShaderStream.str();
+			}
+			catch (std::ifstream::failure e)
+			{
+				std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+			}
 		}
-		catch (std::ifstream::failure e)
-		{
-			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-		}
-		const GLchar *vShaderCode = vertexCode.c_str();
-		const GLchar *fShaderCode = fragmentCode.c_str();
+		const GLchar *vShaderCode = packed ? (const GLchar *)vShaderSlice.data : vertexCode.c_str();
+		const GLchar *fShaderCode = packed ? (const GLchar *)fShaderSlice.data : fragmentCode.c_str();
+		GLint vShaderLength = packed ? (GLint)vShaderSlice.size : (GLint)vertexCode.size();
+		GLint fShaderLength = packed ? (GLint)fShaderSlice.size : (GLint)fragmentCode.size();
 		// 2. Compile shaders
 		GLuint vertex, fragment;
 		GLint success;
 		GLchar infoLog[512];
 		// Vertex Shader
 		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
+		glShaderSource(vertex, 1, &vShaderCode, &vShaderLength);
 		glCompileShader(vertex);
 		// Print compile errors if any
 		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
@@ -62,7 +77,7 @@ public:
 		}
 		// Fragment Shader
 		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
+		glShaderSource(fragment, 1, &fShaderCode, &fShaderLength);
 		glCompileShader(fragment);
 		// Print compile errors if any
 		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
@@ -72,7 +87,7 @@ public:
 			std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
 		}
 		// Shader Program
-		this->Program = glCreateProgram();
+		this->Program = GLProgram::Generate();
 		glAttachShader(this->Program, vertex);
 		glAttachShader(this->Program, fragment);
 		glLinkProgram(this->Program);
@@ -88,6 +103,52 @@ public:
 		glDeleteShader(fragment);
 
 	}
+	// Constructor for a compute program, which needs GL 4.3
+	explicit Shader(const GLchar *computePath)
+	{
+		std::string computeFile = AssetManifest::ResolveMounted(computePath);
+		computePath = computeFile.c_str();
+		std::string computeCode;
+		AssetSlice cShaderSlice;
+		bool packed = AsyncFileReader::ReadAsset(computePath, cShaderSlice);
+		if (!packed)
+		{
+			std::ifstream cShaderFile(computePath);
+			if (cShaderFile.is_open())
+			{
+				std::stringstream cShaderStream;
+				cShaderStream << cShaderFile.rdbuf();
+				computeCode = cShaderStream.str();
+			}
+			else
+			{
+				std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+			}
+		}
+		const GLchar *cShaderCode = packed ? (const GLchar *)cShaderSlice.data : computeCode.c_str();
+		GLint cShaderLength = packed ? (GLint)cShaderSlice.size : (GLint)computeCode.size();
+		GLint success;
+		GLchar infoLog[512];
+		GLuint compute = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(compute, 1, &cShaderCode, &cShaderLength);
+		glCompileShader(compute);
+		glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(compute, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+		}
+		this->Program = GLProgram::Generate();
+		glAttachShader(this->Program, compute);
+		glLinkProgram(this->Program);
+		glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		}
+		glDeleteShader(compute);
+	}
 	// Uses the current shader
 	void Use()
 	{
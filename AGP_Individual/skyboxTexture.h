@@ -1,28 +1,316 @@
 #pragma once
 #include <GL/glew.h>
 #include <vector>
+#include <string>
+#include <map>
+#include <iostream>
+#include <cctype>
 #include "SOIL2\SOIL2\SOIL2.h"// Cubemap (Skybox)
+#include "assetManifest.h"
 
 using std::vector;
+using std::cout;
+using std::endl;
+
+// What a texture is sampled for, which decides the format it's stored in
+enum TextureRole
+{
+	TEXTURE_ROLE_DIFFUSE,	// RGB8, or RGBA8 when the image has transparent texels
+	TEXTURE_ROLE_SPECULAR,	// R8 intensity, swizzled so .rgb still reads it
+	TEXTURE_ROLE_NORMAL		// RG8 tangent space XY, the shader rebuilds Z
+};
+
+// How much texture resolution is kept, as the number of top mip levels dropped at load
+enum TextureQuality
+{
+	TEXTURE_QUALITY_FULL = 0,
+	TEXTURE_QUALITY_HALF = 1,
+	TEXTURE_QUALITY_QUARTER = 2
+};
+
+// Overrides the quality setting for one texture: its longest side is never dropped
+// below minSize or kept above maxSize (0 for no limit)
+struct TextureLimits
+{
+	GLsizei minSize = 0;
+	GLsizei maxSize = 0;
+};
+
+// Running total of the texture memory allocated for a model, including mipmaps
+struct TextureMemory
+{
+	size_t bytes = 0;		// in the formats picked for each role
+	size_t rgbBytes = 0;	// what the same textures took when everything was GL_RGB8
+	size_t fullBytes = 0;	// what they would take at full resolution, before the quality setting
+	GLuint count = 0;
+
+	void Report(const std::string &name) const
+	{
+		long long saved = (long long)rgbBytes - (long long)bytes;
+		cout << "TEXTURES::" << name << ":: " << count << " textures, " << bytes / 1024 << " KB ("
+			<< saved / 1024 << " KB saved over RGB8";
+
+		if (fullBytes > bytes)
+		{
+			cout << ", " << (fullBytes - bytes) / 1024 << " KB by the quality setting";
+		}
+
+		cout << ")" << endl;
+	}
+};
 
 class TextureLoading
 {
 public:
-	static GLuint LoadTexture(GLchar *path)
+	// Diffuse maps are stored as sRGB when this is set. Only turn it on once the
+	// renderer lights in linear space and writes through GL_FRAMEBUFFER_SRGB,
+	// otherwise everything comes out darker.
+	static bool &SrgbDiffuse()
+	{
+		static bool srgb = false;
+		return srgb;
+	}
+
+	// Top mip levels dropped from every texture as it loads, so the same content runs
+	// on machines with less video memory. Set it before loading anything.
+	static TextureQuality &Quality()
+	{
+		static TextureQuality quality = TEXTURE_QUALITY_FULL;
+		return quality;
+	}
+
+	// "full", "half" or "quarter", anything else is full
+	static TextureQuality ParseQuality(const std::string &name)
+	{
+		if (name == "half")
+		{
+			return TEXTURE_QUALITY_HALF;
+		}
+
+		if (name == "quarter")
+		{
+			return TEXTURE_QUALITY_QUARTER;
+		}
+
+		return TEXTURE_QUALITY_FULL;
+	}
+
+	// Per texture overrides of the quality setting, by file name without the directory
+	static std::map<std::string, TextureLimits> &Limits()
 	{
+		static std::map<std::string, TextureLimits> limits;
+		return limits;
+	}
+
+	static void SetLimits(const std::string &fileName, GLsizei minSize, GLsizei maxSize)
+	{
+		TextureLimits limits;
+		limits.minSize = minSize;
+		limits.maxSize = maxSize;
+		Limits()[fileName] = limits;
+	}
+
+	// Number of top levels to drop from a width x height texture, from the quality
+	// setting and any limits set for its file. The 1x1 level is always kept.
+	static GLsizei SkipLevels(const GLchar *path, GLsizei width, GLsizei height)
+	{
+		GLsizei skip = Quality();
+		std::string fileName(path);
+		size_t slash = fileName.find_last_of("/\\");
+
+		if (slash != std::string::npos)
+		{
+			fileName = fileName.substr(slash + 1);
+		}
+
+		std::map<std::string, TextureLimits>::const_iterator limits = Limits().find(fileName);
+
+		// Cooked files are named after their source, "glass_dif.png.dds" has glass_dif.png's limits
+		size_t dot = fileName.find_last_of('.');
+
+		if (limits == Limits().end() && dot != std::string::npos && fileName.find('.') < dot)
+		{
+			limits = Limits().find(fileName.substr(0, dot));
+		}
+
+		if (limits != Limits().end())
+		{
+			while (skip > 0 && LongestSide(width, height, skip) < limits->second.minSize)
+			{
+				skip--;
+			}
+
+			while (limits->second.maxSize > 0 && LongestSide(width, height, skip) > limits->second.maxSize)
+			{
+				skip++;
+			}
+		}
+
+		GLsizei levels = MipLevels(width, height);
+		return (skip < levels) ? skip : levels - 1;
+	}
+
+	// Loads an image into an immutable 2D texture with a full mip chain, in the
+	// smallest format its role needs. The memory used is added to memory if given.
+	// yCoCg is set when the texture holds scaled YCoCg the shader has to decode.
+	// An image already in memory (embedded in a model, say) comes as source, path
+	// then only naming it.
+	static GLuint LoadTexture(const GLchar *path, TextureRole role = TEXTURE_ROLE_DIFFUSE, TextureMemory *memory = NULL, bool *yCoCg = NULL,
+		const AssetSlice *source = NULL)
+	{
+		if (yCoCg)
+		{
+			*yCoCg = false;
+		}
+
+		// A cooked texture is a DDS with its mip chain, uploaded as it is below
+		std::string cooked = source ? std::string(path) : AssetManifest::ResolveMounted(path);
+		path = cooked.c_str();
+
+		// Files in the mounted asset pack or read ahead are decoded straight from memory
+		AssetSlice slice;
+		const AssetSlice *packed = source ? source : AsyncFileReader::ReadAsset(path, slice) ? &slice : NULL;
+
+		// Cooked DDS files (BC4 specular, BC5 normals, YCoCg diffuse) are already block
+		// compressed, so upload their blocks as they are rather than decoding them first
+		if (IsDDS(path))
+		{
+			// YCoCg only stays compressed when the caller can tell the shader about it.
+			// The shader decode skips the sRGB conversion, so sRGB diffuse decodes it here.
+			bool isYCoCg = (packed ? SOIL_DDS_is_YCoCg_from_memory(packed->data, (int)packed->size) : SOIL_DDS_is_YCoCg(path)) != 0;
+
+			if (!isYCoCg || (yCoCg && role == TEXTURE_ROLE_DIFFUSE && !SrgbDiffuse()))
+			{
+				GLuint textureID = LoadCompressedTexture(path, role, memory, packed);
+
+				if (textureID)
+				{
+					if (yCoCg)
+					{
+						*yCoCg = isYCoCg;
+					}
+
+					return textureID;
+				}
+			}
+		}
+
+		int imageWidth, imageHeight, imageChannels;
+
+		// Specular maps only keep their intensity. Everything else is loaded as RGBA,
+		// rows of 4 byte texels never need a special unpack alignment.
+		int forceChannels = (role == TEXTURE_ROLE_SPECULAR) ? SOIL_LOAD_L : SOIL_LOAD_RGBA;
+
+		// Levels dropped for the quality setting are never built: SOIL box filters the
+		// image down as it loads (JPEGs decode straight to the smaller size), by 8 at most
+		int fullWidth = 0, fullHeight = 0;
+		GLsizei skip = 0;
+
+		if (ImageSize(path, packed, &fullWidth, &fullHeight))
+		{
+			skip = SkipLevels(path, fullWidth, fullHeight);
+			skip = (skip < 3) ? skip : 3;
+		}
+
+		unsigned char *image = LoadPixels(path, packed, &imageWidth, &imageHeight, &imageChannels, forceChannels, skip);
+
+		if (!image)
+		{
+			cout << "ERROR::TEXTURE::LOAD_FAILED " << path << " " << SOIL_last_result() << endl;
+			return 0;
+		}
+
+		if (!skip)
+		{
+			fullWidth = imageWidth;
+			fullHeight = imageHeight;
+		}
+
+		GLenum internalFormat, format;
+		GLuint components, texelSize;
+
+		if (role == TEXTURE_ROLE_SPECULAR)
+		{
+			internalFormat = GL_R8;
+			format = GL_RED;
+			components = texelSize = 1;
+		}
+		else if (role == TEXTURE_ROLE_NORMAL)
+		{
+			// Keep X and Y only, packed down in place
+			size_t texels = (size_t)imageWidth * imageHeight;
+
+			for (size_t i = 0; i < texels; i++)
+			{
+				image[i * 2 + 0] = image[i * 4 + 0];
+				image[i * 2 + 1] = image[i * 4 + 1];
+			}
+
+			internalFormat = GL_RG8;
+			format = GL_RG;
+			components = texelSize = 2;
+		}
+		else
+		{
+			// Only pay for alpha if some texel actually uses it
+			bool hasAlpha = false;
+
+			if (imageChannels == 2 || imageChannels == 4)
+			{
+				size_t texels = (size_t)imageWidth * imageHeight;
+
+				for (size_t i = 0; i < texels && !hasAlpha; i++)
+				{
+					hasAlpha = image[i * 4 + 3] != 255;
+				}
+			}
+
+			if (hasAlpha)
+			{
+				internalFormat = SrgbDiffuse() ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+				texelSize = 4;
+			}
+			else
+			{
+				internalFormat = SrgbDiffuse() ? GL_SRGB8 : GL_RGB8;
+				texelSize = 3;
+			}
+
+			format = GL_RGBA;
+			components = 4;
+		}
+
 		//Generate texture ID and load texture data
 		GLuint textureID;
 		glGenTextures(1, &textureID);
 
-		int imageWidth, imageHeight;
-
-		unsigned char *image = SOIL_load_image(path, &imageWidth, &imageHeight, 0, SOIL_LOAD_RGB);
-
 		// Assign texture to ID
 		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+		GLsizei levels = AllocateStorage(internalFormat, imageWidth, imageHeight);
+
+		if ((imageWidth * components) % 4 != 0)
+		{
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		}
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, imageWidth, imageHeight, format, GL_UNSIGNED_BYTE, image);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
+		if (role == TEXTURE_ROLE_SPECULAR)
+		{
+			GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
+
+		if (memory)
+		{
+			memory->bytes += MipChainSize(imageWidth, imageHeight, levels, texelSize);
+			memory->rgbBytes += MipChainSize(imageWidth, imageHeight, levels, 3);
+			memory->fullBytes += MipChainSize(fullWidth, fullHeight, MipLevels(fullWidth, fullHeight), texelSize);
+			memory->count++;
+		}
+
 		// Parameters
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -35,21 +323,289 @@ public:
 		return textureID;
 	}
 
-	static GLuint LoadCubemap(vector<const GLchar * > faces)
+	static bool IsDDS(const GLchar *path)
+	{
+		std::string extension(path);
+		size_t dot = extension.find_last_of('.');
+
+		if (dot == std::string::npos)
+		{
+			return false;
+		}
+
+		extension = extension.substr(dot + 1);
+
+		for (size_t i = 0; i < extension.size(); i++)
+		{
+			extension[i] = (char)tolower(extension[i]);
+		}
+
+		return extension == "dds";
+	}
+
+	// Cooks a diffuse map into a DDS of scaled YCoCg in DXT5 with mipmaps, close to
+	// RGB8 quality at a quarter of the size. Flat, saturated colours (like the ground
+	// plain) keep more detail in plain DXT1, so this is for the detailed maps.
+	static bool CookYCoCgDiffuse(const GLchar *source, const GLchar *destination)
+	{
+		int imageWidth, imageHeight, imageChannels;
+		unsigned char *image = SOIL_load_image(source, &imageWidth, &imageHeight, &imageChannels, SOIL_LOAD_RGB);
+
+		if (!image)
+		{
+			cout << "ERROR::TEXTURE::LOAD_FAILED " << source << " " << SOIL_last_result() << endl;
+			return false;
+		}
+
+		bool saved = SOIL_save_image(destination, SOIL_SAVE_TYPE_DDS_YCOCG, imageWidth, imageHeight, 3, image) != 0;
+		SOIL_free_image_data(image);
+
+		if (!saved)
+		{
+			cout << "ERROR::TEXTURE::COOK_FAILED " << destination << " " << SOIL_last_result() << endl;
+		}
+
+		return saved;
+	}
+
+	// Uploads a DDS file's compressed blocks and mips directly, starting further down
+	// the chain for the quality setting. Returns 0 when the driver can't take its
+	// format, so the caller can decode it instead.
+	static GLuint LoadCompressedTexture(const GLchar *path, TextureRole role, TextureMemory *memory, const AssetSlice *packed = NULL)
 	{
+		int fullWidth = 0, fullHeight = 0;
+		GLsizei skip = 0;
+
+		if (ImageSize(path, packed, &fullWidth, &fullHeight))
+		{
+			skip = SkipLevels(path, fullWidth, fullHeight);
+		}
+
+		GLuint textureID = packed ?
+			SOIL_direct_load_DDS_from_memory_skip_mipmaps(packed->data, (int)packed->size, 0, SOIL_FLAG_TEXTURE_REPEATS, 0, skip) :
+			SOIL_direct_load_DDS_skip_mipmaps(path, 0, SOIL_FLAG_TEXTURE_REPEATS, 0, skip);
+
+		if (!textureID)
+		{
+			return 0;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, textureID);
+
+		// SOIL limits sampling to the levels in the file, count them for the report
+		GLint width, height, compressed, levelSize;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+		GLsizei levels = 0;
+		size_t bytes = 0, topBytes = 0;
+
+		for (GLsizei maxLevels = MipLevels(width, height); levels < maxLevels; levels++)
+		{
+			GLint levelWidth;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, levels, GL_TEXTURE_WIDTH, &levelWidth);
+
+			if (levelWidth == 0)
+			{
+				break;
+			}
+
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, levels, GL_TEXTURE_COMPRESSED, &compressed);
+
+			if (compressed)
+			{
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, levels, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &levelSize);
+				bytes += levelSize;
+			}
+			else
+			{
+				bytes += MipChainSize(width >> levels, height >> levels, 1, 4);
+			}
+
+			if (levels == 0)
+			{
+				topBytes = bytes;
+			}
+		}
+
+		// The file may have had fewer levels to drop than asked for, each one that
+		// was dropped would have taken 4 times the level below it
+		size_t fullBytes = bytes;
+
+		for (GLsizei level = 1; (fullWidth >> level) >= width && (fullHeight >> level) >= height && level < 16; level++)
+		{
+			fullBytes += topBytes << (2 * level);
+		}
+
+		if (role == TEXTURE_ROLE_SPECULAR)
+		{
+			GLint swizzle[] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+			glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		if (memory)
+		{
+			memory->bytes += bytes;
+			memory->rgbBytes += MipChainSize(width, height, levels, 3);
+			memory->fullBytes += fullBytes;
+			memory->count++;
+		}
+
+		return textureID;
+	}
+
+	// Image size from the header, of the packed copy when there is one
+	static bool ImageSize(const GLchar *path, const AssetSlice *packed, int *width, int *height)
+	{
+		return (packed ?
+			SOIL_get_image_size_from_memory(packed->data, (int)packed->size, width, height, NULL) :
+			SOIL_get_image_size(path, width, height, NULL)) != 0;
+	}
+
+	// Decodes an image reduced by 2^skip, from the packed copy when there is one
+	static unsigned char *LoadPixels(const GLchar *path, const AssetSlice *packed, int *width, int *height, int *channels, int forceChannels, GLsizei skip)
+	{
+		if (packed)
+		{
+			return skip ?
+				SOIL_load_image_scaled_from_memory(packed->data, (int)packed->size, width, height, channels, forceChannels, 1 << skip) :
+				SOIL_load_image_from_memory(packed->data, (int)packed->size, width, height, channels, forceChannels);
+		}
+
+		return skip ?
+			SOIL_load_image_scaled(path, width, height, channels, forceChannels, 1 << skip) :
+			SOIL_load_image(path, width, height, channels, forceChannels);
+	}
+
+	// Longest side of a mip level, at least 1
+	static GLsizei LongestSide(GLsizei width, GLsizei height, GLsizei level)
+	{
+		GLsizei side = ((width > height) ? width : height) >> level;
+		return side ? side : 1;
+	}
+
+	// Number of levels in a full mip chain down to 1x1
+	static GLsizei MipLevels(GLsizei width, GLsizei height)
+	{
+		GLsizei levels = 1;
+
+		while ((width | height) >> levels)
+		{
+			levels++;
+		}
+
+		return levels;
+	}
+
+	// Bytes taken by the first levels of a mip chain
+	static size_t MipChainSize(GLsizei width, GLsizei height, GLsizei levels, GLuint texelSize)
+	{
+		size_t size = 0;
+
+		for (GLsizei i = 0; i < levels; i++)
+		{
+			size_t w = (width >> i) ? (width >> i) : 1;
+			size_t h = (height >> i) ? (height >> i) : 1;
+			size += w * h * texelSize;
+		}
+
+		return size;
+	}
+
+	// Allocates every mip level of the bound 2D texture up front. Immutable storage
+	// needs GL 4.2 or ARB_texture_storage, without it each level is specified by hand.
+	static GLsizei AllocateStorage(GLenum internalFormat, GLsizei width, GLsizei height)
+	{
+		GLsizei levels = MipLevels(width, height);
+
+		if (GLEW_ARB_texture_storage)
+		{
+			glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+		}
+		else
+		{
+			for (GLsizei i = 0; i < levels; i++)
+			{
+				GLsizei w = (width >> i) ? (width >> i) : 1;
+				GLsizei h = (height >> i) ? (height >> i) : 1;
+				glTexImage2D(GL_TEXTURE_2D, i, internalFormat, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+			}
+
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		}
+
+		return levels;
+	}
+
+	// Loads 6 faces into a cubemap, reduced for the quality setting. The faces have to
+	// match in size, so the first face's limits apply to all of them.
+	static GLuint LoadCubemap(vector<const GLchar * > faces, TextureMemory *memory = NULL)
+	{
+		// The cooker puts all 6 faces in one cubemap DDS
+		std::string cooked = faces.empty() ? std::string() : AssetManifest::ResolveMounted(faces[0]);
+
+		if (!faces.empty() && cooked != faces[0])
+		{
+			GLuint cookedID = LoadCookedCubemap(cooked, memory);
+
+			if (cookedID)
+			{
+				return cookedID;
+			}
+		}
+
 		GLuint textureID;
 		glGenTextures(1, &textureID);
 
-		int imageWidth, imageHeight;
+		int imageWidth, imageHeight, imageChannels;
 		unsigned char *image;
 
+		int fullWidth = 0, fullHeight = 0;
+		GLsizei skip = 0;
+
+		AssetSlice slice;
+
+		if (!faces.empty() && ImageSize(faces[0], AsyncFileReader::ReadAsset(faces[0], slice) ? &slice : NULL, &fullWidth, &fullHeight))
+		{
+			skip = SkipLevels(faces[0], fullWidth, fullHeight);
+			skip = (skip < 3) ? skip : 3;
+		}
+
 		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
 		for (GLuint i = 0; i < faces.size(); i++)
 		{
-			image = SOIL_load_image(faces[i], &imageWidth, &imageHeight, 0, SOIL_LOAD_RGB);
+			const AssetSlice *packed = AsyncFileReader::ReadAsset(faces[i], slice) ? &slice : NULL;
+			image = LoadPixels(faces[i], packed, &imageWidth, &imageHeight, &imageChannels, SOIL_LOAD_RGB, skip);
+
+			if (!image)
+			{
+				cout << "ERROR::TEXTURE::LOAD_FAILED " << faces[i] << " " << SOIL_last_result() << endl;
+				continue;
+			}
+
+			if ((imageWidth * 3) % 4 != 0)
+			{
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			}
+
 			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 			SOIL_free_image_data(image);
+
+			if (memory)
+			{
+				memory->bytes += (size_t)imageWidth * imageHeight * 3;
+				memory->rgbBytes += (size_t)imageWidth * imageHeight * 3;
+				memory->fullBytes += skip ? (size_t)fullWidth * fullHeight * 3 : (size_t)imageWidth * imageHeight * 3;
+			}
+		}
+
+		if (memory)
+		{
+			memory->count++;
 		}
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -60,4 +616,114 @@ public:
 
 		return textureID;
 	}
+
+	// Loads an equirectangular Radiance .hdr as an RGB9_E5 cubemap. The cooker converts
+	// it ahead of time; without a cooked copy it's converted in memory on every load,
+	// so nothing is written next to the source. At 4 bytes a texel it takes what the
+	// driver gives an RGB8 face.
+	static GLuint LoadHDRCubemap(const GLchar *path, TextureMemory *memory = NULL)
+	{
+		// The cooker converts it ahead of time, at full size
+		std::string cooked = AssetManifest::ResolveMounted(path);
+
+		if (cooked != path)
+		{
+			GLuint cookedID = LoadCookedCubemap(cooked, memory);
+
+			if (cookedID)
+			{
+				return cookedID;
+			}
+		}
+
+		int imageWidth = 0, imageHeight = 0;
+		AssetSlice slice;
+		const AssetSlice *packed = AsyncFileReader::ReadAsset(path, slice) ? &slice : NULL;
+
+		if (!ImageSize(path, packed, &imageWidth, &imageHeight))
+		{
+			cout << "ERROR::TEXTURE::LOAD_FAILED " << path << " " << SOIL_last_result() << endl;
+			return 0;
+		}
+
+		// a face covers a quarter of the longitude, reduced like the LDR faces
+		GLsizei fullSize = (imageWidth >= 4) ? imageWidth / 4 : 1;
+		GLsizei skip = SkipLevels(path, fullSize, fullSize);
+		skip = (skip < 3) ? skip : 3;
+		int faceSize = (fullSize >> skip) ? (fullSize >> skip) : 1;
+
+		unsigned char *faces = packed ?
+			SOIL_load_HDR_cubemap_from_memory(packed->data, (int)packed->size, SOIL_HDR_RGB9_E5, &faceSize) :
+			SOIL_load_HDR_cubemap(path, SOIL_HDR_RGB9_E5, &faceSize);
+
+		if (!faces)
+		{
+			cout << "ERROR::TEXTURE::LOAD_FAILED " << path << " " << SOIL_last_result() << endl;
+			return 0;
+		}
+
+		GLuint textureID;
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+		for (GLuint i = 0; i < 6; i++)
+		{
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB9_E5, faceSize, faceSize, 0,
+				GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV, faces + (size_t)faceSize * faceSize * 4 * i);
+		}
+
+		SOIL_free_image_data(faces);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+		if (memory)
+		{
+			memory->bytes += (size_t)faceSize * faceSize * 4 * 6;
+			memory->rgbBytes += (size_t)faceSize * faceSize * 3 * 6;
+			memory->fullBytes += (size_t)fullSize * fullSize * 4 * 6;
+			memory->count++;
+		}
+
+		return textureID;
+	}
+
+	// Uploads a cubemap DDS made by the cooker, RGBA8 or RGB9_E5 at 4 bytes a texel.
+	// These have a single level, so the quality setting doesn't apply to them.
+	static GLuint LoadCookedCubemap(const std::string &cooked, TextureMemory *memory)
+	{
+		AssetSlice slice;
+		GLuint textureID = AsyncFileReader::ReadAsset(cooked, slice) ?
+			SOIL_direct_load_DDS_from_memory(slice.data, (int)slice.size, 0, 0, 1) :
+			SOIL_direct_load_DDS(cooked.c_str(), 0, 0, 1);
+
+		if (!textureID)
+		{
+			cout << "ERROR::TEXTURE::LOAD_FAILED " << cooked << " " << SOIL_last_result() << endl;
+			return 0;
+		}
+
+		GLint faceSize = 0;
+		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+		glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &faceSize);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+		if (memory)
+		{
+			memory->bytes += (size_t)faceSize * faceSize * 4 * 6;
+			memory->rgbBytes += (size_t)faceSize * faceSize * 3 * 6;
+			memory->fullBytes += (size_t)faceSize * faceSize * 4 * 6;
+			memory->count++;
+		}
+
+		return textureID;
+	}
 };
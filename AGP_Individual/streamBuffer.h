@@ -0,0 +1,243 @@
+#pragma once
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+#include <GL/glew.h>
+#include "glHandle.h"
+
+using std::cout;
+using std::endl;
+
+// Where a frame's dynamic data went: pointer is where to write it, offset where the
+// GPU will read it from in the stream's buffer
+struct StreamAllocation
+{
+	void *pointer;
+	GLintptr offset;
+};
+
+// One buffer for everything that changes every frame: uniform blocks, instance
+// transforms and anything else drawn once and thrown away. It's split into a region
+// per frame in flight, and a frame sub-allocates its data from its own region by
+// bumping an offset. A fence is put down as the frame ends, and the region isn't
+// written again until the GPU has passed it, so nothing ever waits on the implicit
+// sync glBufferData or glBufferSubData would need.
+//
+// With ARB_buffer_storage the buffer is mapped once, persistently and coherently, and
+// writes go straight into it. Without it each allocation maps its own range,
+// unsynchronised since the fences already keep the GPU off it, and is unmapped by Commit.
+class StreamBuffer
+{
+public:
+	StreamBuffer(GLsizeiptr frameSize, GLuint frames = 3) : frameSize(frameSize), frames(std::min(std::max(frames, 1u), (GLuint)MaxFrames)),
+		frame(0), used(0), mapping(NULL), mapped(false), overflowed(false),
+		frameCount(0), mostUsed(0), fenceWaits(0), waitSeconds(0.0)
+	{
+		GLsizeiptr size = this->frameSize * this->frames;
+		this->buffer = GLBuffer::Generate();
+		this->persistent = GLEW_ARB_buffer_storage != 0;
+
+		// The copy target leaves the vertex and uniform bindings alone
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+
+		if (this->persistent)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+			this->mapping = (unsigned char *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+			this->persistent = this->mapping != NULL;
+		}
+
+		if (!this->persistent)
+		{
+			// Storage can't be respecified once it's immutable, so start again
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			this->buffer = GLBuffer::Generate();
+			glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+			glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		for (GLuint i = 0; i < MaxFrames; i++)
+		{
+			this->fences[i] = 0;
+		}
+	}
+
+	StreamBuffer(const StreamBuffer &) = delete;
+	StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+	~StreamBuffer()
+	{
+		for (GLuint i = 0; i < MaxFrames; i++)
+		{
+			if (this->fences[i])
+			{
+				glDeleteSync(this->fences[i]);
+			}
+		}
+
+		if (this->persistent || this->mapped)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+	}
+
+	// Moves on to the next frame's region, waiting for the GPU to finish with it
+	// first if it hasn't already
+	void BeginFrame()
+	{
+		this->frame = (this->frame + 1) % this->frames;
+		this->used = 0;
+		this->overflowed = false;
+
+		GLsync &fence = this->fences[this->frame];
+
+		if (fence)
+		{
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+			{
+				std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+				this->fenceWaits++;
+
+				while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+				{
+				}
+
+				this->waitSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+
+			glDeleteSync(fence);
+			fence = 0;
+		}
+	}
+
+	// Fences off the region once everything using it this frame has been issued
+	void EndFrame()
+	{
+		this->Commit();
+		this->fences[this->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		this->frameCount++;
+		this->mostUsed = std::max(this->mostUsed, this->used);
+	}
+
+	// Reserves size bytes of this frame's region at a multiple of alignment. False
+	// when the region is full, and the caller has to do without the stream.
+	bool Allocate(GLsizeiptr size, GLsizeiptr alignment, StreamAllocation &allocation)
+	{
+		this->Commit();
+
+		GLsizeiptr start = (this->used + alignment - 1) / alignment * alignment;
+
+		if (start + size > this->frameSize)
+		{
+			if (!this->overflowed)
+			{
+				cout << "ERROR::STREAM::FRAME_FULL " << this->frameSize / 1024 << " KB a frame isn't enough" << endl;
+				this->overflowed = true;
+			}
+
+			return false;
+		}
+
+		this->used = start + size;
+		allocation.offset = this->frame * this->frameSize + start;
+
+		if (this->persistent)
+		{
+			allocation.pointer = this->mapping + allocation.offset;
+			return true;
+		}
+
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+		allocation.pointer = glMapBufferRange(GL_COPY_WRITE_BUFFER, allocation.offset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		this->mapped = allocation.pointer != NULL;
+		return this->mapped;
+	}
+
+	// Copies data into this frame's region, -1 if it doesn't fit
+	GLintptr Write(const void *data, GLsizeiptr size, GLsizeiptr alignment = 16)
+	{
+		StreamAllocation allocation;
+
+		if (!this->Allocate(size, alignment, allocation))
+		{
+			return -1;
+		}
+
+		memcpy(allocation.pointer, data, size);
+		this->Commit();
+		return allocation.offset;
+	}
+
+	// Finishes the last allocation, before the GPU uses it. Persistent mappings are
+	// coherent, so there's nothing to do; otherwise the range is unmapped.
+	void Commit()
+	{
+		if (this->mapped)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			this->mapped = false;
+		}
+	}
+
+	GLuint Buffer() const
+	{
+		return this->buffer;
+	}
+
+	bool IsPersistent() const
+	{
+		return this->persistent;
+	}
+
+	void Report(const std::string &name) const
+	{
+		cout << "STREAM::" << name << ":: " << (this->persistent ? "persistently mapped" : "mapped by range") << ", "
+			<< this->frames << " frames of " << this->frameSize / 1024 << " KB, at most " << this->mostUsed << " bytes used, "
+			<< this->fenceWaits << " fence waits in " << this->frameCount << " frames (" << this->waitSeconds * 1000.0 << " ms)" << endl;
+	}
+
+	// Offsets handed to glBindBufferRange for uniform blocks have to be a multiple of this
+	static GLint UniformAlignment()
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		return alignment;
+	}
+
+	// The stream per-frame data goes through, NULL for none
+	static StreamBuffer *&Mounted()
+	{
+		static StreamBuffer *mounted = NULL;
+		return mounted;
+	}
+
+private:
+	static const GLuint MaxFrames = 4;
+
+	GLBuffer buffer;
+	GLsizeiptr frameSize;
+	GLuint frames;
+	GLuint frame;				// the region being written
+	GLsizeiptr used;			// bytes of it allocated
+	GLsync fences[MaxFrames];
+	bool persistent;
+	unsigned char *mapping;		// the whole buffer, when it's persistent
+	bool mapped;				// a range is mapped, when it isn't
+	bool overflowed;
+	size_t frameCount;
+	GLsizeiptr mostUsed;
+	size_t fenceWaits;
+	double waitSeconds;
+};
@@ -0,0 +1,912 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define TRIANGLE_BVH_SSE2
+#include <emmintrin.h>
+#endif
+
+// A ray from origin along direction, as far as tMax. direction needn't be unit
+// length: t is measured in it, so a ray moved into a mesh's own space hits at the
+// same t as it would in the world.
+struct Ray
+{
+	glm::vec3 origin;
+	glm::vec3 direction;
+	float tMax;
+
+	Ray() : tMax(FLT_MAX) { }
+	Ray(const glm::vec3 &origin, const glm::vec3 &direction, float tMax = FLT_MAX) : origin(origin), direction(direction), tMax(tMax) { }
+
+	// The ray in the space objectFromWorld takes it to
+	Ray Transformed(const glm::mat4 &objectFromWorld) const
+	{
+		return Ray(glm::vec3(objectFromWorld * glm::vec4(this->origin, 1.0f)), glm::vec3(objectFromWorld * glm::vec4(this->direction, 0.0f)), this->tMax);
+	}
+};
+
+// Where a ray hit: t along it, on the triangle of the mesh's vertices, at
+// (1 - u - v) * vertices[0] + u * vertices[1] + v * vertices[2]. normal is the
+// triangle's, in the mesh's own space and not normalised.
+struct RayHit
+{
+	float t;
+	float u, v;
+	GLuint vertices[3];
+	glm::vec3 normal;
+};
+
+// A bounding volume hierarchy over a mesh's triangles, for ray casts against loaded
+// geometry: picking, collision and baking. It's built with the surface area
+// heuristic over binned centroids, then collapsed into nodes of four children, so
+// one ray tests all four boxes at once, and a packet of four rays tests a box for
+// each of them at once.
+//
+// Hits name the triangle's vertices rather than its place in the indices, so the
+// tree doesn't care what order Mesh puts them in, and it keeps its own copy of the
+// triangles, so it still works once a mesh has dropped its CPU geometry.
+class TriangleBvh
+{
+public:
+	static const GLuint LeafTriangles = 4;			// leaves are split down to this many
+	static const GLuint MaxLeafTriangles = 16;		// unless splitting costs more, up to this many
+	static const GLuint PacketSize = 4;
+
+	// Builds the tree over the triangles of indices, reading positions through a
+	// stride like MeshletSet::Build
+	static TriangleBvh Build(const void *positions, size_t stride, size_t vertexCount, const std::vector<GLuint> &indices)
+	{
+		TriangleBvh bvh;
+		std::vector<BuildTriangle> build;
+		build.reserve(indices.size() / 3);
+
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount)
+			{
+				continue;
+			}
+
+			BuildTriangle triangle;
+			glm::vec3 p0 = position(positions, stride, indices[i]), p1 = position(positions, stride, indices[i + 1]), p2 = position(positions, stride, indices[i + 2]);
+			triangle.boundsMin = glm::min(glm::min(p0, p1), p2);
+			triangle.boundsMax = glm::max(glm::max(p0, p1), p2);
+			triangle.centroid = (triangle.boundsMin + triangle.boundsMax) * 0.5f;
+			triangle.triangle.v0 = p0;
+			triangle.triangle.e1 = p1 - p0;
+			triangle.triangle.e2 = p2 - p0;
+			triangle.triangle.vertices[0] = indices[i];
+			triangle.triangle.vertices[1] = indices[i + 1];
+			triangle.triangle.vertices[2] = indices[i + 2];
+			build.push_back(triangle);
+		}
+
+		if (build.empty())
+		{
+			return bvh;
+		}
+
+		std::vector<GLuint> order(build.size());
+
+		for (GLuint i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+
+		std::vector<BinaryNode> binary;
+		binary.reserve(build.size() * 2 / LeafTriangles + 1);
+		split(binary, order, build, 0, (GLuint)build.size(), 0);
+
+		// Leaves are ranges of the triangles, in the order the splits left them
+		bvh.triangles.resize(build.size());
+
+		for (GLuint i = 0; i < order.size(); i++)
+		{
+			bvh.triangles[i] = build[order[i]].triangle;
+		}
+
+		bvh.nodes.reserve(binary.size() / 2 + 1);
+		bvh.collapse(binary, 0);
+		return bvh;
+	}
+
+	bool Empty() const
+	{
+		return this->nodes.empty();
+	}
+
+	GLuint NodeCount() const
+	{
+		return (GLuint)this->nodes.size();
+	}
+
+	GLuint TriangleCount() const
+	{
+		return (GLuint)this->triangles.size();
+	}
+
+	size_t Bytes() const
+	{
+		return this->nodes.capacity() * sizeof(Node) + this->triangles.capacity() * sizeof(Triangle);
+	}
+
+	// The nearest hit along a ray in the mesh's own space
+	bool Intersect(const Ray &ray, RayHit &hit) const
+	{
+		return this->traverse(ray, hit, false);
+	}
+
+	// The nearest hit along a ray in the world, with the mesh placed by transform
+	bool Intersect(const Ray &ray, const glm::mat4 &transform, RayHit &hit) const
+	{
+		return this->traverse(ray.Transformed(glm::inverse(transform)), hit, false);
+	}
+
+	// Whether anything is along a ray in the mesh's own space, stopping at the first hit
+	bool Occluded(const Ray &ray) const
+	{
+		RayHit hit;
+		return this->traverse(ray, hit, true);
+	}
+
+	bool Occluded(const Ray &ray, const glm::mat4 &transform) const
+	{
+		RayHit hit;
+		return this->traverse(ray.Transformed(glm::inverse(transform)), hit, true);
+	}
+
+	// The nearest hits of PacketSize rays traced together, returning a bit for each that
+	// hit. The rays go down the tree together, so they should start near each other and
+	// point about the same way, like a pixel's neighbours or a texel's samples.
+	GLuint IntersectPacket(const Ray *rays, RayHit *hits) const
+	{
+		return this->traversePacket(rays, hits, false);
+	}
+
+	GLuint IntersectPacket(const Ray *rays, const glm::mat4 &transform, RayHit *hits) const
+	{
+		Ray local[PacketSize];
+		transformPacket(rays, transform, local);
+		return this->traversePacket(local, hits, false);
+	}
+
+	GLuint OccludedPacket(const Ray *rays) const
+	{
+		RayHit hits[PacketSize];
+		return this->traversePacket(rays, hits, true);
+	}
+
+	GLuint OccludedPacket(const Ray *rays, const glm::mat4 &transform) const
+	{
+		Ray local[PacketSize];
+		RayHit hits[PacketSize];
+		transformPacket(rays, transform, local);
+		return this->traversePacket(local, hits, true);
+	}
+
+	// Appends the tree as the cooked model stores it: uint32 node count and triangle
+	// count, then the nodes and the triangles as they lie in memory
+	void Save(std::vector<unsigned char> &bytes) const
+	{
+		uint32_t counts[2] = { (uint32_t)this->nodes.size(), (uint32_t)this->triangles.size() };
+		append(bytes, counts, sizeof(counts));
+		append(bytes, this->nodes.data(), this->nodes.size() * sizeof(Node));
+		append(bytes, this->triangles.data(), this->triangles.size() * sizeof(Triangle));
+	}
+
+	// Reads a tree Save wrote from data at offset, moving offset past it. False when it
+	// runs off the end or doesn't fit a mesh of vertexCount vertices.
+	bool Load(const unsigned char *data, size_t size, size_t &offset, size_t vertexCount)
+	{
+		uint32_t counts[2];
+
+		if (size - offset < sizeof(counts))
+		{
+			return false;
+		}
+
+		memcpy(counts, data + offset, sizeof(counts));
+		offset += sizeof(counts);
+
+		if ((counts[0] == 0) != (counts[1] == 0) ||
+			(size - offset) / sizeof(Node) < counts[0] || (size - offset - counts[0] * sizeof(Node)) / sizeof(Triangle) < counts[1])
+		{
+			return false;
+		}
+
+		this->nodes.resize(counts[0]);
+		this->triangles.resize(counts[1]);
+
+		if (counts[0])
+		{
+			memcpy(this->nodes.data(), data + offset, counts[0] * sizeof(Node));
+			offset += counts[0] * sizeof(Node);
+			memcpy(this->triangles.data(), data + offset, counts[1] * sizeof(Triangle));
+			offset += counts[1] * sizeof(Triangle);
+		}
+
+		// Children always come after their parent, so a damaged file can't loop
+		for (GLuint n = 0; n < this->nodes.size(); n++)
+		{
+			for (GLuint c = 0; c < 4; c++)
+			{
+				uint64_t child = this->nodes[n].child[c], count = this->nodes[n].count[c];
+
+				if ((count && child + count > counts[1]) || (!count && child && (child <= n || child >= counts[0])))
+				{
+					return false;
+				}
+			}
+		}
+
+		for (GLuint t = 0; t < this->triangles.size(); t++)
+		{
+			for (GLuint v = 0; v < 3; v++)
+			{
+				if (this->triangles[t].vertices[v] >= vertexCount)
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+private:
+	static const GLuint Bins = 16;
+	static const int MaxDepth = 48;				// past this splits are halves, at most 32 more deep
+	static const int StackSize = (MaxDepth + 32) * 3 + 4;
+
+	// Four children's boxes side by side, for testing at once. A child is a node when
+	// its count is 0, a leaf of count triangles from child otherwise, and missing when
+	// both are 0: the root is never anyone's child.
+	struct Node
+	{
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		uint32_t child[4];
+		uint32_t count[4];
+	};
+
+	// Ready for Möller-Trumbore: a corner and the two edges from it
+	struct Triangle
+	{
+		glm::vec3 v0, e1, e2;
+		uint32_t vertices[3];
+	};
+
+	struct BuildTriangle
+	{
+		glm::vec3 boundsMin, boundsMax, centroid;
+		Triangle triangle;
+	};
+
+	// The tree as it's split, before it's collapsed. A leaf has no children: the root is
+	// never anyone's child.
+	struct BinaryNode
+	{
+		glm::vec3 boundsMin, boundsMax;
+		GLuint first, count;
+		GLuint left, right;
+	};
+
+	struct Bin
+	{
+		glm::vec3 boundsMin, boundsMax;
+		GLuint count;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<Triangle> triangles;
+
+	static glm::vec3 position(const void *positions, size_t stride, GLuint vertex)
+	{
+		const float *p = (const float *)((const unsigned char *)positions + vertex * stride);
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+
+	static float halfArea(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+	{
+		glm::vec3 extent = boundsMax - boundsMin;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	static void append(std::vector<unsigned char> &bytes, const void *data, size_t size)
+	{
+		bytes.insert(bytes.end(), (const unsigned char *)data, (const unsigned char *)data + size);
+	}
+
+	static void transformPacket(const Ray *rays, const glm::mat4 &transform, Ray *local)
+	{
+		glm::mat4 objectFromWorld = glm::inverse(transform);
+
+		for (GLuint i = 0; i < PacketSize; i++)
+		{
+			local[i] = rays[i].Transformed(objectFromWorld);
+		}
+	}
+
+	// Axes the ray runs along get a huge rather than an infinite inverse, so a slab the
+	// origin lies on gives 0 rather than NaN
+	static glm::vec3 inverseDirection(const glm::vec3 &direction)
+	{
+		glm::vec3 inverse;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float d = direction[axis];
+			inverse[axis] = 1.0f / (std::fabs(d) > 1e-30f ? d : (d < 0.0f ? -1e-30f : 1e-30f));
+		}
+
+		return inverse;
+	}
+
+	// Splits order[first, first + count) where the surface area heuristic says it's
+	// cheaper than a leaf, returning the binary node for them
+	static GLuint split(std::vector<BinaryNode> &binary, std::vector<GLuint> &order, const std::vector<BuildTriangle> &build,
+		GLuint first, GLuint count, int depth)
+	{
+		GLuint index = (GLuint)binary.size();
+		binary.push_back(BinaryNode());
+
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX), centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+
+		for (GLuint i = first; i < first + count; i++)
+		{
+			const BuildTriangle &triangle = build[order[i]];
+			boundsMin = glm::min(boundsMin, triangle.boundsMin);
+			boundsMax = glm::max(boundsMax, triangle.boundsMax);
+			centroidMin = glm::min(centroidMin, triangle.centroid);
+			centroidMax = glm::max(centroidMax, triangle.centroid);
+		}
+
+		binary[index].boundsMin = boundsMin;
+		binary[index].boundsMax = boundsMax;
+		binary[index].first = first;
+		binary[index].count = count;
+		binary[index].left = binary[index].right = 0;
+
+		if (count <= LeafTriangles)
+		{
+			return index;
+		}
+
+		// The cheapest plane between bins of the centroids, along any axis
+		int bestAxis = -1;
+		GLuint bestBin = 0;
+		float bestCost = FLT_MAX;
+
+		for (int axis = 0; axis < 3 && depth < MaxDepth; axis++)
+		{
+			float extent = centroidMax[axis] - centroidMin[axis];
+
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+
+			Bin bins[Bins];
+
+			for (GLuint b = 0; b < Bins; b++)
+			{
+				bins[b].boundsMin = glm::vec3(FLT_MAX);
+				bins[b].boundsMax = glm::vec3(-FLT_MAX);
+				bins[b].count = 0;
+			}
+
+			float scale = Bins / extent;
+
+			for (GLuint i = first; i < first + count; i++)
+			{
+				const BuildTriangle &triangle = build[order[i]];
+				GLuint b = std::min((GLuint)((triangle.centroid[axis] - centroidMin[axis]) * scale), Bins - 1);
+				bins[b].boundsMin = glm::min(bins[b].boundsMin, triangle.boundsMin);
+				bins[b].boundsMax = glm::max(bins[b].boundsMax, triangle.boundsMax);
+				bins[b].count++;
+			}
+
+			// Sweeping in from the right, then from the left, gives both sides of every plane
+			float rightCost[Bins];
+			glm::vec3 sideMin(FLT_MAX), sideMax(-FLT_MAX);
+			GLuint sideCount = 0;
+
+			for (GLuint b = Bins - 1; b > 0; b--)
+			{
+				sideMin = glm::min(sideMin, bins[b].boundsMin);
+				sideMax = glm::max(sideMax, bins[b].boundsMax);
+				sideCount += bins[b].count;
+				rightCost[b] = sideCount ? halfArea(sideMin, sideMax) * sideCount : -1.0f;
+			}
+
+			sideMin = glm::vec3(FLT_MAX);
+			sideMax = glm::vec3(-FLT_MAX);
+			sideCount = 0;
+
+			for (GLuint b = 1; b < Bins; b++)
+			{
+				sideMin = glm::min(sideMin, bins[b - 1].boundsMin);
+				sideMax = glm::max(sideMax, bins[b - 1].boundsMax);
+				sideCount += bins[b - 1].count;
+
+				if (!sideCount || rightCost[b] < 0.0f)
+				{
+					continue;
+				}
+
+				float cost = halfArea(sideMin, sideMax) * sideCount + rightCost[b];
+
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		GLuint middle;
+
+		if (bestAxis >= 0)
+		{
+			// A split costs a box test and each side's triangles as often as a ray reaches it
+			float area = halfArea(boundsMin, boundsMax);
+
+			if (count <= MaxLeafTriangles && area > 0.0f && 1.0f + bestCost / area >= (float)count)
+			{
+				return index;
+			}
+
+			float scale = Bins / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+			float axisMin = centroidMin[bestAxis];
+			middle = (GLuint)(std::partition(order.begin() + first, order.begin() + first + count, [&](GLuint t)
+			{
+				return std::min((GLuint)((build[t].centroid[bestAxis] - axisMin) * scale), Bins - 1) < bestBin;
+			}) - order.begin());
+		}
+		else
+		{
+			// The centroids are all in one place, or the tree is deep enough: halves it is
+			if (count <= MaxLeafTriangles && depth < MaxDepth)
+			{
+				return index;
+			}
+
+			glm::vec3 extent = centroidMax - centroidMin;
+			int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : (extent.y >= extent.z) ? 1 : 2;
+			middle = first + count / 2;
+			std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+				[&](GLuint a, GLuint b) { return build[a].centroid[axis] < build[b].centroid[axis]; });
+		}
+
+		GLuint left = split(binary, order, build, first, middle - first, depth + 1);
+		GLuint right = split(binary, order, build, middle, first + count - middle, depth + 1);
+		binary[index].left = left;
+		binary[index].right = right;
+		return index;
+	}
+
+	// Makes a four wide node of the binary node b, opening up the largest of its
+	// descendants until it has four children or only leaves, then does the same for
+	// each child. Returns the node's index.
+	GLuint collapse(const std::vector<BinaryNode> &binary, GLuint b)
+	{
+		GLuint children[4] = { b, 0, 0, 0 }, childCount = 1;
+
+		if (binary[b].left)
+		{
+			children[0] = binary[b].left;
+			children[1] = binary[b].right;
+			childCount = 2;
+		}
+
+		while (childCount < 4)
+		{
+			int largest = -1;
+			float largestArea = -1.0f;
+
+			for (GLuint c = 0; c < childCount; c++)
+			{
+				const BinaryNode &child = binary[children[c]];
+				float area = halfArea(child.boundsMin, child.boundsMax);
+
+				if (child.left && area > largestArea)
+				{
+					largest = c;
+					largestArea = area;
+				}
+			}
+
+			if (largest < 0)
+			{
+				break;
+			}
+
+			GLuint opened = children[largest];
+			children[largest] = binary[opened].left;
+			children[childCount++] = binary[opened].right;
+		}
+
+		GLuint index = (GLuint)this->nodes.size();
+		this->nodes.push_back(Node());
+
+		for (GLuint c = 0; c < 4; c++)
+		{
+			Node &node = this->nodes[index];
+
+			if (c >= childCount)
+			{
+				node.minX[c] = node.minY[c] = node.minZ[c] = FLT_MAX;
+				node.maxX[c] = node.maxY[c] = node.maxZ[c] = -FLT_MAX;
+				node.child[c] = node.count[c] = 0;
+				continue;
+			}
+
+			const BinaryNode &child = binary[children[c]];
+			node.minX[c] = child.boundsMin.x;
+			node.minY[c] = child.boundsMin.y;
+			node.minZ[c] = child.boundsMin.z;
+			node.maxX[c] = child.boundsMax.x;
+			node.maxY[c] = child.boundsMax.y;
+			node.maxZ[c] = child.boundsMax.z;
+
+			if (!child.left)
+			{
+				node.child[c] = child.first;
+				node.count[c] = child.count;
+			}
+			else
+			{
+				// The push in there can move the nodes, so the reference is taken again after
+				GLuint grandchild = this->collapse(binary, children[c]);
+				this->nodes[index].child[c] = grandchild;
+				this->nodes[index].count[c] = 0;
+			}
+		}
+
+		return index;
+	}
+
+	// Where along the ray it enters each of the node's four boxes, and a bit for each it
+	// enters before closest
+	static int enter(const Node &node, const glm::vec3 &origin, const glm::vec3 &inverse, float closest, float *tNear)
+	{
+#if defined(TRIANGLE_BVH_SSE2)
+		__m128 originX = _mm_set1_ps(origin.x), originY = _mm_set1_ps(origin.y), originZ = _mm_set1_ps(origin.z);
+		__m128 inverseX = _mm_set1_ps(inverse.x), inverseY = _mm_set1_ps(inverse.y), inverseZ = _mm_set1_ps(inverse.z);
+
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minX), originX), inverseX);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxX), originX), inverseX);
+		__m128 nearT = _mm_min_ps(t0, t1), farT = _mm_max_ps(t0, t1);
+
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minY), originY), inverseY);
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxY), originY), inverseY);
+		nearT = _mm_max_ps(nearT, _mm_min_ps(t0, t1));
+		farT = _mm_min_ps(farT, _mm_max_ps(t0, t1));
+
+		t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minZ), originZ), inverseZ);
+		t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maxZ), originZ), inverseZ);
+		nearT = _mm_max_ps(_mm_max_ps(nearT, _mm_min_ps(t0, t1)), _mm_setzero_ps());
+		farT = _mm_min_ps(_mm_min_ps(farT, _mm_max_ps(t0, t1)), _mm_set1_ps(closest));
+
+		_mm_storeu_ps(tNear, nearT);
+		return _mm_movemask_ps(_mm_cmple_ps(nearT, farT));
+#else
+		int mask = 0;
+		const float *boundsMin[3] = { node.minX, node.minY, node.minZ }, *boundsMax[3] = { node.maxX, node.maxY, node.maxZ };
+
+		for (int c = 0; c < 4; c++)
+		{
+			float nearT = 0.0f, farT = closest;
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float t0 = (boundsMin[axis][c] - origin[axis]) * inverse[axis], t1 = (boundsMax[axis][c] - origin[axis]) * inverse[axis];
+				nearT = std::max(nearT, std::min(t0, t1));
+				farT = std::min(farT, std::max(t0, t1));
+			}
+
+			tNear[c] = nearT;
+			mask |= (nearT <= farT) << c;
+		}
+
+		return mask;
+#endif
+	}
+
+	// Möller-Trumbore, from either side, nearer than closest
+	static bool intersect(const Triangle &triangle, const Ray &ray, float &closest, RayHit &hit)
+	{
+		glm::vec3 p = glm::cross(ray.direction, triangle.e2);
+		float determinant = glm::dot(triangle.e1, p);
+
+		if (std::fabs(determinant) < 1e-20f)
+		{
+			return false;
+		}
+
+		float inverse = 1.0f / determinant;
+		glm::vec3 s = ray.origin - triangle.v0;
+		float u = glm::dot(s, p) * inverse;
+
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+
+		glm::vec3 q = glm::cross(s, triangle.e1);
+		float v = glm::dot(ray.direction, q) * inverse;
+
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+
+		float t = glm::dot(triangle.e2, q) * inverse;
+
+		if (t <= 0.0f || t >= closest)
+		{
+			return false;
+		}
+
+		closest = t;
+		hit.t = t;
+		hit.u = u;
+		hit.v = v;
+		hit.vertices[0] = triangle.vertices[0];
+		hit.vertices[1] = triangle.vertices[1];
+		hit.vertices[2] = triangle.vertices[2];
+		hit.normal = glm::cross(triangle.e1, triangle.e2);
+		return true;
+	}
+
+	bool traverse(const Ray &ray, RayHit &hit, bool anyHit) const
+	{
+		if (this->nodes.empty())
+		{
+			return false;
+		}
+
+		glm::vec3 inverse = inverseDirection(ray.direction);
+		float closest = ray.tMax;
+		bool found = false;
+		GLuint stack[StackSize];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top)
+		{
+			const Node &node = this->nodes[stack[--top]];
+			float tNear[4];
+			int mask = enter(node, ray.origin, inverse, closest, tNear);
+
+			// The nearest nodes are pushed last, so they're opened first and the hits in
+			// them cut the farther ones short
+			GLuint inner[4];
+			float innerNear[4];
+			int innerCount = 0;
+
+			for (int c = 0; c < 4; c++)
+			{
+				if (!(mask & (1 << c)))
+				{
+					continue;
+				}
+
+				if (node.count[c])
+				{
+					for (GLuint t = node.child[c]; t < node.child[c] + node.count[c]; t++)
+					{
+						if (intersect(this->triangles[t], ray, closest, hit))
+						{
+							found = true;
+
+							if (anyHit)
+							{
+								return true;
+							}
+						}
+					}
+				}
+				else if (node.child[c])
+				{
+					int i = innerCount++;
+
+					for (; i > 0 && innerNear[i - 1] < tNear[c]; i--)
+					{
+						inner[i] = inner[i - 1];
+						innerNear[i] = innerNear[i - 1];
+					}
+
+					inner[i] = node.child[c];
+					innerNear[i] = tNear[c];
+				}
+			}
+
+			for (int i = 0; i < innerCount; i++)
+			{
+				stack[top++] = inner[i];
+			}
+		}
+
+		return found;
+	}
+
+#if defined(TRIANGLE_BVH_SSE2)
+	// A packet's rays, a lane each
+	struct Packet
+	{
+		__m128 originX, originY, originZ;
+		__m128 directionX, directionY, directionZ;
+		__m128 inverseX, inverseY, inverseZ;
+	};
+
+	// The rays in lanes crossing triangle nearer than their closest, as a bit each
+	static int intersectPacket(const Triangle &triangle, const Packet &packet, __m128 &closest, int lanes, RayHit *hits)
+	{
+		__m128 e1X = _mm_set1_ps(triangle.e1.x), e1Y = _mm_set1_ps(triangle.e1.y), e1Z = _mm_set1_ps(triangle.e1.z);
+		__m128 e2X = _mm_set1_ps(triangle.e2.x), e2Y = _mm_set1_ps(triangle.e2.y), e2Z = _mm_set1_ps(triangle.e2.z);
+
+		__m128 pX = _mm_sub_ps(_mm_mul_ps(packet.directionY, e2Z), _mm_mul_ps(packet.directionZ, e2Y));
+		__m128 pY = _mm_sub_ps(_mm_mul_ps(packet.directionZ, e2X), _mm_mul_ps(packet.directionX, e2Z));
+		__m128 pZ = _mm_sub_ps(_mm_mul_ps(packet.directionX, e2Y), _mm_mul_ps(packet.directionY, e2X));
+		__m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1X, pX), _mm_mul_ps(e1Y, pY)), _mm_mul_ps(e1Z, pZ));
+		__m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), determinant);
+
+		__m128 sX = _mm_sub_ps(packet.originX, _mm_set1_ps(triangle.v0.x));
+		__m128 sY = _mm_sub_ps(packet.originY, _mm_set1_ps(triangle.v0.y));
+		__m128 sZ = _mm_sub_ps(packet.originZ, _mm_set1_ps(triangle.v0.z));
+		__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sX, pX), _mm_mul_ps(sY, pY)), _mm_mul_ps(sZ, pZ)), inverse);
+
+		__m128 qX = _mm_sub_ps(_mm_mul_ps(sY, e1Z), _mm_mul_ps(sZ, e1Y));
+		__m128 qY = _mm_sub_ps(_mm_mul_ps(sZ, e1X), _mm_mul_ps(sX, e1Z));
+		__m128 qZ = _mm_sub_ps(_mm_mul_ps(sX, e1Y), _mm_mul_ps(sY, e1X));
+		__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.directionX, qX), _mm_mul_ps(packet.directionY, qY)), _mm_mul_ps(packet.directionZ, qZ)), inverse);
+		__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2X, qX), _mm_mul_ps(e2Y, qY)), _mm_mul_ps(e2Z, qZ)), inverse);
+
+		__m128 zero = _mm_setzero_ps();
+		__m128 inside = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), determinant), _mm_set1_ps(1e-20f));
+		inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(v, zero)));
+		inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+		inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, closest)));
+
+		int mask = _mm_movemask_ps(inside) & lanes;
+
+		if (!mask)
+		{
+			return 0;
+		}
+
+		float ts[4], us[4], vs[4], closests[4];
+		_mm_storeu_ps(ts, t);
+		_mm_storeu_ps(us, u);
+		_mm_storeu_ps(vs, v);
+		_mm_storeu_ps(closests, closest);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if (mask & (1 << lane))
+			{
+				closests[lane] = hits[lane].t = ts[lane];
+				hits[lane].u = us[lane];
+				hits[lane].v = vs[lane];
+				hits[lane].vertices[0] = triangle.vertices[0];
+				hits[lane].vertices[1] = triangle.vertices[1];
+				hits[lane].vertices[2] = triangle.vertices[2];
+				hits[lane].normal = glm::cross(triangle.e1, triangle.e2);
+			}
+		}
+
+		closest = _mm_loadu_ps(closests);
+		return mask;
+	}
+#endif
+
+	// The packet goes down every node any of its rays still needs, each box and each
+	// triangle tested against all four rays at once
+	GLuint traversePacket(const Ray *rays, RayHit *hits, bool anyHit) const
+	{
+#if defined(TRIANGLE_BVH_SSE2)
+		if (this->nodes.empty())
+		{
+			return 0;
+		}
+
+		Packet packet;
+		glm::vec3 inverse[4];
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			inverse[lane] = inverseDirection(rays[lane].direction);
+		}
+
+		packet.originX = _mm_setr_ps(rays[0].origin.x, rays[1].origin.x, rays[2].origin.x, rays[3].origin.x);
+		packet.originY = _mm_setr_ps(rays[0].origin.y, rays[1].origin.y, rays[2].origin.y, rays[3].origin.y);
+		packet.originZ = _mm_setr_ps(rays[0].origin.z, rays[1].origin.z, rays[2].origin.z, rays[3].origin.z);
+		packet.directionX = _mm_setr_ps(rays[0].direction.x, rays[1].direction.x, rays[2].direction.x, rays[3].direction.x);
+		packet.directionY = _mm_setr_ps(rays[0].direction.y, rays[1].direction.y, rays[2].direction.y, rays[3].direction.y);
+		packet.directionZ = _mm_setr_ps(rays[0].direction.z, rays[1].direction.z, rays[2].direction.z, rays[3].direction.z);
+		packet.inverseX = _mm_setr_ps(inverse[0].x, inverse[1].x, inverse[2].x, inverse[3].x);
+		packet.inverseY = _mm_setr_ps(inverse[0].y, inverse[1].y, inverse[2].y, inverse[3].y);
+		packet.inverseZ = _mm_setr_ps(inverse[0].z, inverse[1].z, inverse[2].z, inverse[3].z);
+		__m128 closest = _mm_setr_ps(rays[0].tMax, rays[1].tMax, rays[2].tMax, rays[3].tMax);
+
+		int active = 0xF, found = 0;
+		GLuint stack[StackSize];
+		int top = 0;
+		stack[top++] = 0;
+
+		while (top && active)
+		{
+			const Node &node = this->nodes[stack[--top]];
+
+			for (int c = 0; c < 4 && active; c++)
+			{
+				if (!node.count[c] && !node.child[c])
+				{
+					continue;
+				}
+
+				__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minX[c]), packet.originX), packet.inverseX);
+				__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maxX[c]), packet.originX), packet.inverseX);
+				__m128 nearT = _mm_min_ps(t0, t1), farT = _mm_max_ps(t0, t1);
+
+				t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minY[c]), packet.originY), packet.inverseY);
+				t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maxY[c]), packet.originY), packet.inverseY);
+				nearT = _mm_max_ps(nearT, _mm_min_ps(t0, t1));
+				farT = _mm_min_ps(farT, _mm_max_ps(t0, t1));
+
+				t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.minZ[c]), packet.originZ), packet.inverseZ);
+				t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.maxZ[c]), packet.originZ), packet.inverseZ);
+				nearT = _mm_max_ps(_mm_max_ps(nearT, _mm_min_ps(t0, t1)), _mm_setzero_ps());
+				farT = _mm_min_ps(_mm_min_ps(farT, _mm_max_ps(t0, t1)), closest);
+
+				int lanes = _mm_movemask_ps(_mm_cmple_ps(nearT, farT)) & active;
+
+				if (!lanes)
+				{
+					continue;
+				}
+
+				if (!node.count[c])
+				{
+					stack[top++] = node.child[c];
+					continue;
+				}
+
+				for (GLuint t = node.child[c]; t < node.child[c] + node.count[c] && lanes; t++)
+				{
+					int hit = intersectPacket(this->triangles[t], packet, closest, lanes, hits);
+					found |= hit;
+
+					// A ray that only needs a hit is done with the first
+					if (anyHit)
+					{
+						active &= ~hit;
+						lanes &= ~hit;
+					}
+				}
+			}
+		}
+
+		return (GLuint)found;
+#else
+		GLuint found = 0;
+
+		for (GLuint lane = 0; lane < PacketSize; lane++)
+		{
+			found |= (GLuint)this->traverse(rays[lane], hits[lane], anyHit) << lane;
+		}
+
+		return found;
+#endif
+	}
+};